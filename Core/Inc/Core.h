@@ -289,6 +289,7 @@ enum EFileWrite
 enum EFileRead
 {
 	FILEREAD_NoFail             = 0x01,
+	FILEREAD_Mapped             = 0x02, // Only honoured by FFileManagerMapped.
 };
 class CORE_API FFileManager
 {
@@ -380,6 +381,7 @@ extern "C" DLL_EXPORT TCHAR GPackage[];
 
 // Normal includes.
 #include "UnFile.h"     // Low level utility code.
+#include "UnThread.h"   // Threading primitives.
 #include "UnArc.h"      // Archive class.
 #include "UnTemplate.h" // Dynamic arrays.
 #include "UnName.h"     // Global name subsystem.
@@ -388,8 +390,13 @@ extern "C" DLL_EXPORT TCHAR GPackage[];
 #include "UnCoreNet.h"  // Core networking.
 #include "UnCorObj.h"		// Core object class definitions.
 #include "UnClass.h"		// Class definition.
+#include "UnObjHash.h"	// Resizable object lookup.
+#include "UnGarbage.h"	// Parallel garbage collector.
 #include "UnType.h"			// Base property type.
 #include "UnScript.h"		// Script class.
+#include "UnFuncCache.h"	// Cached function lookups.
+#include "UnPropPlan.h"	// Property construction plans.
+#include "UnLocalize.h"	// Interned localized text.
 #include "UnFactory.h"  // Factory definition.
 #include "UnExporter.h" // Exporter definition.
 #include "UnCache.h"    // Cache based memory management.
@@ -397,6 +404,7 @@ extern "C" DLL_EXPORT TCHAR GPackage[];
 #include "UnCid.h"      // Cache ID's.
 #include "UnBits.h"     // Bitstream archiver.
 #include "UnMath.h"     // Vector math functions.
+#include "UnMathBatch.h" // Batched vector math.
 
 /*-----------------------------------------------------------------------------
 	The End.
@@ -21,54 +21,221 @@ public:
 	Burrows-Wheeler inspired data compressor.
 -----------------------------------------------------------------------------*/
 
+//
+// Blocks are sorted with SA-IS in linear time instead of comparing suffixes,
+// which degraded badly on repetitive data. All state lives in the sort work
+// items, so several blocks are sorted at once on GThreadPool (which needs a
+// thread safe GMalloc, the work items themselves don't allocate). The
+// output is identical to the old comparison sort.
+//
 class FCodecBWT : public FCodec
 {
 private:
 	enum {MAX_BUFFER_SIZE=0x40000}; /* Hand tuning suggests this is an ideal size */
-	static BYTE* CompressBuffer;
-	static INT CompressLength;
-	static INT ClampedBufferCompare( const INT* P1, const INT* P2 )
+	enum {MAX_PARALLEL_BLOCKS=8};
+	enum {ALPHABET_SIZE=258};
+
+	// Transforms one block. Buffers are allocated up front by the caller.
+	class FSortWork;
+	friend class FSortWork;
+	class FSortWork : public FQueuedWork
+	{
+	public:
+		TArray<BYTE> Buffer, Result;
+		TArray<INT>  Text, Suffixes, Arena;
+		INT Length, First, Last;
+		FSortWork( INT MaxLength )
+		:	Buffer( MaxLength )
+		,	Result( MaxLength+1 )
+		,	Text( MaxLength+2 )
+		,	Suffixes( MaxLength+2 )
+		,	Arena( 4*(MaxLength+2)+2*ALPHABET_SIZE+64 )
+		,	Length( 0 )
+		,	First( 0 )
+		,	Last( 0 )
+		{}
+		void DoThreadedWork()
+		{
+			FCodecBWT::Transform( *this );
+		}
+	};
+
+	// The old comparison sort put a suffix after all suffixes it is a prefix
+	// of, so the block gets an end symbol above all bytes (257) and a unique
+	// smallest terminator (0) for SA-IS, which sorts first and is skipped.
+	static void Transform( FSortWork& Work )
+	{
+		INT N = Work.Length, i;
+		for( i=0; i<N; i++ )
+			Work.Text(i) = Work.Buffer(i)+1;
+		Work.Text(N+0) = ALPHABET_SIZE-1;
+		Work.Text(N+1) = 0;
+		SuffixSort( &Work.Text(0), &Work.Suffixes(0), N+2, ALPHABET_SIZE, &Work.Arena(0) );
+		for( i=0; i<N+1; i++ )
+		{
+			INT P = Work.Suffixes(i+1);
+			if( P==1 )
+				Work.First = i;
+			else if( P==0 )
+				Work.Last = i;
+			Work.Result(i) = Work.Buffer(P?P-1:0);
+		}
+	}
+
+	// SA-IS suffix sorting (Nong, Zhang & Chan). Text must end in a unique
+	// smallest symbol 0 and all symbols must be below K. Workspace is taken
+	// from Arena, which needs 4*N+2*K+64 entries over all recursion levels.
+	static void SuffixSort( const INT* Text, INT* SA, INT N, INT K, INT* Arena )
+	{
+		INT* Type   = Arena;
+		INT* Count  = Type+N;
+		INT* Bucket = Count+K;
+		Arena       = Bucket+K;
+		INT i, j;
+
+		// Classify suffixes as S (1) or L (0) type.
+		Type[N-1] = 1;
+		for( i=N-2; i>=0; i-- )
+			Type[i] = Text[i]<Text[i+1] || (Text[i]==Text[i+1] && Type[i+1]);
+		for( i=0; i<K; i++ )
+			Count[i] = 0;
+		for( i=0; i<N; i++ )
+			Count[Text[i]]++;
+
+		// Sort the LMS substrings by inducing from their unsorted positions.
+		for( i=0; i<N; i++ )
+			SA[i] = -1;
+		GetBuckets( Count, Bucket, K, 1 );
+		for( i=1; i<N; i++ )
+			if( IsLMS(Type,i) )
+				SA[--Bucket[Text[i]]] = i;
+		Induce( Text, SA, N, K, Type, Count, Bucket );
+
+		// Compact the sorted LMS substrings and name them.
+		INT N1 = 0;
+		for( i=0; i<N; i++ )
+			if( IsLMS(Type,SA[i]) )
+				SA[N1++] = SA[i];
+		for( i=N1; i<N; i++ )
+			SA[i] = -1;
+		INT Name=0, Prev=-1;
+		for( i=0; i<N1; i++ )
+		{
+			INT Pos=SA[i], Diff=0;
+			for( INT d=0; d<N; d++ )
+			{
+				if( Prev==-1 || Text[Pos+d]!=Text[Prev+d] || Type[Pos+d]!=Type[Prev+d] )
+				{
+					Diff = 1;
+					break;
+				}
+				else if( d>0 && (IsLMS(Type,Pos+d) || IsLMS(Type,Prev+d)) )
+					break;
+			}
+			if( Diff )
+			{
+				Name++;
+				Prev = Pos;
+			}
+			SA[N1+Pos/2] = Name-1;
+		}
+		for( i=N-1, j=N-1; i>=N1; i-- )
+			if( SA[i]>=0 )
+				SA[j--] = SA[i];
+
+		// Sort the reduced string, recursing while names aren't unique.
+		INT* Text1 = SA+N-N1;
+		if( Name<N1 )
+			SuffixSort( Text1, SA, N1, Name, Arena );
+		else
+			for( i=0; i<N1; i++ )
+				SA[Text1[i]] = i;
+
+		// Induce the final order from the sorted LMS suffixes.
+		for( i=1, j=0; i<N; i++ )
+			if( IsLMS(Type,i) )
+				Text1[j++] = i;
+		for( i=0; i<N1; i++ )
+			SA[i] = Text1[SA[i]];
+		for( i=N1; i<N; i++ )
+			SA[i] = -1;
+		GetBuckets( Count, Bucket, K, 1 );
+		for( i=N1-1; i>=0; i-- )
+		{
+			j     = SA[i];
+			SA[i] = -1;
+			SA[--Bucket[Text[j]]] = j;
+		}
+		Induce( Text, SA, N, K, Type, Count, Bucket );
+	}
+	static UBOOL IsLMS( const INT* Type, INT i )
 	{
-		guardSlow(FCodecBWT::ClampedBufferCompare);
-		BYTE* B1 = CompressBuffer + *P1;
-		BYTE* B2 = CompressBuffer + *P2;
-		for( INT Count=CompressLength-Max(*P1,*P2); Count>0; Count--,B1++,B2++ )
+		return i>0 && Type[i] && !Type[i-1];
+	}
+	static void GetBuckets( const INT* Count, INT* Bucket, INT K, UBOOL End )
+	{
+		for( INT i=0, Sum=0; i<K; i++ )
 		{
-			if( *B1 < *B2 )
-				return -1;
-			else if( *B1 > *B2 )
-				return 1;
+			Sum += Count[i];
+			Bucket[i] = End ? Sum : Sum-Count[i];
 		}
-		return *P1 - *P2;
-		unguardSlow;
 	}
+	static void Induce( const INT* Text, INT* SA, INT N, INT K, const INT* Type, const INT* Count, INT* Bucket )
+	{
+		INT i, j;
+		GetBuckets( Count, Bucket, K, 0 );
+		for( i=0; i<N; i++ )
+			if( (j=SA[i]-1)>=0 && !Type[j] )
+				SA[Bucket[Text[j]]++] = j;
+		GetBuckets( Count, Bucket, K, 1 );
+		for( i=N-1; i>=0; i-- )
+			if( (j=SA[i]-1)>=0 && Type[j] )
+				SA[--Bucket[Text[j]]] = j;
+	}
+
+	UBOOL Parallel;
+
 public:
+	// Constructors. Pass InParallel=0 when encoding on a pool thread.
+	FCodecBWT( UBOOL InParallel=1 )
+	:	Parallel( InParallel )
+	{}
+
+	// FCodec interface.
 	UBOOL Encode( FArchive& In, FArchive& Out )
 	{
 		guard(FCodecBWT::Encode);
-		TArray<BYTE> CompressBufferArray(MAX_BUFFER_SIZE);
-		TArray<INT>  CompressPosition   (MAX_BUFFER_SIZE+1);
-		CompressBuffer = &CompressBufferArray(0);
-		INT i, First=0, Last=0;
+		INT Remaining = In.TotalSize()-In.Tell();
+		INT NumWork   = Min<INT>( (Remaining+MAX_BUFFER_SIZE-1)/MAX_BUFFER_SIZE, MAX_PARALLEL_BLOCKS );
+		if( !Parallel || !GThreadPool )
+			NumWork = 1;
+		else if( NumWork>GThreadPool->GetNumThreads()+1 )
+			NumWork = GThreadPool->GetNumThreads()+1;
+		FSortWork*   Work [MAX_PARALLEL_BLOCKS];
+		FQueuedWork* Queue[MAX_PARALLEL_BLOCKS];
+		INT i;
+		for( i=0; i<NumWork; i++ )
+			Queue[i] = Work[i] = new FSortWork( Min<INT>(Remaining,MAX_BUFFER_SIZE) );
 		while( !In.AtEnd() )
 		{
-			CompressLength = Min<INT>( In.TotalSize()-In.Tell(), MAX_BUFFER_SIZE );
-			In.Serialize( CompressBuffer, CompressLength );
-			for( i=0; i<CompressLength+1; i++ )
-				CompressPosition(i) = i;
-			appQsort( &CompressPosition(0), CompressLength+1, sizeof(INT), (QSORT_COMPARE)ClampedBufferCompare );
-			for( i=0; i<CompressLength+1; i++ )
-				if( CompressPosition(i)==1 )
-					First = i;
-				else if( CompressPosition(i)==0 )
-					Last = i;
-			Out << CompressLength << First << Last;
-			for( i=0; i<CompressLength+1; i++ )
-				Out << CompressBuffer[CompressPosition(i)?CompressPosition(i)-1:0];
-			//GWarn->Logf(TEXT("Compression table"));
-			//for( i=0; i<CompressLength+1; i++ )
-			//	GWarn->Logf(TEXT("    %03i: %s"),CompressPosition(i)?CompressBuffer[CompressPosition(i)-1]:-1,appFromAnsi((ANSICHAR*)CompressBuffer+CompressPosition(i)));
+			INT Num=0;
+			for( ; Num<NumWork && !In.AtEnd(); Num++ )
+			{
+				Work[Num]->Length = Min<INT>( In.TotalSize()-In.Tell(), MAX_BUFFER_SIZE );
+				In.Serialize( &Work[Num]->Buffer(0), Work[Num]->Length );
+			}
+			if( Num>1 )
+				FQueuedWorkBatch( Queue, Num ).Run();
+			else
+				Work[0]->DoThreadedWork();
+			for( i=0; i<Num; i++ )
+			{
+				Out << Work[i]->Length << Work[i]->First << Work[i]->Last;
+				Out.Serialize( &Work[i]->Result(0), Work[i]->Length+1 );
+			}
 		}
+		for( i=0; i<NumWork; i++ )
+			delete Work[i];
 		return 0;
 		unguard;
 	}
@@ -108,8 +275,6 @@ public:
 		unguard;
 	}
 };
-BYTE* FCodecBWT::CompressBuffer;
-INT   FCodecBWT::CompressLength;
 
 /*-----------------------------------------------------------------------------
 	RLE compressor.
@@ -179,7 +344,11 @@ public:
 	Huffman codec.
 -----------------------------------------------------------------------------*/
 
-class FCodecHuffman : public FCodec
+//
+// Original Huffman codec, building a node tree. Kept as the reference for
+// FCodecHuffman, which reads and writes the same format.
+//
+class FCodecHuffmanTree : public FCodec
 {
 private:
 	struct FHuffman
@@ -236,7 +405,7 @@ private:
 public:
 	UBOOL Encode( FArchive& In, FArchive& Out )
 	{
-		guard(FCodecHuffman::Encode);
+		guard(FCodecHuffmanTree::Encode);
 		INT SavedPos = In.Tell();
 		INT Total=0, i;
 
@@ -299,7 +468,7 @@ public:
 	}
 	UBOOL Decode( FArchive& In, FArchive& Out )
 	{
-		guard(FCodecHuffman::Decode);
+		guard(FCodecHuffmanTree::Decode);
 		INT Total;
 		In << Total;
 		TArray<BYTE> InArray( In.TotalSize()-In.Tell() );
@@ -321,6 +490,251 @@ public:
 	}
 };
 
+//
+// Huffman codec using flat tables, reads and writes the same format as
+// FCodecHuffmanTree: the symbol count, the code tree in preorder (1 for an
+// inner node followed by both children, 0 for a leaf followed by its byte)
+// and the codes, all LSB first.
+//
+// Encode builds canonical codes limited to MAX_CODE_BITS from fixed arrays
+// and writes the tree they form. Decode reads any tree, so older data still
+// loads, and resolves up to LOOKUP_BITS bits per lookup; longer codes finish
+// by walking the tree.
+//
+class FCodecHuffman : public FCodec
+{
+private:
+	enum {MAX_CODE_BITS=24};
+	enum {LOOKUP_BITS=10};
+	enum {MAX_NODES=511};
+
+	// Code tree in flat arrays. Symbol is -1 for inner nodes.
+	struct FTree
+	{
+		INT Num;
+		INT Child[MAX_NODES][2];
+		INT Symbol[MAX_NODES];
+		FTree()
+		:	Num( 0 )
+		{}
+		INT AddNode()
+		{
+			check(Num<MAX_NODES);
+			Child[Num][0] = Child[Num][1] = -1;
+			Symbol[Num] = -1;
+			return Num++;
+		}
+	};
+
+	// Resolves a code prefix of up to LOOKUP_BITS bits.
+	struct FLookup
+	{
+		_WORD Value; // Symbol if Leaf, else node to continue at.
+		BYTE  Bits;
+		BYTE  Leaf;
+	};
+
+	// Computes code lengths for the used symbols. Frequencies are flattened
+	// until no code exceeds MAX_CODE_BITS, as bzip2 does.
+	static void BuildLengths( const INT* InCount, BYTE* Length )
+	{
+		INT Count[256], Weight[MAX_NODES], Parent[MAX_NODES], i, j;
+		for( i=0; i<256; i++ )
+			Count[i] = InCount[i];
+		for( ;; )
+		{
+			INT Num=0, MaxLength=0;
+			for( i=0; i<256; i++ )
+			{
+				Weight[i] = Count[i];
+				Parent[i] = -1;
+				Num      += Count[i]!=0;
+			}
+			for( INT Nodes=256; Num>1; Nodes++, Num-- )
+			{
+				// Join the two lightest roots.
+				INT A=-1, B=-1;
+				for( j=0; j<Nodes; j++ )
+					if( Parent[j]==-1 && Weight[j] )
+					{
+						if( A==-1 || Weight[j]<Weight[A] )
+							B = A, A = j;
+						else if( B==-1 || Weight[j]<Weight[B] )
+							B = j;
+					}
+				Weight[Nodes] = Weight[A] + Weight[B];
+				Parent[Nodes] = -1;
+				Parent[A] = Parent[B] = Nodes;
+			}
+			for( i=0; i<256; i++ )
+			{
+				Length[i] = 0;
+				if( Count[i] )
+				{
+					for( j=i; Parent[j]!=-1; j=Parent[j] )
+						Length[i]++;
+					MaxLength = Max<INT>( MaxLength, Length[i] );
+				}
+			}
+			if( MaxLength<=MAX_CODE_BITS )
+				break;
+			for( i=0; i<256; i++ )
+				if( Count[i] )
+					Count[i] = Count[i]/2 + 1;
+		}
+	}
+	static void WriteTable( const FTree& Tree, INT Node, FWordBitWriter& Writer )
+	{
+		if( Tree.Symbol[Node]==-1 )
+		{
+			Writer.WriteBits( 1, 1 );
+			WriteTable( Tree, Tree.Child[Node][0], Writer );
+			WriteTable( Tree, Tree.Child[Node][1], Writer );
+		}
+		else Writer.WriteBits( Tree.Symbol[Node]<<1, 9 );
+	}
+	static INT ReadTable( FTree& Tree, FWordBitReader& Reader )
+	{
+		INT Node = Tree.AddNode();
+		check(!Reader.IsError());
+		if( Reader.ReadBits(1) )
+		{
+			INT Child0 = ReadTable( Tree, Reader );
+			INT Child1 = ReadTable( Tree, Reader );
+			Tree.Child[Node][0] = Child0;
+			Tree.Child[Node][1] = Child1;
+		}
+		else Tree.Symbol[Node] = Reader.ReadBits(8);
+		return Node;
+	}
+	static void FillLookup( const FTree& Tree, INT Node, INT Depth, INT Prefix, FLookup* Lookup )
+	{
+		if( Tree.Symbol[Node]==-1 && Depth<LOOKUP_BITS )
+		{
+			FillLookup( Tree, Tree.Child[Node][0], Depth+1, Prefix,            Lookup );
+			FillLookup( Tree, Tree.Child[Node][1], Depth+1, Prefix|(1<<Depth), Lookup );
+			return;
+		}
+		FLookup Entry;
+		Entry.Leaf  = Tree.Symbol[Node]!=-1;
+		Entry.Value = Entry.Leaf ? Tree.Symbol[Node] : Node;
+		Entry.Bits  = Depth;
+		for( INT i=Prefix; i<(1<<LOOKUP_BITS); i+=(1<<Depth) )
+			Lookup[i] = Entry;
+	}
+
+public:
+	UBOOL Encode( FArchive& In, FArchive& Out )
+	{
+		guard(FCodecHuffman::Encode);
+		INT Total = In.TotalSize()-In.Tell(), i, j;
+		TArray<BYTE> InArray( Total );
+		if( Total )
+			In.Serialize( &InArray(0), Total );
+		Out << Total;
+
+		// Compute character frequencies and code lengths.
+		INT Count[256];
+		BYTE Length[256];
+		for( i=0; i<256; i++ )
+			Count[i] = 0;
+		for( i=0; i<Total; i++ )
+			Count[InArray(i)]++;
+		BuildLengths( Count, Length );
+
+		// Assign canonical codes, ordered by length and symbol.
+		DWORD Code[256], Reversed[256], NextCode=0;
+		INT Bits = 0;
+		for( j=1; j<=MAX_CODE_BITS; j++, NextCode<<=1 )
+			for( i=0; i<256; i++ )
+				if( Length[i]==j )
+					Code[i] = NextCode++;
+		for( i=0; i<256; i++ )
+		{
+			Reversed[i] = 0;
+			for( j=0; j<Length[i]; j++ )
+				Reversed[i] |= ((Code[i]>>(Length[i]-1-j))&1) << j;
+			Bits += Count[i]*Length[i];
+		}
+
+		// Build the tree the codes form. One or no symbols get a single leaf.
+		FTree Tree;
+		Tree.AddNode();
+		for( i=0; i<256; i++ )
+		{
+			if( Length[i] )
+			{
+				INT Node = 0;
+				for( j=Length[i]-1; j>=0; j-- )
+				{
+					INT& Next = Tree.Child[Node][(Code[i]>>j)&1];
+					if( Next==-1 )
+						Next = Tree.AddNode();
+					Node = Next;
+				}
+				Tree.Symbol[Node] = i;
+			}
+			else if( Tree.Num==1 && Count[i] )
+				Tree.Symbol[0] = i;
+		}
+		if( Tree.Symbol[0]==-1 && Tree.Child[0][0]==-1 )
+			Tree.Symbol[0] = 0;
+		Bits += (Tree.Num+1)/2*8 + Tree.Num;
+
+		// Save table and bitstream.
+		FWordBitWriter Writer( Bits );
+		WriteTable( Tree, 0, Writer );
+		for( i=0; i<Total; i++ )
+			Writer.WriteBits( Reversed[InArray(i)], Length[InArray(i)] );
+		check(!Writer.IsError());
+		check(Writer.GetNumBits()==Bits);
+		Out.Serialize( Writer.GetData(), Writer.GetNumBytes() );
+		return 0;
+		unguard;
+	}
+	UBOOL Decode( FArchive& In, FArchive& Out )
+	{
+		guard(FCodecHuffman::Decode);
+		INT Total;
+		In << Total;
+		TArray<BYTE> InArray( In.TotalSize()-In.Tell() );
+		if( InArray.Num() )
+			In.Serialize( &InArray(0), InArray.Num() );
+		FWordBitReader Reader( InArray.Num() ? &InArray(0) : NULL, InArray.Num()*8 );
+
+		// Read the tree and build the lookup table.
+		FTree Tree;
+		ReadTable( Tree, Reader );
+		FLookup Lookup[1<<LOOKUP_BITS];
+		FillLookup( Tree, 0, 0, 0, Lookup );
+
+		// Decode.
+		TArray<BYTE> OutArray( Max(Total,0) );
+		for( INT i=0; i<Total; i++ )
+		{
+			check(!Reader.AtEnd());
+			const FLookup& Entry = Lookup[Reader.PeekBits(LOOKUP_BITS)];
+			Reader.SkipBits( Entry.Bits );
+			INT Node = Entry.Value;
+			if( !Entry.Leaf )
+			{
+				while( Tree.Symbol[Node]==-1 )
+				{
+					check(!Reader.AtEnd());
+					Node = Tree.Child[Node][Reader.ReadBit()];
+				}
+				Node = Tree.Symbol[Node];
+			}
+			OutArray(i) = Node;
+		}
+		check(Reader.GetPosBits()<=Reader.GetNumBits());
+		if( OutArray.Num() )
+			Out.Serialize( &OutArray(0), OutArray.Num() );
+		return 1;
+		unguard;
+	}
+};
+
 /*-----------------------------------------------------------------------------
 	Move-to-front encoder.
 -----------------------------------------------------------------------------*/
@@ -0,0 +1,464 @@
+/*=============================================================================
+	FCompressedPackage.h: Block compressed package container.
+	Copyright 2016-2019 Sebastian Kaufel, Inc. All Rights Reserved.
+
+	Notes:
+	* This file contains the implementation, include it only once (e.g. in
+	  the launcher) after FCodec.h and FFileManagerMapped.h, and use
+	  FFileManagerCompressed in place of FFileManagerMapped.
+	* A container holds an unmodified package, cut into blocks which are
+	  compressed on their own with the FCodecFull stages (RLE, BWT, MTF,
+	  RLE, Huffman). The block index lives in the container header, as
+	  FPackageFileSummary's layout is fixed by Core.dll. The package inside
+	  is untouched, so ULinkerLoad reads it through the container reader
+	  like any other file.
+	* Reads only decode the blocks they touch. ULinkerLoad calls Precache()
+	  with the size of each export before loading it, which hands the
+	  blocks it covers to GThreadPool. Decoding on pool threads needs a
+	  thread safe GMalloc.
+	* Use "COMPRESSPACKAGE <Src> <Dest> [BLOCKSIZE=<bytes>]" to create one.
+	  Blocks are encoded in parallel on GThreadPool as well.
+
+	Layout:
+		INT  Tag               PACKAGE_CONTAINER_TAG
+		INT  Version           PACKAGE_CONTAINER_VERSION
+		INT  UncompressedSize
+		INT  BlockSize         All blocks but the last are this big.
+		INT  NumBlocks
+		INT  Offset, Size      For each block, into the container file.
+		...  Block data.
+=============================================================================*/
+
+enum {PACKAGE_CONTAINER_TAG     = 0x43415055}; // "UPAC".
+enum {PACKAGE_CONTAINER_VERSION = 1         };
+
+/*-----------------------------------------------------------------------------
+	FBlockCodec.
+-----------------------------------------------------------------------------*/
+
+//
+// Codes a single block through the FCodecFull stages, without the logging
+// FCodecFull does. Both may run on any thread.
+//
+class FBlockCodec
+{
+public:
+	static void Encode( const TArray<BYTE>& In, TArray<BYTE>& Out )
+	{
+		guard(FBlockCodec::Encode);
+		FCodecRLE RLE1;
+		FCodecBWT BWT( 0 );
+		FCodecMTF MTF;
+		FCodecRLE RLE2;
+		FCodecHuffman Huffman;
+		FCodec* Stages[] = { &RLE1, &BWT, &MTF, &RLE2, &Huffman };
+		Code( In, Out, Stages, ARRAY_COUNT(Stages), &FCodec::Encode );
+		unguard;
+	}
+	static void Decode( const TArray<BYTE>& In, TArray<BYTE>& Out )
+	{
+		guard(FBlockCodec::Decode);
+		FCodecHuffman Huffman;
+		FCodecRLE RLE2;
+		FCodecMTF MTF;
+		FCodecBWT BWT;
+		FCodecRLE RLE1;
+		FCodec* Stages[] = { &Huffman, &RLE2, &MTF, &BWT, &RLE1 };
+		Code( In, Out, Stages, ARRAY_COUNT(Stages), &FCodec::Decode );
+		unguard;
+	}
+
+private:
+	static void Code( const TArray<BYTE>& In, TArray<BYTE>& Out, FCodec** Stages, INT NumStages, UBOOL (FCodec::*Func)(FArchive&,FArchive&) )
+	{
+		TArray<BYTE> Temp[2];
+		const TArray<BYTE>* Src = &In;
+		for( INT i=0; i<NumStages; i++ )
+		{
+			TArray<BYTE>& Dest = i<NumStages-1 ? Temp[i&1] : Out;
+			Dest.Empty();
+			FBufferReader Reader( *Src );
+			FBufferWriter Writer( Dest );
+			(Stages[i]->*Func)( Reader, Writer );
+			Src = &Dest;
+		}
+	}
+};
+
+/*-----------------------------------------------------------------------------
+	FArchiveCompressedReader.
+-----------------------------------------------------------------------------*/
+
+//
+// Reads the package inside a container, see notes above. Owns the archive
+// it reads the container from.
+//
+class FArchiveCompressedReader : public FArchive
+{
+public:
+	enum {MAX_CACHED_BLOCKS=16};
+
+	// Constructors.
+	FArchiveCompressedReader( FArchive* InInner, const TCHAR* InFilename, FOutputDevice* InError )
+	:	Inner( InInner )
+	,	Filename( InFilename )
+	,	Error( InError )
+	,	Pos( 0 )
+	,	Size( 0 )
+	,	BlockSize( 0 )
+	,	UseCount( 0 )
+	{
+		guard(FArchiveCompressedReader::FArchiveCompressedReader);
+		ArIsLoading = ArIsPersistent = 1;
+
+		// Header and block index.
+		INT Tag=0, Version=0, NumBlocks=0;
+		Inner->Seek( 0 );
+		*Inner << Tag << Version << Size << BlockSize << NumBlocks;
+		if( Tag!=PACKAGE_CONTAINER_TAG || Version!=PACKAGE_CONTAINER_VERSION || Size<0 || BlockSize<=0 || NumBlocks!=(Size+BlockSize-1)/BlockSize )
+		{
+			ArIsError = 1;
+			Error->Logf( TEXT("Bad package container %s"), *Filename );
+			return;
+		}
+		Blocks.AddZeroed( NumBlocks );
+		for( INT i=0; i<NumBlocks; i++ )
+			*Inner << Blocks(i).Offset << Blocks(i).CompressedSize;
+		unguard;
+	}
+	~FArchiveCompressedReader()
+	{
+		guard(FArchiveCompressedReader::~FArchiveCompressedReader);
+		for( INT i=0; i<Blocks.Num(); i++ )
+			WaitForBlock( Blocks(i) );
+		delete Inner;
+		unguard;
+	}
+
+	// FArchive interface.
+	void Serialize( void* V, INT Length )
+	{
+		guardSlow(FArchiveCompressedReader::Serialize);
+		if( Length<0 || Pos+Length>Size )
+		{
+			ArIsError = 1;
+			Error->Logf( TEXT("ReadFile beyond EOF %i+%i/%i (%s)"), Pos, Length, Size, *Filename );
+			return;
+		}
+		while( Length>0 )
+		{
+			INT    Offset = Pos%BlockSize;
+			BYTE*  Data   = GetBlock( Pos/BlockSize );
+			INT    Count  = Min( Length, BlockSize-Offset );
+			appMemcpy( V, Data+Offset, Count );
+			V       = (BYTE*)V + Count;
+			Pos    += Count;
+			Length -= Count;
+		}
+		unguardSlow;
+	}
+	void Seek( INT InPos )
+	{
+		guard(FArchiveCompressedReader::Seek);
+		if( InPos<0 || InPos>Size )
+		{
+			ArIsError = 1;
+			Error->Logf( TEXT("Seek Failed %i/%i (%s)"), InPos, Size, *Filename );
+			return;
+		}
+		Pos = InPos;
+		unguard;
+	}
+	INT Tell()
+	{
+		return Pos;
+	}
+	INT TotalSize()
+	{
+		return Size;
+	}
+	void Precache( INT HintCount )
+	{
+		guard(FArchiveCompressedReader::Precache);
+		if( !GThreadPool || HintCount<=0 )
+			return;
+		// Not further ahead than the cache holds, or they'd evict each other.
+		INT First = Pos/BlockSize;
+		INT Last  = Min( (Min(Pos+HintCount,Size)-1)/BlockSize, First+MAX_CACHED_BLOCKS/2-1 );
+		for( INT i=First; i<=Last && i<Blocks.Num(); i++ )
+			if( Blocks(i).State==BLOCK_Empty )
+				StartDecode( i );
+		unguard;
+	}
+
+private:
+	FArchiveCompressedReader( const FArchiveCompressedReader& );
+	void operator=( const FArchiveCompressedReader& );
+
+	// Block states.
+	enum EBlockState
+	{
+		BLOCK_Empty,	// Not decoded.
+		BLOCK_Decoding,	// Queued on GThreadPool.
+		BLOCK_Ready,	// Data holds the block.
+	};
+
+	// A block. Data belongs to the decoder while Decoding.
+	struct FBlock
+	{
+		INT				Offset;
+		INT				CompressedSize;
+		volatile INT	State;
+		INT				LastUse;
+		TArray<BYTE>	Data;
+	};
+
+	// Decodes a block on a pool thread, deletes itself.
+	class FDecodeWork : public FQueuedWork
+	{
+	public:
+		FBlock*			Block;
+		TArray<BYTE>	Compressed;
+		void DoThreadedWork()
+		{
+			FBlock* Target = Block;
+			FBlockCodec::Decode( Compressed, Target->Data );
+			delete this;
+			appMemoryBarrier();
+			Target->State = BLOCK_Ready;
+		}
+	};
+
+	// Reads a block's compressed data. Game thread, as Inner isn't thread safe.
+	void ReadCompressed( INT Index, TArray<BYTE>& Compressed )
+	{
+		guard(FArchiveCompressedReader::ReadCompressed);
+		FBlock& Block = Blocks(Index);
+		Compressed.Empty( Block.CompressedSize );
+		Compressed.Add( Block.CompressedSize );
+		Inner->Seek( Block.Offset );
+		Inner->Serialize( &Compressed(0), Block.CompressedSize );
+		unguard;
+	}
+	void StartDecode( INT Index )
+	{
+		guard(FArchiveCompressedReader::StartDecode);
+		EvictBlocks();
+		FBlock& Block = Blocks(Index);
+		FDecodeWork* Work = new FDecodeWork;
+		Work->Block = &Block;
+		ReadCompressed( Index, Work->Compressed );
+		Block.State   = BLOCK_Decoding;
+		Block.LastUse = ++UseCount;
+		GThreadPool->AddQueuedWork( Work );
+		unguard;
+	}
+	static void WaitForBlock( FBlock& Block )
+	{
+		for( INT Spins=0; Block.State==BLOCK_Decoding; Spins++ )
+		{
+			if( Spins<64 )
+				appPause();
+			else
+				appSleep( 0.f );
+		}
+		appMemoryBarrier();
+	}
+	BYTE* GetBlock( INT Index )
+	{
+		guardSlow(FArchiveCompressedReader::GetBlock);
+		FBlock& Block = Blocks(Index);
+		if( Block.State==BLOCK_Empty )
+		{
+			EvictBlocks();
+			TArray<BYTE> Compressed;
+			ReadCompressed( Index, Compressed );
+			FBlockCodec::Decode( Compressed, Block.Data );
+			Block.State = BLOCK_Ready;
+		}
+		WaitForBlock( Block );
+		INT Expected = Index<Blocks.Num()-1 ? BlockSize : Size-Index*BlockSize;
+		if( Block.Data.Num()!=Expected )
+			appErrorf( TEXT("Corrupt block %i in %s (%i/%i bytes)"), Index, *Filename, Block.Data.Num(), Expected );
+		Block.LastUse = ++UseCount;
+		return &Block.Data(0);
+		unguardSlow;
+	}
+
+	// Keeps the number of decoded blocks below MAX_CACHED_BLOCKS.
+	void EvictBlocks()
+	{
+		guardSlow(FArchiveCompressedReader::EvictBlocks);
+		for( ;; )
+		{
+			INT NumCached=0, Oldest=INDEX_NONE;
+			for( INT i=0; i<Blocks.Num(); i++ )
+			{
+				if( Blocks(i).State!=BLOCK_Empty )
+				{
+					NumCached++;
+					if( Blocks(i).State==BLOCK_Ready && (Oldest==INDEX_NONE || Blocks(i).LastUse<Blocks(Oldest).LastUse) )
+						Oldest = i;
+				}
+			}
+			if( NumCached<MAX_CACHED_BLOCKS || Oldest==INDEX_NONE )
+				break;
+			Blocks(Oldest).Data.Empty();
+			Blocks(Oldest).State = BLOCK_Empty;
+		}
+		unguardSlow;
+	}
+
+	FArchive*		Inner;
+	FString			Filename;
+	FOutputDevice*	Error;
+	INT				Pos;
+	INT				Size;
+	INT				BlockSize;
+	INT				UseCount;
+	TArray<FBlock>	Blocks;
+};
+
+/*-----------------------------------------------------------------------------
+	FFileManagerCompressed.
+-----------------------------------------------------------------------------*/
+
+//
+// FFileManagerMapped which also opens package containers.
+//
+class FFileManagerCompressed : public FFileManagerMapped
+{
+public:
+	enum {DEFAULT_BLOCK_SIZE=0x10000};
+
+	// Constructors.
+	FFileManagerCompressed( FFileManager* InBacking )
+	:	FFileManagerMapped( InBacking )
+	{}
+
+	// FFileManagerCompressed interface. Blocks are encoded on GThreadPool.
+	static UBOOL Compress( const TArray<BYTE>& Package, FArchive& Out, INT BlockSize=DEFAULT_BLOCK_SIZE )
+	{
+		guard(FFileManagerCompressed::Compress);
+		check(BlockSize>0);
+		INT Size=Package.Num(), NumBlocks=(Size+BlockSize-1)/BlockSize;
+		INT Tag=PACKAGE_CONTAINER_TAG, Version=PACKAGE_CONTAINER_VERSION;
+		Out << Tag << Version << Size << BlockSize << NumBlocks;
+
+		// Leave room for the index, it's written last.
+		INT IndexPos = Out.Tell();
+		INT Zero     = 0;
+		INT i;
+		for( i=0; i<NumBlocks*2; i++ )
+			Out << Zero;
+		TArray<INT> Index( NumBlocks*2 );
+		TArray<FQueuedWork*> Work( NumBlocks );
+		for( i=0; i<NumBlocks; i++ )
+			Work(i) = new FEncodeWork( &Package(i*BlockSize), Min(BlockSize,Size-i*BlockSize) );
+		if( NumBlocks )
+			FQueuedWorkBatch( &Work(0), NumBlocks ).Run();
+		for( i=0; i<NumBlocks; i++ )
+		{
+			TArray<BYTE>& Compressed = ((FEncodeWork*)Work(i))->Compressed;
+			Index(i*2+0) = Out.Tell();
+			Index(i*2+1) = Compressed.Num();
+			Out.Serialize( &Compressed(0), Compressed.Num() );
+			delete Work(i);
+		}
+		INT EndPos = Out.Tell();
+		Out.Seek( IndexPos );
+		for( i=0; i<Index.Num(); i++ )
+			Out << Index(i);
+		Out.Seek( EndPos );
+		return !Out.IsError();
+		unguard;
+	}
+
+	// FFileManager interface.
+	FArchive* CreateFileReader( const TCHAR* Filename, DWORD ReadFlags, FOutputDevice* Error )
+	{
+		guard(FFileManagerCompressed::CreateFileReader);
+		FArchive* Reader = FFileManagerMapped::CreateFileReader( Filename, ReadFlags, Error );
+		if( Reader && Reader->TotalSize()>=(INT)sizeof(INT) )
+		{
+			INT Tag = 0;
+			*Reader << Tag;
+			Reader->Seek( 0 );
+			if( Tag==PACKAGE_CONTAINER_TAG )
+			{
+				FArchiveCompressedReader* Compressed = new(TEXT("CompressedReader"))FArchiveCompressedReader( Reader, Filename, Error );
+				if( !Compressed->IsError() )
+					return Compressed;
+				delete Compressed;
+				return NULL;
+			}
+		}
+		return Reader;
+		unguard;
+	}
+
+	// FExec interface.
+	UBOOL Exec( const TCHAR* Cmd, FOutputDevice& Ar )
+	{
+		guard(FFileManagerCompressed::Exec);
+		if( ParseCommand(&Cmd,TEXT("COMPRESSPACKAGE")) )
+		{
+			TInlineString<256> Src, Dest;
+			INT BlockSize = DEFAULT_BLOCK_SIZE;
+			Parse( Cmd, TEXT("BLOCKSIZE="), BlockSize );
+			if( !ParseToken(Cmd,Src,0) || !ParseToken(Cmd,Dest,0) || BlockSize<=0 )
+			{
+				Ar.Logf( TEXT("Usage: COMPRESSPACKAGE <Src> <Dest> [BLOCKSIZE=<bytes>]") );
+				return 1;
+			}
+			TArray<BYTE> Package;
+			if( !appLoadFileToArray(Package,*Src,this) )
+			{
+				Ar.Logf( TEXT("Can't read %s"), *Src );
+				return 1;
+			}
+			FArchive* Out = CreateFileWriter( *Dest, 0, GNull );
+			if( !Out )
+			{
+				Ar.Logf( TEXT("Can't write %s"), *Dest );
+				return 1;
+			}
+			DOUBLE StartTime = appSeconds();
+			UBOOL Success = Compress( Package, *Out, BlockSize );
+			INT CompressedSize = Out->Tell();
+			Success = Out->Close() && Success;
+			delete Out;
+			if( Success )
+				Ar.Logf( TEXT("%s: %i -> %i bytes (%.1f%%) in %.2f sec"), *Dest, Package.Num(), CompressedSize, Package.Num() ? 100.0*CompressedSize/Package.Num() : 0.0, appSeconds()-StartTime );
+			else
+				Ar.Logf( TEXT("Failed to write %s"), *Dest );
+			return 1;
+		}
+		return FFileManagerMapped::Exec( Cmd, Ar );
+		unguard;
+	}
+
+private:
+	// Encodes a block on a pool thread.
+	class FEncodeWork : public FQueuedWork
+	{
+	public:
+		const BYTE*		Src;
+		INT				Count;
+		TArray<BYTE>	Compressed;
+		FEncodeWork( const BYTE* InSrc, INT InCount )
+		:	Src( InSrc )
+		,	Count( InCount )
+		{}
+		void DoThreadedWork()
+		{
+			TArray<BYTE> Block( Count );
+			appMemcpy( &Block(0), Src, Count );
+			FBlockCodec::Encode( Block, Compressed );
+		}
+	};
+};
+
+/*-----------------------------------------------------------------------------
+	The End.
+-----------------------------------------------------------------------------*/
@@ -0,0 +1,633 @@
+/*=============================================================================
+	FConfigCacheHashed.h: Hashed config cache with a binary snapshot.
+	Copyright 2016-2019 Sebastian Kaufel, Inc. All Rights Reserved.
+
+	Notes:
+	* This file contains the implementation, include it only once (e.g. in
+	  the launcher) and pass the factory to appInit():
+
+		appInit( ..., FConfigCacheHashed::Factory, ... );
+
+	* Behaves like the stock ini cache, but files, sections and keys are
+	  looked up straight from the TCHAR* arguments through their hashes,
+	  so LoadConfig(), Localize() and friends no longer build a temporary
+	  FString for each lookup. The last file used is remembered.
+	* Parsed files are kept in one binary snapshot (ConfigCache.bin next to
+	  the executable), which is read with a single load at Init(). A file
+	  is taken from the snapshot only if its size and last write time
+	  still match, otherwise it is parsed from text as before. Both are
+	  taken when the file is read or written, so edits made while running
+	  are noticed next time. Without a time from appGetFileTime() files
+	  are always parsed. This mostly pays
+	  off for the .int files scanned by UObject::CacheDrivers() on startup.
+	* The snapshot is rewritten on Exit() when anything had to be parsed
+	  or was written. It only ever holds what is on disk, files which are
+	  dirty or detached are left out.
+	* Use "CONFIGCACHE" to report stats. Route it to
+	  FConfigCacheHashed::Exec().
+=============================================================================*/
+
+/*-----------------------------------------------------------------------------
+	TStringKeyMap.
+-----------------------------------------------------------------------------*/
+
+//
+// Map keyed by case insensitive strings, which can be searched without
+// constructing an FString.
+//
+template< class TI, class TBase > class TStringKeyMap : public TBase
+{
+public:
+	TI* FindName( const TCHAR* Key )
+	{
+		guardSlow(TStringKeyMap::FindName);
+		for( INT i=this->Hash[(appStrihash(Key) & (this->HashCount-1))]; i!=INDEX_NONE; i=this->Pairs(i).HashNext )
+			if( appStricmp(*this->Pairs(i).Key,Key)==0 )
+				return &this->Pairs(i).Value;
+		return NULL;
+		unguardSlow;
+	}
+};
+
+/*-----------------------------------------------------------------------------
+	FConfigSection and FConfigFile.
+-----------------------------------------------------------------------------*/
+
+//
+// Keys and values of a section.
+//
+class FConfigSection : public TStringKeyMap< FString, TMultiMap<FString,FString> >
+{};
+
+//
+// Sections of a file.
+//
+class FConfigFile : public TStringKeyMap< FConfigSection, TMap<FString,FConfigSection> >
+{
+public:
+	// Variables.
+	FString Filename;
+	UBOOL   Dirty;
+	UBOOL   NoSave;
+	INT     Size; // Of the file on disk when read or written, -1 if none.
+	SQWORD  Time; // Last write time then, 0 if unknown.
+
+	// Constructor.
+	FConfigFile( const TCHAR* InFilename )
+	:	Filename( InFilename )
+	,	Dirty( 0 )
+	,	NoSave( 0 )
+	,	Size( -1 )
+	,	Time( 0 )
+	{}
+
+	// FConfigFile interface.
+	FConfigSection* FindOrAddSection( const TCHAR* Section )
+	{
+		guardSlow(FConfigFile::FindOrAddSection);
+		FConfigSection* Sec = FindName( Section );
+		if( !Sec )
+			Sec = &Set( Section, FConfigSection() );
+		return Sec;
+		unguardSlow;
+	}
+	void Read()
+	{
+		guard(FConfigFile::Read);
+		Empty();
+		FString Text;
+		if( !appLoadFileToString(Text,*Filename) || !Text.Len() )
+			return;
+		TCHAR*          Ptr            = (TCHAR*)*Text;
+		FConfigSection* CurrentSection = NULL;
+		UBOOL           Done           = 0;
+		while( !Done )
+		{
+			while( *Ptr=='\r' || *Ptr=='\n' )
+				Ptr++;
+			TCHAR* Start = Ptr;
+			while( *Ptr && *Ptr!='\r' && *Ptr!='\n' )
+				Ptr++;
+			if( *Ptr==0 )
+				Done = 1;
+			*Ptr++ = 0;
+			if( *Start=='[' && Start[appStrlen(Start)-1]==']' )
+			{
+				Start++;
+				Start[appStrlen(Start)-1] = 0;
+				CurrentSection = FindOrAddSection( Start );
+			}
+			else if( CurrentSection && *Start )
+			{
+				TCHAR* Value = appStrstr( Start, TEXT("=") );
+				if( Value )
+				{
+					*Value++ = 0;
+					if( *Value=='\"' && Value[appStrlen(Value)-1]=='\"' )
+					{
+						Value++;
+						Value[appStrlen(Value)-1] = 0;
+					}
+					CurrentSection->Add( Start, Value );
+				}
+			}
+		}
+		unguard;
+	}
+	UBOOL Write()
+	{
+		guard(FConfigFile::Write);
+		Dirty = 0;
+		FString Text;
+		for( TIterator It(*this); It; ++It )
+		{
+			Text += TEXT("[");
+			Text += It.Key();
+			Text += TEXT("]\r\n");
+			for( FConfigSection::TIterator It2(It.Value()); It2; ++It2 )
+			{
+				Text += It2.Key();
+				Text += TEXT("=");
+				Text += It2.Value();
+				Text += TEXT("\r\n");
+			}
+			Text += TEXT("\r\n");
+		}
+		return appSaveStringToFile( Text, *Filename );
+		unguard;
+	}
+	friend FArchive& operator<<( FArchive& Ar, FConfigFile& File )
+	{
+		guard(FConfigFile<<);
+		return Ar << (TMap<FString,FConfigSection>&)File;
+		unguard;
+	}
+};
+
+/*-----------------------------------------------------------------------------
+	FConfigCacheHashed.
+-----------------------------------------------------------------------------*/
+
+//
+// Hashed ini cache backed by a binary snapshot.
+//
+class FConfigCacheHashed : public FConfigCache, public FExec
+{
+public:
+	// Constants.
+	enum {SNAPSHOT_MAGIC=0x43474643};
+	enum {SNAPSHOT_VERSION=2};
+	enum {SNAPSHOT_HEADER=16};
+
+	// Constructors.
+	FConfigCacheHashed( const TCHAR* InSnapshotFilename=NULL )
+	:	SnapshotFilename( InSnapshotFilename ? InSnapshotFilename : TEXT("") )
+	,	UseSnapshot( InSnapshotFilename==NULL || *InSnapshotFilename )
+	,	SnapshotDirty( 0 )
+	,	LastFile( NULL )
+	,	NumParsed( 0 )
+	,	NumSnapshot( 0 )
+	,	NumWritten( 0 )
+	{}
+	~FConfigCacheHashed()
+	{
+		guard(FConfigCacheHashed::~FConfigCacheHashed);
+		Flush( 1 );
+		unguard;
+	}
+	static FConfigCache* Factory()
+	{
+		return new FConfigCacheHashed;
+	}
+
+	// FConfigCache interface.
+	UBOOL GetBool( const TCHAR* Section, const TCHAR* Key, UBOOL& Value, const TCHAR* Filename=NULL )
+	{
+		guard(FConfigCacheHashed::GetBool);
+		const TCHAR* Text = FindValue( Section, Key, Filename );
+		if( !Text )
+			return 0;
+		Value = appStricmp(Text,TEXT("True"))==0 || appStricmp(Text,GTrue)==0 || appAtoi(Text)==1;
+		return 1;
+		unguard;
+	}
+	UBOOL GetInt( const TCHAR* Section, const TCHAR* Key, INT& Value, const TCHAR* Filename=NULL )
+	{
+		guard(FConfigCacheHashed::GetInt);
+		const TCHAR* Text = FindValue( Section, Key, Filename );
+		if( !Text )
+			return 0;
+		Value = appAtoi( Text );
+		return 1;
+		unguard;
+	}
+	UBOOL GetFloat( const TCHAR* Section, const TCHAR* Key, FLOAT& Value, const TCHAR* Filename=NULL )
+	{
+		guard(FConfigCacheHashed::GetFloat);
+		const TCHAR* Text = FindValue( Section, Key, Filename );
+		if( !Text )
+			return 0;
+		Value = appAtof( Text );
+		return 1;
+		unguard;
+	}
+	UBOOL GetString( const TCHAR* Section, const TCHAR* Key, TCHAR* Value, INT Size, const TCHAR* Filename=NULL )
+	{
+		guard(FConfigCacheHashed::GetString);
+		*Value = 0;
+		const TCHAR* Text = FindValue( Section, Key, Filename );
+		if( !Text )
+			return 0;
+		appStrncpy( Value, Text, Size );
+		return 1;
+		unguard;
+	}
+	UBOOL GetString( const TCHAR* Section, const TCHAR* Key, FString& Str, const TCHAR* Filename=NULL )
+	{
+		guard(FConfigCacheHashed::GetString);
+		const TCHAR* Text = FindValue( Section, Key, Filename );
+		Str = Text ? Text : TEXT("");
+		return Text!=NULL;
+		unguard;
+	}
+	const TCHAR* GetStr( const TCHAR* Section, const TCHAR* Key, const TCHAR* Filename=NULL )
+	{
+		guard(FConfigCacheHashed::GetStr);
+		static TCHAR Result[4096];
+		GetString( Section, Key, Result, ARRAY_COUNT(Result), Filename );
+		return Result;
+		unguard;
+	}
+	UBOOL GetSection( const TCHAR* Section, TCHAR* Result, INT Size, const TCHAR* Filename=NULL )
+	{
+		guard(FConfigCacheHashed::GetSection);
+		*Result = 0;
+		FConfigFile* File = Find( Filename, 0 );
+		FConfigSection* Sec = File ? File->FindName( Section ) : NULL;
+		if( !Sec )
+			return 0;
+		TCHAR* End = Result;
+		for( FConfigSection::TIterator It(*Sec); It; ++It )
+		{
+			// Leave room for both terminators.
+			INT Len = It.Key().Len() + 1 + It.Value().Len() + 1;
+			if( (End-Result)+Len+1>Size )
+				break;
+			appStrcpy( End, *It.Key() );
+			appStrcat( End, TEXT("=") );
+			appStrcat( End, *It.Value() );
+			End += Len;
+		}
+		*End = 0;
+		return 1;
+		unguard;
+	}
+	TMultiMap<FString,FString>* GetSectionPrivate( const TCHAR* Section, UBOOL Force, UBOOL Const, const TCHAR* Filename=NULL )
+	{
+		guard(FConfigCacheHashed::GetSectionPrivate);
+		FConfigFile* File = Find( Filename, Force );
+		if( !File )
+			return NULL;
+		FConfigSection* Sec = Force ? File->FindOrAddSection( Section ) : File->FindName( Section );
+		if( Sec && (Force || !Const) )
+			File->Dirty = 1;
+		return Sec;
+		unguard;
+	}
+	void EmptySection( const TCHAR* Section, const TCHAR* Filename=NULL )
+	{
+		guard(FConfigCacheHashed::EmptySection);
+		FConfigFile* File = Find( Filename, 0 );
+		FConfigSection* Sec = File ? File->FindName( Section ) : NULL;
+		if( Sec && Sec->Num() )
+		{
+			Sec->Empty();
+			File->Dirty = 1;
+		}
+		unguard;
+	}
+	void SetBool( const TCHAR* Section, const TCHAR* Key, UBOOL Value, const TCHAR* Filename=NULL )
+	{
+		guard(FConfigCacheHashed::SetBool);
+		SetString( Section, Key, Value ? TEXT("True") : TEXT("False"), Filename );
+		unguard;
+	}
+	void SetInt( const TCHAR* Section, const TCHAR* Key, INT Value, const TCHAR* Filename=NULL )
+	{
+		guard(FConfigCacheHashed::SetInt);
+		TCHAR Text[32];
+		appSprintf( Text, TEXT("%i"), Value );
+		SetString( Section, Key, Text, Filename );
+		unguard;
+	}
+	void SetFloat( const TCHAR* Section, const TCHAR* Key, FLOAT Value, const TCHAR* Filename=NULL )
+	{
+		guard(FConfigCacheHashed::SetFloat);
+		TCHAR Text[64];
+		appSprintf( Text, TEXT("%f"), Value );
+		SetString( Section, Key, Text, Filename );
+		unguard;
+	}
+	void SetString( const TCHAR* Section, const TCHAR* Key, const TCHAR* Value, const TCHAR* Filename=NULL )
+	{
+		guard(FConfigCacheHashed::SetString);
+		FConfigFile*    File = Find( Filename, 1 );
+		FConfigSection* Sec  = File->FindOrAddSection( Section );
+		FString*        Str  = Sec->FindName( Key );
+		if( !Str )
+		{
+			Sec->Add( Key, Value );
+			File->Dirty = 1;
+		}
+		else if( appStrcmp(**Str,Value)!=0 )
+		{
+			*Str        = Value;
+			File->Dirty = 1;
+		}
+		unguard;
+	}
+	void Flush( UBOOL Read, const TCHAR* Filename=NULL )
+	{
+		guard(FConfigCacheHashed::Flush);
+		TCHAR Name[1024]=TEXT("");
+		if( Filename )
+			GetFilename( Filename, Name );
+		for( TMap<FString,FConfigFile*>::TIterator It(Files); It; ++It )
+		{
+			FConfigFile* File = It.Value();
+			if( Filename && appStricmp(*File->Filename,Name)!=0 )
+				continue;
+			if( File->Dirty && !File->NoSave )
+			{
+				if( File->Write() )
+					Stamp( File );
+				else
+					File->Size = -1;
+				NumWritten++;
+				SnapshotDirty = 1;
+			}
+			if( Read )
+			{
+				if( File==LastFile )
+					LastFile = NULL;
+				delete File;
+			}
+		}
+		if( Read )
+		{
+			if( Filename )
+				Files.Remove( Name );
+			else
+				Files.Empty();
+		}
+		unguard;
+	}
+	void Detach( const TCHAR* Filename )
+	{
+		guard(FConfigCacheHashed::Detach);
+		FConfigFile* File = Find( Filename, 1 );
+		if( File )
+			File->NoSave = 1;
+		unguard;
+	}
+	void Init( const TCHAR* InSystem, const TCHAR* InUser, UBOOL RequireConfig )
+	{
+		guard(FConfigCacheHashed::Init);
+		SystemIni = InSystem;
+		UserIni   = InUser;
+		if( UseSnapshot && !SnapshotFilename.Len() )
+			SnapshotFilename = FString(appBaseDir()) + TEXT("ConfigCache.bin");
+		LoadSnapshot();
+		unguard;
+	}
+	void Exit()
+	{
+		guard(FConfigCacheHashed::Exit);
+		Flush( 0 );
+		SaveSnapshot();
+		Flush( 1 );
+		Snapshot.Empty();
+		SnapshotData.Empty();
+		unguard;
+	}
+	void Dump( FOutputDevice& Ar )
+	{
+		guard(FConfigCacheHashed::Dump);
+		Ar.Log( TEXT("Files:") );
+		for( TMap<FString,FConfigFile*>::TIterator It(Files); It; ++It )
+		{
+			Ar.Logf( TEXT("FILE: %s"), *It.Key() );
+			for( FConfigFile::TIterator It2(*It.Value()); It2; ++It2 )
+			{
+				Ar.Logf( TEXT("   [%s]"), *It2.Key() );
+				for( FConfigSection::TIterator It3(It2.Value()); It3; ++It3 )
+					Ar.Logf( TEXT("   %s=%s"), *It3.Key(), *It3.Value() );
+			}
+		}
+		unguard;
+	}
+
+	// FExec interface.
+	UBOOL Exec( const TCHAR* Cmd, FOutputDevice& Ar )
+	{
+		guard(FConfigCacheHashed::Exec);
+		if( ParseCommand(&Cmd,TEXT("CONFIGCACHE")) )
+		{
+			Ar.Logf( TEXT("Config cache: %i files (%i from snapshot, %i parsed, %i written), %i snapshot records in %i bytes."), Files.Num(), NumSnapshot, NumParsed, NumWritten, Snapshot.Num(), SnapshotData.Num() );
+			return 1;
+		}
+		return 0;
+		unguard;
+	}
+
+private:
+	// A file in the snapshot.
+	struct FSnapshotRecord
+	{
+		INT		Size;
+		SQWORD	Time;
+		INT		Offset;
+		INT		Count;
+	};
+
+	// Variables.
+	FString SystemIni;
+	FString UserIni;
+	FString SnapshotFilename;
+	UBOOL   UseSnapshot;
+	UBOOL   SnapshotDirty;
+	TArray<BYTE> SnapshotData;
+	TStringKeyMap< FSnapshotRecord, TMap<FString,FSnapshotRecord> > Snapshot;
+	TStringKeyMap< FConfigFile*, TMap<FString,FConfigFile*> > Files;
+	FConfigFile* LastFile;
+	INT NumParsed;
+	INT NumSnapshot;
+	INT NumWritten;
+
+	// Implementation.
+	void GetFilename( const TCHAR* InFilename, TCHAR* Result )
+	{
+		// Result must hold 1024 characters, like the names used by Flush().
+		appStrncpy( Result, InFilename ? InFilename : *SystemIni, 1024-4 );
+		INT Len = appStrlen( Result );
+		if( Len<5 || (Result[Len-4]!='.' && Result[Len-5]!='.') )
+			appStrcat( Result, TEXT(".ini") );
+	}
+	FConfigFile* Find( const TCHAR* InFilename, UBOOL CreateIfNotFound )
+	{
+		guardSlow(FConfigCacheHashed::Find);
+		TCHAR Filename[1024];
+		GetFilename( InFilename, Filename );
+		if( LastFile && appStricmp(*LastFile->Filename,Filename)==0 )
+			return LastFile;
+		FConfigFile** Found = Files.FindName( Filename );
+		if( Found )
+			return LastFile = *Found;
+		INT Size = GFileManager->FileSize( Filename );
+		if( Size<0 && !CreateIfNotFound )
+			return NULL;
+		FConfigFile* File = new FConfigFile( Filename );
+		Files.Set( Filename, File );
+
+		// Stamped before reading, a later edit then shows up as a new stamp.
+		Stamp( File );
+		if( LoadFromSnapshot(File) )
+			NumSnapshot++;
+		else
+		{
+			File->Read();
+			NumParsed++;
+			SnapshotDirty = 1;
+		}
+		return LastFile = File;
+		unguardSlow;
+	}
+	const TCHAR* FindValue( const TCHAR* Section, const TCHAR* Key, const TCHAR* Filename )
+	{
+		guardSlow(FConfigCacheHashed::FindValue);
+		FConfigFile* File = Find( Filename, 0 );
+		FConfigSection* Sec = File ? File->FindName( Section ) : NULL;
+		FString* Str = Sec ? Sec->FindName( Key ) : NULL;
+		return Str ? **Str : NULL;
+		unguardSlow;
+	}
+	void Stamp( FConfigFile* File )
+	{
+		File->Size = GFileManager->FileSize( *File->Filename );
+		File->Time = File->Size>=0 ? appGetFileTime( *File->Filename ) : 0;
+	}
+	UBOOL LoadFromSnapshot( FConfigFile* File )
+	{
+		guard(FConfigCacheHashed::LoadFromSnapshot);
+		if( File->Size<0 || File->Time==0 )
+			return 0;
+		FSnapshotRecord* Record = Snapshot.FindName( *File->Filename );
+		if( !Record || Record->Size!=File->Size || Record->Time!=File->Time )
+			return 0;
+		FBufferReader Ar( SnapshotData );
+		Ar.Seek( Record->Offset );
+		Ar << *File;
+		if( Ar.Tell()!=Record->Offset+Record->Count )
+		{
+			File->Empty();
+			return 0;
+		}
+		return 1;
+		unguard;
+	}
+	void LoadSnapshot()
+	{
+		guard(FConfigCacheHashed::LoadSnapshot);
+		Snapshot.Empty();
+		SnapshotData.Empty();
+		if( !UseSnapshot || GFileManager->FileSize(*SnapshotFilename)<SNAPSHOT_HEADER+(INT)sizeof(INT) || !appLoadFileToArray(SnapshotData,*SnapshotFilename) )
+			return;
+
+		// Check the header before trusting any of it.
+		FBufferReader Ar( SnapshotData );
+		DWORD Magic=0, Crc=0;
+		INT   Version=0, CharSize=0, Num=0;
+		Ar << Magic << Version << CharSize << Crc;
+		if
+		(	Magic!=SNAPSHOT_MAGIC
+		||	Version!=SNAPSHOT_VERSION
+		||	CharSize!=sizeof(TCHAR)
+		||	Crc!=appMemCrc(&SnapshotData(SNAPSHOT_HEADER),SnapshotData.Num()-SNAPSHOT_HEADER) )
+		{
+			debugf( NAME_Init, TEXT("Ignoring outdated config snapshot %s"), *SnapshotFilename );
+			SnapshotData.Empty();
+			return;
+		}
+		Ar << Num;
+		for( INT i=0; i<Num; i++ )
+		{
+			FString         Filename;
+			FSnapshotRecord Record;
+			Ar << Filename << Record.Size << Record.Time << Record.Count;
+			Record.Offset = Ar.Tell();
+			if( Record.Count<0 || Record.Offset+Record.Count>SnapshotData.Num() )
+			{
+				Snapshot.Empty();
+				SnapshotData.Empty();
+				return;
+			}
+			Snapshot.Set( *Filename, Record );
+			Ar.Seek( Record.Offset+Record.Count );
+		}
+		unguard;
+	}
+	void SaveSnapshot()
+	{
+		guard(FConfigCacheHashed::SaveSnapshot);
+		if( !UseSnapshot || !SnapshotDirty )
+			return;
+		FBufferArchive Ar;
+		DWORD Magic=SNAPSHOT_MAGIC, Crc=0;
+		INT   Version=SNAPSHOT_VERSION, CharSize=sizeof(TCHAR), Num=0;
+		Ar << Magic << Version << CharSize << Crc << Num;
+
+		// Files with the stamps taken when they were read or written.
+		for( TMap<FString,FConfigFile*>::TIterator It(Files); It; ++It )
+		{
+			FConfigFile* File = It.Value();
+			if( File->Dirty || File->NoSave || File->Size<0 || File->Time==0 )
+				continue;
+			INT Count = 0;
+			Ar << File->Filename << File->Size << File->Time;
+			INT CountPos = Ar.Tell();
+			Ar << Count << *File;
+			INT End = Ar.Tell();
+			Count = End - CountPos - sizeof(INT);
+			Ar.Seek( CountPos );
+			Ar << Count;
+			Ar.Seek( End );
+			Num++;
+		}
+
+		// Records of files not used this time, checked when next used.
+		for( TMap<FString,FSnapshotRecord>::TIterator It2(Snapshot); It2; ++It2 )
+		{
+			FSnapshotRecord& Record = It2.Value();
+			if( Files.FindName(*It2.Key()) )
+				continue;
+			Ar << It2.Key() << Record.Size << Record.Time << Record.Count;
+			if( Record.Count )
+				Ar.Serialize( &SnapshotData(Record.Offset), Record.Count );
+			Num++;
+		}
+
+		Ar.Seek( SNAPSHOT_HEADER );
+		Ar << Num;
+		Crc = appMemCrc( &Ar(SNAPSHOT_HEADER), Ar.Num()-SNAPSHOT_HEADER );
+		Ar.Seek( SNAPSHOT_HEADER-sizeof(DWORD) );
+		Ar << Crc;
+		if( !appSaveArrayToFile(Ar,*SnapshotFilename) )
+			debugf( NAME_Warning, TEXT("Failed to save config snapshot %s"), *SnapshotFilename );
+		SnapshotDirty = 0;
+		unguard;
+	}
+};
+
+/*-----------------------------------------------------------------------------
+	The End.
+-----------------------------------------------------------------------------*/
@@ -0,0 +1,299 @@
+/*=============================================================================
+	FFileManagerMapped.h: File manager reading packages from mapped files.
+	Copyright 2016-2019 Sebastian Kaufel, Inc. All Rights Reserved.
+
+	Notes:
+	* This file contains the implementation, include it only once (e.g. in
+	  the launcher) and pass the file manager used so far as backing file
+	  manager:
+
+		static FFileManagerMapped FileManager( &FileManagerBase );
+		appInit( ..., &FileManager, ... );
+
+	* ULinkerLoad creates its loader through GFileManager->CreateFileReader(),
+	  so this is where mapping is selected. Packages (by extension) are
+	  mapped while MapPackages is set, which can be changed for a single
+	  load with FScopedMappedLoad. Other callers may ask for a mapped reader
+	  with FILEREAD_Mapped. Anything which can't be mapped is read through
+	  the backing file manager as before.
+	* The linker still copies names, imports, exports and loaded arrays out
+	  of the view, but without any read calls. TLazyArray::GetMappedData()
+	  serves pending payloads straight from the view.
+	* Views are read only and unmapped when the linker closes its loader.
+	* Use "MAPPEDLOAD [ON|OFF]" to toggle MapPackages and report stats.
+	  Route it to FFileManagerMapped::Exec().
+=============================================================================*/
+
+/*-----------------------------------------------------------------------------
+	FArchiveMappedReader.
+-----------------------------------------------------------------------------*/
+
+//
+// Archive reading from a file mapped by appMapFile(). Owns the view.
+//
+class FArchiveMappedReader : public FArchive
+{
+public:
+	// Constructors.
+	FArchiveMappedReader( const BYTE* InView, INT InSize, const TCHAR* InFilename, FOutputDevice* InError )
+	:	View( InView )
+	,	Size( InSize )
+	,	Pos( 0 )
+	,	Filename( InFilename )
+	,	Error( InError )
+	{
+		guard(FArchiveMappedReader::FArchiveMappedReader);
+		check(View);
+		ArIsLoading = ArIsPersistent = 1;
+		unguard;
+	}
+	~FArchiveMappedReader()
+	{
+		guard(FArchiveMappedReader::~FArchiveMappedReader);
+		appUnmapFile( View, Size );
+		unguard;
+	}
+
+	// FArchive interface.
+	void Serialize( void* V, INT Length )
+	{
+		guardSlow(FArchiveMappedReader::Serialize);
+		if( Length==0 )
+		{
+			// View request, see appGetArchiveView().
+			if( V && V==GArchiveViewRequest )
+			{
+				GArchiveViewRequest->View = View;
+				GArchiveViewRequest->Size = Size;
+			}
+			return;
+		}
+		if( Length<0 || Pos+Length>Size )
+		{
+			ArIsError = 1;
+			Error->Logf( TEXT("ReadFile beyond EOF %i+%i/%i (%s)"), Pos, Length, Size, *Filename );
+			return;
+		}
+		appMemcpy( V, View+Pos, Length );
+		Pos += Length;
+		unguardSlow;
+	}
+	void Seek( INT InPos )
+	{
+		guard(FArchiveMappedReader::Seek);
+		if( InPos<0 || InPos>Size )
+		{
+			ArIsError = 1;
+			Error->Logf( TEXT("Seek Failed %i/%i (%s)"), InPos, Size, *Filename );
+			return;
+		}
+		Pos = InPos;
+		unguard;
+	}
+	INT Tell()
+	{
+		return Pos;
+	}
+	INT TotalSize()
+	{
+		return Size;
+	}
+
+	// FArchiveMappedReader interface.
+	const BYTE* GetView() const
+	{
+		return View;
+	}
+
+private:
+	FArchiveMappedReader( const FArchiveMappedReader& );
+	void operator=( const FArchiveMappedReader& );
+
+	const BYTE*		View;
+	INT				Size;
+	INT				Pos;
+	FString			Filename;
+	FOutputDevice*	Error;
+};
+
+/*-----------------------------------------------------------------------------
+	FFileManagerMapped.
+-----------------------------------------------------------------------------*/
+
+//
+// File manager handing out mapped readers, see notes above.
+//
+class FFileManagerMapped : public FFileManager, public FExec
+{
+public:
+	// Variables.
+	UBOOL MapPackages;
+
+	// Constructors.
+	FFileManagerMapped( FFileManager* InBacking )
+	:	MapPackages( 1 )
+	,	Backing( InBacking )
+	,	NumMapped( 0 )
+	,	NumFallbacks( 0 )
+	,	BytesMapped( 0 )
+	{
+		check(Backing);
+		const TCHAR* DefaultExtensions[] = { TEXT("u"), TEXT("dx"), TEXT("utx"), TEXT("uax"), TEXT("umx"), TEXT("usx"), TEXT("ukx"), TEXT("unr") };
+		for( INT i=0; i<ARRAY_COUNT(DefaultExtensions); i++ )
+			new(Extensions)FString( DefaultExtensions[i] );
+	}
+
+	// FFileManagerMapped interface.
+	void AddExtension( const TCHAR* Extension )
+	{
+		guard(FFileManagerMapped::AddExtension);
+		for( INT i=0; i<Extensions.Num(); i++ )
+			if( Extensions(i)==Extension )
+				return;
+		new(Extensions)FString( Extension );
+		unguard;
+	}
+	UBOOL IsPackage( const TCHAR* Filename )
+	{
+		guard(FFileManagerMapped::IsPackage);
+		const TCHAR* Dot = NULL;
+		for( const TCHAR* Ch=Filename; *Ch; Ch++ )
+		{
+			if( *Ch=='.' )
+				Dot = Ch;
+			else if( *Ch=='\\' || *Ch=='/' )
+				Dot = NULL;
+		}
+		if( Dot )
+			for( INT i=0; i<Extensions.Num(); i++ )
+				if( Extensions(i)==Dot+1 )
+					return 1;
+		return 0;
+		unguard;
+	}
+
+	// FFileManager interface.
+	FArchive* CreateFileReader( const TCHAR* Filename, DWORD ReadFlags, FOutputDevice* Error )
+	{
+		guard(FFileManagerMapped::CreateFileReader);
+		if( (ReadFlags & FILEREAD_Mapped) || (MapPackages && IsPackage(Filename)) )
+		{
+			INT Size = 0;
+			const BYTE* View = appMapFile( Filename, Size );
+			if( View )
+			{
+				NumMapped++;
+				BytesMapped += Size;
+				return new(TEXT("MappedReader"))FArchiveMappedReader( View, Size, Filename, Error );
+			}
+			NumFallbacks++;
+		}
+		return Backing->CreateFileReader( Filename, ReadFlags & ~FILEREAD_Mapped, Error );
+		unguard;
+	}
+	FArchive* CreateFileWriter( const TCHAR* Filename, DWORD WriteFlags, FOutputDevice* Error )
+	{
+		return Backing->CreateFileWriter( Filename, WriteFlags, Error );
+	}
+	INT FileSize( const TCHAR* Filename )
+	{
+		return Backing->FileSize( Filename );
+	}
+	UBOOL Delete( const TCHAR* Filename, UBOOL RequireExists, UBOOL EvenReadOnly )
+	{
+		return Backing->Delete( Filename, RequireExists, EvenReadOnly );
+	}
+	UBOOL Copy( const TCHAR* Dest, const TCHAR* Src, UBOOL Replace, UBOOL EvenIfReadOnly, UBOOL Attributes, void (*Progress)(FLOAT Fraction) )
+	{
+		return Backing->Copy( Dest, Src, Replace, EvenIfReadOnly, Attributes, Progress );
+	}
+	UBOOL Move( const TCHAR* Dest, const TCHAR* Src, UBOOL Replace, UBOOL EvenIfReadOnly, UBOOL Attributes )
+	{
+		return Backing->Move( Dest, Src, Replace, EvenIfReadOnly, Attributes );
+	}
+	SQWORD GetGlobalTime( const TCHAR* Filename )
+	{
+		return Backing->GetGlobalTime( Filename );
+	}
+	UBOOL SetGlobalTime( const TCHAR* Filename )
+	{
+		return Backing->SetGlobalTime( Filename );
+	}
+	UBOOL MakeDirectory( const TCHAR* Path, UBOOL Tree )
+	{
+		return Backing->MakeDirectory( Path, Tree );
+	}
+	UBOOL DeleteDirectory( const TCHAR* Path, UBOOL RequireExists, UBOOL Tree )
+	{
+		return Backing->DeleteDirectory( Path, RequireExists, Tree );
+	}
+	TArray<FString> FindFiles( const TCHAR* Filename, UBOOL Files, UBOOL Directories )
+	{
+		return Backing->FindFiles( Filename, Files, Directories );
+	}
+	UBOOL SetDefaultDirectory( const TCHAR* Filename )
+	{
+		return Backing->SetDefaultDirectory( Filename );
+	}
+	FString GetDefaultDirectory()
+	{
+		return Backing->GetDefaultDirectory();
+	}
+
+	// FExec interface.
+	UBOOL Exec( const TCHAR* Cmd, FOutputDevice& Ar )
+	{
+		guard(FFileManagerMapped::Exec);
+		if( ParseCommand(&Cmd,TEXT("MAPPEDLOAD")) )
+		{
+			if( ParseCommand(&Cmd,TEXT("ON")) )
+				MapPackages = 1;
+			else if( ParseCommand(&Cmd,TEXT("OFF")) )
+				MapPackages = 0;
+			Ar.Logf( TEXT("Mapped packages %s: %i files (%.1f MB) mapped, %i read normally after mapping failed."), MapPackages ? TEXT("on") : TEXT("off"), NumMapped, BytesMapped/1048576.0, NumFallbacks );
+			return 1;
+		}
+		return 0;
+		unguard;
+	}
+
+private:
+	FFileManagerMapped( const FFileManagerMapped& );
+	void operator=( const FFileManagerMapped& );
+
+	FFileManager*	Backing;
+	TArray<FString>	Extensions;
+	INT				NumMapped;
+	INT				NumFallbacks;
+	DOUBLE			BytesMapped;
+};
+
+//
+// Selects whether packages are mapped for the lifetime of the scope, e.g.
+// around a single UObject::LoadPackage().
+//
+class FScopedMappedLoad
+{
+public:
+	FScopedMappedLoad( FFileManagerMapped& InFileManager, UBOOL InMapPackages=1 )
+	:	FileManager( InFileManager )
+	,	PushedMapPackages( InFileManager.MapPackages )
+	{
+		FileManager.MapPackages = InMapPackages;
+	}
+	~FScopedMappedLoad()
+	{
+		FileManager.MapPackages = PushedMapPackages;
+	}
+
+private:
+	FScopedMappedLoad( const FScopedMappedLoad& );
+	void operator=( const FScopedMappedLoad& );
+
+	FFileManagerMapped&	FileManager;
+	UBOOL				PushedMapPackages;
+};
+
+/*-----------------------------------------------------------------------------
+	The End.
+-----------------------------------------------------------------------------*/
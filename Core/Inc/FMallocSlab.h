@@ -0,0 +1,791 @@
+/*=============================================================================
+	FMallocSlab.h: Size class based slab allocator.
+	Copyright 2016-2019 Sebastian Kaufel, Inc. All Rights Reserved.
+
+	Notes:
+	* This file contains the implementation, include it only once (e.g. in
+	  the launcher) and pass the allocator used so far as backing allocator.
+	  It is only used for 1 MB superchunks, large blocks and bookkeeping,
+	  and is initialized and shut down by FMallocSlab:
+
+		static FMallocSlab Malloc( &MallocBase );
+		appInit( ..., &Malloc, ... );
+
+	* Blocks up to 32 KB are served out of 64 KB slabs. Each slab holds
+	  blocks of a single size class, the owning slab is found through a
+	  page map, so small blocks carry no header at all.
+	* Each thread keeps a magazine of free blocks per size class and only
+	  takes the size class lock to refill or flush half of a magazine.
+	  When a thread exits its magazines are flushed back to the size
+	  classes and its cache is freed, blocks it frees after that go to
+	  the size classes directly.
+	* Allocations are accounted per tag passed to appMalloc(). Use the
+	  "MALLOC [TAGS|CLASSES|FLUSH]" command to report live bytes, allocation
+	  rate and fragmentation. Route it to FMallocSlab::Exec().
+	* Assumes 32 bit pointers.
+=============================================================================*/
+
+/*-----------------------------------------------------------------------------
+	FMallocSlab.
+-----------------------------------------------------------------------------*/
+
+class FMallocSlab : public FMalloc, public FExec, public FThreadExitHandler
+{
+private:
+	// Constants.
+	enum {SLAB_SIZE_BITS  = 16                      };
+	enum {SLAB_SIZE       = 1<<SLAB_SIZE_BITS       };
+	enum {SLABS_PER_CHUNK = 16                      };
+	enum {PAGE_MAP_SIZE   = 1<<(32-SLAB_SIZE_BITS)  };
+	enum {MAX_SMALL_SIZE  = 32768                   };
+	enum {NUM_CLASSES     = 44                      };
+	enum {MAX_MAGAZINE    = 32                      };
+	enum {MAX_TAGS        = 512                     };
+	enum {TAG_HASH_SIZE   = 4096                    };
+	enum {LARGE_MAGIC     = 0x4C524753              };
+	enum {EXITED_CACHE    = 1                       };
+
+	// A 64 KB slab serving blocks of a single size class.
+	struct FSlab
+	{
+		BYTE*	Base;			// Start of slab memory.
+		FSlab*	Next;			// Next slab in partial or free list.
+		FSlab*	Prev;			// Previous slab in partial list.
+		void*	FreeList;		// Freed blocks.
+		INT		NumUsed;		// Blocks handed out (including those in magazines).
+		INT		NumSlots;		// Total number of blocks.
+		INT		NumCarved;		// Blocks ever handed out, the rest is untouched.
+		INT		Class;			// Size class or INDEX_NONE if unused.
+		UBOOL	Partial;		// Whether the slab is linked into the partial list.
+		_WORD*	Tags;			// Tag index of each block.
+	};
+
+	// Memory for SLABS_PER_CHUNK slabs.
+	struct FSuperChunk
+	{
+		FSuperChunk*	Next;
+		void*			Allocation;
+		FSlab			Slabs[SLABS_PER_CHUNK];
+	};
+
+	// Size class.
+	struct FSizeClass
+	{
+		FSpinLock	Lock;
+		INT			Size;
+		INT			MagazineSize;
+		DWORD		Reciprocal;		// Turns block offsets into slot indices.
+		FSlab*		Partial;		// Slabs with free blocks.
+		FSlab*		Empty;			// One empty slab kept around to avoid thrashing.
+		INT			NumSlabs;
+	};
+
+	// Per thread cache.
+	struct FMagazine
+	{
+		INT		Num;
+		void*	Blocks[MAX_MAGAZINE];
+	};
+	struct FThreadCache
+	{
+		FThreadCache*	Next;
+		FMagazine		Magazines[NUM_CLASSES];
+	};
+
+	// Large block header.
+	struct FLargeHeader
+	{
+		DWORD	Size;
+		INT		Tag;
+		DWORD	Magic;
+		DWORD	Pad;
+	};
+
+	// Per tag statistics.
+	struct FTagStats
+	{
+		TCHAR			Name[64];
+		volatile INT	LiveSlots[NUM_CLASSES];
+		volatile INT	LiveLargeBytes;
+		volatile INT	NumAllocs;
+		INT				LastNumAllocs;
+	};
+	struct FTagHashEntry
+	{
+		const TCHAR*	Ptr;
+		INT				Index;
+	};
+
+	// Variables.
+	FMalloc*		Base;
+	UBOOL			Stats;
+	UBOOL			Initialized;
+	FSpinLock		BaseLock;
+	FSpinLock		SlabLock;
+	FSpinLock		CacheLock;
+	FSpinLock		TagLock;
+	FSlab**			PageMap;
+	FSuperChunk*	SuperChunks;
+	FSlab*			FreeSlabs;
+	FThreadCache*	ThreadCaches;
+	INT				TlsSlot;
+	FSizeClass		Classes[NUM_CLASSES];
+	BYTE			SizeToClass[(MAX_SMALL_SIZE>>4)+1];
+	FTagStats*		Tags;
+	INT				NumTags;
+	FTagHashEntry*	TagHash;
+	INT				NumTagHash;
+	DOUBLE			LastReportTime;
+
+public:
+	// Constructor.
+	FMallocSlab( FMalloc* InBase, UBOOL InStats=1 )
+	:	Base( InBase )
+	,	Stats( InStats )
+	,	Initialized( 0 )
+	,	PageMap( NULL )
+	,	SuperChunks( NULL )
+	,	FreeSlabs( NULL )
+	,	ThreadCaches( NULL )
+	,	TlsSlot( INDEX_NONE )
+	,	Tags( NULL )
+	,	NumTags( 0 )
+	,	TagHash( NULL )
+	,	NumTagHash( 0 )
+	,	LastReportTime( 0.0 )
+	{}
+
+	// FMalloc interface.
+	void* Malloc( DWORD Count, const TCHAR* Tag )
+	{
+		guardSlow(FMallocSlab::Malloc);
+		checkSlow(Initialized);
+		if( Count>MAX_SMALL_SIZE )
+			return MallocLarge( Count, Tag );
+
+		INT   Class = SizeToClass[(Count+15)>>4];
+		void* Result;
+		FThreadCache* Cache = GetThreadCache();
+		if( Cache )
+		{
+			FMagazine& Magazine = Cache->Magazines[Class];
+			if( Magazine.Num==0 )
+				Magazine.Num = AllocateBlocks( Class, Magazine.Blocks, (Classes[Class].MagazineSize+1)/2 );
+			Result = Magazine.Blocks[--Magazine.Num];
+		}
+		else AllocateBlocks( Class, &Result, 1 );
+
+		if( Stats )
+			TrackAlloc( GetSlab(Result), Result, Tag );
+		return Result;
+		unguardSlow;
+	}
+	void* Realloc( void* Original, DWORD Count, const TCHAR* Tag )
+	{
+		guardSlow(FMallocSlab::Realloc);
+		if( !Original )
+			return Malloc( Count, Tag );
+		if( Count==0 )
+		{
+			Free( Original );
+			return NULL;
+		}
+
+		// Stay in place if the block still fits well.
+		DWORD OldSize = GetBlockSize( Original );
+		FSlab* Slab   = GetSlab( Original );
+		if( Slab ? (Count<=MAX_SMALL_SIZE && SizeToClass[(Count+15)>>4]==Slab->Class) : (Count<=OldSize && Count>OldSize/2) )
+			return Original;
+
+		void* Result = Malloc( Count, Tag );
+		appMemcpy( Result, Original, Min<DWORD>(Count,OldSize) );
+		Free( Original );
+		return Result;
+		unguardSlow;
+	}
+	void Free( void* Original )
+	{
+		guardSlow(FMallocSlab::Free);
+		if( !Original )
+			return;
+		FSlab* Slab = GetSlab( Original );
+		if( !Slab )
+		{
+			FreeLarge( Original );
+			return;
+		}
+		checkSlow(Slab->Class!=INDEX_NONE);
+
+		INT Class = Slab->Class;
+		if( Stats )
+			TrackFree( Slab, Original );
+		FThreadCache* Cache = GetThreadCache();
+		if( Cache )
+		{
+			FMagazine& Magazine = Cache->Magazines[Class];
+			if( Magazine.Num>=Classes[Class].MagazineSize )
+			{
+				INT Flush = Magazine.Num/2;
+				FreeBlocks( Class, Magazine.Blocks+Magazine.Num-Flush, Flush );
+				Magazine.Num -= Flush;
+			}
+			Magazine.Blocks[Magazine.Num++] = Original;
+		}
+		else FreeBlocks( Class, &Original, 1 );
+		unguardSlow;
+	}
+	void DumpAllocs()
+	{
+		guard(FMallocSlab::DumpAllocs);
+		DumpClasses( *GLog );
+		if( Stats )
+			DumpTags( *GLog );
+		unguard;
+	}
+	void HeapCheck()
+	{
+		guard(FMallocSlab::HeapCheck);
+		for( INT i=0; i<NUM_CLASSES; i++ )
+		{
+			FScopeLock Lock( Classes[i].Lock );
+			for( FSlab* Slab=Classes[i].Partial; Slab; Slab=Slab->Next )
+			{
+				check(Slab->Class==i);
+				check(Slab->Partial);
+				check(Slab->NumUsed<Slab->NumSlots);
+				check(Slab->NumCarved<=Slab->NumSlots);
+				INT NumFree = Slab->NumCarved-Slab->NumUsed;
+				for( void* Block=Slab->FreeList; Block; Block=*(void**)Block, NumFree-- )
+					check(GetSlab(Block)==Slab);
+				check(NumFree==0);
+			}
+		}
+		Base->HeapCheck();
+		unguard;
+	}
+	void Init()
+	{
+		guard(FMallocSlab::Init);
+		check(!Initialized);
+		check(Base);
+		check(sizeof(void*)==sizeof(DWORD));
+		check(sizeof(FLargeHeader)%DEFAULT_ALIGNMENT==0);
+		Base->Init();
+
+		// Build size classes: 16 byte steps up to 256, then four per power of two.
+		INT Num=0, Size, Pow;
+		for( Size=16; Size<=256; Size+=16 )
+			Classes[Num++].Size = Size;
+		for( Pow=256; Pow<MAX_SMALL_SIZE; Pow*=2 )
+			for( INT Quarter=1; Quarter<=4; Quarter++ )
+				Classes[Num++].Size = Pow+Quarter*Pow/4;
+		check(Num==NUM_CLASSES);
+		for( INT i=0, Class=0; i<ARRAY_COUNT(SizeToClass); i++ )
+		{
+			while( Classes[Class].Size<i*16 )
+				Class++;
+			SizeToClass[i] = Class;
+		}
+		for( INT c=0; c<NUM_CLASSES; c++ )
+		{
+			FSizeClass& Class  = Classes[c];
+			Class.MagazineSize = Clamp( 16384/Class.Size, 4, (INT)MAX_MAGAZINE );
+			Class.Reciprocal   = (DWORD)((((QWORD)1<<32)+Class.Size-1)/Class.Size);
+			Class.Partial      = NULL;
+			Class.Empty        = NULL;
+			Class.NumSlabs     = 0;
+		}
+
+		// Page map.
+		PageMap = (FSlab**)Base->Malloc( PAGE_MAP_SIZE*sizeof(FSlab*), TEXT("SlabPageMap") );
+		appMemzero( PageMap, PAGE_MAP_SIZE*sizeof(FSlab*) );
+
+		// Tag statistics. Tag 0 catches untagged allocations and overflow.
+		if( Stats )
+		{
+			Tags    = (FTagStats*)Base->Malloc( MAX_TAGS*sizeof(FTagStats), TEXT("SlabTags") );
+			TagHash = (FTagHashEntry*)Base->Malloc( TAG_HASH_SIZE*sizeof(FTagHashEntry), TEXT("SlabTagHash") );
+			appMemzero( Tags, MAX_TAGS*sizeof(FTagStats) );
+			appMemzero( TagHash, TAG_HASH_SIZE*sizeof(FTagHashEntry) );
+			appStrcpy( Tags[0].Name, TEXT("Other") );
+			NumTags = 1;
+		}
+
+		TlsSlot        = appTlsAlloc();
+		LastReportTime = appSeconds();
+		Initialized    = 1;
+		if( TlsSlot!=INDEX_NONE )
+			appRegisterThreadExitHandler( this );
+		unguard;
+	}
+	void Exit()
+	{
+		guard(FMallocSlab::Exit);
+		check(Initialized);
+		Initialized = 0;
+		if( TlsSlot!=INDEX_NONE )
+		{
+			appUnregisterThreadExitHandler( this );
+			appTlsFree( TlsSlot );
+		}
+		while( ThreadCaches )
+		{
+			FThreadCache* Next = ThreadCaches->Next;
+			Base->Free( ThreadCaches );
+			ThreadCaches = Next;
+		}
+		while( SuperChunks )
+		{
+			FSuperChunk* Next = SuperChunks->Next;
+			for( INT i=0; i<SLABS_PER_CHUNK; i++ )
+				if( SuperChunks->Slabs[i].Tags )
+					Base->Free( SuperChunks->Slabs[i].Tags );
+			Base->Free( SuperChunks->Allocation );
+			Base->Free( SuperChunks );
+			SuperChunks = Next;
+		}
+		if( Tags )
+			Base->Free( Tags );
+		if( TagHash )
+			Base->Free( TagHash );
+		Base->Free( PageMap );
+		Base->Exit();
+		Tags      = NULL;
+		TagHash   = NULL;
+		PageMap   = NULL;
+		FreeSlabs = NULL;
+		unguard;
+	}
+
+	// FExec interface.
+	UBOOL Exec( const TCHAR* Cmd, FOutputDevice& Ar )
+	{
+		guard(FMallocSlab::Exec);
+		if( ParseCommand(&Cmd,TEXT("MALLOC")) )
+		{
+			if( ParseCommand(&Cmd,TEXT("TAGS")) )
+				DumpTags( Ar );
+			else if( ParseCommand(&Cmd,TEXT("CLASSES")) )
+				DumpClasses( Ar );
+			else if( ParseCommand(&Cmd,TEXT("FLUSH")) )
+				FlushThreadCache();
+			else
+			{
+				DumpClasses( Ar );
+				DumpTags( Ar );
+			}
+			return 1;
+		}
+		return 0;
+		unguard;
+	}
+
+	// FMallocSlab interface.
+	void FlushThreadCache()
+	{
+		guard(FMallocSlab::FlushThreadCache);
+		FThreadCache* Cache = GetThreadCache();
+		if( Cache )
+			FlushMagazines( Cache );
+		unguard;
+	}
+
+	// FThreadExitHandler interface.
+	void ThreadExit()
+	{
+		guard(FMallocSlab::ThreadExit);
+		FThreadCache* Cache = (FThreadCache*)appTlsGetValue( TlsSlot );
+		appTlsSetValue( TlsSlot, (void*)EXITED_CACHE );
+		if( !Cache || Cache==(FThreadCache*)EXITED_CACHE )
+			return;
+		FlushMagazines( Cache );
+		{
+			FScopeLock Lock( CacheLock );
+			FThreadCache** Link = &ThreadCaches;
+			while( *Link!=Cache )
+				Link = &(*Link)->Next;
+			*Link = Cache->Next;
+		}
+		BaseLock.Lock();
+		Base->Free( Cache );
+		BaseLock.Unlock();
+		unguard;
+	}
+
+private:
+	// Block lookup.
+	FSlab* GetSlab( void* Ptr )
+	{
+		return PageMap[(DWORD)Ptr>>SLAB_SIZE_BITS];
+	}
+	INT GetSlot( FSlab* Slab, void* Ptr )
+	{
+		return (INT)(((QWORD)(DWORD)((BYTE*)Ptr-Slab->Base)*Classes[Slab->Class].Reciprocal)>>32);
+	}
+	DWORD GetBlockSize( void* Ptr )
+	{
+		FSlab* Slab = GetSlab( Ptr );
+		if( Slab )
+			return Classes[Slab->Class].Size;
+		FLargeHeader* Header = (FLargeHeader*)Ptr-1;
+		check(Header->Magic==LARGE_MAGIC);
+		return Header->Size;
+	}
+
+	// Thread cache, NULL if no TLS is available or the thread is exiting.
+	FThreadCache* GetThreadCache()
+	{
+		if( TlsSlot==INDEX_NONE )
+			return NULL;
+		FThreadCache* Cache = (FThreadCache*)appTlsGetValue( TlsSlot );
+		if( Cache==(FThreadCache*)EXITED_CACHE )
+			return NULL;
+		if( !Cache )
+		{
+			BaseLock.Lock();
+			Cache = (FThreadCache*)Base->Malloc( sizeof(FThreadCache), TEXT("SlabThreadCache") );
+			BaseLock.Unlock();
+			appMemzero( Cache, sizeof(FThreadCache) );
+
+			FScopeLock Lock( CacheLock );
+			Cache->Next  = ThreadCaches;
+			ThreadCaches = Cache;
+			appTlsSetValue( TlsSlot, Cache );
+		}
+		return Cache;
+	}
+	void FlushMagazines( FThreadCache* Cache )
+	{
+		for( INT i=0; i<NUM_CLASSES; i++ )
+		{
+			FreeBlocks( i, Cache->Magazines[i].Blocks, Cache->Magazines[i].Num );
+			Cache->Magazines[i].Num = 0;
+		}
+	}
+
+	// Size class functions.
+	INT AllocateBlocks( INT c, void** Out, INT Num )
+	{
+		guardSlow(FMallocSlab::AllocateBlocks);
+		FSizeClass& Class = Classes[c];
+		FScopeLock Lock( Class.Lock );
+		INT Count = 0;
+		while( Count<Num )
+		{
+			FSlab* Slab = Class.Partial;
+			if( !Slab )
+			{
+				if( Class.Empty )
+				{
+					Slab        = Class.Empty;
+					Class.Empty = NULL;
+				}
+				else Slab = NewSlab( c );
+				LinkPartial( Class, Slab );
+			}
+			while( Count<Num && Slab->NumUsed<Slab->NumSlots )
+			{
+				void* Block;
+				if( Slab->FreeList )
+				{
+					Block          = Slab->FreeList;
+					Slab->FreeList = *(void**)Block;
+				}
+				else Block = Slab->Base + Class.Size*Slab->NumCarved++;
+				Slab->NumUsed++;
+				Out[Count++] = Block;
+			}
+			if( Slab->NumUsed==Slab->NumSlots )
+				UnlinkPartial( Class, Slab );
+		}
+		return Count;
+		unguardSlow;
+	}
+	void FreeBlocks( INT c, void** In, INT Num )
+	{
+		guardSlow(FMallocSlab::FreeBlocks);
+		FSizeClass& Class = Classes[c];
+		FScopeLock Lock( Class.Lock );
+		for( INT i=0; i<Num; i++ )
+		{
+			FSlab* Slab     = GetSlab( In[i] );
+			checkSlow(Slab && Slab->Class==c);
+			*(void**)In[i]  = Slab->FreeList;
+			Slab->FreeList  = In[i];
+			if( --Slab->NumUsed==0 )
+			{
+				// Keep one empty slab, release the others.
+				if( Slab->Partial )
+					UnlinkPartial( Class, Slab );
+				if( !Class.Empty )
+					Class.Empty = Slab;
+				else
+					ReleaseSlab( Slab );
+			}
+			else if( !Slab->Partial )
+				LinkPartial( Class, Slab );
+		}
+		unguardSlow;
+	}
+	void LinkPartial( FSizeClass& Class, FSlab* Slab )
+	{
+		Slab->Prev    = NULL;
+		Slab->Next    = Class.Partial;
+		Slab->Partial = 1;
+		if( Class.Partial )
+			Class.Partial->Prev = Slab;
+		Class.Partial = Slab;
+	}
+	void UnlinkPartial( FSizeClass& Class, FSlab* Slab )
+	{
+		if( Slab->Prev )
+			Slab->Prev->Next = Slab->Next;
+		else
+			Class.Partial = Slab->Next;
+		if( Slab->Next )
+			Slab->Next->Prev = Slab->Prev;
+		Slab->Next    = NULL;
+		Slab->Prev    = NULL;
+		Slab->Partial = 0;
+	}
+
+	// Slab functions, called with the size class lock held.
+	FSlab* NewSlab( INT c )
+	{
+		guardSlow(FMallocSlab::NewSlab);
+		FSlab* Slab;
+		{
+			FScopeLock Lock( SlabLock );
+			if( !FreeSlabs )
+				NewSuperChunk();
+			Slab      = FreeSlabs;
+			FreeSlabs = Slab->Next;
+		}
+		Slab->Class     = c;
+		Slab->NumSlots  = SLAB_SIZE/Classes[c].Size;
+		Slab->NumUsed   = 0;
+		Slab->NumCarved = 0;
+		Slab->FreeList  = NULL;
+		Slab->Next      = NULL;
+		Slab->Prev      = NULL;
+		Slab->Partial   = 0;
+		if( Stats )
+		{
+			BaseLock.Lock();
+			Slab->Tags = (_WORD*)Base->Malloc( Slab->NumSlots*sizeof(_WORD), TEXT("SlabTags") );
+			BaseLock.Unlock();
+		}
+		Classes[c].NumSlabs++;
+		return Slab;
+		unguardSlow;
+	}
+	void ReleaseSlab( FSlab* Slab )
+	{
+		guardSlow(FMallocSlab::ReleaseSlab);
+		Classes[Slab->Class].NumSlabs--;
+		if( Slab->Tags )
+		{
+			BaseLock.Lock();
+			Base->Free( Slab->Tags );
+			BaseLock.Unlock();
+			Slab->Tags = NULL;
+		}
+		Slab->Class = INDEX_NONE;
+		FScopeLock Lock( SlabLock );
+		Slab->Next  = FreeSlabs;
+		FreeSlabs   = Slab;
+		unguardSlow;
+	}
+	void NewSuperChunk()
+	{
+		guardSlow(FMallocSlab::NewSuperChunk);
+		FScopeLock Lock( BaseLock );
+		FSuperChunk* Chunk = (FSuperChunk*)Base->Malloc( sizeof(FSuperChunk), TEXT("SlabSuperChunk") );
+		Chunk->Allocation  = Base->Malloc( (SLABS_PER_CHUNK+1)*SLAB_SIZE, TEXT("SlabMemory") );
+		if( !Chunk->Allocation )
+			appErrorf( TEXT("FMallocSlab: Out of memory") );
+		Chunk->Next        = SuperChunks;
+		SuperChunks        = Chunk;
+		BYTE* Memory       = (BYTE*)Align( (DWORD)Chunk->Allocation, SLAB_SIZE );
+		for( INT i=0; i<SLABS_PER_CHUNK; i++ )
+		{
+			FSlab* Slab = &Chunk->Slabs[i];
+			appMemzero( Slab, sizeof(FSlab) );
+			Slab->Base  = Memory + i*SLAB_SIZE;
+			Slab->Class = INDEX_NONE;
+			Slab->Next  = FreeSlabs;
+			FreeSlabs   = Slab;
+			PageMap[(DWORD)Slab->Base>>SLAB_SIZE_BITS] = Slab;
+		}
+		unguardSlow;
+	}
+
+	// Large blocks.
+	void* MallocLarge( DWORD Count, const TCHAR* Tag )
+	{
+		guardSlow(FMallocSlab::MallocLarge);
+		BaseLock.Lock();
+		FLargeHeader* Header = (FLargeHeader*)Base->Malloc( Count+sizeof(FLargeHeader), Tag );
+		BaseLock.Unlock();
+		Header->Size  = Count;
+		Header->Magic = LARGE_MAGIC;
+		Header->Tag   = 0;
+		if( Stats )
+		{
+			Header->Tag = FindTag( Tag );
+			appInterlockedAdd( &Tags[Header->Tag].LiveLargeBytes, Count );
+			appInterlockedIncrement( &Tags[Header->Tag].NumAllocs );
+		}
+		return Header+1;
+		unguardSlow;
+	}
+	void FreeLarge( void* Original )
+	{
+		guardSlow(FMallocSlab::FreeLarge);
+		FLargeHeader* Header = (FLargeHeader*)Original-1;
+		check(Header->Magic==LARGE_MAGIC);
+		if( Stats )
+			appInterlockedAdd( &Tags[Header->Tag].LiveLargeBytes, -(INT)Header->Size );
+		Header->Magic = 0;
+		FScopeLock Lock( BaseLock );
+		Base->Free( Header );
+		unguardSlow;
+	}
+
+	// Tag statistics.
+	void TrackAlloc( FSlab* Slab, void* Ptr, const TCHAR* Tag )
+	{
+		INT Index = FindTag( Tag );
+		Slab->Tags[GetSlot(Slab,Ptr)] = Index;
+		appInterlockedIncrement( &Tags[Index].LiveSlots[Slab->Class] );
+		appInterlockedIncrement( &Tags[Index].NumAllocs );
+	}
+	void TrackFree( FSlab* Slab, void* Ptr )
+	{
+		INT Index = Slab->Tags[GetSlot(Slab,Ptr)];
+		appInterlockedDecrement( &Tags[Index].LiveSlots[Slab->Class] );
+	}
+	INT FindTag( const TCHAR* Tag )
+	{
+		if( !Tag )
+			return 0;
+
+		// Lock free lookup by pointer, tags are almost always string literals.
+		DWORD Hash = ((DWORD)Tag>>1)*2654435761U;
+		INT   i;
+		for( i=Hash>>20; TagHash[i].Ptr; i=(i+1)&(TAG_HASH_SIZE-1) )
+			if( TagHash[i].Ptr==Tag )
+				return TagHash[i].Index;
+
+		// Match by name, so equal literals in different modules are merged.
+		FScopeLock Lock( TagLock );
+		for( i=Hash>>20; TagHash[i].Ptr; i=(i+1)&(TAG_HASH_SIZE-1) )
+			if( TagHash[i].Ptr==Tag )
+				return TagHash[i].Index;
+		if( NumTagHash>=TAG_HASH_SIZE/2 )
+			return 0;
+		INT Index;
+		for( Index=1; Index<NumTags; Index++ )
+			if( appStricmp(Tags[Index].Name,Tag)==0 )
+				break;
+		if( Index==NumTags )
+		{
+			if( NumTags==MAX_TAGS )
+				return 0;
+			appStrncpy( Tags[Index].Name, Tag, ARRAY_COUNT(Tags[Index].Name) );
+			NumTags++;
+		}
+		TagHash[i].Index = Index;
+		appMemoryBarrier();
+		TagHash[i].Ptr   = Tag;
+		NumTagHash++;
+		return Index;
+	}
+	void DumpClasses( FOutputDevice& Ar )
+	{
+		guard(FMallocSlab::DumpClasses);
+		INT TotalSlabs=0, TotalLive=0;
+		Ar.Logf( TEXT("Size classes:") );
+		Ar.Logf( TEXT("  %6s %6s %10s %10s %6s"), TEXT("Size"), TEXT("Slabs"), TEXT("LiveKB"), TEXT("SlackKB"), TEXT("Frag%") );
+		for( INT c=0; c<NUM_CLASSES; c++ )
+		{
+			INT Live = GetLiveSlots( c )*Classes[c].Size;
+			INT Used = Classes[c].NumSlabs*SLAB_SIZE;
+			if( !Used )
+				continue;
+			Ar.Logf( TEXT("  %6i %6i %10i %10i %6.1f"), Classes[c].Size, Classes[c].NumSlabs, Live/1024, (Used-Live)/1024, 100.0*(Used-Live)/Used );
+			TotalSlabs += Classes[c].NumSlabs;
+			TotalLive  += Live;
+		}
+		INT Committed = 0;
+		for( FSuperChunk* Chunk=SuperChunks; Chunk; Chunk=Chunk->Next )
+			Committed += SLABS_PER_CHUNK*SLAB_SIZE;
+		Ar.Logf( TEXT("  Slabs: %i in use, %iK committed, %iK live"), TotalSlabs, Committed/1024, TotalLive/1024 );
+		unguard;
+	}
+	void DumpTags( FOutputDevice& Ar )
+	{
+		guard(FMallocSlab::DumpTags);
+		if( !Stats )
+		{
+			Ar.Logf( TEXT("Allocation tags are not tracked.") );
+			return;
+		}
+
+		// Bytes lost in each class, attributed to tags by their share of live blocks.
+		DOUBLE Slack[NUM_CLASSES];
+		INT    c;
+		for( c=0; c<NUM_CLASSES; c++ )
+		{
+			INT Live = GetLiveSlots( c );
+			Slack[c] = Live ? (DOUBLE)(Classes[c].NumSlabs*SLAB_SIZE-Live*Classes[c].Size)/Live : 0.0;
+		}
+
+		DOUBLE Now     = appSeconds();
+		DOUBLE Elapsed = Max( Now-LastReportTime, 0.001 );
+		LastReportTime = Now;
+		Ar.Logf( TEXT("Allocation tags:") );
+		Ar.Logf( TEXT("  %-32s %10s %10s %10s %6s"), TEXT("Tag"), TEXT("LiveKB"), TEXT("Blocks"), TEXT("Allocs/s"), TEXT("Frag%") );
+		for( INT i=0; i<NumTags; i++ )
+		{
+			FTagStats& Tag = Tags[i];
+			DOUBLE Live=Tag.LiveLargeBytes, Lost=0.0;
+			INT    Blocks=0;
+			for( c=0; c<NUM_CLASSES; c++ )
+			{
+				Live   += (DOUBLE)Tag.LiveSlots[c]*Classes[c].Size;
+				Lost   += Tag.LiveSlots[c]*Slack[c];
+				Blocks += Tag.LiveSlots[c];
+			}
+			INT NumAllocs     = Tag.NumAllocs;
+			INT Rate          = (DWORD)(NumAllocs-Tag.LastNumAllocs)/Elapsed;
+			Tag.LastNumAllocs = NumAllocs;
+			if( Live>0.0 || Rate )
+				Ar.Logf( TEXT("  %-32s %10i %10i %10i %6.1f"), Tag.Name, (INT)(Live/1024), Blocks, Rate, Live>0.0 ? 100.0*Lost/(Live+Lost) : 0.0 );
+		}
+		unguard;
+	}
+	INT GetLiveSlots( INT c )
+	{
+		// With stats these are blocks held by the application, otherwise
+		// blocks cached in thread magazines are counted as well.
+		INT Live = 0;
+		if( Stats )
+		{
+			for( INT i=0; i<NumTags; i++ )
+				Live += Tags[i].LiveSlots[c];
+		}
+		else
+		{
+			FScopeLock Lock( Classes[c].Lock );
+			Live += (Classes[c].NumSlabs-(Classes[c].Empty!=NULL))*(SLAB_SIZE/Classes[c].Size);
+			for( FSlab* Slab=Classes[c].Partial; Slab; Slab=Slab->Next )
+				Live += Slab->NumUsed - SLAB_SIZE/Classes[c].Size;
+		}
+		return Live;
+	}
+};
+
+/*-----------------------------------------------------------------------------
+	The End.
+-----------------------------------------------------------------------------*/
@@ -0,0 +1,518 @@
+/*=============================================================================
+	FScriptCache.h: Pre-decoded call sites and dispatch for UnrealScript.
+	Copyright 2016-2019 Sebastian Kaufel, Inc. All Rights Reserved.
+
+	Notes:
+	* This file contains the implementation, include it only once (e.g. in
+	  the launcher) and install the cache once Core is initialized:
+
+		static FScriptCache ScriptCache;
+		ScriptCache.Install();
+
+	* The byte code interpreter lives in Core.dll, only its extension points
+	  can be used: the GNatives table and UFunction::Func. Script functions
+	  get a dispatcher in place of UObject::ProcessInternal, which runs the
+	  statement loop off a per struct table of pre-decoded ops. Ops are
+	  decoded the first time their offset is executed and hold the resolved
+	  native of extended native calls, the function of final calls and a
+	  small cache of (class, state) to function for virtual and global calls.
+	* Operands are still read from the byte code by the natives themselves,
+	  so nested expressions are stepped through GNatives as before. The
+	  natives for EX_VirtualFunction, EX_FinalFunction and EX_GlobalFunction
+	  are replaced as well, so calls inside expressions and in state code
+	  use the same call site caches.
+	* Everything is flushed after a garbage collection, which is noticed
+	  through an FGarbageSentinel. A struct's ops are decoded again once its
+	  script was relinked. Keep the cache off in the editor, classes can be
+	  recompiled there without a collection.
+	* Use "SCRIPTCACHE [ON|OFF|FLUSH]" to switch back to the byte code
+	  interpreter for debugging and to report stats. Route it to
+	  FScriptCache::Exec().
+	* Game thread only.
+=============================================================================*/
+
+/*-----------------------------------------------------------------------------
+	UScriptCacheNatives.
+-----------------------------------------------------------------------------*/
+
+//
+// Replacement natives. Never instantiated, they are called on whatever
+// object the interpreter is executing, like any other native.
+//
+class UScriptCacheNatives : public UObject
+{
+public:
+	void execProcessCached( FFrame& Stack, RESULT_DECL );
+	void execCachedVirtualFunction( FFrame& Stack, RESULT_DECL );
+	void execCachedFinalFunction( FFrame& Stack, RESULT_DECL );
+	void execCachedGlobalFunction( FFrame& Stack, RESULT_DECL );
+};
+
+/*-----------------------------------------------------------------------------
+	FScriptCache.
+-----------------------------------------------------------------------------*/
+
+class FScriptCache : public FExec
+{
+public:
+	// Constants.
+	enum {CALL_CACHE_SIZE=4};
+	enum {RECURSE_LIMIT=250};
+
+	// Kinds of pre-decoded ops.
+	enum EScriptOp
+	{
+		OP_Native,
+		OP_HighNative,
+		OP_VirtualFunction,
+		OP_GlobalFunction,
+		OP_FinalFunction,
+		OP_Return,
+		OP_MAX,
+	};
+
+	// Function called at a call site for a receiver class and state.
+	struct FCallCache
+	{
+		UClass*		Class;
+		UState*		State;
+		UFunction*	Function;
+	};
+
+	// A pre-decoded token.
+	struct FOp
+	{
+		BYTE		Kind;
+		BYTE		Size;		// Bytes of token and operands.
+		BYTE		NextCall;	// Call cache entry to replace next.
+		Native		Handler;	// OP_Native, OP_HighNative.
+		FName		Name;		// OP_VirtualFunction, OP_GlobalFunction.
+		UFunction*	Function;	// OP_FinalFunction.
+		FCallCache	Calls[CALL_CACHE_SIZE];
+	};
+
+	// Pre-decoded ops of a struct's script, by code offset.
+	struct FRecord
+	{
+		UStruct*	Node;
+		BYTE*		Script;
+		INT			ScriptNum;
+		TArray<INT>	OpIndex;
+		TArray<FOp>	Ops;
+	};
+
+	// The installed cache, used by the replacement natives.
+	static FScriptCache* Current;
+
+	// Constructors.
+	FScriptCache()
+	:	Installed( 0 )
+	,	Generation( 0 )
+	,	Recurse( 0 )
+	,	OldVirtualFunction( NULL )
+	,	OldFinalFunction( NULL )
+	,	OldGlobalFunction( NULL )
+	,	NumDecoded( 0 )
+	,	NumFlushes( 0 )
+	,	NumHits( 0 )
+	,	NumMisses( 0 )
+	{}
+	~FScriptCache()
+	{
+		FreeRecords();
+	}
+
+	// FScriptCache interface.
+	void Install()
+	{
+		guard(FScriptCache::Install);
+		if( Installed )
+			return;
+		check(!Current || Current==this);
+		Current            = this;
+		OldVirtualFunction = GNatives[EX_VirtualFunction];
+		OldFinalFunction   = GNatives[EX_FinalFunction];
+		OldGlobalFunction  = GNatives[EX_GlobalFunction];
+		GNatives[EX_VirtualFunction] = (Native)&UScriptCacheNatives::execCachedVirtualFunction;
+		GNatives[EX_FinalFunction]   = (Native)&UScriptCacheNatives::execCachedFinalFunction;
+		GNatives[EX_GlobalFunction]  = (Native)&UScriptCacheNatives::execCachedGlobalFunction;
+		Installed = 1;
+		Flush();
+		unguard;
+	}
+	void Uninstall()
+	{
+		guard(FScriptCache::Uninstall);
+		if( !Installed )
+			return;
+		GNatives[EX_VirtualFunction] = OldVirtualFunction;
+		GNatives[EX_FinalFunction]   = OldFinalFunction;
+		GNatives[EX_GlobalFunction]  = OldGlobalFunction;
+		for( TObjectIterator<UFunction> It; It; ++It )
+			if( It->Func==(Native)&UScriptCacheNatives::execProcessCached )
+				It->Func = (Native)&UObject::ProcessInternal;
+		Installed = 0;
+		Flush();
+		unguard;
+	}
+	void Flush()
+	{
+		guard(FScriptCache::Flush);
+		FreeRecords();
+		Generation++;
+		NumFlushes++;
+		Sentinel.Clear();
+		if( Installed )
+		{
+			Sentinel.Reset();
+			for( TObjectIterator<UFunction> It; It; ++It )
+				Attach( *It );
+		}
+		unguard;
+	}
+	UBOOL IsUsable()
+	{
+		guardSlow(FScriptCache::IsUsable);
+		if( !Installed )
+			return 0;
+#if DEUS_EX
+		if( UObject::IsInGarbageCollection() )
+			return 0;
+#endif
+		if( !Sentinel.IsAlive() )
+			Flush();
+		return 1;
+		unguardSlow;
+	}
+	void Attach( UFunction* Function )
+	{
+		if( Installed && Function->Func==(Native)&UObject::ProcessInternal )
+			Function->Func = (Native)&UScriptCacheNatives::execProcessCached;
+	}
+
+	// Runs the statement loop of the script function in Stack, see
+	// UObject::ProcessInternal().
+	void Run( FFrame& Stack, RESULT_DECL )
+	{
+		guardSlow(FScriptCache::Run);
+		BYTE  Buffer[MAX_CONST_SIZE];
+		void* Dest          = Buffer;
+		UBOOL Done          = 0;
+		DWORD RunGeneration = Generation;
+		FRecord* Record     = GetRecord( Stack.Node );
+		FRecurseScope RecurseScope( Recurse );
+		if( Recurse > RECURSE_LIMIT )
+			Stack.Logf( NAME_Critical, TEXT("Infinite script recursion (%i calls) detected"), RECURSE_LIMIT );
+#if __GNUC__
+		static void* Labels[OP_MAX] = { &&Op_Native, &&Op_HighNative, &&Op_VirtualFunction, &&Op_GlobalFunction, &&Op_FinalFunction, &&Op_Return };
+		#define DISPATCH_OP(Kind)	goto *Labels[Kind];
+		#define CASE_OP(Kind)		Op_##Kind:
+#else
+		#define DISPATCH_OP(Kind)	switch( Kind )
+		#define CASE_OP(Kind)		case OP_##Kind:
+#endif
+		#define NEXT_OP				if( Done ) goto Finished; continue;
+		for( ;; )
+		{
+			if( RunGeneration!=Generation )
+			{
+				// Flushed or uninstalled by a call.
+				if( !Installed )
+				{
+					while( *Stack.Code!=EX_Return )
+						Stack.Step( Stack.Object, Buffer );
+					Stack.Code++;
+					Stack.Step( Stack.Object, Result );
+					goto Finished;
+				}
+				RunGeneration = Generation;
+				Record        = GetRecord( Stack.Node );
+			}
+			INT Offset = Stack.Code - Record->Script;
+			checkSlow(Offset>=0 && Offset<Record->ScriptNum);
+			FOp& Op = Record->Ops( GetOp(Record,Offset) );
+			DISPATCH_OP(Op.Kind)
+			{
+				CASE_OP(Native)
+				{
+					Native Handler = Op.Handler;
+					Stack.Code++;
+					(Stack.Object->*Handler)( Stack, Dest );
+					NEXT_OP;
+				}
+				CASE_OP(HighNative)
+				{
+					Native Handler = Op.Handler;
+					Stack.Code += 2;
+					(Stack.Object->*Handler)( Stack, Dest );
+					NEXT_OP;
+				}
+				CASE_OP(VirtualFunction)
+				{
+					Stack.Code += Op.Size;
+					Stack.Object->CallFunction( Stack, Dest, Resolve(Op,Stack.Object,0) );
+					NEXT_OP;
+				}
+				CASE_OP(GlobalFunction)
+				{
+					Stack.Code += Op.Size;
+					Stack.Object->CallFunction( Stack, Dest, Resolve(Op,Stack.Object,1) );
+					NEXT_OP;
+				}
+				CASE_OP(FinalFunction)
+				{
+					UFunction* Function = Op.Function;
+					Attach( Function );
+					Stack.Code += Op.Size;
+					Stack.Object->CallFunction( Stack, Dest, Function );
+					NEXT_OP;
+				}
+				CASE_OP(Return)
+				{
+					// Evaluate the return value into Result and stop.
+					Stack.Code++;
+					Dest = Result;
+					Done = 1;
+					continue;
+				}
+			}
+		}
+	Finished: ;
+		#undef DISPATCH_OP
+		#undef CASE_OP
+		#undef NEXT_OP
+		unguardfSlow(( TEXT("(%s @ %s : %04X)"), Stack.Object->GetFullName(), Stack.Node->GetFullName(), Stack.Code - &Stack.Node->Script(0) ));
+	}
+
+	// Resolves the function called by the EX_VirtualFunction or
+	// EX_GlobalFunction token just read by Stack.Step().
+	UFunction* ResolveCall( FFrame& Stack, UObject* Object, UBOOL Global )
+	{
+		guardSlow(FScriptCache::ResolveCall);
+		if( Stack.Node && IsUsable() )
+		{
+			FRecord* Record = GetRecord( Stack.Node );
+			INT      Offset = Stack.Code - 1 - Record->Script;
+			if( Offset>=0 && Offset<Record->ScriptNum )
+			{
+				FOp& Op = Record->Ops( GetOp(Record,Offset) );
+				if( Op.Kind==(Global ? OP_GlobalFunction : OP_VirtualFunction) )
+				{
+					Stack.Code += Op.Size - 1;
+					return Resolve( Op, Object, Global );
+				}
+			}
+		}
+		return Object->FindFunctionChecked( Stack.ReadName(), Global );
+		unguardSlow;
+	}
+
+	// FExec interface.
+	UBOOL Exec( const TCHAR* Cmd, FOutputDevice& Ar )
+	{
+		guard(FScriptCache::Exec);
+		if( ParseCommand(&Cmd,TEXT("SCRIPTCACHE")) )
+		{
+			if( ParseCommand(&Cmd,TEXT("ON")) )
+				Install();
+			else if( ParseCommand(&Cmd,TEXT("OFF")) )
+				Uninstall();
+			else if( ParseCommand(&Cmd,TEXT("FLUSH")) )
+				Flush();
+			Ar.Logf( TEXT("Script cache %s: %i structs, %i ops decoded, %.0f call site hits, %.0f misses, %i flushes."), Installed ? TEXT("on") : TEXT("off"), Records.Num(), NumDecoded, NumHits, NumMisses, NumFlushes );
+			return 1;
+		}
+		return 0;
+		unguard;
+	}
+
+private:
+	FScriptCache( const FScriptCache& );
+	void operator=( const FScriptCache& );
+
+	// Counts a Run() for the recursion check. Undone in the destructor, so
+	// script errors unwinding through Run() leave the count intact.
+	class FRecurseScope
+	{
+	public:
+		FRecurseScope( INT& InRecurse ) : Recurse( InRecurse ) { ++Recurse; }
+		~FRecurseScope() { --Recurse; }
+	private:
+		INT& Recurse;
+	};
+
+	// Variables.
+	UBOOL						Installed;
+	DWORD						Generation;
+	INT							Recurse;
+	FGarbageSentinel			Sentinel;
+	Native						OldVirtualFunction;
+	Native						OldFinalFunction;
+	Native						OldGlobalFunction;
+	TArray<FRecord*>			Records;
+	TFlatMap<UStruct*,FRecord*>	RecordMap;
+	INT							NumDecoded;
+	INT							NumFlushes;
+	DOUBLE						NumHits;
+	DOUBLE						NumMisses;
+
+	// Implementation.
+	void FreeRecords()
+	{
+		for( INT i=0; i<Records.Num(); i++ )
+			delete Records(i);
+		Records.Empty();
+		RecordMap.Empty();
+	}
+	FRecord* GetRecord( UStruct* Node )
+	{
+		guardSlow(FScriptCache::GetRecord);
+		FRecord* Record = RecordMap.FindRef( Node );
+		if( Record && Record->Script==Node->Script.GetData() && Record->ScriptNum==Node->Script.Num() )
+			return Record;
+
+		// New or relinked script.
+		if( !Record )
+		{
+			Record = new FRecord;
+			Records.AddItem( Record );
+			RecordMap.Set( Node, Record );
+		}
+		Record->Node      = Node;
+		Record->Script    = (BYTE*)Node->Script.GetData();
+		Record->ScriptNum = Node->Script.Num();
+		Record->Ops.Empty();
+		Record->OpIndex.Empty();
+		Record->OpIndex.Add( Record->ScriptNum );
+		for( INT i=0; i<Record->ScriptNum; i++ )
+			Record->OpIndex(i) = INDEX_NONE;
+		return Record;
+		unguardSlow;
+	}
+	INT GetOp( FRecord* Record, INT Offset )
+	{
+		INT iOp = Record->OpIndex(Offset);
+		return iOp!=INDEX_NONE ? iOp : Decode( Record, Offset );
+	}
+	INT Decode( FRecord* Record, INT Offset )
+	{
+		guard(FScriptCache::Decode);
+		BYTE* Code  = Record->Script + Offset;
+		INT   Left  = Record->ScriptNum - Offset;
+		INT   iOp   = Record->Ops.AddZeroed();
+		FOp&  Op    = Record->Ops(iOp);
+		BYTE  Token = *Code;
+		if( (Token==EX_VirtualFunction || Token==EX_GlobalFunction) && Left>(INT)sizeof(FName) )
+		{
+			Op.Kind = Token==EX_VirtualFunction ? OP_VirtualFunction : OP_GlobalFunction;
+			Op.Size = 1 + sizeof(FName);
+			Op.Name = *(FName*)(Code+1);
+		}
+		else if( Token==EX_FinalFunction && Left>(INT)sizeof(INT) )
+		{
+			Op.Kind     = OP_FinalFunction;
+			Op.Size     = 1 + sizeof(INT);
+			Op.Function = *(UFunction**)(Code+1);
+		}
+		else if( Token==EX_Return )
+		{
+			Op.Kind = OP_Return;
+			Op.Size = 1;
+		}
+		else if( Token>=EX_ExtendedNative && Token<EX_FirstNative && Left>1 )
+		{
+			Op.Kind    = OP_HighNative;
+			Op.Size    = 2;
+			Op.Handler = GNatives[(Token-EX_ExtendedNative)*0x100 + Code[1]];
+		}
+		else
+		{
+			Op.Kind    = OP_Native;
+			Op.Size    = 1;
+			Op.Handler = GNatives[Token];
+		}
+		Record->OpIndex(Offset) = iOp;
+		NumDecoded++;
+		return iOp;
+		unguard;
+	}
+	UFunction* Resolve( FOp& Op, UObject* Object, UBOOL Global )
+	{
+		guardSlow(FScriptCache::Resolve);
+		UClass*      Class      = Object->GetClass();
+		FStateFrame* StateFrame = Object->GetStateFrame();
+		UState*      State      = (!Global && StateFrame) ? StateFrame->StateNode : NULL;
+		for( INT i=0; i<CALL_CACHE_SIZE; i++ )
+		{
+			if( Op.Calls[i].Class==Class && Op.Calls[i].State==State )
+			{
+				NumHits++;
+				return Op.Calls[i].Function;
+			}
+		}
+		NumMisses++;
+		UFunction* Function = Object->FindFunctionChecked( Op.Name, Global );
+		Attach( Function );
+		FCallCache& Call = Op.Calls[Op.NextCall];
+		Call.Class       = Class;
+		Call.State       = State;
+		Call.Function    = Function;
+		Op.NextCall      = (Op.NextCall+1) % CALL_CACHE_SIZE;
+		return Function;
+		unguardSlow;
+	}
+};
+
+FScriptCache* FScriptCache::Current = NULL;
+
+/*-----------------------------------------------------------------------------
+	UScriptCacheNatives implementation.
+-----------------------------------------------------------------------------*/
+
+//
+// Replaces UObject::ProcessInternal as UFunction::Func of script functions.
+//
+void UScriptCacheNatives::execProcessCached( FFrame& Stack, RESULT_DECL )
+{
+	guardSlow(UScriptCacheNatives::execProcessCached);
+	FScriptCache* Cache = FScriptCache::Current;
+	if( !Cache || !Cache->IsUsable() )
+	{
+		ProcessInternal( Stack, Result );
+		return;
+	}
+	UFunction* Function     = (UFunction*)Stack.Node;
+	DWORD      SingularFlag = Function->FunctionFlags & FUNC_Singular;
+	if
+	(	!ProcessRemoteFunction( Function, Stack.Locals, NULL )
+	&&	IsProbing( Function->GetFName() )
+	&&	!(GetFlags() & SingularFlag) )
+	{
+		SetFlags( SingularFlag );
+		Cache->Run( Stack, Result );
+		ClearFlags( SingularFlag );
+	}
+	unguardSlow;
+}
+
+//
+// Replacements for the function call natives.
+//
+void UScriptCacheNatives::execCachedVirtualFunction( FFrame& Stack, RESULT_DECL )
+{
+	CallFunction( Stack, Result, FScriptCache::Current->ResolveCall(Stack,this,0) );
+}
+void UScriptCacheNatives::execCachedFinalFunction( FFrame& Stack, RESULT_DECL )
+{
+	UFunction* Function = (UFunction*)Stack.ReadObject();
+	FScriptCache::Current->Attach( Function );
+	CallFunction( Stack, Result, Function );
+}
+void UScriptCacheNatives::execCachedGlobalFunction( FFrame& Stack, RESULT_DECL )
+{
+	CallFunction( Stack, Result, FScriptCache::Current->ResolveCall(Stack,this,1) );
+}
+
+/*-----------------------------------------------------------------------------
+	The End.
+-----------------------------------------------------------------------------*/
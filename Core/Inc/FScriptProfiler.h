@@ -0,0 +1,562 @@
+/*=============================================================================
+	FScriptProfiler.h: Instrumenting UnrealScript profiler.
+	Copyright 2016-2019 Sebastian Kaufel, Inc. All Rights Reserved.
+
+	Notes:
+	* This file contains the implementation, include it only once (e.g. in
+	  the launcher) and route "PROFILESCRIPT" commands to it:
+
+		static FScriptProfiler ScriptProfiler;
+
+	* Both UObject::ProcessEvent() and UObject::CallFunction() enter script
+	  functions through UFunction::Func, which is UObject::ProcessInternal
+	  (or FScriptCache's dispatcher). While profiling, Func of every script
+	  function is swapped for a native which times the call around the
+	  previous Func. Native functions are not hooked, their time counts as
+	  exclusive time of the calling script function. Latent state code only
+	  shows up through the functions it calls.
+	* Per function it keeps calls and inclusive and exclusive time, per
+	  receiver class calls and exclusive time, and a call tree for
+	  collapsed stacks. Recursive calls add to inclusive time only once.
+	  Times are taken with appSeconds(), as appCycles() wraps within
+	  seconds.
+	* To keep the overhead down for soak tests, RATE=n only instruments
+	  every n-th call entered from native code, with everything it calls.
+	  TRACE=n additionally records the first n calls for a Chrome trace.
+	* Functions loaded later are hooked after the next garbage collection,
+	  noticed through an FGarbageSentinel. The previous Func is only kept
+	  for functions which still exist then. Stats are kept by path name, so
+	  they survive packages being unloaded.
+	* Use "PROFILESCRIPT START [RATE=n] [TRACE=n]", "PROFILESCRIPT STOP",
+	  "PROFILESCRIPT RESET", "PROFILESCRIPT REPORT [NUM=n]" and
+	  "PROFILESCRIPT DUMP [FILE=base]", which writes base.folded for flame
+	  graph tools and base.json for chrome://tracing. Route them to
+	  FScriptProfiler::Exec().
+	* Game thread only.
+=============================================================================*/
+
+/*-----------------------------------------------------------------------------
+	UScriptProfilerNatives.
+-----------------------------------------------------------------------------*/
+
+//
+// Replacement native. Never instantiated, it is called on whatever object
+// executes the script function, like UObject::ProcessInternal.
+//
+class UScriptProfilerNatives : public UObject
+{
+public:
+	void execProfiledFunction( FFrame& Stack, RESULT_DECL );
+};
+
+/*-----------------------------------------------------------------------------
+	FScriptProfiler.
+-----------------------------------------------------------------------------*/
+
+class FScriptProfiler : public FExec
+{
+public:
+	// Constants.
+	enum {MAX_DEPTH=256};
+
+	// Stats of a function.
+	struct FFunctionStats
+	{
+		FString	Name;
+		INT		Calls;
+		INT		Active;
+		DOUBLE	InclusiveSeconds;
+		DOUBLE	ExclusiveSeconds;
+		FFunctionStats( const TCHAR* InName )
+		: Name( InName ), Calls( 0 ), Active( 0 ), InclusiveSeconds( 0.0 ), ExclusiveSeconds( 0.0 )
+		{}
+	};
+
+	// Stats of a receiver class.
+	struct FClassStats
+	{
+		FString	Name;
+		INT		Calls;
+		DOUBLE	ExclusiveSeconds;
+		FClassStats( const TCHAR* InName )
+		: Name( InName ), Calls( 0 ), ExclusiveSeconds( 0.0 )
+		{}
+	};
+
+	// A function called along a call path.
+	struct FNode
+	{
+		INT		Parent;
+		INT		Function;
+		INT		Calls;
+		DOUBLE	ExclusiveSeconds;
+	};
+
+	// A function call on the shadow stack.
+	struct FCall
+	{
+		INT		Node;
+		INT		Function;
+		INT		Class;
+		DOUBLE	StartSeconds;
+		DOUBLE	ChildSeconds;
+	};
+
+	// A recorded call for the Chrome trace.
+	struct FTraceEvent
+	{
+		INT		Function;
+		INT		Depth;
+		DOUBLE	StartSeconds;
+		DOUBLE	Seconds;
+	};
+
+	// The hooked profiler, used by the replacement native.
+	static FScriptProfiler* Current;
+
+	// Friends.
+	friend class UScriptProfilerNatives;
+
+	// Constructors.
+	FScriptProfiler()
+	:	Hooked( 0 )
+	,	PendingReset( 0 )
+	,	SampleRate( 1 )
+	,	MaxTraceEvents( 0 )
+	,	Depth( 0 )
+	,	SkipDepth( 0 )
+	,	NumRoots( 0 )
+	,	NumSampled( 0 )
+	,	RootPhase( 0 )
+	{}
+
+	// FScriptProfiler interface.
+	void Start( INT InSampleRate=1, INT InMaxTraceEvents=0 )
+	{
+		guard(FScriptProfiler::Start);
+		check(!Current || Current==this);
+		Current        = this;
+		SampleRate     = Max( InSampleRate, 1 );
+		MaxTraceEvents = Max( InMaxTraceEvents, 0 );
+		Hooked         = 1;
+		Hook();
+		unguard;
+	}
+	void Stop()
+	{
+		guard(FScriptProfiler::Stop);
+		if( !Hooked )
+			return;
+		for( TObjectIterator<UFunction> It; It; ++It )
+		{
+			if( It->Func==(Native)&UScriptProfilerNatives::execProfiledFunction )
+			{
+				Native Original = Originals.FindRef( *It );
+				It->Func = Original ? Original : (Native)&UObject::ProcessInternal;
+			}
+		}
+		Originals.Empty();
+		FunctionMap.Empty();
+		ClassMap.Empty();
+		Sentinel.Clear();
+		Hooked = 0;
+		unguard;
+	}
+	void Reset()
+	{
+		guard(FScriptProfiler::Reset);
+		if( Depth || SkipDepth )
+		{
+			// Called from script, wait for the next call from native code.
+			PendingReset = 1;
+			return;
+		}
+		PendingReset = 0;
+		Functions.Empty();
+		Classes.Empty();
+		Nodes.Empty();
+		Trace.Empty();
+		FunctionMap.Empty();
+		ClassMap.Empty();
+		FunctionNames.Empty();
+		ClassNames.Empty();
+		Edges.Empty();
+		NumRoots   = 0;
+		NumSampled = 0;
+		RootPhase  = 0;
+		unguard;
+	}
+
+	// Called around the previous Func of a hooked function. Returns whether
+	// the call is instrumented, End() must be called if so.
+	UBOOL Begin( UFunction* Function, UObject* Object )
+	{
+		guardSlow(FScriptProfiler::Begin);
+		if( SkipDepth || Depth>=MAX_DEPTH )
+			return 0;
+		if( Depth==0 )
+		{
+#if DEUS_EX
+			if( UObject::IsInGarbageCollection() )
+				return 0;
+#endif
+			if( PendingReset )
+				Reset();
+			if( !Sentinel.IsAlive() )
+			{
+				// Pointers may have been reused, rehook and resolve again.
+				FunctionMap.Empty();
+				ClassMap.Empty();
+				Hook();
+			}
+			NumRoots++;
+			if( ++RootPhase<SampleRate )
+				return 0;
+			RootPhase = 0;
+			NumSampled++;
+		}
+		INT   iFunction = GetFunction( Function );
+		FCall& Call     = Calls[Depth];
+		Call.Node        = GetNode( Depth ? Calls[Depth-1].Node : INDEX_NONE, iFunction );
+		Call.Function    = iFunction;
+		Call.Class       = GetClass( Object->GetClass() );
+		Call.ChildSeconds = 0.0;
+		Functions(iFunction).Active++;
+		Depth++;
+		Call.StartSeconds = appSeconds();
+		return 1;
+		unguardSlow;
+	}
+	void End()
+	{
+		guardSlow(FScriptProfiler::End);
+		DOUBLE Now       = appSeconds();
+		FCall& Call      = Calls[--Depth];
+		DOUBLE Total     = Now - Call.StartSeconds;
+		DOUBLE Exclusive = Total - Call.ChildSeconds;
+
+		FFunctionStats& Function = Functions(Call.Function);
+		Function.Calls++;
+		Function.ExclusiveSeconds += Exclusive;
+		if( --Function.Active==0 )
+			Function.InclusiveSeconds += Total;
+
+		FClassStats& Class = Classes(Call.Class);
+		Class.Calls++;
+		Class.ExclusiveSeconds += Exclusive;
+
+		FNode& Node = Nodes(Call.Node);
+		Node.Calls++;
+		Node.ExclusiveSeconds += Exclusive;
+
+		if( Depth )
+			Calls[Depth-1].ChildSeconds += Total;
+		if( Trace.Num()<MaxTraceEvents )
+		{
+			FTraceEvent& Event = Trace(Trace.Add());
+			Event.Function     = Call.Function;
+			Event.Depth        = Depth;
+			Event.StartSeconds = Call.StartSeconds;
+			Event.Seconds      = Total;
+		}
+		unguardSlow;
+	}
+
+	// Logs the functions and classes with the most exclusive time.
+	void Report( FOutputDevice& Ar, INT Num=20 )
+	{
+		guard(FScriptProfiler::Report);
+		Ar.Logf( TEXT("Script profile: %i of %.0f calls from native code instrumented (rate %i), %i functions, %i call paths."), NumSampled, NumRoots, SampleRate, Functions.Num(), Nodes.Num() );
+
+		TArray<INT> Order;
+		{for( INT i=0; i<Functions.Num(); i++ )
+			Order.AddItem( i );}
+		if( Order.Num() )
+			Sort( &Order(0), Order.Num(), FCompareFunctions(Functions) );
+		Ar.Logf( TEXT("   Excl ms   Incl ms     Calls  Function") );
+		{for( INT i=0; i<Order.Num() && i<Num; i++ )
+		{
+			FFunctionStats& Function = Functions(Order(i));
+			Ar.Logf( TEXT("%10.2f%10.2f%10i  %s"), Function.ExclusiveSeconds*1000.0, Function.InclusiveSeconds*1000.0, Function.Calls, *Function.Name );
+		}}
+
+		Order.Empty();
+		{for( INT i=0; i<Classes.Num(); i++ )
+			Order.AddItem( i );}
+		if( Order.Num() )
+			Sort( &Order(0), Order.Num(), FCompareClasses(Classes) );
+		Ar.Logf( TEXT("   Excl ms     Calls  Class") );
+		{for( INT i=0; i<Order.Num() && i<Num; i++ )
+		{
+			FClassStats& Class = Classes(Order(i));
+			Ar.Logf( TEXT("%10.2f%10i  %s"), Class.ExclusiveSeconds*1000.0, Class.Calls, *Class.Name );
+		}}
+		unguard;
+	}
+
+	// Writes collapsed stacks, one call path per line with its exclusive
+	// time in microseconds, e.g. for flamegraph.pl.
+	UBOOL SaveCollapsed( const TCHAR* Filename )
+	{
+		guard(FScriptProfiler::SaveCollapsed);
+		FString Result;
+		for( INT i=0; i<Nodes.Num(); i++ )
+		{
+			QWORD Micro = (QWORD)(Nodes(i).ExclusiveSeconds*1000000.0);
+			if( Micro==0 )
+				continue;
+			FString Path = Functions(Nodes(i).Function).Name;
+			for( INT iParent=Nodes(i).Parent; iParent!=INDEX_NONE; iParent=Nodes(iParent).Parent )
+				Path = Functions(Nodes(iParent).Function).Name + TEXT(";") + Path;
+			Result += FString::Printf( TEXT("%s %i\r\n"), *Path, (INT)Micro );
+		}
+		return appSaveStringToFile( Result, Filename );
+		unguard;
+	}
+
+	// Writes the recorded calls in Chrome's trace event format.
+	UBOOL SaveTrace( const TCHAR* Filename )
+	{
+		guard(FScriptProfiler::SaveTrace);
+		FString Result = TEXT("{\"traceEvents\":[\r\n");
+		for( INT i=0; i<Trace.Num(); i++ )
+		{
+			FTraceEvent& Event = Trace(i);
+			Result += FString::Printf
+			(
+				TEXT("{\"name\":\"%s\",\"cat\":\"script\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1,\"args\":{\"depth\":%i}}%s\r\n"),
+				*Functions(Event.Function).Name,
+				Event.StartSeconds*1000000.0,
+				Event.Seconds*1000000.0,
+				Event.Depth,
+				i+1<Trace.Num() ? TEXT(",") : TEXT("")
+			);
+		}
+		Result += TEXT("]}\r\n");
+		return appSaveStringToFile( Result, Filename );
+		unguard;
+	}
+
+	// FExec interface.
+	UBOOL Exec( const TCHAR* Cmd, FOutputDevice& Ar )
+	{
+		guard(FScriptProfiler::Exec);
+		if( ParseCommand(&Cmd,TEXT("PROFILESCRIPT")) )
+		{
+			if( ParseCommand(&Cmd,TEXT("START")) )
+			{
+				INT Rate=1, TraceEvents=0;
+				Parse( Cmd, TEXT("RATE="), Rate );
+				Parse( Cmd, TEXT("TRACE="), TraceEvents );
+				Start( Rate, TraceEvents );
+				Ar.Logf( TEXT("Script profiling started, %i functions hooked."), Originals.Num() );
+			}
+			else if( ParseCommand(&Cmd,TEXT("STOP")) )
+			{
+				Stop();
+				Ar.Logf( TEXT("Script profiling stopped.") );
+			}
+			else if( ParseCommand(&Cmd,TEXT("RESET")) )
+			{
+				Reset();
+				Ar.Logf( TEXT("Script profile reset.") );
+			}
+			else if( ParseCommand(&Cmd,TEXT("DUMP")) )
+			{
+				FString Base = TEXT("ScriptProfile");
+				Parse( Cmd, TEXT("FILE="), Base );
+				if( SaveCollapsed(*(Base+TEXT(".folded"))) )
+					Ar.Logf( TEXT("Wrote %s.folded, %i call paths."), *Base, Nodes.Num() );
+				if( Trace.Num() && SaveTrace(*(Base+TEXT(".json"))) )
+					Ar.Logf( TEXT("Wrote %s.json, %i calls."), *Base, Trace.Num() );
+			}
+			else
+			{
+				INT Num=20;
+				ParseCommand( &Cmd, TEXT("REPORT") );
+				Parse( Cmd, TEXT("NUM="), Num );
+				Report( Ar, Num );
+			}
+			return 1;
+		}
+		return 0;
+		unguard;
+	}
+
+private:
+	FScriptProfiler( const FScriptProfiler& );
+	void operator=( const FScriptProfiler& );
+
+	// Predicates for Report(), most exclusive time first.
+	class FCompareFunctions
+	{
+	public:
+		FCompareFunctions( TArray<FFunctionStats>& InFunctions ) : Functions( InFunctions ) {}
+		INT operator()( INT& A, INT& B ) const
+		{
+			DOUBLE SecondsA = Functions(A).ExclusiveSeconds, SecondsB = Functions(B).ExclusiveSeconds;
+			return SecondsA>SecondsB ? -1 : SecondsA<SecondsB ? 1 : 0;
+		}
+		TArray<FFunctionStats>& Functions;
+	};
+	class FCompareClasses
+	{
+	public:
+		FCompareClasses( TArray<FClassStats>& InClasses ) : Classes( InClasses ) {}
+		INT operator()( INT& A, INT& B ) const
+		{
+			DOUBLE SecondsA = Classes(A).ExclusiveSeconds, SecondsB = Classes(B).ExclusiveSeconds;
+			return SecondsA>SecondsB ? -1 : SecondsA<SecondsB ? 1 : 0;
+		}
+		TArray<FClassStats>& Classes;
+	};
+
+	// Wraps a call of a hooked function. Ended or unskipped in the
+	// destructor, so script errors unwinding through the call leave Depth
+	// and SkipDepth intact.
+	class FCallScope;
+	friend class FCallScope;
+	class FCallScope
+	{
+	public:
+		FCallScope( FScriptProfiler& InProfiler, UFunction* Function, UObject* Object )
+		:	Profiler( InProfiler )
+		,	Instrumented( InProfiler.Begin(Function,Object) )
+		{
+			if( !Instrumented )
+				Profiler.SkipDepth++;
+		}
+		~FCallScope()
+		{
+			if( Instrumented )
+				Profiler.End();
+			else
+				Profiler.SkipDepth--;
+		}
+	private:
+		FScriptProfiler& Profiler;
+		UBOOL Instrumented;
+	};
+
+	// Variables.
+	UBOOL						Hooked;
+	UBOOL						PendingReset;
+	INT							SampleRate;
+	INT							MaxTraceEvents;
+	INT							Depth;
+	INT							SkipDepth;
+	DOUBLE						NumRoots;
+	INT							NumSampled;
+	INT							RootPhase;
+	FCall						Calls[MAX_DEPTH];
+	FGarbageSentinel			Sentinel;
+	TFlatMap<UFunction*,Native>	Originals;
+	TFlatMap<UFunction*,INT>	FunctionMap;
+	TFlatMap<UClass*,INT>		ClassMap;
+	TMap<FString,INT>			FunctionNames;
+	TMap<FString,INT>			ClassNames;
+	TFlatMap<QWORD,INT>			Edges;
+	TArray<FFunctionStats>		Functions;
+	TArray<FClassStats>			Classes;
+	TArray<FNode>				Nodes;
+	TArray<FTraceEvent>			Trace;
+
+	// Implementation.
+	Native GetOriginal( UFunction* Function )
+	{
+		Native Original = Originals.FindRef( Function );
+		return Original ? Original : (Native)&UObject::ProcessInternal;
+	}
+	void Hook()
+	{
+		guard(FScriptProfiler::Hook);
+		// Rebuilt from the functions which exist, so those which were
+		// collected drop out before their pointers get reused.
+		TFlatMap<UFunction*,Native> Live;
+		Live.Reserve( Originals.Num() );
+		for( TObjectIterator<UFunction> It; It; ++It )
+		{
+			UFunction* Function = *It;
+			if( Function->Func==(Native)&UScriptProfilerNatives::execProfiledFunction )
+			{
+				Live.Set( Function, GetOriginal(Function) );
+			}
+			else if( !(Function->FunctionFlags & FUNC_Native) && Function->Func )
+			{
+				Live.Set( Function, Function->Func );
+				Function->Func = (Native)&UScriptProfilerNatives::execProfiledFunction;
+			}
+		}
+		Originals = Live;
+		Sentinel.Reset();
+		unguard;
+	}
+	INT GetFunction( UFunction* Function )
+	{
+		INT* Found = FunctionMap.Find( Function );
+		if( Found )
+			return *Found;
+		FString Name = Function->GetPathName();
+		INT* Named = FunctionNames.Find( Name );
+		INT  Index = Named ? *Named : Functions.Num();
+		if( !Named )
+		{
+			new(Functions)FFunctionStats( *Name );
+			FunctionNames.Set( *Name, Index );
+		}
+		FunctionMap.Set( Function, Index );
+		return Index;
+	}
+	INT GetClass( UClass* Class )
+	{
+		INT* Found = ClassMap.Find( Class );
+		if( Found )
+			return *Found;
+		FString Name = Class->GetPathName();
+		INT* Named = ClassNames.Find( Name );
+		INT  Index = Named ? *Named : Classes.Num();
+		if( !Named )
+		{
+			new(Classes)FClassStats( *Name );
+			ClassNames.Set( *Name, Index );
+		}
+		ClassMap.Set( Class, Index );
+		return Index;
+	}
+	INT GetNode( INT Parent, INT Function )
+	{
+		QWORD Key   = ((QWORD)(DWORD)(Parent+1) << 32) | (DWORD)Function;
+		INT*  Found = Edges.Find( Key );
+		if( Found )
+			return *Found;
+		INT Index = Nodes.AddZeroed();
+		Nodes(Index).Parent   = Parent;
+		Nodes(Index).Function = Function;
+		Edges.Set( Key, Index );
+		return Index;
+	}
+};
+
+FScriptProfiler* FScriptProfiler::Current = NULL;
+
+/*-----------------------------------------------------------------------------
+	UScriptProfilerNatives implementation.
+-----------------------------------------------------------------------------*/
+
+//
+// Replaces UFunction::Func of script functions while profiling.
+//
+void UScriptProfilerNatives::execProfiledFunction( FFrame& Stack, RESULT_DECL )
+{
+	guardSlow(UScriptProfilerNatives::execProfiledFunction);
+	FScriptProfiler* Profiler = FScriptProfiler::Current;
+	UFunction*       Function = (UFunction*)Stack.Node;
+	Native           Original = Profiler->GetOriginal( Function );
+	FScriptProfiler::FCallScope CallScope( *Profiler, Function, this );
+	(this->*Original)( Stack, Result );
+	unguardSlow;
+}
+
+/*-----------------------------------------------------------------------------
+	The End.
+-----------------------------------------------------------------------------*/
@@ -1 +1,5 @@
 friend class UObjectI;
+friend class FObjectHash;
+friend class FGarbageCollector;
+friend class FAsyncPackageLoader;
+friend class FLinkerExportHashes;
@@ -0,0 +1,664 @@
+/*=============================================================================
+	UCodecBenchmarkCommandlet.h: Codec and serialization benchmark.
+	Copyright 2016-2019 Sebastian Kaufel, Inc. All Rights Reserved.
+
+	Notes:
+	* This file contains the implementation, include it only once in a
+	  native package's main source file after FCodec.h and UnLinker.h. The
+	  class is native only and registers with that package:
+
+		IMPLEMENT_CLASS(UCodecBenchmarkCommandlet);
+
+	* Run as "ucc <Package>.CodecBenchmark [<Files>...] [CSV=<File>]
+	  [REPEAT=<Count>]". Files are wildcards and default to the packages,
+	  maps, textures, sounds and music of the game.
+	* For each file the codecs are run on their own and as the FCodecFull
+	  chain (RLE, BWT, MTF, RLE, Huffman) and verified to decode. FBuffer-
+	  Writer/FBufferReader round trips of bytes, INTs, compact indices and
+	  bulk data are timed, as is ULinkerLoad parsing the tables of packages
+	  which aren't loaded yet.
+	* Bunch sized payloads of replicated properties are written and read
+	  back through FBitWriter/FBitReader and FWordBitWriter/FWordBitReader.
+	* Each stage reports throughput of uncompressed data in MB/s, the
+	  output ratio and the peak bytes allocated through GMalloc while it
+	  ran. Times are the best out of REPEAT runs, memory is taken from the
+	  first run. PeakKB is "?" if too many blocks were live to track them.
+=============================================================================*/
+
+/*-----------------------------------------------------------------------------
+	FMallocPeakTracker.
+-----------------------------------------------------------------------------*/
+
+//
+// Passes allocations through to GMalloc while it is installed and tracks
+// the peak of the bytes allocated since then. Blocks allocated before are
+// not tracked.
+//
+class FMallocPeakTracker : public FMalloc
+{
+public:
+	enum {TABLE_BITS=17};
+	enum {TABLE_SIZE=1<<TABLE_BITS};
+
+	// Constructors.
+	FMallocPeakTracker()
+	:	Inner( NULL )
+	,	Keys( NULL )
+	,	Sizes( NULL )
+	{}
+
+	// FMallocPeakTracker interface. End() returns INDEX_NONE when more blocks
+	// were live than the table holds, the peak would be undercounted then.
+	void Begin()
+	{
+		guard(FMallocPeakTracker::Begin);
+		check(!Inner);
+		Inner = GMalloc;
+		if( !Keys )
+		{
+			Keys  = (void**)Inner->Malloc( TABLE_SIZE*sizeof(void*), TEXT("PeakTrackerKeys") );
+			Sizes = (DWORD*)Inner->Malloc( TABLE_SIZE*sizeof(DWORD), TEXT("PeakTrackerSizes") );
+		}
+		appMemzero( Keys, TABLE_SIZE*sizeof(void*) );
+		Num = Current = Peak = 0;
+		Overflow = 0;
+		GMalloc = this;
+		unguard;
+	}
+	INT End()
+	{
+		guard(FMallocPeakTracker::End);
+		check(GMalloc==this);
+		GMalloc = Inner;
+		Inner   = NULL;
+		return Overflow ? INDEX_NONE : Peak;
+		unguard;
+	}
+	UBOOL Overflowed()
+	{
+		return Overflow;
+	}
+	void Release()
+	{
+		guard(FMallocPeakTracker::Release);
+		check(!Inner);
+		if( Keys )
+		{
+			GMalloc->Free( Keys );
+			GMalloc->Free( Sizes );
+		}
+		Keys  = NULL;
+		Sizes = NULL;
+		unguard;
+	}
+
+	// FMalloc interface.
+	void* Malloc( DWORD Count, const TCHAR* Tag )
+	{
+		void* Result = Inner->Malloc( Count, Tag );
+		FScopeLock Scope( Lock );
+		Add( Result, Count );
+		return Result;
+	}
+	void* Realloc( void* Original, DWORD Count, const TCHAR* Tag )
+	{
+		void* Result = Inner->Realloc( Original, Count, Tag );
+		FScopeLock Scope( Lock );
+		if( Original )
+			Current -= Remove( Original );
+		if( Result )
+			Add( Result, Count );
+		return Result;
+	}
+	void Free( void* Original )
+	{
+		if( Original )
+		{
+			FScopeLock Scope( Lock );
+			Current -= Remove( Original );
+		}
+		Inner->Free( Original );
+	}
+	void DumpAllocs()
+	{
+		Inner->DumpAllocs();
+	}
+	void HeapCheck()
+	{
+		Inner->HeapCheck();
+	}
+	void Init()
+	{}
+	void Exit()
+	{}
+
+private:
+	FMallocPeakTracker( const FMallocPeakTracker& );
+	void operator=( const FMallocPeakTracker& );
+
+	// Open addressed table of tracked blocks, removal shifts entries back.
+	static INT Hash( void* Ptr )
+	{
+		return (((DWORD)Ptr>>4)*2654435761U) >> (32-TABLE_BITS);
+	}
+	INT Find( void* Ptr )
+	{
+		INT i;
+		for( i=Hash(Ptr); Keys[i] && Keys[i]!=Ptr; i=(i+1)&(TABLE_SIZE-1) );
+		return i;
+	}
+	void Add( void* Ptr, DWORD Count )
+	{
+		if( !Ptr )
+			return;
+		if( Num>=TABLE_SIZE*3/4 )
+		{
+			Overflow = 1;
+			return;
+		}
+		INT i = Find( Ptr );
+		if( !Keys[i] )
+			Num++;
+		Keys[i]  = Ptr;
+		Sizes[i] = Count;
+		Current += Count;
+		Peak     = Max( Peak, Current );
+	}
+	INT Remove( void* Ptr )
+	{
+		INT i = Find( Ptr );
+		if( !Keys[i] )
+			return 0;
+		INT Result = Sizes[i];
+		Keys[i] = NULL;
+		Num--;
+		for( INT j=(i+1)&(TABLE_SIZE-1); Keys[j]; j=(j+1)&(TABLE_SIZE-1) )
+		{
+			INT k = Hash( Keys[j] );
+			if( j>i ? (k<=i || k>j) : (k<=i && k>j) )
+			{
+				Keys[i]  = Keys[j];
+				Sizes[i] = Sizes[j];
+				Keys[j]  = NULL;
+				i        = j;
+			}
+		}
+		return Result;
+	}
+
+	FMalloc*	Inner;
+	FSpinLock	Lock;
+	void**		Keys;
+	DWORD*		Sizes;
+	INT			Num;
+	INT			Current;
+	INT			Peak;
+	UBOOL		Overflow;
+};
+
+/*-----------------------------------------------------------------------------
+	Bitstream payloads.
+-----------------------------------------------------------------------------*/
+
+enum {BENCHMARK_BUNCHES=20000};
+enum {BENCHMARK_BUNCH_BYTES=512};
+enum {BENCHMARK_PROPERTIES=8};
+
+//
+// Writes a bunch worth of properties: a bool, a byte, an enum, an INT and
+// an FVector each.
+//
+template<class TWriter> void appWriteBenchmarkBunch( TWriter& Writer, INT Seed )
+{
+	for( INT i=0; i<BENCHMARK_PROPERTIES; i++ )
+	{
+		INT   Value = Seed*BENCHMARK_PROPERTIES+i;
+		FLOAT X=Value, Y=-Value, Z=0.5f*Value;
+		Writer.WriteBit( Value&1 );
+		Writer.WriteInt( Value&255, 256 );
+		Writer.WriteInt( Value%37, 37 );
+		Writer << Value << X << Y << Z;
+	}
+}
+template<class TReader> UBOOL appReadBenchmarkBunch( TReader& Reader, INT Seed )
+{
+	UBOOL Ok = 1;
+	for( INT i=0; i<BENCHMARK_PROPERTIES; i++ )
+	{
+		INT   Expected = Seed*BENCHMARK_PROPERTIES+i, Value;
+		DWORD Byte, Enum;
+		FLOAT X, Y, Z;
+		BYTE  Bit = Reader.ReadBit();
+		Reader.SerializeInt( Byte, 256 );
+		Reader.SerializeInt( Enum, 37 );
+		Reader << Value << X << Y << Z;
+		Ok = Ok && Bit==(Expected&1) && Byte==(DWORD)(Expected&255) && Enum==(DWORD)(Expected%37) && Value==Expected && X==(FLOAT)Expected && Y==-(FLOAT)Expected && Z==0.5f*Expected;
+	}
+	return Ok && !Reader.IsError();
+}
+
+//
+// Writes BENCHMARK_BUNCHES bunches into Stored and reads them back. The
+// pointers only select the writer and reader classes.
+//
+template<class TWriter, class TReader> UBOOL appBenchmarkBunches( TArray<BYTE>& Stored, TArray<INT>& Bits, DOUBLE& WriteTime, DOUBLE& ReadTime, TWriter*, TReader* )
+{
+	Stored.Empty();
+	Stored.Add( BENCHMARK_BUNCHES*BENCHMARK_BUNCH_BYTES );
+	Bits.Empty();
+	Bits.Add( BENCHMARK_BUNCHES );
+	DOUBLE StartTime = appSeconds();
+	INT i;
+	for( i=0; i<BENCHMARK_BUNCHES; i++ )
+	{
+		TWriter Writer( BENCHMARK_BUNCH_BYTES*8 );
+		appWriteBenchmarkBunch( Writer, i );
+		Bits(i) = Writer.GetNumBits();
+		appMemcpy( &Stored(i*BENCHMARK_BUNCH_BYTES), Writer.GetData(), Writer.GetNumBytes() );
+	}
+	WriteTime = appSeconds()-StartTime;
+	UBOOL Ok = 1;
+	StartTime = appSeconds();
+	for( i=0; i<BENCHMARK_BUNCHES; i++ )
+	{
+		TReader Reader( &Stored(i*BENCHMARK_BUNCH_BYTES), Bits(i) );
+		Ok = appReadBenchmarkBunch( Reader, i ) && Ok;
+	}
+	ReadTime = appSeconds()-StartTime;
+	return Ok;
+}
+
+/*-----------------------------------------------------------------------------
+	UCodecBenchmarkCommandlet.
+-----------------------------------------------------------------------------*/
+
+//
+// Benchmarks codecs and serialization, see notes above.
+//
+class UCodecBenchmarkCommandlet : public UCommandlet
+{
+	DECLARE_CLASS(UCodecBenchmarkCommandlet,UCommandlet,CLASS_Transient)
+
+	// UObject interface.
+	void StaticConstructor()
+	{
+		guard(UCodecBenchmarkCommandlet::StaticConstructor);
+		LogToStdout    = 0;
+		IsClient       = 0;
+		IsEditor       = 0;
+		IsServer       = 0;
+		LazyLoad       = 1;
+		ShowErrorCount = 1;
+		HelpCmd        = TEXT("CodecBenchmark");
+		HelpOneLiner   = TEXT("Benchmark codecs and serialization");
+		HelpUsage      = TEXT("CodecBenchmark [<Files>...] [CSV=<File>] [REPEAT=<Count>]");
+		HelpParm[0]    = TEXT("Files");
+		HelpDesc[0]    = TEXT("Wildcards of files to benchmark, defaults to all game content.");
+		HelpParm[1]    = TEXT("CSV");
+		HelpDesc[1]    = TEXT("File to write the results to, defaults to CodecBenchmark.csv.");
+		HelpParm[2]    = TEXT("REPEAT");
+		HelpDesc[2]    = TEXT("Number of runs to take the best time of, defaults to 3.");
+		unguard;
+	}
+
+	// UCommandlet interface.
+	INT Main( const TCHAR* Parms )
+	{
+		guard(UCodecBenchmarkCommandlet::Main);
+		FString CsvFile = TEXT("CodecBenchmark.csv");
+		Parse( Parms, TEXT("CSV="), CsvFile );
+		Repeat = 3;
+		Parse( Parms, TEXT("REPEAT="), Repeat );
+		Repeat = Max( Repeat, 1 );
+		NumFailures = 0;
+
+		// Collect files.
+		TArray<FString> Wildcards, Files;
+		TInlineString<64> Token;
+		while( ParseToken(Parms,Token,0) )
+			if( !appStrfind(*Token,TEXT("=")) )
+				new(Wildcards)FString( *Token );
+		if( !Wildcards.Num() )
+		{
+			const TCHAR* DefaultWildcards[] = { TEXT("*.u"), TEXT("..\\Maps\\*.dx"), TEXT("..\\Textures\\*.utx"), TEXT("..\\Sounds\\*.uax"), TEXT("..\\Music\\*.umx") };
+			for( INT i=0; i<ARRAY_COUNT(DefaultWildcards); i++ )
+				new(Wildcards)FString( DefaultWildcards[i] );
+		}
+		{for( INT i=0; i<Wildcards.Num(); i++ )
+		{
+			FString Path = Wildcards(i);
+			INT Slash = Max( Path.InStr(TEXT("\\"),1), Path.InStr(TEXT("/"),1) );
+			Path = Slash>=0 ? Path.Left(Slash+1) : FString();
+			TArray<FString> Found = GFileManager->FindFiles( *Wildcards(i), 1, 0 );
+			for( INT j=0; j<Found.Num(); j++ )
+				new(Files)FString( Path + Found(j) );
+		}}
+		if( !Files.Num() )
+		{
+			GWarn->Logf( TEXT("No files found.") );
+			return 1;
+		}
+
+		// Run.
+		Csv = TEXT("File,Stage,Operation,InBytes,OutBytes,Ratio,Seconds,MBPerSec,PeakKB,Result\r\n");
+		BenchmarkBits();
+		{for( INT i=0; i<Files.Num(); i++ )
+		{
+			TArray<BYTE> Data;
+			if( !appLoadFileToArray(Data,*Files(i)) )
+			{
+				GWarn->Logf( TEXT("Can't read %s"), *Files(i) );
+				NumFailures++;
+				continue;
+			}
+			if( !Data.Num() )
+				continue;
+			GWarn->Logf( TEXT("%s (%i bytes)"), *Files(i), Data.Num() );
+			BenchmarkCodecs( *Files(i), Data );
+			BenchmarkArchives( *Files(i), Data );
+			BenchmarkLinker( *Files(i), Data );
+		}}
+		UObject::CollectGarbage( RF_Native );
+		Tracker.Release();
+
+		if( !appSaveStringToFile(Csv,*CsvFile) )
+		{
+			GWarn->Logf( TEXT("Can't write %s"), *CsvFile );
+			return 1;
+		}
+		GWarn->Logf( TEXT("Wrote %s, %i failures."), *CsvFile, NumFailures );
+		return NumFailures!=0;
+		unguard;
+	}
+
+private:
+	FMallocPeakTracker	Tracker;
+	FString				Csv;
+	INT					Repeat;
+	INT					NumFailures;
+
+	// Adds a result. Throughput is measured on the uncompressed side, a
+	// negative Peak wasn't tracked and is written as "?".
+	void AddRow( const TCHAR* File, const TCHAR* Stage, const TCHAR* Operation, INT InBytes, INT OutBytes, DOUBLE Seconds, INT Peak, const TCHAR* Result )
+	{
+		INT Bytes = appStricmp(Operation,TEXT("Decode"))==0 ? OutBytes : InBytes;
+		Csv += FString::Printf
+		(
+			TEXT("%s,%s,%s,%i,%i,%.4f,%.6f,%.2f,%s,%s\r\n"),
+			File, Stage, Operation, InBytes, OutBytes,
+			InBytes ? (DOUBLE)OutBytes/InBytes : 0.0,
+			Seconds,
+			Seconds>0.0 ? Bytes/Seconds/1048576.0 : 0.0,
+			Peak>=0 ? *FString::Printf(TEXT("%i"),(Peak+1023)/1024) : TEXT("?"),
+			Result
+		);
+		if( Peak<0 )
+			GWarn->Logf( TEXT("   %s %s: Too many live blocks, peak memory not tracked"), Stage, Operation );
+		if( appStricmp(Result,TEXT("Ok"))!=0 )
+			GWarn->Logf( TEXT("   %s %s: %s"), Stage, Operation, Result );
+	}
+
+	// Peak of two stages, untracked if either is.
+	static INT MaxPeak( INT A, INT B )
+	{
+		return A<0 || B<0 ? INDEX_NONE : Max( A, B );
+	}
+
+	// Runs a codec Repeat times, returns the best time and the peak memory.
+	DOUBLE RunCodec( FCodec& Codec, UBOOL Encode, const TArray<BYTE>& In, TArray<BYTE>& Out, INT& Peak )
+	{
+		guard(UCodecBenchmarkCommandlet::RunCodec);
+		DOUBLE Best = 0.0;
+		for( INT r=0; r<Repeat; r++ )
+		{
+			Out.Empty();
+			FBufferReader Reader( In );
+			FBufferWriter Writer( Out );
+			if( r==0 )
+				Tracker.Begin();
+			DOUBLE StartTime = appSeconds();
+			if( Encode )
+				Codec.Encode( Reader, Writer );
+			else
+				Codec.Decode( Reader, Writer );
+			DOUBLE Time = appSeconds()-StartTime;
+			if( r==0 )
+				Peak = Tracker.End();
+			Best = r ? Min( Best, Time ) : Time;
+		}
+		return Best;
+		unguard;
+	}
+
+	// Encodes and decodes with each codec on its own, then as a chain.
+	void BenchmarkCodecs( const TCHAR* File, const TArray<BYTE>& Data )
+	{
+		guard(UCodecBenchmarkCommandlet::BenchmarkCodecs);
+		FCodecRLE         RLE1, RLE2;
+		FCodecBWT         BWT;
+		FCodecMTF         MTF;
+		FCodecHuffman     Huffman;
+		FCodecHuffmanTree HuffmanTree;
+		FCodec* Codecs[]     = { &RLE1, &BWT, &MTF, &Huffman, &HuffmanTree };
+		const TCHAR* Names[] = { TEXT("RLE"), TEXT("BWT"), TEXT("MTF"), TEXT("Huffman"), TEXT("HuffmanTree") };
+		TArray<BYTE> Encoded, Decoded;
+		INT i, EncodePeak=0, DecodePeak=0;
+		for( i=0; i<ARRAY_COUNT(Codecs); i++ )
+		{
+			DOUBLE EncodeTime = RunCodec( *Codecs[i], 1, Data, Encoded, EncodePeak );
+			DOUBLE DecodeTime = RunCodec( *Codecs[i], 0, Encoded, Decoded, DecodePeak );
+			const TCHAR* Result = SameData(Data,Decoded) ? TEXT("Ok") : TEXT("Mismatch");
+			AddRow( File, Names[i], TEXT("Encode"), Data.Num(), Encoded.Num(), EncodeTime, EncodePeak, TEXT("Ok") );
+			AddRow( File, Names[i], TEXT("Decode"), Encoded.Num(), Decoded.Num(), DecodeTime, DecodePeak, Result );
+			NumFailures += Result[0]!='O';
+		}
+
+		// The FCodecFull chain, stage by stage.
+		FCodec* Chain[]           = { &RLE1, &BWT, &MTF, &RLE2, &Huffman };
+		const TCHAR* ChainNames[] = { TEXT("Chain.RLE"), TEXT("Chain.BWT"), TEXT("Chain.MTF"), TEXT("Chain.RLE2"), TEXT("Chain.Huffman") };
+		TArray<BYTE> Stages[ARRAY_COUNT(Chain)+1];
+		DOUBLE TotalEncode=0.0, TotalDecode=0.0;
+		INT ChainPeak=0;
+		Stages[0] = Data;
+		for( i=0; i<ARRAY_COUNT(Chain); i++ )
+		{
+			DOUBLE Time = RunCodec( *Chain[i], 1, Stages[i], Stages[i+1], EncodePeak );
+			AddRow( File, ChainNames[i], TEXT("Encode"), Stages[i].Num(), Stages[i+1].Num(), Time, EncodePeak, TEXT("Ok") );
+			TotalEncode += Time;
+			ChainPeak    = MaxPeak( ChainPeak, EncodePeak );
+		}
+		AddRow( File, TEXT("Chain"), TEXT("Encode"), Data.Num(), Stages[ARRAY_COUNT(Chain)].Num(), TotalEncode, ChainPeak, TEXT("Ok") );
+		UBOOL Ok = 1;
+		ChainPeak = 0;
+		for( i=ARRAY_COUNT(Chain)-1; i>=0; i-- )
+		{
+			DOUBLE Time = RunCodec( *Chain[i], 0, Stages[i+1], Decoded, DecodePeak );
+			UBOOL StageOk = SameData( Stages[i], Decoded );
+			AddRow( File, ChainNames[i], TEXT("Decode"), Stages[i+1].Num(), Decoded.Num(), Time, DecodePeak, StageOk ? TEXT("Ok") : TEXT("Mismatch") );
+			TotalDecode += Time;
+			ChainPeak    = MaxPeak( ChainPeak, DecodePeak );
+			Ok           = Ok && StageOk;
+		}
+		AddRow( File, TEXT("Chain"), TEXT("Decode"), Stages[ARRAY_COUNT(Chain)].Num(), Data.Num(), TotalDecode, ChainPeak, Ok ? TEXT("Ok") : TEXT("Mismatch") );
+		NumFailures += !Ok;
+		GWarn->Logf( TEXT("   Chain: %.1f%% in %.3f sec encode, %.3f sec decode"), 100.0*Stages[ARRAY_COUNT(Chain)].Num()/Data.Num(), TotalEncode, TotalDecode );
+		unguard;
+	}
+
+	// Times both bitstream implementations and checks they agree.
+	void BenchmarkBits()
+	{
+		guard(UCodecBenchmarkCommandlet::BenchmarkBits);
+		TArray<BYTE> Stored[2];
+		TArray<INT>  Bits[2];
+		DOUBLE WriteTime[2], ReadTime[2];
+		INT Peak[2];
+		UBOOL Ok[2];
+		for( INT r=0; r<Repeat; r++ )
+		{
+			for( INT k=0; k<2; k++ )
+			{
+				DOUBLE Write=0.0, Read=0.0;
+				if( r==0 )
+					Tracker.Begin();
+				if( k==0 )
+					Ok[k] = appBenchmarkBunches( Stored[k], Bits[k], Write, Read, (FBitWriter*)NULL, (FBitReader*)NULL );
+				else
+					Ok[k] = appBenchmarkBunches( Stored[k], Bits[k], Write, Read, (FWordBitWriter*)NULL, (FWordBitReader*)NULL );
+				if( r==0 )
+				{
+					Peak[k]      = Tracker.End();
+					WriteTime[k] = Write;
+					ReadTime[k]  = Read;
+				}
+				WriteTime[k] = Min( WriteTime[k], Write );
+				ReadTime[k]  = Min( ReadTime[k], Read );
+			}
+		}
+		INT Payload=0;
+		UBOOL Same = 1;
+		for( INT i=0; i<BENCHMARK_BUNCHES; i++ )
+		{
+			Payload     += (Bits[0](i)+7)>>3;
+			Same         = Same && Bits[0](i)==Bits[1](i) && appMemcmp( &Stored[0](i*BENCHMARK_BUNCH_BYTES), &Stored[1](i*BENCHMARK_BUNCH_BYTES), (Bits[0](i)+7)>>3 )==0;
+		}
+		const TCHAR* Names[2] = { TEXT("Bits.FBitWriter"), TEXT("Bits.FWordBitWriter") };
+		for( INT k=0; k<2; k++ )
+		{
+			const TCHAR* Result = !Ok[k] ? TEXT("Mismatch") : !Same ? TEXT("Differs from FBitWriter") : TEXT("Ok");
+			AddRow( TEXT("(bunches)"), Names[k], TEXT("Write"), Payload, Payload, WriteTime[k], Peak[k], TEXT("Ok") );
+			AddRow( TEXT("(bunches)"), Names[k], TEXT("Read"), Payload, Payload, ReadTime[k], Peak[k], Result );
+			NumFailures += Result[0]!='O';
+		}
+		GWarn->Logf( TEXT("%i bunches of %i bytes: FBitWriter %.3f/%.3f sec, FWordBitWriter %.3f/%.3f sec (write/read)"), BENCHMARK_BUNCHES, Payload/BENCHMARK_BUNCHES, WriteTime[0], ReadTime[0], WriteTime[1], ReadTime[1] );
+		unguard;
+	}
+
+	// Times FBufferWriter and FBufferReader round trips of the file data.
+	enum EArchiveMode
+	{
+		ARCHIVE_Byte,
+		ARCHIVE_Int,
+		ARCHIVE_Index,
+		ARCHIVE_Bulk,
+		ARCHIVE_MAX,
+	};
+	static void SerializeData( FArchive& Ar, BYTE* Data, INT Num, INT Mode )
+	{
+		INT i;
+		switch( Mode )
+		{
+			case ARCHIVE_Byte:
+				for( i=0; i<Num; i++ )
+					Ar << Data[i];
+				break;
+			case ARCHIVE_Int:
+				for( i=0; i<Num/4; i++ )
+					Ar << ((INT*)Data)[i];
+				break;
+			case ARCHIVE_Index:
+				for( i=0; i<Num/4; i++ )
+					Ar << AR_INDEX(((INT*)Data)[i]);
+				break;
+			default:
+				Ar.Serialize( Data, Num );
+				break;
+		}
+	}
+	void BenchmarkArchives( const TCHAR* File, const TArray<BYTE>& Data )
+	{
+		guard(UCodecBenchmarkCommandlet::BenchmarkArchives);
+		const TCHAR* Names[ARCHIVE_MAX] = { TEXT("Archive.Byte"), TEXT("Archive.Int"), TEXT("Archive.Index"), TEXT("Archive.Bulk") };
+		TArray<BYTE> Source(Data), Written, Read(Data.Num());
+		for( INT Mode=0; Mode<ARCHIVE_MAX; Mode++ )
+		{
+			INT Num=Mode==ARCHIVE_Int || Mode==ARCHIVE_Index ? Data.Num()&~3 : Data.Num();
+			INT WritePeak=0, ReadPeak=0;
+			DOUBLE WriteTime=0.0, ReadTime=0.0;
+			for( INT r=0; r<Repeat; r++ )
+			{
+				Written.Empty();
+				FBufferWriter Writer( Written );
+				if( r==0 )
+					Tracker.Begin();
+				DOUBLE StartTime = appSeconds();
+				SerializeData( Writer, &Source(0), Num, Mode );
+				DOUBLE Time = appSeconds()-StartTime;
+				if( r==0 )
+					WritePeak = Tracker.End();
+				WriteTime = r ? Min( WriteTime, Time ) : Time;
+
+				appMemzero( &Read(0), Read.Num() );
+				FBufferReader Reader( Written );
+				if( r==0 )
+					Tracker.Begin();
+				StartTime = appSeconds();
+				SerializeData( Reader, &Read(0), Num, Mode );
+				Time = appSeconds()-StartTime;
+				if( r==0 )
+					ReadPeak = Tracker.End();
+				ReadTime = r ? Min( ReadTime, Time ) : Time;
+			}
+			UBOOL Ok = Num==0 || appMemcmp( &Read(0), &Source(0), Num )==0;
+			AddRow( File, Names[Mode], TEXT("Write"), Num, Written.Num(), WriteTime, WritePeak, TEXT("Ok") );
+			AddRow( File, Names[Mode], TEXT("Read"), Written.Num(), Num, ReadTime, ReadPeak, Ok ? TEXT("Ok") : TEXT("Mismatch") );
+			NumFailures += !Ok;
+		}
+		unguard;
+	}
+
+	// Times ULinkerLoad reading the summary, names, imports and exports.
+	void BenchmarkLinker( const TCHAR* File, const TArray<BYTE>& Data )
+	{
+		guard(UCodecBenchmarkCommandlet::BenchmarkLinker);
+		if( Data.Num()<4 || *(DWORD*)&Data(0)!=PACKAGE_FILE_TAG )
+			return;
+		FString Name = File;
+		INT Slash = Max( Name.InStr(TEXT("\\"),1), Name.InStr(TEXT("/"),1) );
+		Name = Name.Mid( Slash+1 );
+		if( Name.InStr(TEXT("."))>=0 )
+			Name = Name.Left( Name.InStr(TEXT(".")) );
+		if( FindObject<UPackage>(NULL,*Name) )
+		{
+			AddRow( File, TEXT("Linker"), TEXT("Parse"), Data.Num(), 0, 0.0, 0, TEXT("Skipped (already loaded)") );
+			return;
+		}
+		DOUBLE Best=0.0;
+		INT Peak=0, NumNames=0, NumImports=0, NumExports=0;
+		for( INT r=0; r<Repeat; r++ )
+		{
+			if( r==0 )
+				Tracker.Begin();
+			DOUBLE StartTime = appSeconds();
+			UObject::BeginLoad();
+			ULinkerLoad* Linker = UObject::GetPackageLinker( NULL, File, LOAD_NoWarn|LOAD_Quiet|LOAD_NoVerify, NULL, NULL );
+			UObject::EndLoad();
+			DOUBLE Time = appSeconds()-StartTime;
+			if( r==0 )
+				Peak = Tracker.End();
+			Best = r ? Min( Best, Time ) : Time;
+			if( !Linker )
+			{
+				AddRow( File, TEXT("Linker"), TEXT("Parse"), Data.Num(), 0, 0.0, 0, TEXT("Failed") );
+				NumFailures++;
+				return;
+			}
+			NumNames   = Linker->NameMap.Num();
+			NumImports = Linker->ImportMap.Num();
+			NumExports = Linker->ExportMap.Num();
+			UObject::ResetLoaders( Linker->LinkerRoot, 0, 1 );
+		}
+		AddRow( File, TEXT("Linker"), TEXT("Parse"), Data.Num(), NumNames+NumImports+NumExports, Best, Peak, TEXT("Ok") );
+		GWarn->Logf( TEXT("   Linker: %i names, %i imports, %i exports in %.3f sec"), NumNames, NumImports, NumExports, Best );
+		unguard;
+	}
+
+	static UBOOL SameData( const TArray<BYTE>& A, const TArray<BYTE>& B )
+	{
+		return A.Num()==B.Num() && (A.Num()==0 || appMemcmp(&A(0),&B(0),A.Num())==0);
+	}
+};
+
+/*-----------------------------------------------------------------------------
+	The End.
+-----------------------------------------------------------------------------*/
@@ -0,0 +1,249 @@
+/*=============================================================================
+	UContainerBenchmarkCommandlet.h: Container benchmark.
+	Copyright 2016-2019 Sebastian Kaufel, Inc. All Rights Reserved.
+
+	Notes:
+	* This file contains the implementation, include it only once in a
+	  native package's main source file. The class is native only and
+	  registers with that package:
+
+		IMPLEMENT_CLASS(UContainerBenchmarkCommandlet);
+
+	* Run as "ucc <Package>.ContainerBenchmark [NUM=<Count>]
+	  [REPEAT=<Count>]".
+	* TMap and TFlatMap are timed on object pointer and FName keys, the
+	  two key types of the hot engine maps. Keys are taken from the
+	  objects and names which exist, in random order. The first half is
+	  inserted, then looked up (hits), then the second half is looked up
+	  (misses).
+	* appQsort, Sort and ParallelSort are timed on NUM INTs which are
+	  sorted, reversed and random, and each result is checked.
+	* Times are the best out of REPEAT runs.
+=============================================================================*/
+
+/*-----------------------------------------------------------------------------
+	Map benchmark.
+-----------------------------------------------------------------------------*/
+
+//
+// Shuffles an array in place.
+//
+template<class T> void appShuffleBenchmarkArray( TArray<T>& Array )
+{
+	for( INT i=Array.Num()-1; i>0; i-- )
+		Exchange( Array(i), Array(appRand()%(i+1)) );
+}
+
+//
+// Inserts the first NumInserted keys into a map and looks up all keys.
+// The pointer only selects the map class.
+//
+template<class TMapClass, class TK> UBOOL appBenchmarkMap( const TArray<TK>& Keys, INT NumInserted, INT Repeat, DOUBLE& InsertTime, DOUBLE& HitTime, DOUBLE& MissTime, TMapClass* )
+{
+	UBOOL Ok = 1;
+	InsertTime = HitTime = MissTime = 0.0;
+	for( INT Run=0; Run<Repeat; Run++ )
+	{
+		TMapClass Map;
+		INT i, Hits=0, Misses=0;
+		DOUBLE StartTime = appSeconds();
+		for( i=0; i<NumInserted; i++ )
+			Map.Set( Keys(i), i );
+		DOUBLE Insert = appSeconds()-StartTime;
+		StartTime = appSeconds();
+		for( i=0; i<NumInserted; i++ )
+			if( Map.Find(Keys(i)) )
+				Hits++;
+		DOUBLE Hit = appSeconds()-StartTime;
+		StartTime = appSeconds();
+		for( i=NumInserted; i<Keys.Num(); i++ )
+			if( !Map.Find(Keys(i)) )
+				Misses++;
+		DOUBLE Miss = appSeconds()-StartTime;
+		Ok = Ok && Map.Num()==NumInserted && Hits==NumInserted && Misses==Keys.Num()-NumInserted;
+		if( Run==0 || Insert<InsertTime )
+			InsertTime = Insert;
+		if( Run==0 || Hit<HitTime )
+			HitTime = Hit;
+		if( Run==0 || Miss<MissTime )
+			MissTime = Miss;
+	}
+	return Ok;
+}
+
+/*-----------------------------------------------------------------------------
+	Sort benchmark.
+-----------------------------------------------------------------------------*/
+
+// Orders INTs, for Sort and ParallelSort.
+struct FCompareBenchmarkInt
+{
+	INT operator()( INT& A, INT& B ) const
+	{
+		return A<B ? -1 : A>B ? 1 : 0;
+	}
+};
+
+// Orders INTs, for appQsort.
+inline QSORT_RETURN CDECL appCompareBenchmarkInt( const INT* A, const INT* B )
+{
+	return *A<*B ? -1 : *A>*B ? 1 : 0;
+}
+
+/*-----------------------------------------------------------------------------
+	UContainerBenchmarkCommandlet.
+-----------------------------------------------------------------------------*/
+
+//
+// Benchmarks containers, see notes above.
+//
+class UContainerBenchmarkCommandlet : public UCommandlet
+{
+	DECLARE_CLASS(UContainerBenchmarkCommandlet,UCommandlet,CLASS_Transient)
+
+	// UObject interface.
+	void StaticConstructor()
+	{
+		guard(UContainerBenchmarkCommandlet::StaticConstructor);
+		LogToStdout    = 0;
+		IsClient       = 0;
+		IsEditor       = 0;
+		IsServer       = 0;
+		LazyLoad       = 1;
+		ShowErrorCount = 1;
+		HelpCmd        = TEXT("ContainerBenchmark");
+		HelpOneLiner   = TEXT("Benchmark containers");
+		HelpUsage      = TEXT("ContainerBenchmark [NUM=<Count>] [REPEAT=<Count>]");
+		HelpParm[0]    = TEXT("NUM");
+		HelpDesc[0]    = TEXT("Number of INTs to sort and maximum number of keys per map, defaults to 65536.");
+		HelpParm[1]    = TEXT("REPEAT");
+		HelpDesc[1]    = TEXT("Number of runs to take the best time of, defaults to 5.");
+		unguard;
+	}
+
+	// UCommandlet interface.
+	INT Main( const TCHAR* Parms )
+	{
+		guard(UContainerBenchmarkCommandlet::Main);
+		Num = 65536;
+		Parse( Parms, TEXT("NUM="), Num );
+		Num = Max( Num, 2 );
+		Repeat = 5;
+		Parse( Parms, TEXT("REPEAT="), Repeat );
+		Repeat = Max( Repeat, 1 );
+		NumFailures = 0;
+
+		BenchmarkMaps();
+		BenchmarkSorts();
+
+		GWarn->Logf( TEXT("%i failures."), NumFailures );
+		return NumFailures!=0;
+		unguard;
+	}
+
+private:
+	INT Num;
+	INT Repeat;
+	INT NumFailures;
+
+	// Logs a result line.
+	void LogRow( const TCHAR* Label, DOUBLE Seconds, INT Count, DOUBLE BaseSeconds, UBOOL Ok )
+	{
+		GWarn->Logf
+		(
+			TEXT("   %-24s %8.3f ms %8.1f M/s %6.2fx%s"),
+			Label,
+			Seconds*1000.0,
+			Seconds>0.0 ? Count/Seconds/1000000.0 : 0.0,
+			Seconds>0.0 ? BaseSeconds/Seconds : 0.0,
+			Ok ? TEXT("") : TEXT(" FAILED")
+		);
+		if( !Ok )
+			NumFailures++;
+	}
+
+	// Maps.
+	void BenchmarkMaps()
+	{
+		guard(UContainerBenchmarkCommandlet::BenchmarkMaps);
+		DOUBLE Map[3], Flat[3];
+		UBOOL  MapOk, FlatOk;
+
+		TArray<UObject*> Objects;
+		for( FObjectIterator It; It && Objects.Num()<Num; ++It )
+			Objects.AddItem( *It );
+		appShuffleBenchmarkArray( Objects );
+		MapOk  = appBenchmarkMap( Objects, Objects.Num()/2, Repeat, Map[0], Map[1], Map[2], (TMap<UObject*,INT>*)NULL );
+		FlatOk = appBenchmarkMap( Objects, Objects.Num()/2, Repeat, Flat[0], Flat[1], Flat[2], (TFlatMap<UObject*,INT>*)NULL );
+		LogMap( TEXT("Object keys"), Objects.Num(), Map, MapOk, Flat, FlatOk );
+
+		TArray<FName> Names;
+		for( INT i=0; i<FName::GetMaxNames() && Names.Num()<Num; i++ )
+			if( FName::GetEntry(i) )
+				new(Names)FName( (EName)i );
+		appShuffleBenchmarkArray( Names );
+		MapOk  = appBenchmarkMap( Names, Names.Num()/2, Repeat, Map[0], Map[1], Map[2], (TMap<FName,INT>*)NULL );
+		FlatOk = appBenchmarkMap( Names, Names.Num()/2, Repeat, Flat[0], Flat[1], Flat[2], (TFlatMap<FName,INT>*)NULL );
+		LogMap( TEXT("Name keys"), Names.Num(), Map, MapOk, Flat, FlatOk );
+		unguard;
+	}
+	void LogMap( const TCHAR* Title, INT NumKeys, DOUBLE* Map, UBOOL MapOk, DOUBLE* Flat, UBOOL FlatOk )
+	{
+		INT NumInserted = NumKeys/2;
+		GWarn->Logf( TEXT("%s: %i inserted, %i missing."), Title, NumInserted, NumKeys-NumInserted );
+		LogRow( TEXT("TMap insert"),     Map[0],  NumInserted,         Map[0], MapOk  );
+		LogRow( TEXT("TFlatMap insert"), Flat[0], NumInserted,         Map[0], FlatOk );
+		LogRow( TEXT("TMap find"),       Map[1],  NumInserted,         Map[1], MapOk  );
+		LogRow( TEXT("TFlatMap find"),   Flat[1], NumInserted,         Map[1], FlatOk );
+		LogRow( TEXT("TMap miss"),       Map[2],  NumKeys-NumInserted, Map[2], MapOk  );
+		LogRow( TEXT("TFlatMap miss"),   Flat[2], NumKeys-NumInserted, Map[2], FlatOk );
+	}
+
+	// Sorting.
+	void BenchmarkSorts()
+	{
+		guard(UContainerBenchmarkCommandlet::BenchmarkSorts);
+		const TCHAR* Orders[]  = { TEXT("Sorted"), TEXT("Reversed"), TEXT("Random") };
+		const TCHAR* Methods[] = { TEXT("appQsort"), TEXT("Sort"), TEXT("ParallelSort") };
+		TArray<INT> Input, Data;
+		Data.Add( Num );
+		for( INT Order=0; Order<ARRAY_COUNT(Orders); Order++ )
+		{
+			Input.Empty( Num );
+			for( INT i=0; i<Num; i++ )
+				Input.AddItem( Order==0 ? i : Order==1 ? Num-i : appRand() );
+			GWarn->Logf( TEXT("%s INTs: %i."), Orders[Order], Num );
+			DOUBLE BaseTime = 0.0;
+			for( INT Method=0; Method<ARRAY_COUNT(Methods); Method++ )
+			{
+				DOUBLE Time = 0.0;
+				UBOOL  Ok   = 1;
+				for( INT Run=0; Run<Repeat; Run++ )
+				{
+					appMemcpy( &Data(0), &Input(0), Num*sizeof(INT) );
+					DOUBLE StartTime = appSeconds();
+					if( Method==0 )
+						appQsort( &Data(0), Num, sizeof(INT), (QSORT_COMPARE)appCompareBenchmarkInt );
+					else if( Method==1 )
+						Sort( &Data(0), Num, FCompareBenchmarkInt() );
+					else
+						ParallelSort( &Data(0), Num, FCompareBenchmarkInt() );
+					DOUBLE Seconds = appSeconds()-StartTime;
+					if( Run==0 || Seconds<Time )
+						Time = Seconds;
+					for( INT j=1; j<Num; j++ )
+						if( Data(j-1)>Data(j) )
+							Ok = 0;
+				}
+				if( Method==0 )
+					BaseTime = Time;
+				LogRow( Methods[Method], Time, Num, BaseTime, Ok );
+			}
+		}
+		unguard;
+	}
+};
+
+/*-----------------------------------------------------------------------------
+	The End.
+-----------------------------------------------------------------------------*/
@@ -0,0 +1,286 @@
+/*=============================================================================
+	UMathBenchmarkCommandlet.h: Batched vector math benchmark.
+	Copyright 2016-2019 Sebastian Kaufel, Inc. All Rights Reserved.
+
+	Notes:
+	* This file contains the implementation, include it only once in a
+	  native package's main source file. The class is native only and
+	  registers with that package:
+
+		IMPLEMENT_CLASS(UMathBenchmarkCommandlet);
+
+	* Run as "ucc <Package>.MathBenchmark [NUM=<Count>] [REPEAT=<Count>]".
+	* Each FBatchMath operation is timed as a plain loop over the FVector
+	  and FPlane operators and at every level the CPU supports, on NUM
+	  random elements. Results of each level are verified against the
+	  loop. Times are the best out of REPEAT runs.
+	* Frustum tests may disagree for elements which touch a plane within
+	  rounding, up to one in ten thousand of these is accepted.
+=============================================================================*/
+
+/*-----------------------------------------------------------------------------
+	UMathBenchmarkCommandlet.
+-----------------------------------------------------------------------------*/
+
+//
+// Benchmarks FBatchMath, see notes above.
+//
+class UMathBenchmarkCommandlet : public UCommandlet
+{
+	DECLARE_CLASS(UMathBenchmarkCommandlet,UCommandlet,CLASS_Transient)
+
+	// Operations benchmarked.
+	enum EOperation
+	{
+		OP_TransformPoints,
+		OP_PointPlaneDots,
+		OP_PlanePointDots,
+		OP_SpheresInFrustum,
+		OP_BoxesInFrustum,
+		OP_NormalizeMany,
+		OP_MAX,
+	};
+	enum {NUM_FRUSTUM_PLANES=6};
+
+	// UObject interface.
+	void StaticConstructor()
+	{
+		guard(UMathBenchmarkCommandlet::StaticConstructor);
+		LogToStdout    = 0;
+		IsClient       = 0;
+		IsEditor       = 0;
+		IsServer       = 0;
+		LazyLoad       = 1;
+		ShowErrorCount = 1;
+		HelpCmd        = TEXT("MathBenchmark");
+		HelpOneLiner   = TEXT("Benchmark batched vector math");
+		HelpUsage      = TEXT("MathBenchmark [NUM=<Count>] [REPEAT=<Count>]");
+		HelpParm[0]    = TEXT("NUM");
+		HelpDesc[0]    = TEXT("Number of elements per operation, defaults to 65536.");
+		HelpParm[1]    = TEXT("REPEAT");
+		HelpDesc[1]    = TEXT("Number of runs to take the best time of, defaults to 5.");
+		unguard;
+	}
+
+	// UCommandlet interface.
+	INT Main( const TCHAR* Parms )
+	{
+		guard(UMathBenchmarkCommandlet::Main);
+		Num = 65536;
+		Parse( Parms, TEXT("NUM="), Num );
+		Num = Max( Num, 1 );
+		Repeat = 5;
+		Parse( Parms, TEXT("REPEAT="), Repeat );
+		Repeat = Max( Repeat, 1 );
+		NumFailures = 0;
+
+		// Random input.
+		Coords = FCoords( VRand()*100.f, VRand(), VRand(), VRand() );
+		Plane  = FPlane( VRand().SafeNormal(), appFrand()*100.f );
+		{for( INT i=0; i<NUM_FRUSTUM_PLANES; i++ )
+			Frustum[i] = FPlane( VRand().SafeNormal(), 500.f );}
+		Points.Empty( Num );
+		Planes.Empty( Num );
+		Spheres.Empty( Num );
+		Boxes.Empty( Num );
+		{for( INT i=0; i<Num; i++ )
+		{
+			FVector Center = VRand()*1000.f;
+			FVector Extent = FVector( appFrand(), appFrand(), appFrand() )*100.f;
+			new(Points)FVector( i%64 ? VRand()*1000.f : FVector(0,0,0) );
+			new(Planes)FPlane( VRand().SafeNormal(), appFrand()*1000.f );
+			new(Spheres)FSphere( Center, appFrand()*100.f );
+			FBox* Box = new(Boxes)FBox( Center-Extent, Center+Extent );
+			Box->IsValid = i%16!=0;
+		}}
+		OutVectors.Empty( Num );
+		OutVectors.Add( Num );
+		OutFloats.Empty( Num );
+		OutFloats.Add( Num );
+		OutVisible.Empty( Num );
+		OutVisible.Add( Num );
+
+		// Run.
+		INT OldLevel = FBatchMath::GetLevel();
+		GWarn->Logf( TEXT("%i elements, best of %i runs, CPU supports %s."), Num, Repeat, FBatchMath::GetLevelName(FBatchMath::GetSupportedLevel()) );
+		{for( INT Op=0; Op<OP_MAX; Op++ )
+		{
+			DOUBLE BaseTime = Time( Op, INDEX_NONE );
+			RefVectors = OutVectors;
+			RefFloats  = OutFloats;
+			RefVisible = OutVisible;
+			GWarn->Logf( TEXT("%s:"), GetOperationName(Op) );
+			GWarn->Logf( TEXT("   Operators %8.3f ms %8.1f M/s"), BaseTime*1000.0, BaseTime>0.0 ? Num/BaseTime/1000000.0 : 0.0 );
+			for( INT Level=BATCH_Scalar; Level<=FBatchMath::GetSupportedLevel(); Level++ )
+			{
+				FBatchMath::SetLevel( Level );
+				DOUBLE LevelTime = Time( Op, Level );
+				const TCHAR* Result = Verify( Op ) ? TEXT("Ok") : TEXT("MISMATCH");
+				GWarn->Logf
+				(
+					TEXT("   %-9s %8.3f ms %8.1f M/s %6.2fx %s"),
+					FBatchMath::GetLevelName(Level),
+					LevelTime*1000.0,
+					LevelTime>0.0 ? Num/LevelTime/1000000.0 : 0.0,
+					LevelTime>0.0 ? BaseTime/LevelTime : 0.0,
+					Result
+				);
+			}
+		}}
+		FBatchMath::SetLevel( OldLevel );
+
+		GWarn->Logf( TEXT("%i failures."), NumFailures );
+		return NumFailures!=0;
+		unguard;
+	}
+
+private:
+	INT				Num;
+	INT				Repeat;
+	INT				NumFailures;
+	FCoords			Coords;
+	FPlane			Plane;
+	FPlane			Frustum[NUM_FRUSTUM_PLANES];
+	TArray<FVector>	Points;
+	TArray<FPlane>	Planes;
+	TArray<FSphere>	Spheres;
+	TArray<FBox>	Boxes;
+	TArray<FVector>	OutVectors, RefVectors;
+	TArray<FLOAT>	OutFloats, RefFloats;
+	TArray<BYTE>	OutVisible, RefVisible;
+
+	static const TCHAR* GetOperationName( INT Op )
+	{
+		switch( Op )
+		{
+			case OP_TransformPoints:	return TEXT("TransformPoints");
+			case OP_PointPlaneDots:		return TEXT("PointPlaneDots");
+			case OP_PlanePointDots:		return TEXT("PlanePointDots");
+			case OP_SpheresInFrustum:	return TEXT("SpheresInFrustum");
+			case OP_BoxesInFrustum:		return TEXT("BoxesInFrustum");
+			case OP_NormalizeMany:		return TEXT("NormalizeMany");
+			default:					return TEXT("Unknown");
+		}
+	}
+
+	// Runs an operation Repeat times and returns the best time. Level is
+	// INDEX_NONE for the plain operator loop.
+	DOUBLE Time( INT Op, INT Level )
+	{
+		guard(UMathBenchmarkCommandlet::Time);
+		DOUBLE Best = 0.0;
+		for( INT i=0; i<Repeat; i++ )
+		{
+			DOUBLE StartTime = appSeconds();
+			Run( Op, Level );
+			DOUBLE Seconds = appSeconds() - StartTime;
+			if( i==0 || Seconds<Best )
+				Best = Seconds;
+		}
+		return Best;
+		unguard;
+	}
+	void Run( INT Op, INT Level )
+	{
+		guardSlow(UMathBenchmarkCommandlet::Run);
+		UBOOL    Batch   = Level!=INDEX_NONE;
+		FVector* Vectors = &OutVectors(0);
+		FLOAT*   Floats  = &OutFloats(0);
+		BYTE*    Visible = &OutVisible(0);
+		INT      i, j;
+		switch( Op )
+		{
+			case OP_TransformPoints:
+				if( Batch )
+					FBatchMath::TransformPoints( Coords, &Points(0), Vectors, Num );
+				else for( i=0; i<Num; i++ )
+					Vectors[i] = Points(i).TransformPointBy( Coords );
+				break;
+			case OP_PointPlaneDots:
+				if( Batch )
+					FBatchMath::PointPlaneDots( Plane, &Points(0), Floats, Num );
+				else for( i=0; i<Num; i++ )
+					Floats[i] = Plane.PlaneDot( Points(i) );
+				break;
+			case OP_PlanePointDots:
+				if( Batch )
+					FBatchMath::PlanePointDots( &Planes(0), Coords.Origin, Floats, Num );
+				else for( i=0; i<Num; i++ )
+					Floats[i] = Planes(i).PlaneDot( Coords.Origin );
+				break;
+			case OP_SpheresInFrustum:
+				if( Batch )
+					FBatchMath::SpheresInFrustum( Frustum, NUM_FRUSTUM_PLANES, &Spheres(0), Visible, Num );
+				else for( i=0; i<Num; i++ )
+				{
+					Visible[i] = 1;
+					for( j=0; j<NUM_FRUSTUM_PLANES && Visible[i]; j++ )
+						if( Frustum[j].PlaneDot(Spheres(i)) > Spheres(i).W )
+							Visible[i] = 0;
+				}
+				break;
+			case OP_BoxesInFrustum:
+				if( Batch )
+					FBatchMath::BoxesInFrustum( Frustum, NUM_FRUSTUM_PLANES, &Boxes(0), Visible, Num );
+				else for( i=0; i<Num; i++ )
+				{
+					const FBox& Box = Boxes(i);
+					FVector Center  = (Box.Min+Box.Max)*0.5f;
+					FVector Extent  = (Box.Max-Box.Min)*0.5f;
+					Visible[i] = Box.IsValid!=0;
+					for( j=0; j<NUM_FRUSTUM_PLANES && Visible[i]; j++ )
+						if( Frustum[j].PlaneDot(Center) > Extent.X*Abs(Frustum[j].X) + Extent.Y*Abs(Frustum[j].Y) + Extent.Z*Abs(Frustum[j].Z) )
+							Visible[i] = 0;
+				}
+				break;
+			case OP_NormalizeMany:
+				appMemcpy( Vectors, &Points(0), Num*sizeof(FVector) );
+				if( Batch )
+					FBatchMath::NormalizeMany( Vectors, Num );
+				else for( i=0; i<Num; i++ )
+					Vectors[i].Normalize();
+				break;
+		}
+		unguardSlow;
+	}
+
+	// Compares the output of a level against the operator loop.
+	UBOOL Verify( INT Op )
+	{
+		guard(UMathBenchmarkCommandlet::Verify);
+		INT Mismatches = 0, Allowed = 0;
+		{for( INT i=0; i<Num; i++ )
+		{
+			switch( Op )
+			{
+				case OP_TransformPoints:
+				case OP_NormalizeMany:
+					if( (OutVectors(i)-RefVectors(i)).Size() > 1.e-4f*(1.f+RefVectors(i).Size()) )
+						Mismatches++;
+					break;
+				case OP_PointPlaneDots:
+				case OP_PlanePointDots:
+					if( Abs(OutFloats(i)-RefFloats(i)) > 1.e-4f*(1.f+Abs(RefFloats(i))) )
+						Mismatches++;
+					break;
+				default:
+					if( OutVisible(i)!=RefVisible(i) )
+						Mismatches++;
+					Allowed = Num/10000;
+					break;
+			}
+		}}
+		if( Mismatches>Allowed )
+		{
+			GWarn->Logf( TEXT("   %s: %i of %i results differ."), GetOperationName(Op), Mismatches, Num );
+			NumFailures++;
+			return 0;
+		}
+		return 1;
+		unguard;
+	}
+};
+
+/*-----------------------------------------------------------------------------
+	The End.
+-----------------------------------------------------------------------------*/
@@ -241,6 +241,89 @@ template <class T> T Arctor( FArchive& Ar )
 #define AR_INDEX(intref) \
 	(*(FCompactIndex*)&(intref))
 
+//
+// Decodes a compact index straight from memory. Returns the number of bytes
+// used, or 0 if the encoding runs past Size.
+//
+inline INT appReadCompactIndex( const BYTE* Src, INT Size, INT& Value )
+{
+	INT Used = 1;
+	if( Size<Used )
+		return 0;
+	BYTE B0 = Src[0];
+	INT V = 0;
+	if( B0 & 0x40 )
+	{
+		if( Size<++Used )
+			return 0;
+		BYTE B1 = Src[1];
+		if( B1 & 0x80 )
+		{
+			if( Size<++Used )
+				return 0;
+			BYTE B2 = Src[2];
+			if( B2 & 0x80 )
+			{
+				if( Size<++Used )
+					return 0;
+				BYTE B3 = Src[3];
+				if( B3 & 0x80 )
+				{
+					if( Size<++Used )
+						return 0;
+					V = Src[4];
+				}
+				V = (V << 7) + (B3 & 0x7f);
+			}
+			V = (V << 7) + (B2 & 0x7f);
+		}
+		V = (V << 7) + (B1 & 0x7f);
+	}
+	V = (V << 6) + (B0 & 0x3f);
+	if( B0 & 0x80 )
+		V = -V;
+	Value = V;
+	return Used;
+}
+
+/*-----------------------------------------------------------------------------
+	Archive views.
+-----------------------------------------------------------------------------*/
+
+//
+// Asks an archive for the memory it reads from. FArchive can't grow new
+// virtuals, so the request travels through Serialize(): set
+// GArchiveViewRequest, pass it with a Length of 0 and archives backed by
+// memory fill it in. Every other archive treats it as an empty read, and
+// ULinkerLoad passes it on to its loader unchanged.
+//
+struct FArchiveViewRequest
+{
+	const BYTE*	View;
+	INT			Size;
+	FArchiveViewRequest()
+	:	View( NULL )
+	,	Size( 0 )
+	{}
+};
+
+// Request currently in flight, game thread only.
+extern COREI_API FArchiveViewRequest* GArchiveViewRequest;
+
+//
+// Returns the memory Ar reads from or NULL.
+//
+inline const BYTE* appGetArchiveView( FArchive& Ar, INT& OutSize )
+{
+	FArchiveViewRequest Request;
+	FArchiveViewRequest* Pushed = GArchiveViewRequest;
+	GArchiveViewRequest = &Request;
+	Ar.Serialize( &Request, 0 );
+	GArchiveViewRequest = Pushed;
+	OutSize = Request.Size;
+	return Request.View;
+}
+
 /*----------------------------------------------------------------------------
 	The End.
 ----------------------------------------------------------------------------*/
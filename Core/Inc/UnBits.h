@@ -99,6 +99,325 @@ private:
 	INT   Pos;
 };
 
+/*-----------------------------------------------------------------------------
+	FWordBitWriter.
+-----------------------------------------------------------------------------*/
+
+//
+// Writes bitstreams like FBitWriter, with the same layout, but gathers bits
+// in a 64 bit register and stores whole words. Byte aligned runs are copied
+// and SerializeInt() with a power of two Max writes all bits at once.
+//
+class FWordBitWriter : public FArchive
+{
+public:
+	// Constructors.
+	FWordBitWriter( INT InMaxBits )
+	:	Buffer( ((InMaxBits+63)>>6)*8+8 )
+	,	Num( 0 )
+	,	Max( InMaxBits )
+	,	Bytes( 0 )
+	,	Acc( 0 )
+	,	AccBits( 0 )
+	{
+		appMemzero( &Buffer(0), Buffer.Num() );
+		ArIsPersistent = ArIsSaving = 1;
+	}
+
+	// FWordBitWriter interface.
+	void WriteBits( DWORD Value, INT LengthBits )
+	{
+		checkSlow(LengthBits>=0 && LengthBits<=32);
+		if( Num+LengthBits>Max )
+		{
+			ArIsError = 1;
+			return;
+		}
+		Num += LengthBits;
+		if( LengthBits<32 )
+			Value &= (1<<LengthBits)-1;
+		Acc |= (QWORD)Value << AccBits;
+		AccBits += LengthBits;
+		if( AccBits>=64 )
+		{
+			StoreWord( &Buffer(Bytes), Acc );
+			Bytes   += 8;
+			AccBits -= 64;
+			Acc      = AccBits ? (QWORD)(Value >> (LengthBits-AccBits)) : 0;
+		}
+	}
+	void SerializeBits( void* Src, INT LengthBits )
+	{
+		if( Num+LengthBits>Max )
+		{
+			ArIsError = 1;
+			return;
+		}
+		BYTE* Data = (BYTE*)Src;
+		if( (AccBits&7)==0 && LengthBits>=64 )
+		{
+			// Byte aligned run, copy it.
+			Commit();
+			INT Count = LengthBits>>3;
+			appMemcpy( &Buffer(Bytes), Data, Count );
+			Bytes      += Count;
+			Num        += Count*8;
+			Data       += Count;
+			LengthBits -= Count*8;
+		}
+		for( ; LengthBits>=32; LengthBits-=32, Data+=4 )
+			WriteBits( Data[0] | (Data[1]<<8) | (Data[2]<<16) | ((DWORD)Data[3]<<24), 32 );
+		for( ; LengthBits>=8; LengthBits-=8, Data++ )
+			WriteBits( *Data, 8 );
+		if( LengthBits )
+			WriteBits( *Data, LengthBits );
+	}
+	void SerializeInt( DWORD& Value, DWORD ValueMax )
+	{
+		WriteInt( Value, ValueMax );
+	}
+	void WriteInt( DWORD Value, DWORD ValueMax )
+	{
+		check(Value<ValueMax);
+		if( (ValueMax&(ValueMax-1))==0 )
+		{
+			WriteBits( Value, appFloorLogTwo(ValueMax) );
+			return;
+		}
+		if( Num+appCeilLogTwo(ValueMax)>Max )
+		{
+			ArIsError = 1;
+			return;
+		}
+		// Same bit count as FBitWriter::WriteInt(), which stops as soon as no
+		// further bit can keep the value below ValueMax.
+		DWORD NewValue=0;
+		INT   Bits=0;
+		for( DWORD Mask=1; NewValue+Mask<ValueMax && Mask; Mask*=2, Bits++ )
+			if( Value&Mask )
+				NewValue += Mask;
+		WriteBits( Value, Bits );
+	}
+	void WriteBit( BYTE In )
+	{
+		WriteBits( In!=0, 1 );
+	}
+	void Serialize( void* Src, INT LengthBytes )
+	{
+		SerializeBits( Src, LengthBytes*8 );
+	}
+	BYTE* GetData()
+	{
+		// Stores the pending bits, but keeps them pending.
+		StoreWord( &Buffer(Bytes), Acc );
+		return &Buffer(0);
+	}
+	INT GetNumBytes()
+	{
+		return (Num+7)>>3;
+	}
+	INT GetNumBits()
+	{
+		return Num;
+	}
+	void SetOverflowed()
+	{
+		ArIsError = 1;
+	}
+
+private:
+	FWordBitWriter( const FWordBitWriter& );
+	void operator=( const FWordBitWriter& );
+
+	static void StoreWord( BYTE* Dest, QWORD Word )
+	{
+#if __INTEL_BYTE_ORDER__
+		*(QWORD*)Dest = Word;
+#else
+		for( INT i=0; i<8; i++ )
+			Dest[i] = (BYTE)(Word>>(i*8));
+#endif
+	}
+	void Commit()
+	{
+		// Moves whole pending bytes into the buffer.
+		checkSlow((AccBits&7)==0);
+		StoreWord( &Buffer(Bytes), Acc );
+		Bytes  += AccBits>>3;
+		Acc     = 0;
+		AccBits = 0;
+	}
+
+	TArray<BYTE> Buffer;
+	INT   Num;		// Bits written.
+	INT   Max;		// Bits available.
+	INT   Bytes;	// Bytes stored, Acc holds the bits following them.
+	QWORD Acc;
+	INT   AccBits;
+};
+
+/*-----------------------------------------------------------------------------
+	FWordBitReader.
+-----------------------------------------------------------------------------*/
+
+//
+// Reads bitstreams like FBitReader, loading 64 bits per read. Byte aligned
+// runs are copied and SerializeInt() with a power of two Max reads all bits
+// at once.
+//
+class FWordBitReader : public FArchive
+{
+public:
+	// Constructors.
+	FWordBitReader( BYTE* Src=NULL, INT CountBits=0 )
+	:	Buffer( ((CountBits+7)>>3)+8 )
+	,	Num( CountBits )
+	,	Pos( 0 )
+	{
+		appMemzero( &Buffer(0), Buffer.Num() );
+		if( Src )
+			appMemcpy( &Buffer(0), Src, (CountBits+7)>>3 );
+		if( CountBits&7 )
+			Buffer(CountBits>>3) &= (1<<(CountBits&7))-1;
+		ArIsPersistent = ArIsLoading = 1;
+	}
+
+	// FWordBitReader interface.
+	DWORD PeekBits( INT LengthBits )
+	{
+		// Bits past the end read as zero.
+		checkSlow(LengthBits>=0 && LengthBits<=32);
+		DWORD Result = (DWORD)(LoadWord(&Buffer(Pos>>3)) >> (Pos&7));
+		return LengthBits<32 ? Result & ((1<<LengthBits)-1) : Result;
+	}
+	void SkipBits( INT LengthBits )
+	{
+		Pos += LengthBits;
+	}
+	DWORD ReadBits( INT LengthBits )
+	{
+		if( Pos+LengthBits>Num )
+		{
+			ArIsError = 1;
+			Pos       = Num;
+			return 0;
+		}
+		DWORD Result = PeekBits( LengthBits );
+		Pos += LengthBits;
+		return Result;
+	}
+	void SerializeBits( void* Dest, INT LengthBits )
+	{
+		BYTE* Data = (BYTE*)Dest;
+		appMemzero( Data, (LengthBits+7)>>3 );
+		if( Pos+LengthBits>Num )
+		{
+			ArIsError = 1;
+			return;
+		}
+		if( (Pos&7)==0 )
+		{
+			// Byte aligned run, copy it.
+			INT Count = LengthBits>>3;
+			appMemcpy( Data, &Buffer(Pos>>3), Count );
+			Pos        += Count*8;
+			Data       += Count;
+			LengthBits -= Count*8;
+		}
+		for( ; LengthBits>=32; LengthBits-=32, Data+=4 )
+		{
+			DWORD Value = ReadBits( 32 );
+			Data[0] = (BYTE)(Value    );
+			Data[1] = (BYTE)(Value>> 8);
+			Data[2] = (BYTE)(Value>>16);
+			Data[3] = (BYTE)(Value>>24);
+		}
+		for( ; LengthBits>=8; LengthBits-=8, Data++ )
+			*Data = ReadBits( 8 );
+		if( LengthBits )
+			*Data = ReadBits( LengthBits );
+	}
+	void SerializeInt( DWORD& Value, DWORD ValueMax )
+	{
+		if( (ValueMax&(ValueMax-1))==0 )
+		{
+			Value = ReadBits( appFloorLogTwo(ValueMax) );
+			return;
+		}
+		// Same bit count as FBitReader::SerializeInt().
+		DWORD Bits = PeekBits( 32 );
+		INT   i    = 0;
+		Value = 0;
+		for( DWORD Mask=1; Value+Mask<ValueMax && Mask; Mask*=2, i++ )
+		{
+			if( Pos+i>=Num )
+			{
+				ArIsError = 1;
+				break;
+			}
+			if( Bits&Mask )
+				Value |= Mask;
+		}
+		Pos += i;
+	}
+	DWORD ReadInt( DWORD ValueMax )
+	{
+		DWORD Value=0;
+		SerializeInt( Value, ValueMax );
+		return Value;
+	}
+	BYTE ReadBit()
+	{
+		return ReadBits( 1 );
+	}
+	void Serialize( void* Dest, INT LengthBytes )
+	{
+		SerializeBits( Dest, LengthBytes*8 );
+	}
+	BYTE* GetData()
+	{
+		return &Buffer(0);
+	}
+	UBOOL AtEnd()
+	{
+		return ArIsError || Pos>=Num;
+	}
+	void SetOverflowed()
+	{
+		ArIsError = 1;
+	}
+	INT GetNumBytes()
+	{
+		return (Num+7)>>3;
+	}
+	INT GetNumBits()
+	{
+		return Num;
+	}
+	INT GetPosBits()
+	{
+		return Pos;
+	}
+
+private:
+	static QWORD LoadWord( const BYTE* Src )
+	{
+		// Buffer has 8 bytes slack, so this never reads past its end.
+#if __INTEL_BYTE_ORDER__
+		return *(const QWORD*)Src;
+#else
+		QWORD Result = 0;
+		for( INT i=7; i>=0; i-- )
+			Result = (Result<<8) | Src[i];
+		return Result;
+#endif
+	}
+
+	TArray<BYTE> Buffer;
+	INT   Num;
+	INT   Pos;
+};
+
 /*-----------------------------------------------------------------------------
 	The End.
 -----------------------------------------------------------------------------*/
@@ -189,6 +189,277 @@ private:
 // Global scope.
 typedef FMemCache::FCacheItem FCacheItem;
 
+/*-----------------------------------------------------------------------------
+	FShardedMemCache.
+-----------------------------------------------------------------------------*/
+
+//
+// Memory cache which can be shared between threads.
+//
+// FMemCache::Get() modifies the item and the cache itself, so a single
+// FMemCache can only ever be used by one thread. This splits the memory into
+// several FMemCache shards, each guarded by its own lock, so threads
+// working on different items rarely contend. The shard is picked by hashing
+// the whole cache id.
+//
+// Items are returned locked, exactly as by FMemCache. They must be unlocked
+// through FShardedMemCache::Unlock() instead of FCacheItem::Unlock() though,
+// as the cost is only protected by the shard lock.
+//
+// Hits, misses, creates and evictions are counted per cache id base (the
+// low byte of the id, see ECacheIDBase), see "SHARDCACHE STATS". FMemCache
+// evicts inside Create() without telling anyone, so each shard remembers
+// the ids it created. An eviction is counted when a remembered id misses,
+// or when the ids are pruned and it is no longer cached. The ids are pruned
+// when the stats are dumped and whenever the table, which is sized for
+// twice the shard's items in Init(), fills up.
+//
+class FShardedMemCache
+{
+public:
+	// Constants.
+	enum {MAX_SHARDS=16};
+
+	// Per cache id base statistics.
+	struct FCidStats
+	{
+		INT		Hits;
+		INT		Misses;
+		INT		Creates;
+		INT		Evicted;
+		INT		Flushed;
+		QWORD	CreatedBytes;
+	};
+
+	// Constructors.
+	FShardedMemCache()
+	:	NumShards( 0 )
+	{}
+
+	// FShardedMemCache interface.
+	void Init( INT BytesToAllocate, INT MaxItems, INT InNumShards=4 )
+	{
+		guard(FShardedMemCache::Init);
+		check(NumShards==0);
+		check(InNumShards>0 && InNumShards<=MAX_SHARDS);
+		check((InNumShards&(InNumShards-1))==0);
+		NumShards = InNumShards;
+		for( INT i=0; i<NumShards; i++ )
+		{
+			Shards[i].Cache.Init( BytesToAllocate/NumShards, MaxItems/NumShards );
+			Shards[i].Resident.Empty( 2*(MaxItems/NumShards) );
+		}
+		ResetStats();
+		unguard;
+	}
+	void Exit( INT FreeMemory )
+	{
+		guard(FShardedMemCache::Exit);
+		for( INT i=0; i<NumShards; i++ )
+		{
+			Shards[i].Cache.Exit( FreeMemory );
+			Shards[i].Resident.Empty();
+		}
+		NumShards = 0;
+		unguard;
+	}
+	BYTE* Get( QWORD Id, FCacheItem*& Item, INT Alignment=DEFAULT_ALIGNMENT )
+	{
+		guardSlow(FShardedMemCache::Get);
+		FShard& Shard = GetShard( Id );
+		FScopeLock Lock( Shard.Lock );
+		BYTE* Result = Shard.Cache.Get( Id, Item, Alignment );
+		if( Result )
+			Shard.Stats[(BYTE)Id].Hits++;
+		else
+		{
+			Shard.Stats[(BYTE)Id].Misses++;
+			if( Shard.Resident.Remove(Id) )
+				Shard.Stats[(BYTE)Id].Evicted++;
+		}
+		return Result;
+		unguardSlow;
+	}
+	BYTE* Create( QWORD Id, FCacheItem*& Item, INT CreateSize, INT Alignment=DEFAULT_ALIGNMENT, INT SafetyPad=0 )
+	{
+		guardSlow(FShardedMemCache::Create);
+		FShard& Shard = GetShard( Id );
+		FScopeLock Lock( Shard.Lock );
+		FCidStats& Stats = Shard.Stats[(BYTE)Id];
+		Stats.Creates++;
+		Stats.CreatedBytes += CreateSize;
+		if( Shard.Resident.GetSlack()==0 )
+			PruneResident( Shard );
+		Shard.Resident.Set( Id, 1 );
+		return Shard.Cache.Create( Id, Item, CreateSize, Alignment, SafetyPad );
+		unguardSlow;
+	}
+	void Unlock( FCacheItem* Item )
+	{
+		guardSlow(FShardedMemCache::Unlock);
+		FShard& Shard = GetShard( Item->GetId() );
+		FScopeLock Lock( Shard.Lock );
+		Item->Unlock();
+		unguardSlow;
+	}
+	void Flush( QWORD Id=0, DWORD Mask=~0, UBOOL IgnoreLocked=0 )
+	{
+		guard(FShardedMemCache::Flush);
+		for( INT i=0; i<NumShards; i++ )
+		{
+			// FMemCache::Flush() only compares the low 32 bits, so items
+			// matching Id may be in any shard.
+			FShard& Shard = Shards[i];
+			FScopeLock Lock( Shard.Lock );
+			for( FCacheItem* Item=Shard.Cache.First(); Item && Shard.Cache.Next(Item); Item=Shard.Cache.Next(Item) )
+				if( Item->GetId() && (Id==0 || (Item->GetId()&Mask)==(Id&Mask)) && (!IgnoreLocked || Item->GetCost()<FMemCache::COST_INFINITE) )
+				{
+					Shard.Stats[(BYTE)Item->GetId()].Flushed++;
+					Shard.Resident.Remove( Item->GetId() );
+				}
+			Shard.Cache.Flush( Id, Mask, IgnoreLocked );
+		}
+		unguard;
+	}
+	void Tick()
+	{
+		guard(FShardedMemCache::Tick);
+		for( INT i=0; i<NumShards; i++ )
+		{
+			FScopeLock Lock( Shards[i].Lock );
+			Shards[i].Cache.Tick();
+		}
+		unguard;
+	}
+	void ResetStats()
+	{
+		guard(FShardedMemCache::ResetStats);
+		for( INT i=0; i<NumShards; i++ )
+		{
+			FScopeLock Lock( Shards[i].Lock );
+			appMemzero( Shards[i].Stats, sizeof(Shards[i].Stats) );
+		}
+		unguard;
+	}
+	INT GetNumShards()
+	{
+		return NumShards;
+	}
+	FMemCache& GetShardCache( INT Index )
+	{
+		return Shards[Index].Cache;
+	}
+	UBOOL Exec( const TCHAR* Cmd, FOutputDevice& Ar=*GLog )
+	{
+		guard(FShardedMemCache::Exec);
+		if( ParseCommand(&Cmd,TEXT("SHARDCACHE")) )
+		{
+			if( ParseCommand(&Cmd,TEXT("RESET")) )
+				ResetStats();
+			else if( ParseCommand(&Cmd,TEXT("FLUSH")) )
+				Flush();
+			else
+				DumpStats( Ar );
+			return 1;
+		}
+		return 0;
+		unguard;
+	}
+	void DumpStats( FOutputDevice& Ar )
+	{
+		guard(FShardedMemCache::DumpStats);
+
+		// Walk the items to see what is still cached, anything created but
+		// gone was evicted. Then sum up the counters.
+		FCidStats Stats[256];
+		INT       LiveItems[256], LiveBytes[256], i, Cid;
+		appMemzero( Stats, sizeof(Stats) );
+		appMemzero( LiveItems, sizeof(LiveItems) );
+		appMemzero( LiveBytes, sizeof(LiveBytes) );
+		for( i=0; i<NumShards; i++ )
+		{
+			FShard& Shard = Shards[i];
+			FScopeLock Lock( Shard.Lock );
+			PruneResident( Shard );
+			for( FCacheItem* Item=Shard.Cache.First(); Item && Shard.Cache.Next(Item); Item=Shard.Cache.Next(Item) )
+			{
+				if( Item->GetId() )
+				{
+					LiveItems[(BYTE)Item->GetId()]++;
+					LiveBytes[(BYTE)Item->GetId()] += Item->GetSize();
+				}
+			}
+			for( Cid=0; Cid<256; Cid++ )
+			{
+				Stats[Cid].Hits         += Shard.Stats[Cid].Hits;
+				Stats[Cid].Misses       += Shard.Stats[Cid].Misses;
+				Stats[Cid].Creates      += Shard.Stats[Cid].Creates;
+				Stats[Cid].Evicted      += Shard.Stats[Cid].Evicted;
+				Stats[Cid].Flushed      += Shard.Stats[Cid].Flushed;
+				Stats[Cid].CreatedBytes += Shard.Stats[Cid].CreatedBytes;
+			}
+		}
+
+		Ar.Logf( TEXT("Cache statistics (%i shards):"), NumShards );
+		Ar.Logf( TEXT("  %4s %10s %10s %6s %8s %8s %8s %8s %10s"), TEXT("CID"), TEXT("Hits"), TEXT("Misses"), TEXT("Hit%"), TEXT("Creates"), TEXT("Evicted"), TEXT("Flushed"), TEXT("Items"), TEXT("LiveKB") );
+		for( Cid=0; Cid<256; Cid++ )
+		{
+			FCidStats& S = Stats[Cid];
+			if( !S.Hits && !S.Misses && !S.Creates && !LiveItems[Cid] )
+				continue;
+			INT Lookups = S.Hits+S.Misses;
+			Ar.Logf( TEXT("  0x%02X %10i %10i %6.1f %8i %8i %8i %8i %10i"), Cid, S.Hits, S.Misses, Lookups ? 100.0*S.Hits/Lookups : 0.0, S.Creates, S.Evicted, S.Flushed, LiveItems[Cid], LiveBytes[Cid]/1024 );
+		}
+		unguard;
+	}
+
+private:
+	// A single shard.
+	struct FShard
+	{
+		FSpinLock				Lock;
+		FMemCache				Cache;
+		FCidStats				Stats[256];
+		TFlatMap<QWORD,BYTE>	Resident;	// Ids created and not flushed since.
+	};
+
+	// Variables.
+	INT		NumShards;
+	FShard	Shards[MAX_SHARDS];
+
+	// Internal functions.
+	FShard& GetShard( QWORD Id )
+	{
+		DWORD Hash = ((DWORD)Id ^ (DWORD)(Id>>24) ^ (DWORD)(Id>>40)) * 0x9E3779B1;
+		return Shards[(Hash>>16)&(NumShards-1)];
+	}
+
+	// Counts and forgets the remembered ids which are no longer cached.
+	// Marks live ids through their value, so it doesn't allocate. Called
+	// with the shard locked.
+	void PruneResident( FShard& Shard )
+	{
+		guardSlow(FShardedMemCache::PruneResident);
+		for( TFlatMap<QWORD,BYTE>::TIterator It(Shard.Resident); It; ++It )
+			It.Value() = 0;
+		for( FCacheItem* Item=Shard.Cache.First(); Item && Shard.Cache.Next(Item); Item=Shard.Cache.Next(Item) )
+		{
+			BYTE* Mark = Item->GetId() ? Shard.Resident.Find( Item->GetId() ) : NULL;
+			if( Mark )
+				*Mark = 1;
+		}
+		for( TFlatMap<QWORD,BYTE>::TIterator Jt(Shard.Resident); Jt; ++Jt )
+		{
+			if( !Jt.Value() )
+			{
+				Shard.Stats[(BYTE)Jt.Key()].Evicted++;
+				Jt.RemoveCurrent();
+			}
+		}
+		unguardSlow;
+	}
+};
+
 /*-----------------------------------------------------------------------------
 	The End.
 -----------------------------------------------------------------------------*/
@@ -680,6 +680,17 @@ CORE_API UBOOL appLoadFileToString( FString& Result, const TCHAR* Filename, FFil
 CORE_API UBOOL appSaveArrayToFile( const TArray<BYTE>& Array, const TCHAR* Filename, FFileManager* FileManager=GFileManager );
 CORE_API UBOOL appSaveStringToFile( const FString& String, const TCHAR* Filename, FFileManager* FileManager=GFileManager );
 
+/*-----------------------------------------------------------------------------
+	File mapping functions (CoreI).
+-----------------------------------------------------------------------------*/
+
+// Maps a whole file read only. Returns NULL on failure or for empty files.
+COREI_API const BYTE* appMapFile( const TCHAR* Filename, INT& OutSize );
+COREI_API void appUnmapFile( const BYTE* View, INT Size );
+
+// Time stamp of a file from the platform, 0 if it can't be determined.
+COREI_API SQWORD appGetFileTime( const TCHAR* Filename, EFileTimes Which=FILETIME_LastWrite );
+
 /*-----------------------------------------------------------------------------
 	Memory functions.
 -----------------------------------------------------------------------------*/
@@ -756,6 +767,19 @@ inline BYTE appFloorLogTwo( DWORD Arg )
 }
 #endif
 
+// Index of the lowest set bit, undefined for zero.
+#ifndef DEFINED_appCountTrailingZeros
+inline INT appCountTrailingZeros( DWORD Arg )
+{
+	static const BYTE DeBruijn[32] =
+	{
+		 0,  1, 28,  2, 29, 14, 24,  3, 30, 22, 20, 15, 25, 17,  4,  8,
+		31, 27, 13, 23, 21, 19, 16,  7, 26, 12, 18,  6, 11,  5, 10,  9
+	};
+	return DeBruijn[((Arg&(0-Arg))*0x077CB531U)>>27];
+}
+#endif
+
 /*-----------------------------------------------------------------------------
 	MD5 functions.
 -----------------------------------------------------------------------------*/
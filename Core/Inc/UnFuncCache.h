@@ -0,0 +1,239 @@
+/*=============================================================================
+	UnFuncCache.h: Cached function lookups for script events.
+	Copyright 2016-2019 Sebastian Kaufel, Inc. All Rights Reserved.
+
+	Notes:
+	* Native code fires events through UObject::FindFunctionChecked(),
+	  which looks through the hash of the object's state and class on
+	  every call. FFunctionCache remembers the result per class and state
+	  in open addressing tables, which are filled on demand. Functions which
+	  weren't found are remembered as well.
+	* Most events fired are empty in script. Their byte code only returns,
+	  so ProcessEvent() would set up a frame, copy the parameters in and
+	  out, run the interpreter and come back with nothing changed. These
+	  stubs are remembered too and ProcessEvent() skips them. Replicated
+	  functions are never skipped, they still have to be sent.
+	* Use appProcessEventCached() and appFindFunctionCached() in hand
+	  written event stubs. Events with a return value keep ProcessEvent(),
+	  a skipped stub would leave the return value as passed in. The headers
+	  exported from script are generated and keep ProcessEvent() as well.
+	* XWindow::ProcessScript() and UEventManager::AIEvent() are compiled
+	  into Extension.dll and Engine.dll, they don't use the cache yet.
+	* Tables are flushed after garbage collection, which is noticed through
+	  an FGarbageSentinel. In the editor, where classes are relinked when
+	  compiled, everything goes straight to UObject::FindFunction().
+	* Use "FUNCCACHE [ON|OFF|FLUSH]" to toggle it and report stats.
+	* Game thread only.
+=============================================================================*/
+
+/*-----------------------------------------------------------------------------
+	FFunctionCache.
+-----------------------------------------------------------------------------*/
+
+class FFunctionCache : public FExec
+{
+public:
+	// A function found by name.
+	struct FEntry
+	{
+		UFunction*	Function;
+		UBOOL		IsEmpty;
+	};
+
+	// Functions found for objects of a class in a state.
+	struct FScope
+	{
+		UClass*					Class;
+		UState*					State;
+		TFlatMap<FName,FEntry>	Entries;
+	};
+
+	// Variables.
+	UBOOL Enabled;
+
+	// Constructors.
+	FFunctionCache()
+	:	Enabled( 1 )
+	,	LastScope( NULL )
+	,	NumLookups( 0 )
+	,	NumMisses( 0 )
+	,	NumSkipped( 0 )
+	{}
+	~FFunctionCache()
+	{
+		Flush();
+	}
+
+	// FFunctionCache interface.
+	void Flush()
+	{
+		guard(FFunctionCache::Flush);
+		for( INT i=0; i<ScopeList.Num(); i++ )
+			delete ScopeList(i);
+		ScopeList.Empty();
+		Scopes.Empty();
+		LastScope = NULL;
+		Sentinel.Clear();
+		unguard;
+	}
+	UFunction* FindFunction( UObject* Object, FName InName, UBOOL Global=0 )
+	{
+		guardSlow(FFunctionCache::FindFunction);
+		if( !IsUsable() )
+			return Object->FindFunction( InName, Global );
+		return Find( Object, InName, Global )->Function;
+		unguardSlow;
+	}
+	UFunction* FindFunctionChecked( UObject* Object, FName InName, UBOOL Global=0 )
+	{
+		guardSlow(FFunctionCache::FindFunctionChecked);
+		UFunction* Function = FindFunction( Object, InName, Global );
+		if( !Function )
+			appErrorf( TEXT("Failed to find function %s in %s"), *InName, Object->GetFullName() );
+		return Function;
+		unguardSlow;
+	}
+	void ProcessEvent( UObject* Object, FName EventName, void* Parms )
+	{
+		guardSlow(FFunctionCache::ProcessEvent);
+		if( !IsUsable() )
+		{
+			Object->ProcessEvent( Object->FindFunctionChecked(EventName), Parms );
+			return;
+		}
+		FEntry*    Entry    = Find( Object, EventName, 0 );
+		UFunction* Function = Entry->Function;
+		if( !Function )
+			appErrorf( TEXT("Failed to find function %s in %s"), *EventName, Object->GetFullName() );
+		if( Entry->IsEmpty )
+		{
+			NumSkipped++;
+			return;
+		}
+		Object->ProcessEvent( Function, Parms );
+		unguardSlow;
+	}
+
+	// Whether running Function can't have any effect.
+	static UBOOL IsEmptyStub( UFunction* Function )
+	{
+		guardSlow(FFunctionCache::IsEmptyStub);
+		if( (Function->FunctionFlags & (FUNC_Native|FUNC_Net)) || Function->iNative )
+			return 0;
+		INT i=0;
+		while( i<Function->Script.Num() && Function->Script(i)==EX_Nothing )
+			i++;
+		return i+1<Function->Script.Num() && Function->Script(i)==EX_Return && Function->Script(i+1)==EX_Nothing;
+		unguardSlow;
+	}
+
+	// FExec interface.
+	UBOOL Exec( const TCHAR* Cmd, FOutputDevice& Ar )
+	{
+		guard(FFunctionCache::Exec);
+		if( ParseCommand(&Cmd,TEXT("FUNCCACHE")) )
+		{
+			if( ParseCommand(&Cmd,TEXT("ON")) )
+				Enabled = 1;
+			else if( ParseCommand(&Cmd,TEXT("OFF")) )
+				Enabled = 0;
+			if( !Enabled || ParseCommand(&Cmd,TEXT("FLUSH")) )
+				Flush();
+			INT NumEntries=0;
+			for( INT i=0; i<ScopeList.Num(); i++ )
+				NumEntries += ScopeList(i)->Entries.Num();
+			Ar.Logf( TEXT("Function cache %s: %i scopes, %i functions, %.0f lookups, %.0f misses, %.0f empty events skipped."), Enabled ? TEXT("on") : TEXT("off"), ScopeList.Num(), NumEntries, NumLookups, NumMisses, NumSkipped );
+			return 1;
+		}
+		return 0;
+		unguard;
+	}
+
+private:
+	FFunctionCache( const FFunctionCache& );
+	void operator=( const FFunctionCache& );
+
+	// Variables.
+	TArray<FScope*>				ScopeList;
+	TFlatMap<QWORD,FScope*>		Scopes;
+	FScope*						LastScope;
+	FGarbageSentinel			Sentinel;
+	DOUBLE						NumLookups;
+	DOUBLE						NumMisses;
+	DOUBLE						NumSkipped;
+
+	// Implementation.
+	UBOOL IsUsable()
+	{
+		if( !Enabled || GIsEditor )
+			return 0;
+#if DEUS_EX
+		if( UObject::IsInGarbageCollection() )
+			return 0;
+#endif
+		if( !Sentinel.IsAlive() )
+		{
+			// Pointers may have been reused.
+			Flush();
+			Sentinel.Reset();
+		}
+		return 1;
+	}
+	FEntry* Find( UObject* Object, FName InName, UBOOL Global )
+	{
+		guardSlow(FFunctionCache::Find);
+		NumLookups++;
+
+		// Same scope as UObject::FindFunction.
+		UClass*      Class      = Object->GetClass();
+		FStateFrame* StateFrame = Object->GetStateFrame();
+		UState*      State      = (!Global && StateFrame) ? StateFrame->StateNode : NULL;
+		FScope*      Scope      = LastScope;
+		if( !Scope || Scope->Class!=Class || Scope->State!=State )
+		{
+			QWORD Key = ((QWORD)(DWORD)Class << 32) | (DWORD)State;
+			Scope     = Scopes.FindRef( Key );
+			if( !Scope )
+			{
+				Scope        = new FScope;
+				Scope->Class = Class;
+				Scope->State = State;
+				ScopeList.AddItem( Scope );
+				Scopes.Set( Key, Scope );
+			}
+			LastScope = Scope;
+		}
+
+		FEntry* Entry = Scope->Entries.Find( InName );
+		if( !Entry )
+		{
+			NumMisses++;
+			FEntry New;
+			New.Function = Object->FindFunction( InName, Global );
+			New.IsEmpty  = New.Function && IsEmptyStub( New.Function );
+			Entry        = &Scope->Entries.Set( InName, New );
+		}
+		return Entry;
+		unguardSlow;
+	}
+};
+
+// Global function cache.
+extern COREI_API FFunctionCache GFunctionCache;
+
+/*-----------------------------------------------------------------------------
+	Cached event dispatch.
+-----------------------------------------------------------------------------*/
+
+inline UFunction* appFindFunctionCached( UObject* Object, FName InName, UBOOL Global )
+{
+	return GFunctionCache.FindFunction( Object, InName, Global );
+}
+inline void appProcessEventCached( UObject* Object, FName EventName, void* Parms )
+{
+	GFunctionCache.ProcessEvent( Object, EventName, Parms );
+}
+
+/*-----------------------------------------------------------------------------
+	The End.
+-----------------------------------------------------------------------------*/
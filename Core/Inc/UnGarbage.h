@@ -0,0 +1,488 @@
+/*=============================================================================
+	UnGarbage.h: Parallel and incremental garbage collector.
+	Copyright 2016-2019 Sebastian Kaufel, Inc. All Rights Reserved.
+
+	Notes:
+	* Alternative to UObject::CollectGarbage() with the same semantics: all
+	  objects and names are tagged RF_Unreachable, everything reachable from
+	  the root set (UObject::SerializeRootSet) is untagged by serializing
+	  references, and whatever is still tagged gets destroyed.
+	* Marking can run on GThreadPool (GC PARALLEL 1). It is off by default,
+	  see FArchiveGCMark for what it relies on.
+	* There are no write barriers, so marking itself is never incremental.
+	  In incremental mode only destroying and deleting the garbage is spread
+	  over Tick() calls with a time budget. Name purging is skipped in that
+	  mode, as names created in between would still carry the tag.
+	* Pending garbage is hidden right after marking: it is detached from its
+	  linker, unhashed and its GObjObjects slot is cleared, while the index
+	  stays reserved. So StaticFindObject, loads (which create a new object
+	  instead of reviving the old one) and FObjectIterator never see it.
+	  Each object is put back only for the duration of its own
+	  ConditionalDestroy() and delete, which Core expects of it.
+	* Finish a pending collection (Flush()) before UObject::CollectGarbage(),
+	  which doesn't know about hidden objects and could purge their names.
+=============================================================================*/
+
+/*-----------------------------------------------------------------------------
+	FGarbageCollector.
+-----------------------------------------------------------------------------*/
+
+class FGarbageCollector
+{
+public:
+	enum {MAX_MARKERS=16};
+	enum {LOCAL_STACK_SIZE=256};
+
+	// Constructors.
+	FGarbageCollector()
+	:	Parallel( 0 )
+	,	TimeBudget( 0.002f )
+	,	Cursor( 0 )
+	,	Phase( PHASE_Idle )
+	,	SharedStack( NULL )
+	,	SharedNum( 0 )
+	,	NumActive( 0 )
+	,	Done( 0 )
+	,	LastMarkTime( 0.0 )
+	,	LastNumGarbage( 0 )
+	{}
+
+	// FGarbageCollector interface.
+	void Collect( DWORD KeepFlags, UBOOL Incremental=0 )
+	{
+		guard(FGarbageCollector::Collect);
+		check(UObject::GObjBeginLoadCount==0);
+		Flush();
+#if DEUS_EX
+		UObject::GObjInGarbageCollection = 1;
+#endif
+		Mark( KeepFlags );
+
+		// Gather garbage.
+		Garbage.Empty();
+		for( INT i=0; i<UObject::GObjObjects.Num(); i++ )
+		{
+			UObject* Object = UObject::GObjObjects(i);
+			if( Object && (Object->ObjectFlags & (RF_Unreachable|RF_Native))==RF_Unreachable )
+				Garbage.AddItem( Object );
+		}
+		LastNumGarbage = Garbage.Num();
+		debugf( NAME_Log, TEXT("Collecting garbage: %i unreachable objects, marked in %.1f ms."), Garbage.Num(), LastMarkTime*1000.0 );
+
+		if( Incremental )
+		{
+			// Keep all names, see notes.
+			{for( INT i=0; i<FName::GetMaxNames(); i++ )
+				if( FName::GetEntry(i) )
+					FName::GetEntry(i)->Flags &= ~RF_Unreachable;}
+
+			// Hide the garbage, see notes. Unreachable loaders must not be
+			// picked up by package loads either.
+			{for( INT i=UObject::GObjLoaders.Num()-1; i>=0; i-- )
+				if( (UObject::GObjLoaders(i)->ObjectFlags & (RF_Unreachable|RF_Native))==RF_Unreachable )
+					UObject::GObjLoaders.Remove( i );}
+			{for( INT i=0; i<Garbage.Num(); i++ )
+				Garbage(i)->SetLinker( NULL, INDEX_NONE );}
+			{for( INT i=0; i<Garbage.Num(); i++ )
+				Hide( Garbage(i) );}
+			Phase  = PHASE_Destroy;
+			Cursor = 0;
+		}
+		else
+		{
+			// Let Core destroy, delete and purge names.
+			for( INT i=0; i<Garbage.Num(); i++ )
+				Garbage(i)->ConditionalDestroy();
+			UObject::PurgeGarbage();
+			Garbage.Empty();
+		}
+#if DEUS_EX
+		UObject::GObjInGarbageCollection = 0;
+#endif
+		unguard;
+	}
+
+	// Continues a pending incremental collection. Returns whether one is still pending.
+	UBOOL Tick()
+	{
+		guard(FGarbageCollector::Tick);
+		if( Phase==PHASE_Idle )
+			return 0;
+#if DEUS_EX
+		UObject::GObjInGarbageCollection = 1;
+#endif
+		DOUBLE EndTime = appSeconds() + TimeBudget;
+		while( Phase!=PHASE_Idle )
+		{
+			if( Cursor<Garbage.Num() )
+			{
+				UObject* Object = Garbage( Cursor++ );
+				Show( Object );
+				if( Phase==PHASE_Destroy )
+				{
+					Object->ConditionalDestroy();
+					Hide( Object );
+				}
+				else delete Object;
+			}
+			else if( Phase==PHASE_Destroy )
+			{
+				Phase  = PHASE_Delete;
+				Cursor = 0;
+			}
+			else
+			{
+				debugf( NAME_Log, TEXT("Purged %i objects"), Garbage.Num() );
+				Phase = PHASE_Idle;
+				Garbage.Empty();
+			}
+			if( (Cursor&15)==0 && appSeconds()>=EndTime )
+				break;
+		}
+#if DEUS_EX
+		UObject::GObjInGarbageCollection = 0;
+#endif
+		return Phase!=PHASE_Idle;
+		unguard;
+	}
+
+	// Finishes a pending incremental collection.
+	void Flush()
+	{
+		guard(FGarbageCollector::Flush);
+		FLOAT SavedBudget = TimeBudget;
+		TimeBudget = 1000000.f;
+		while( Tick() );
+		TimeBudget = SavedBudget;
+		unguard;
+	}
+	UBOOL IsPending() const
+	{
+		return Phase!=PHASE_Idle;
+	}
+
+	// Exec.
+	UBOOL Exec( const TCHAR* Cmd, FOutputDevice& Ar )
+	{
+		guard(FGarbageCollector::Exec);
+		if( ParseCommand(&Cmd,TEXT("GC")) )
+		{
+			INT Value;
+			if( ParseCommand(&Cmd,TEXT("PARALLEL")) )
+			{
+				Parallel = appAtoi(Cmd)!=0;
+			}
+			else if( ParseCommand(&Cmd,TEXT("BUDGET")) )
+			{
+				Value = appAtoi(Cmd);
+				if( Value>0 )
+					TimeBudget = Value/1000.f;
+			}
+			else if( ParseCommand(&Cmd,TEXT("INCREMENTAL")) )
+			{
+				Collect( RF_Native | RF_Standalone, 1 );
+			}
+			else if( ParseCommand(&Cmd,TEXT("FULL")) )
+			{
+				Collect( RF_Native | RF_Standalone, 0 );
+			}
+			Ar.Logf( TEXT("GC: parallel %i, budget %.1f ms, last mark %.1f ms, last garbage %i objects, %s."), Parallel, TimeBudget*1000.f, LastMarkTime*1000.0, LastNumGarbage, IsPending() ? TEXT("pending") : TEXT("idle") );
+			return 1;
+		}
+		return 0;
+		unguard;
+	}
+
+	// Settings.
+	UBOOL Parallel;		// Mark on GThreadPool.
+	FLOAT TimeBudget;	// Seconds per Tick() in incremental mode.
+
+	// Clears RF_Unreachable, returns whether this call did.
+	static UBOOL ClearUnreachable( volatile DWORD& Flags )
+	{
+		for( ; ; )
+		{
+			DWORD Old = Flags;
+			if( !(Old & RF_Unreachable) )
+				return 0;
+			if( (DWORD)appInterlockedCompareExchange( (volatile INT*)&Flags, Old & ~RF_Unreachable, Old )==Old )
+				return 1;
+		}
+	}
+	static UBOOL ClearUnreachable( UObject* Object )
+	{
+		return ClearUnreachable( *(volatile DWORD*)&Object->ObjectFlags );
+	}
+
+private:
+	FGarbageCollector( const FGarbageCollector& );
+	void operator=( const FGarbageCollector& );
+
+	enum EPhase
+	{
+		PHASE_Idle,
+		PHASE_Destroy,
+		PHASE_Delete,
+	};
+
+	class FArchiveGCMark;
+	class FMarker;
+	friend class FArchiveGCMark;
+	friend class FMarker;
+
+	//
+	// Reference collector, one per marking thread. References are pushed on
+	// a small local stack which spills into the shared one when full.
+	//
+	// Parallel marking calls Serialize() on different objects at once, which
+	// is safe as long as Serialize() only reads for this archive:
+	// - It neither loads nor saves, is not transactional and its
+	//   Serialize( void*, INT ) is FArchive's empty one. So plain data is
+	//   never written, TLazyArray doesn't load and TTransArray doesn't
+	//   record, those only do so for loading, saving or transacting
+	//   archives.
+	// - The two operators below are the only ones with an effect. They never
+	//   write the reference itself, only the mark bit, through the compare
+	//   exchange in ClearUnreachable(). So each object is pushed, and
+	//   serialized, by exactly one thread.
+	// - The object and name tables don't change while marking, as nothing
+	//   is created, loaded or destroyed.
+	// Native Serialize() overrides are expected to follow the first point,
+	// as Core's and Engine's do. As those of other packages can't be vouched
+	// for here, parallel marking has to be enabled with GC PARALLEL 1.
+	//
+	class FArchiveGCMark : public FArchive
+	{
+	public:
+		FArchiveGCMark()
+		:	Collector( NULL )
+		,	LocalNum( 0 )
+		{}
+		FArchive& operator<<( UObject*& Object )
+		{
+			if( Object && (Object->GetFlags() & RF_Unreachable) && ClearUnreachable(Object) )
+			{
+				if( LocalNum==LOCAL_STACK_SIZE )
+					Collector->Spill( Local, LocalNum );
+				Local[LocalNum++] = Object;
+			}
+			return *this;
+		}
+		FArchive& operator<<( FName& Name )
+		{
+			if( Name.GetFlags() & RF_Unreachable )
+				ClearUnreachable( *(volatile DWORD*)&FName::GetEntry(Name.GetIndex())->Flags );
+			return *this;
+		}
+		FGarbageCollector*	Collector;
+		UObject*			Local[LOCAL_STACK_SIZE];
+		INT					LocalNum;
+	};
+
+	//
+	// Marking thread.
+	//
+	class FMarker : public FQueuedWork
+	{
+	public:
+		FGarbageCollector* Collector;
+		void DoThreadedWork()
+		{
+			FArchiveGCMark Ar;
+			Ar.Collector = Collector;
+			Collector->Drain( Ar );
+		}
+	};
+
+	void Mark( DWORD KeepFlags )
+	{
+		guard(FGarbageCollector::Mark);
+		DOUBLE StartTime = appSeconds();
+
+		// Tag everything.
+		INT i;
+		for( i=0; i<UObject::GObjObjects.Num(); i++ )
+			if( UObject::GObjObjects(i) )
+				UObject::GObjObjects(i)->ObjectFlags |= RF_Unreachable | RF_TagGarbage;
+		for( i=0; i<FName::GetMaxNames(); i++ )
+			if( FName::GetEntry(i) )
+				FName::GetEntry(i)->Flags |= RF_Unreachable;
+
+		// Every object gets pushed at most once, so the shared stack never
+		// has to grow while marking.
+		SharedStack = (UObject**)appMalloc( (UObject::GObjObjects.Num()+1)*sizeof(UObject*), TEXT("GCMarkStack") );
+		SharedNum   = 0;
+		NumActive   = 0;
+		Done        = 0;
+
+		// Untag the root set.
+		FArchiveGCMark RootAr;
+		RootAr.Collector = this;
+		UObject::SerializeRootSet( RootAr, KeepFlags, RF_TagGarbage );
+		while( RootAr.LocalNum>0 )
+			Spill( RootAr.Local, RootAr.LocalNum );
+
+		// Untag everything reachable.
+		INT NumMarkers = (Parallel && GThreadPool) ? Clamp( GThreadPool->GetNumThreads()+1, 1, (INT)MAX_MARKERS ) : 1;
+		FMarker Markers[MAX_MARKERS];
+		FQueuedWork* Work[MAX_MARKERS];
+		for( i=0; i<NumMarkers; i++ )
+		{
+			Markers[i].Collector = this;
+			Work[i]              = &Markers[i];
+		}
+		FQueuedWorkBatch( Work, NumMarkers ).Run();
+		check(SharedNum==0);
+
+		appFree( SharedStack );
+		SharedStack = NULL;
+		for( i=0; i<UObject::GObjObjects.Num(); i++ )
+			if( UObject::GObjObjects(i) )
+				UObject::GObjObjects(i)->ObjectFlags &= ~RF_TagGarbage;
+		LastMarkTime = appSeconds() - StartTime;
+		unguard;
+	}
+	void Spill( UObject** Local, INT& LocalNum )
+	{
+		// Moves half of a local stack (all of it if small) to the shared one.
+		INT Count = LocalNum>LOCAL_STACK_SIZE/2 ? LocalNum/2 : LocalNum;
+		FScopeLock ScopeLock( Lock );
+		checkSlow(SharedNum+Count<=UObject::GObjObjects.Num()+1);
+		appMemcpy( SharedStack+SharedNum, Local+LocalNum-Count, Count*sizeof(UObject*) );
+		SharedNum += Count;
+		LocalNum  -= Count;
+	}
+	UBOOL Steal( FArchiveGCMark& Ar )
+	{
+		FScopeLock ScopeLock( Lock );
+		INT Count = Min( SharedNum, (INT)LOCAL_STACK_SIZE/2 );
+		appMemcpy( Ar.Local, SharedStack+SharedNum-Count, Count*sizeof(UObject*) );
+		SharedNum  -= Count;
+		Ar.LocalNum = Count;
+		return Count>0;
+	}
+	void Drain( FArchiveGCMark& Ar )
+	{
+		// Join, unless marking is already over.
+		Lock.Lock();
+		if( Done )
+		{
+			Lock.Unlock();
+			return;
+		}
+		NumActive++;
+		Lock.Unlock();
+
+		for( ; ; )
+		{
+			// Serialize objects until out of work.
+			while( Ar.LocalNum>0 || Steal(Ar) )
+			{
+				UObject* Object = Ar.Local[--Ar.LocalNum];
+				Object->Serialize( Ar );
+			}
+
+			// Go idle. The last one to do so with no shared work left is done.
+			Lock.Lock();
+			if( --NumActive==0 && SharedNum==0 )
+				Done = 1;
+			Lock.Unlock();
+			for( INT Spins=0; !Done && SharedNum==0; Spins++ )
+			{
+				if( Spins<64 )
+					appPause();
+				else
+					appSleep( 0.f );
+			}
+			Lock.Lock();
+			if( Done )
+			{
+				Lock.Unlock();
+				return;
+			}
+			NumActive++;
+			Lock.Unlock();
+		}
+	}
+	// Takes pending garbage out of the hash and the object table, see notes.
+	// Its index is not made available, so it stays reserved.
+	static void Hide( UObject* Object )
+	{
+		Object->UnhashObject( Object->Outer ? Object->Outer->GetIndex() : 0 );
+		UObject::GObjObjects(Object->GetIndex()) = NULL;
+	}
+	static void Show( UObject* Object )
+	{
+		checkSlow(UObject::GObjObjects(Object->GetIndex())==NULL);
+		UObject::GObjObjects(Object->GetIndex()) = Object;
+		Object->HashObject();
+	}
+
+	// Incremental state.
+	TArray<UObject*>	Garbage;
+	INT				Cursor;
+	EPhase			Phase;
+
+	// Marking state.
+	FSpinLock		Lock;
+	UObject**		SharedStack;
+	volatile INT	SharedNum;
+	INT				NumActive;
+	volatile INT	Done;
+
+	// Stats.
+	DOUBLE			LastMarkTime;
+	INT				LastNumGarbage;
+};
+
+// Global garbage collector.
+extern COREI_API FGarbageCollector GGarbageCollector;
+
+/*-----------------------------------------------------------------------------
+	FGarbageSentinel.
+-----------------------------------------------------------------------------*/
+
+//
+// Tells whether garbage was collected since Reset(), by either collector.
+// Keeps an unreferenced transient object, which any collection destroys,
+// and checks that its index still holds the very same object.
+//
+class FGarbageSentinel
+{
+public:
+	// Constructors.
+	FGarbageSentinel()
+	:	Object( NULL )
+	,	Index( INDEX_NONE )
+	,	Name( NAME_None )
+	{}
+
+	// FGarbageSentinel interface.
+	void Reset()
+	{
+		guard(FGarbageSentinel::Reset);
+		Object = UObject::StaticConstructObject( UObject::StaticClass(), UObject::GetTransientPackage(), NAME_None, RF_Transient );
+		Index  = Object->GetIndex();
+		Name   = Object->GetFName();
+		unguard;
+	}
+	void Clear()
+	{
+		Object = NULL;
+		Index  = INDEX_NONE;
+		Name   = NAME_None;
+	}
+	UBOOL IsAlive()
+	{
+		return Object && UObject::GetIndexedObject(Index)==Object && Object->GetFName()==Name;
+	}
+
+private:
+	UObject*	Object;
+	INT			Index;
+	FName		Name;
+};
+
+/*-----------------------------------------------------------------------------
+	The End.
+-----------------------------------------------------------------------------*/
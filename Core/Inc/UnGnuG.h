@@ -274,6 +274,48 @@ inline void appMemzero( void* Dest, INT Count )
 	memset( Dest, 0, Count );
 }
 
+/*----------------------------------------------------------------------------
+	Atomic operations.
+----------------------------------------------------------------------------*/
+
+#define DEFINED_appInterlocked 1
+inline INT appInterlockedIncrement( volatile INT* Addend )
+{
+	return __sync_add_and_fetch( Addend, 1 );
+}
+inline INT appInterlockedDecrement( volatile INT* Addend )
+{
+	return __sync_sub_and_fetch( Addend, 1 );
+}
+inline INT appInterlockedAdd( volatile INT* Addend, INT Value )
+{
+	return __sync_fetch_and_add( Addend, Value );
+}
+inline INT appInterlockedExchange( volatile INT* Target, INT Value )
+{
+	return __sync_lock_test_and_set( Target, Value );
+}
+inline INT appInterlockedCompareExchange( volatile INT* Dest, INT Exchange, INT Comparand )
+{
+	return __sync_val_compare_and_swap( Dest, Comparand, Exchange );
+}
+inline SQWORD appInterlockedCompareExchange64( volatile SQWORD* Dest, SQWORD Exchange, SQWORD Comparand )
+{
+	return __sync_val_compare_and_swap( Dest, Comparand, Exchange );
+}
+inline void* appInterlockedCompareExchangePointer( void* volatile* Dest, void* Exchange, void* Comparand )
+{
+	return __sync_val_compare_and_swap( Dest, Comparand, Exchange );
+}
+inline void appMemoryBarrier()
+{
+	__sync_synchronize();
+}
+inline void appPause()
+{
+	asm volatile("pause");
+}
+
 /*----------------------------------------------------------------------------
 	Globals.
 ----------------------------------------------------------------------------*/
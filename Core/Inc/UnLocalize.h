@@ -0,0 +1,337 @@
+/*=============================================================================
+	UnLocalize.h: Interned localized text.
+	Copyright 2016-2019 Sebastian Kaufel, Inc. All Rights Reserved.
+
+	Notes:
+	* Localize() goes through the config cache on every call and returns
+	  its result in a rotating static buffer. FLocalizeCache keeps a table
+	  for each language, which maps (package, section, key) to an interned
+	  string with a single hash lookup. The pointers returned stay valid
+	  until exit, so callers may hold on to them.
+	* A package's language file is read into the table in one go when it
+	  is first used. Anything not in there is resolved through Localize()
+	  once, which takes care of falling back to .int and of the <?..?>
+	  placeholders, and is remembered as well.
+	* The current language is compared against UObject::GetLanguage() on
+	  each lookup, so switching with UObject::SetLanguage() selects (or
+	  builds) the matching table. Tables of other languages are kept.
+	* Use "LOCALIZECACHE [FLUSH]" to reload the tables and report stats.
+	  Flushed tables are retired but not freed, strings handed out before
+	  stay valid.
+	* Game thread only.
+=============================================================================*/
+
+/*-----------------------------------------------------------------------------
+	FLocalizeTable.
+-----------------------------------------------------------------------------*/
+
+//
+// Localized text of a single language.
+//
+class FLocalizeTable
+{
+public:
+	// Kinds of entries.
+	enum EEntryKind
+	{
+		ENTRY_Found,	// Value found, for optional and required lookups.
+		ENTRY_Optional,	// Not found, result of an optional lookup.
+		ENTRY_Required,	// Not found, result of a required lookup.
+	};
+
+	// Variables.
+	FString Language;
+	INT     NumMisses;
+
+	// Constructor.
+	FLocalizeTable( const TCHAR* InLanguage )
+	:	Language( InLanguage )
+	,	NumMisses( 0 )
+	{
+		guard(FLocalizeTable::FLocalizeTable);
+		Hash.Add( 64 );
+		for( INT i=0; i<Hash.Num(); i++ )
+			Hash(i) = INDEX_NONE;
+		unguard;
+	}
+
+	// FLocalizeTable interface.
+	const TCHAR* Find( const TCHAR* Section, const TCHAR* Key, const TCHAR* Package, UBOOL Optional )
+	{
+		guardSlow(FLocalizeTable::Find);
+		DWORD KeyHash = GetKeyHash( Section, Key, Package );
+		INT   Kind    = Optional ? ENTRY_Optional : ENTRY_Required;
+		INT   iEntry  = FindEntry( KeyHash, Section, Key, Package, Kind );
+		if( iEntry==INDEX_NONE && !IsPreloaded(Package) )
+		{
+			Preload( Package );
+			iEntry = FindEntry( KeyHash, Section, Key, Package, Kind );
+		}
+		if( iEntry==INDEX_NONE )
+		{
+			// Not in the language file, Localize() falls back to .int.
+			NumMisses++;
+			const TCHAR* Result = ::Localize( Section, Key, Package, *Language, 1 );
+			if( *Result )
+				Kind = ENTRY_Found;
+			else if( !Optional )
+				Result = ::Localize( Section, Key, Package, *Language, 0 );
+			iEntry = AddEntry( KeyHash, Section, Key, Package, Result, Kind );
+		}
+		return *Entries(iEntry).Value;
+		unguardSlow;
+	}
+	INT NumEntries() const
+	{
+		return Entries.Num();
+	}
+	INT NumPackages() const
+	{
+		return Packages.Num();
+	}
+
+private:
+	// An interned string.
+	struct FEntry
+	{
+		DWORD	KeyHash;
+		INT		HashNext;
+		INT		Kind;
+		FString	Section;
+		FString	Key;
+		FString	Package;
+		FString	Value;
+	};
+
+	// Variables.
+	TArray<FEntry>	Entries;
+	TArray<INT>		Hash;
+	TArray<FString>	Packages;
+
+	// Implementation.
+	static DWORD GetKeyHash( const TCHAR* Section, const TCHAR* Key, const TCHAR* Package )
+	{
+		return (appStrihash(Key)*31 + appStrihash(Section))*31 + appStrihash(Package);
+	}
+	INT FindEntry( DWORD KeyHash, const TCHAR* Section, const TCHAR* Key, const TCHAR* Package, INT Kind )
+	{
+		guardSlow(FLocalizeTable::FindEntry);
+		for( INT i=Hash(KeyHash & (Hash.Num()-1)); i!=INDEX_NONE; i=Entries(i).HashNext )
+		{
+			FEntry& Entry = Entries(i);
+			if
+			(	Entry.KeyHash==KeyHash
+			&&	(Entry.Kind==ENTRY_Found || Entry.Kind==Kind)
+			&&	appStricmp(*Entry.Key,Key)==0
+			&&	appStricmp(*Entry.Section,Section)==0
+			&&	appStricmp(*Entry.Package,Package)==0 )
+				return i;
+		}
+		return INDEX_NONE;
+		unguardSlow;
+	}
+	INT AddEntry( DWORD KeyHash, const TCHAR* Section, const TCHAR* Key, const TCHAR* Package, const TCHAR* Value, INT Kind )
+	{
+		guardSlow(FLocalizeTable::AddEntry);
+		if( Entries.Num()>=Hash.Num() )
+		{
+			// Keep at most one entry per bucket on average.
+			INT NumBuckets = Hash.Num()*2;
+			Hash.Empty( NumBuckets );
+			Hash.Add( NumBuckets );
+			{for( INT i=0; i<Hash.Num(); i++ )
+				Hash(i) = INDEX_NONE;}
+			{for( INT i=0; i<Entries.Num(); i++ )
+			{
+				INT iHash           = Entries(i).KeyHash & (Hash.Num()-1);
+				Entries(i).HashNext = Hash(iHash);
+				Hash(iHash)         = i;
+			}}
+		}
+		INT     iEntry = Entries.Num();
+		FEntry* Entry  = new(Entries)FEntry;
+		INT     iHash  = KeyHash & (Hash.Num()-1);
+		Entry->KeyHash  = KeyHash;
+		Entry->HashNext = Hash(iHash);
+		Entry->Kind     = Kind;
+		Entry->Section  = Section;
+		Entry->Key      = Key;
+		Entry->Package  = Package;
+		Entry->Value    = Value;
+		Hash(iHash)     = iEntry;
+		return iEntry;
+		unguardSlow;
+	}
+	UBOOL IsPreloaded( const TCHAR* Package ) const
+	{
+		for( INT i=0; i<Packages.Num(); i++ )
+			if( appStricmp(*Packages(i),Package)==0 )
+				return 1;
+		return 0;
+	}
+	void Preload( const TCHAR* Package )
+	{
+		guard(FLocalizeTable::Preload);
+		new(Packages)FString( Package );
+
+		// Same file Localize() reads.
+		TCHAR Filename[256];
+		appSprintf( Filename, TEXT("%s") PATH_SEPARATOR TEXT("%s.%s"), appBaseDir(), Package, *Language );
+		FString Text;
+		if( !appLoadFileToString(Text,Filename) || !Text.Len() )
+			return;
+
+		// Parse it like the config cache does.
+		TCHAR* Ptr     = (TCHAR*)*Text;
+		TCHAR* Section = NULL;
+		UBOOL  Done    = 0;
+		while( !Done )
+		{
+			while( *Ptr=='\r' || *Ptr=='\n' )
+				Ptr++;
+			TCHAR* Start = Ptr;
+			while( *Ptr && *Ptr!='\r' && *Ptr!='\n' )
+				Ptr++;
+			if( *Ptr==0 )
+				Done = 1;
+			*Ptr++ = 0;
+			if( *Start=='[' && Start[appStrlen(Start)-1]==']' )
+			{
+				Start++;
+				Start[appStrlen(Start)-1] = 0;
+				Section = Start;
+			}
+			else if( Section && *Start )
+			{
+				TCHAR* Value = appStrstr( Start, TEXT("=") );
+				if( Value )
+				{
+					*Value++ = 0;
+					if( *Value=='\"' && Value[appStrlen(Value)-1]=='\"' )
+					{
+						Value++;
+						Value[appStrlen(Value)-1] = 0;
+					}
+
+					// Later duplicates win, as they do in the config cache.
+					DWORD KeyHash = GetKeyHash( Section, Start, Package );
+					INT   iEntry  = FindEntry( KeyHash, Section, Start, Package, ENTRY_Found );
+					if( iEntry!=INDEX_NONE )
+						Entries(iEntry).Value = Value;
+					else
+						AddEntry( KeyHash, Section, Start, Package, Value, ENTRY_Found );
+				}
+			}
+		}
+		unguard;
+	}
+};
+
+/*-----------------------------------------------------------------------------
+	FLocalizeCache.
+-----------------------------------------------------------------------------*/
+
+//
+// Interned Localize() results for each language.
+//
+class FLocalizeCache : public FExec
+{
+public:
+	// Constructors.
+	FLocalizeCache()
+	:	Current( NULL )
+	,	NumLookups( 0 )
+	{}
+	~FLocalizeCache()
+	{
+		Flush();
+		for( INT i=0; i<Retired.Num(); i++ )
+			delete Retired(i);
+		Retired.Empty();
+	}
+
+	// FLocalizeCache interface.
+	const TCHAR* Localize( const TCHAR* Section, const TCHAR* Key, const TCHAR* Package=GPackage, const TCHAR* LangExt=NULL, UBOOL Optional=0 )
+	{
+		guardSlow(FLocalizeCache::Localize);
+		if( !Section || !Key || !Package )
+			return TEXT("");
+		NumLookups++;
+		return GetTable( LangExt ? LangExt : UObject::GetLanguage() )->Find( Section, Key, Package, Optional );
+		unguardSlow;
+	}
+	const TCHAR* LocalizeError( const TCHAR* Key, const TCHAR* Package=GPackage, const TCHAR* LangExt=NULL )
+	{
+		return Localize( TEXT("Errors"), Key, Package, LangExt );
+	}
+	const TCHAR* LocalizeProgress( const TCHAR* Key, const TCHAR* Package=GPackage, const TCHAR* LangExt=NULL )
+	{
+		return Localize( TEXT("Progress"), Key, Package, LangExt );
+	}
+	const TCHAR* LocalizeQuery( const TCHAR* Key, const TCHAR* Package=GPackage, const TCHAR* LangExt=NULL )
+	{
+		return Localize( TEXT("Query"), Key, Package, LangExt );
+	}
+	const TCHAR* LocalizeGeneral( const TCHAR* Key, const TCHAR* Package=GPackage, const TCHAR* LangExt=NULL )
+	{
+		return Localize( TEXT("General"), Key, Package, LangExt );
+	}
+	void Flush()
+	{
+		guard(FLocalizeCache::Flush);
+		for( INT i=0; i<Tables.Num(); i++ )
+			Retired.AddItem( Tables(i) );
+		Tables.Empty();
+		Current = NULL;
+		unguard;
+	}
+
+	// FExec interface.
+	UBOOL Exec( const TCHAR* Cmd, FOutputDevice& Ar )
+	{
+		guard(FLocalizeCache::Exec);
+		if( ParseCommand(&Cmd,TEXT("LOCALIZECACHE")) )
+		{
+			if( ParseCommand(&Cmd,TEXT("FLUSH")) )
+				Flush();
+			Ar.Logf( TEXT("Localize cache: %i tables, %i retired, %.0f lookups."), Tables.Num(), Retired.Num(), NumLookups );
+			for( INT i=0; i<Tables.Num(); i++ )
+				Ar.Logf( TEXT("   %s: %i packages, %i strings, %i misses."), *Tables(i)->Language, Tables(i)->NumPackages(), Tables(i)->NumEntries(), Tables(i)->NumMisses );
+			return 1;
+		}
+		return 0;
+		unguard;
+	}
+
+private:
+	FLocalizeCache( const FLocalizeCache& );
+	void operator=( const FLocalizeCache& );
+
+	// Variables.
+	TArray<FLocalizeTable*>	Tables;
+	TArray<FLocalizeTable*>	Retired;
+	FLocalizeTable*			Current;
+	DOUBLE					NumLookups;
+
+	// Implementation.
+	FLocalizeTable* GetTable( const TCHAR* Language )
+	{
+		guardSlow(FLocalizeCache::GetTable);
+		if( Current && appStricmp(*Current->Language,Language)==0 )
+			return Current;
+		for( INT i=0; i<Tables.Num(); i++ )
+			if( appStricmp(*Tables(i)->Language,Language)==0 )
+				return Current = Tables(i);
+		Current = new FLocalizeTable( Language );
+		Tables.AddItem( Current );
+		return Current;
+		unguardSlow;
+	}
+};
+
+// Global localize cache.
+extern COREI_API FLocalizeCache GLocalizeCache;
+
+/*-----------------------------------------------------------------------------
+	The End.
+-----------------------------------------------------------------------------*/
@@ -0,0 +1,568 @@
+/*=============================================================================
+	UnMathBatch.h: Batched vector math.
+	Copyright 2016-2019 Sebastian Kaufel, Inc. All Rights Reserved.
+
+	Notes:
+	* FBatchMath runs the same operation over arrays of vectors, planes,
+	  spheres and boxes: transforming points by an FCoords, plane dot
+	  products, frustum tests and normalizing. Each has a scalar version,
+	  which is the reference, and SSE2 and AVX2 versions written with
+	  compiler intrinsics, which take 4 or 8 elements at a time.
+	* The fastest version the CPU and OS support is picked on first use.
+	  SetLevel() can force a lower one, e.g. for benchmarking. Operations
+	  without an AVX2 version use SSE2 at that level.
+	* Intrinsics need MSVC 2005 (SSE2), MSVC 2012 (AVX2) or GCC 5, other
+	  compilers only get the scalar versions. No build flags are needed,
+	  GCC compiles the kernels for their target through attributes.
+	* Results match the scalar versions up to rounding. Inputs need no
+	  alignment and may overlap outputs exactly (In==Out).
+	* Frustum planes face outwards: a sphere or box is culled once it is
+	  entirely in front of any plane.
+	* Thread safe, apart from SetLevel().
+=============================================================================*/
+
+/*-----------------------------------------------------------------------------
+	Compiler support.
+-----------------------------------------------------------------------------*/
+
+#if defined(__GNUC__) && __GNUC__>=5 && (defined(__i386__) || defined(__x86_64__))
+	#define BATCHMATH_HAS_SSE2		1
+	#define BATCHMATH_HAS_AVX2		1
+	#define BATCHMATH_TARGET_SSE2	__attribute__((target("sse2")))
+	#define BATCHMATH_TARGET_AVX2	__attribute__((target("avx2")))
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	#define BATCHMATH_HAS_SSE2		(_MSC_VER>=1400)
+	#define BATCHMATH_HAS_AVX2		(_MSC_VER>=1700)
+	#define BATCHMATH_TARGET_SSE2
+	#define BATCHMATH_TARGET_AVX2
+#else
+	#define BATCHMATH_HAS_SSE2		0
+	#define BATCHMATH_HAS_AVX2		0
+#endif
+
+#if BATCHMATH_HAS_SSE2
+	#include <emmintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#endif
+#endif
+#if BATCHMATH_HAS_AVX2
+	#include <immintrin.h>
+#endif
+
+//
+// Shuffles 4 packed FVectors (A,B,C) into their components (X,Y,Z) and
+// back. Work the same on each 128 bit lane of AVX registers.
+//
+#define BATCHMATH_DEINTERLEAVE3(SHUFFLE,A,B,C,X,Y,Z) \
+	{ \
+		T T0 = SHUFFLE( B, C, _MM_SHUFFLE(2,1,3,2) ); \
+		T T1 = SHUFFLE( A, B, _MM_SHUFFLE(1,0,2,1) ); \
+		X    = SHUFFLE( A,  T0, _MM_SHUFFLE(2,0,3,0) ); \
+		Y    = SHUFFLE( T1, T0, _MM_SHUFFLE(3,1,2,0) ); \
+		Z    = SHUFFLE( T1, C,  _MM_SHUFFLE(3,0,3,1) ); \
+	}
+#define BATCHMATH_INTERLEAVE3(SHUFFLE,UNPACKLO,UNPACKHI,X,Y,Z,A,B,C) \
+	{ \
+		T XY01 = UNPACKLO( X, Y ); \
+		T XY23 = UNPACKHI( X, Y ); \
+		T T0   = SHUFFLE( Z, X, _MM_SHUFFLE(1,1,0,0) ); \
+		T T1   = SHUFFLE( Y, Z, _MM_SHUFFLE(1,1,1,1) ); \
+		T T2   = SHUFFLE( Z, XY23, _MM_SHUFFLE(3,2,3,2) ); \
+		A      = SHUFFLE( XY01, T0, _MM_SHUFFLE(2,0,1,0) ); \
+		B      = SHUFFLE( T1, XY23, _MM_SHUFFLE(1,0,2,0) ); \
+		C      = SHUFFLE( T2, T2, _MM_SHUFFLE(1,3,2,0) ); \
+	}
+
+//
+// Transposes 4 packed FPlanes (R0..R3) into their components (X,Y,Z,W).
+//
+#define BATCHMATH_TRANSPOSE4(SHUFFLE,UNPACKLO,UNPACKHI,R0,R1,R2,R3,X,Y,Z,W) \
+	{ \
+		T T0 = UNPACKLO( R0, R1 ); \
+		T T1 = UNPACKLO( R2, R3 ); \
+		T T2 = UNPACKHI( R0, R1 ); \
+		T T3 = UNPACKHI( R2, R3 ); \
+		X    = SHUFFLE( T0, T1, _MM_SHUFFLE(1,0,1,0) ); \
+		Y    = SHUFFLE( T0, T1, _MM_SHUFFLE(3,2,3,2) ); \
+		Z    = SHUFFLE( T2, T3, _MM_SHUFFLE(1,0,1,0) ); \
+		W    = SHUFFLE( T2, T3, _MM_SHUFFLE(3,2,3,2) ); \
+	}
+
+// Loads two unaligned 128 bit halves into an AVX register.
+#define BATCHMATH_LOADU2(Lo,Hi) \
+	_mm256_insertf128_ps( _mm256_castps128_ps256(_mm_loadu_ps(Lo)), _mm_loadu_ps(Hi), 1 )
+
+/*-----------------------------------------------------------------------------
+	FBatchMath.
+-----------------------------------------------------------------------------*/
+
+// Instruction sets used by FBatchMath.
+enum EBatchMathLevel
+{
+	BATCH_Scalar,
+	BATCH_SSE2,
+	BATCH_AVX2,
+	BATCH_MAX,
+};
+
+//
+// Batched vector math, see notes above.
+//
+class FBatchMath
+{
+public:
+	// Out[i] = In[i].TransformPointBy( Coords ).
+	static void TransformPoints( const FCoords& Coords, const FVector* In, FVector* Out, INT Num )
+	{
+		GetKernels().TransformPoints( Coords, In, Out, Num );
+	}
+	// Out[i] = Plane.PlaneDot( Points[i] ).
+	static void PointPlaneDots( const FPlane& Plane, const FVector* Points, FLOAT* Out, INT Num )
+	{
+		GetKernels().PointPlaneDots( Plane, Points, Out, Num );
+	}
+	// Out[i] = Planes[i].PlaneDot( Point ).
+	static void PlanePointDots( const FPlane* Planes, const FVector& Point, FLOAT* Out, INT Num )
+	{
+		GetKernels().PlanePointDots( Planes, Point, Out, Num );
+	}
+	// Visible[i] = whether Spheres[i] (W is the radius) isn't entirely in front of any of the planes.
+	static void SpheresInFrustum( const FPlane* Planes, INT NumPlanes, const FSphere* Spheres, BYTE* Visible, INT Num )
+	{
+		GetKernels().SpheresInFrustum( Planes, NumPlanes, Spheres, Visible, Num );
+	}
+	// Visible[i] = whether Boxes[i] is valid and isn't entirely in front of any of the planes.
+	static void BoxesInFrustum( const FPlane* Planes, INT NumPlanes, const FBox* Boxes, BYTE* Visible, INT Num )
+	{
+		GetKernels().BoxesInFrustum( Planes, NumPlanes, Boxes, Visible, Num );
+	}
+	// V[i].Normalize().
+	static void NormalizeMany( FVector* V, INT Num )
+	{
+		GetKernels().NormalizeMany( V, Num );
+	}
+
+	// Levels.
+	static INT GetLevel()
+	{
+		return GetKernels().Level;
+	}
+	static INT GetSupportedLevel()
+	{
+		// Racing threads detect the same level, either store is fine.
+		static volatile INT Supported = INDEX_NONE;
+		if( Supported==INDEX_NONE )
+			appInterlockedExchange( &Supported, DetectLevel() );
+		return Supported;
+	}
+	static INT SetLevel( INT Level )
+	{
+		guard(FBatchMath::SetLevel);
+		Select( GetKernels(), Clamp<INT>(Level,BATCH_Scalar,GetSupportedLevel()) );
+		return GetLevel();
+		unguard;
+	}
+	static const TCHAR* GetLevelName( INT Level )
+	{
+		switch( Level )
+		{
+			case BATCH_Scalar:	return TEXT("Scalar");
+			case BATCH_SSE2:	return TEXT("SSE2");
+			case BATCH_AVX2:	return TEXT("AVX2");
+			default:			return TEXT("Unknown");
+		}
+	}
+
+	// Scalar versions.
+	static void ScalarTransformPoints( const FCoords& Coords, const FVector* In, FVector* Out, INT Num )
+	{
+		for( INT i=0; i<Num; i++ )
+			Out[i] = In[i].TransformPointBy( Coords );
+	}
+	static void ScalarPointPlaneDots( const FPlane& Plane, const FVector* Points, FLOAT* Out, INT Num )
+	{
+		for( INT i=0; i<Num; i++ )
+			Out[i] = Plane.PlaneDot( Points[i] );
+	}
+	static void ScalarPlanePointDots( const FPlane* Planes, const FVector& Point, FLOAT* Out, INT Num )
+	{
+		for( INT i=0; i<Num; i++ )
+			Out[i] = Planes[i].PlaneDot( Point );
+	}
+	static void ScalarSpheresInFrustum( const FPlane* Planes, INT NumPlanes, const FSphere* Spheres, BYTE* Visible, INT Num )
+	{
+		for( INT i=0; i<Num; i++ )
+		{
+			Visible[i] = 1;
+			for( INT j=0; j<NumPlanes && Visible[i]; j++ )
+				if( Planes[j].PlaneDot(Spheres[i]) > Spheres[i].W )
+					Visible[i] = 0;
+		}
+	}
+	static void ScalarBoxesInFrustum( const FPlane* Planes, INT NumPlanes, const FBox* Boxes, BYTE* Visible, INT Num )
+	{
+		for( INT i=0; i<Num; i++ )
+		{
+			const FBox& Box = Boxes[i];
+			FVector Center  = (Box.Min+Box.Max)*0.5f;
+			FVector Extent  = (Box.Max-Box.Min)*0.5f;
+			Visible[i] = Box.IsValid!=0;
+			for( INT j=0; j<NumPlanes && Visible[i]; j++ )
+			{
+				const FPlane& Plane = Planes[j];
+				FLOAT Push = Extent.X*Abs(Plane.X) + Extent.Y*Abs(Plane.Y) + Extent.Z*Abs(Plane.Z);
+				if( Plane.PlaneDot(Center) > Push )
+					Visible[i] = 0;
+			}
+		}
+	}
+	static void ScalarNormalizeMany( FVector* V, INT Num )
+	{
+		for( INT i=0; i<Num; i++ )
+			V[i].Normalize();
+	}
+
+private:
+	// Kernels of a level.
+	struct FKernels
+	{
+		INT Level;
+		void (*TransformPoints)( const FCoords& Coords, const FVector* In, FVector* Out, INT Num );
+		void (*PointPlaneDots)( const FPlane& Plane, const FVector* Points, FLOAT* Out, INT Num );
+		void (*PlanePointDots)( const FPlane* Planes, const FVector& Point, FLOAT* Out, INT Num );
+		void (*SpheresInFrustum)( const FPlane* Planes, INT NumPlanes, const FSphere* Spheres, BYTE* Visible, INT Num );
+		void (*BoxesInFrustum)( const FPlane* Planes, INT NumPlanes, const FBox* Boxes, BYTE* Visible, INT Num );
+		void (*NormalizeMany)( FVector* V, INT Num );
+	};
+
+	// Dispatch.
+	static FKernels& GetKernels()
+	{
+		static FKernels     Kernels;
+		static volatile INT State = KERNELS_Empty;
+		if( State!=KERNELS_Ready )
+			InitKernels( Kernels, State );
+		return Kernels;
+	}
+	// Fills the table on first use. The thread which claims it fills it
+	// and publishes it with an interlocked store, others wait for that.
+	enum {KERNELS_Empty=0, KERNELS_Filling=1, KERNELS_Ready=2};
+	static void InitKernels( FKernels& Kernels, volatile INT& State )
+	{
+		guard(FBatchMath::InitKernels);
+		if( appInterlockedCompareExchange( &State, KERNELS_Filling, KERNELS_Empty )==KERNELS_Empty )
+		{
+			Select( Kernels, GetSupportedLevel() );
+			appInterlockedExchange( &State, KERNELS_Ready );
+		}
+		else for( INT Spins=0; State!=KERNELS_Ready; Spins++ )
+		{
+			if( Spins<64 )
+				appPause();
+			else
+				appSleep( 0.f );
+		}
+		unguard;
+	}
+	static void Select( FKernels& Kernels, INT Level )
+	{
+		Kernels.Level            = BATCH_Scalar;
+		Kernels.TransformPoints  = ScalarTransformPoints;
+		Kernels.PointPlaneDots   = ScalarPointPlaneDots;
+		Kernels.PlanePointDots   = ScalarPlanePointDots;
+		Kernels.SpheresInFrustum = ScalarSpheresInFrustum;
+		Kernels.BoxesInFrustum   = ScalarBoxesInFrustum;
+		Kernels.NormalizeMany    = ScalarNormalizeMany;
+#if BATCHMATH_HAS_SSE2
+		if( Level>=BATCH_SSE2 )
+		{
+			Kernels.Level            = BATCH_SSE2;
+			Kernels.TransformPoints  = SSE2TransformPoints;
+			Kernels.PointPlaneDots   = SSE2PointPlaneDots;
+			Kernels.PlanePointDots   = SSE2PlanePointDots;
+			Kernels.SpheresInFrustum = SSE2SpheresInFrustum;
+			Kernels.BoxesInFrustum   = SSE2BoxesInFrustum;
+			Kernels.NormalizeMany    = SSE2NormalizeMany;
+		}
+#endif
+#if BATCHMATH_HAS_AVX2
+		if( Level>=BATCH_AVX2 )
+		{
+			Kernels.Level            = BATCH_AVX2;
+			Kernels.TransformPoints  = AVX2TransformPoints;
+			Kernels.PointPlaneDots   = AVX2PointPlaneDots;
+			Kernels.SpheresInFrustum = AVX2SpheresInFrustum;
+			Kernels.NormalizeMany    = AVX2NormalizeMany;
+		}
+#endif
+	}
+	static INT DetectLevel()
+	{
+#if BATCHMATH_HAS_SSE2 && defined(__GNUC__)
+		__builtin_cpu_init();
+		if( __builtin_cpu_supports("avx2") )
+			return BATCH_AVX2;
+		if( __builtin_cpu_supports("sse2") )
+			return BATCH_SSE2;
+#elif BATCHMATH_HAS_SSE2
+		int Info[4];
+		__cpuid( Info, 0 );
+		INT MaxLeaf = Info[0];
+		__cpuid( Info, 1 );
+		UBOOL SSE2 = (Info[3] & (1<<26))!=0;
+	#if BATCHMATH_HAS_AVX2
+		// AVX needs the OS to save the YMM registers.
+		if( MaxLeaf>=7 && (Info[2] & (1<<27)) && (Info[2] & (1<<28)) && (_xgetbv(0) & 6)==6 )
+		{
+			__cpuidex( Info, 7, 0 );
+			if( Info[1] & (1<<5) )
+				return BATCH_AVX2;
+		}
+	#endif
+		if( SSE2 )
+			return BATCH_SSE2;
+#endif
+		return BATCH_Scalar;
+	}
+
+#if BATCHMATH_HAS_SSE2
+	// SSE2 versions.
+	BATCHMATH_TARGET_SSE2 static void SSE2TransformPoints( const FCoords& Coords, const FVector* In, FVector* Out, INT Num )
+	{
+		typedef __m128 T;
+		const T Ox=_mm_set1_ps(Coords.Origin.X), Oy=_mm_set1_ps(Coords.Origin.Y), Oz=_mm_set1_ps(Coords.Origin.Z);
+		const T Xx=_mm_set1_ps(Coords.XAxis.X),  Xy=_mm_set1_ps(Coords.XAxis.Y),  Xz=_mm_set1_ps(Coords.XAxis.Z);
+		const T Yx=_mm_set1_ps(Coords.YAxis.X),  Yy=_mm_set1_ps(Coords.YAxis.Y),  Yz=_mm_set1_ps(Coords.YAxis.Z);
+		const T Zx=_mm_set1_ps(Coords.ZAxis.X),  Zy=_mm_set1_ps(Coords.ZAxis.Y),  Zz=_mm_set1_ps(Coords.ZAxis.Z);
+		INT i=0;
+		for( ; i+4<=Num; i+=4 )
+		{
+			const FLOAT* Src  = &In[i].X;
+			FLOAT*       Dest = &Out[i].X;
+			T A=_mm_loadu_ps(Src), B=_mm_loadu_ps(Src+4), C=_mm_loadu_ps(Src+8), X, Y, Z;
+			BATCHMATH_DEINTERLEAVE3( _mm_shuffle_ps, A, B, C, X, Y, Z );
+			X = _mm_sub_ps( X, Ox );
+			Y = _mm_sub_ps( Y, Oy );
+			Z = _mm_sub_ps( Z, Oz );
+			T RX = _mm_add_ps( _mm_add_ps(_mm_mul_ps(X,Xx),_mm_mul_ps(Y,Xy)), _mm_mul_ps(Z,Xz) );
+			T RY = _mm_add_ps( _mm_add_ps(_mm_mul_ps(X,Yx),_mm_mul_ps(Y,Yy)), _mm_mul_ps(Z,Yz) );
+			T RZ = _mm_add_ps( _mm_add_ps(_mm_mul_ps(X,Zx),_mm_mul_ps(Y,Zy)), _mm_mul_ps(Z,Zz) );
+			BATCHMATH_INTERLEAVE3( _mm_shuffle_ps, _mm_unpacklo_ps, _mm_unpackhi_ps, RX, RY, RZ, A, B, C );
+			_mm_storeu_ps( Dest,   A );
+			_mm_storeu_ps( Dest+4, B );
+			_mm_storeu_ps( Dest+8, C );
+		}
+		ScalarTransformPoints( Coords, In+i, Out+i, Num-i );
+	}
+	BATCHMATH_TARGET_SSE2 static void SSE2PointPlaneDots( const FPlane& Plane, const FVector* Points, FLOAT* Out, INT Num )
+	{
+		typedef __m128 T;
+		const T Nx=_mm_set1_ps(Plane.X), Ny=_mm_set1_ps(Plane.Y), Nz=_mm_set1_ps(Plane.Z), Nw=_mm_set1_ps(Plane.W);
+		INT i=0;
+		for( ; i+4<=Num; i+=4 )
+		{
+			const FLOAT* Src = &Points[i].X;
+			T A=_mm_loadu_ps(Src), B=_mm_loadu_ps(Src+4), C=_mm_loadu_ps(Src+8), X, Y, Z;
+			BATCHMATH_DEINTERLEAVE3( _mm_shuffle_ps, A, B, C, X, Y, Z );
+			T D = _mm_add_ps( _mm_add_ps(_mm_mul_ps(X,Nx),_mm_mul_ps(Y,Ny)), _mm_mul_ps(Z,Nz) );
+			_mm_storeu_ps( Out+i, _mm_sub_ps(D,Nw) );
+		}
+		ScalarPointPlaneDots( Plane, Points+i, Out+i, Num-i );
+	}
+	BATCHMATH_TARGET_SSE2 static void SSE2PlanePointDots( const FPlane* Planes, const FVector& Point, FLOAT* Out, INT Num )
+	{
+		typedef __m128 T;
+		const T Px=_mm_set1_ps(Point.X), Py=_mm_set1_ps(Point.Y), Pz=_mm_set1_ps(Point.Z);
+		INT i=0;
+		for( ; i+4<=Num; i+=4 )
+		{
+			const FLOAT* Src = &Planes[i].X;
+			T R0=_mm_loadu_ps(Src), R1=_mm_loadu_ps(Src+4), R2=_mm_loadu_ps(Src+8), R3=_mm_loadu_ps(Src+12), X, Y, Z, W;
+			BATCHMATH_TRANSPOSE4( _mm_shuffle_ps, _mm_unpacklo_ps, _mm_unpackhi_ps, R0, R1, R2, R3, X, Y, Z, W );
+			T D = _mm_add_ps( _mm_add_ps(_mm_mul_ps(X,Px),_mm_mul_ps(Y,Py)), _mm_mul_ps(Z,Pz) );
+			_mm_storeu_ps( Out+i, _mm_sub_ps(D,W) );
+		}
+		ScalarPlanePointDots( Planes+i, Point, Out+i, Num-i );
+	}
+	BATCHMATH_TARGET_SSE2 static void SSE2SpheresInFrustum( const FPlane* Planes, INT NumPlanes, const FSphere* Spheres, BYTE* Visible, INT Num )
+	{
+		typedef __m128 T;
+		INT i=0;
+		for( ; i+4<=Num; i+=4 )
+		{
+			const FLOAT* Src = &Spheres[i].X;
+			T R0=_mm_loadu_ps(Src), R1=_mm_loadu_ps(Src+4), R2=_mm_loadu_ps(Src+8), R3=_mm_loadu_ps(Src+12), X, Y, Z, Radius;
+			BATCHMATH_TRANSPOSE4( _mm_shuffle_ps, _mm_unpacklo_ps, _mm_unpackhi_ps, R0, R1, R2, R3, X, Y, Z, Radius );
+			T Culled = _mm_setzero_ps();
+			for( INT j=0; j<NumPlanes; j++ )
+			{
+				const FPlane& P = Planes[j];
+				T D = _mm_add_ps( _mm_add_ps(_mm_mul_ps(X,_mm_set1_ps(P.X)),_mm_mul_ps(Y,_mm_set1_ps(P.Y))), _mm_mul_ps(Z,_mm_set1_ps(P.Z)) );
+				Culled = _mm_or_ps( Culled, _mm_cmpgt_ps(_mm_sub_ps(D,_mm_set1_ps(P.W)),Radius) );
+			}
+			INT Mask = _mm_movemask_ps( Culled );
+			for( INT k=0; k<4; k++ )
+				Visible[i+k] = !(Mask & (1<<k));
+		}
+		ScalarSpheresInFrustum( Planes, NumPlanes, Spheres+i, Visible+i, Num-i );
+	}
+	BATCHMATH_TARGET_SSE2 static void SSE2BoxesInFrustum( const FPlane* Planes, INT NumPlanes, const FBox* Boxes, BYTE* Visible, INT Num )
+	{
+		typedef __m128 T;
+		const T Half    = _mm_set1_ps( 0.5f );
+		const T AbsMask = _mm_castsi128_ps( _mm_set1_epi32(0x7FFFFFFF) );
+		INT i=0;
+		for( ; i+4<=Num; i+=4 )
+		{
+			// FBox isn't packed, gather the components.
+			const FBox* B = Boxes+i;
+			T MinX=_mm_setr_ps(B[0].Min.X,B[1].Min.X,B[2].Min.X,B[3].Min.X), MaxX=_mm_setr_ps(B[0].Max.X,B[1].Max.X,B[2].Max.X,B[3].Max.X);
+			T MinY=_mm_setr_ps(B[0].Min.Y,B[1].Min.Y,B[2].Min.Y,B[3].Min.Y), MaxY=_mm_setr_ps(B[0].Max.Y,B[1].Max.Y,B[2].Max.Y,B[3].Max.Y);
+			T MinZ=_mm_setr_ps(B[0].Min.Z,B[1].Min.Z,B[2].Min.Z,B[3].Min.Z), MaxZ=_mm_setr_ps(B[0].Max.Z,B[1].Max.Z,B[2].Max.Z,B[3].Max.Z);
+			T Cx=_mm_mul_ps(_mm_add_ps(MinX,MaxX),Half), Ex=_mm_mul_ps(_mm_sub_ps(MaxX,MinX),Half);
+			T Cy=_mm_mul_ps(_mm_add_ps(MinY,MaxY),Half), Ey=_mm_mul_ps(_mm_sub_ps(MaxY,MinY),Half);
+			T Cz=_mm_mul_ps(_mm_add_ps(MinZ,MaxZ),Half), Ez=_mm_mul_ps(_mm_sub_ps(MaxZ,MinZ),Half);
+			T Culled = _mm_setzero_ps();
+			for( INT j=0; j<NumPlanes; j++ )
+			{
+				const FPlane& P = Planes[j];
+				T Nx=_mm_set1_ps(P.X), Ny=_mm_set1_ps(P.Y), Nz=_mm_set1_ps(P.Z);
+				T D    = _mm_sub_ps( _mm_add_ps(_mm_add_ps(_mm_mul_ps(Cx,Nx),_mm_mul_ps(Cy,Ny)),_mm_mul_ps(Cz,Nz)), _mm_set1_ps(P.W) );
+				T Push = _mm_add_ps( _mm_add_ps(_mm_mul_ps(Ex,_mm_and_ps(Nx,AbsMask)),_mm_mul_ps(Ey,_mm_and_ps(Ny,AbsMask))), _mm_mul_ps(Ez,_mm_and_ps(Nz,AbsMask)) );
+				Culled = _mm_or_ps( Culled, _mm_cmpgt_ps(D,Push) );
+			}
+			INT Mask = _mm_movemask_ps( Culled );
+			for( INT k=0; k<4; k++ )
+				Visible[i+k] = B[k].IsValid && !(Mask & (1<<k));
+		}
+		ScalarBoxesInFrustum( Planes, NumPlanes, Boxes+i, Visible+i, Num-i );
+	}
+	BATCHMATH_TARGET_SSE2 static void SSE2NormalizeMany( FVector* V, INT Num )
+	{
+		typedef __m128 T;
+		const T One   = _mm_set1_ps( 1.0f );
+		const T Small = _mm_set1_ps( SMALL_NUMBER );
+		INT i=0;
+		for( ; i+4<=Num; i+=4 )
+		{
+			FLOAT* Data = &V[i].X;
+			T A=_mm_loadu_ps(Data), B=_mm_loadu_ps(Data+4), C=_mm_loadu_ps(Data+8), X, Y, Z;
+			BATCHMATH_DEINTERLEAVE3( _mm_shuffle_ps, A, B, C, X, Y, Z );
+			T SquareSum = _mm_add_ps( _mm_add_ps(_mm_mul_ps(X,X),_mm_mul_ps(Y,Y)), _mm_mul_ps(Z,Z) );
+			T Keep      = _mm_cmplt_ps( SquareSum, Small );
+			T Scale     = _mm_div_ps( One, _mm_sqrt_ps(SquareSum) );
+			X = _mm_or_ps( _mm_and_ps(Keep,X), _mm_andnot_ps(Keep,_mm_mul_ps(X,Scale)) );
+			Y = _mm_or_ps( _mm_and_ps(Keep,Y), _mm_andnot_ps(Keep,_mm_mul_ps(Y,Scale)) );
+			Z = _mm_or_ps( _mm_and_ps(Keep,Z), _mm_andnot_ps(Keep,_mm_mul_ps(Z,Scale)) );
+			BATCHMATH_INTERLEAVE3( _mm_shuffle_ps, _mm_unpacklo_ps, _mm_unpackhi_ps, X, Y, Z, A, B, C );
+			_mm_storeu_ps( Data,   A );
+			_mm_storeu_ps( Data+4, B );
+			_mm_storeu_ps( Data+8, C );
+		}
+		ScalarNormalizeMany( V+i, Num-i );
+	}
+#endif
+
+#if BATCHMATH_HAS_AVX2
+	// AVX2 versions. Lane 0 holds elements 0-3, lane 1 elements 4-7.
+	BATCHMATH_TARGET_AVX2 static void AVX2TransformPoints( const FCoords& Coords, const FVector* In, FVector* Out, INT Num )
+	{
+		typedef __m256 T;
+		const T Ox=_mm256_set1_ps(Coords.Origin.X), Oy=_mm256_set1_ps(Coords.Origin.Y), Oz=_mm256_set1_ps(Coords.Origin.Z);
+		const T Xx=_mm256_set1_ps(Coords.XAxis.X),  Xy=_mm256_set1_ps(Coords.XAxis.Y),  Xz=_mm256_set1_ps(Coords.XAxis.Z);
+		const T Yx=_mm256_set1_ps(Coords.YAxis.X),  Yy=_mm256_set1_ps(Coords.YAxis.Y),  Yz=_mm256_set1_ps(Coords.YAxis.Z);
+		const T Zx=_mm256_set1_ps(Coords.ZAxis.X),  Zy=_mm256_set1_ps(Coords.ZAxis.Y),  Zz=_mm256_set1_ps(Coords.ZAxis.Z);
+		INT i=0;
+		for( ; i+8<=Num; i+=8 )
+		{
+			const FLOAT* Src  = &In[i].X;
+			FLOAT*       Dest = &Out[i].X;
+			T A=BATCHMATH_LOADU2(Src,Src+12), B=BATCHMATH_LOADU2(Src+4,Src+16), C=BATCHMATH_LOADU2(Src+8,Src+20), X, Y, Z;
+			BATCHMATH_DEINTERLEAVE3( _mm256_shuffle_ps, A, B, C, X, Y, Z );
+			X = _mm256_sub_ps( X, Ox );
+			Y = _mm256_sub_ps( Y, Oy );
+			Z = _mm256_sub_ps( Z, Oz );
+			T RX = _mm256_add_ps( _mm256_add_ps(_mm256_mul_ps(X,Xx),_mm256_mul_ps(Y,Xy)), _mm256_mul_ps(Z,Xz) );
+			T RY = _mm256_add_ps( _mm256_add_ps(_mm256_mul_ps(X,Yx),_mm256_mul_ps(Y,Yy)), _mm256_mul_ps(Z,Yz) );
+			T RZ = _mm256_add_ps( _mm256_add_ps(_mm256_mul_ps(X,Zx),_mm256_mul_ps(Y,Zy)), _mm256_mul_ps(Z,Zz) );
+			BATCHMATH_INTERLEAVE3( _mm256_shuffle_ps, _mm256_unpacklo_ps, _mm256_unpackhi_ps, RX, RY, RZ, A, B, C );
+			_mm_storeu_ps( Dest,    _mm256_castps256_ps128(A) );
+			_mm_storeu_ps( Dest+4,  _mm256_castps256_ps128(B) );
+			_mm_storeu_ps( Dest+8,  _mm256_castps256_ps128(C) );
+			_mm_storeu_ps( Dest+12, _mm256_extractf128_ps(A,1) );
+			_mm_storeu_ps( Dest+16, _mm256_extractf128_ps(B,1) );
+			_mm_storeu_ps( Dest+20, _mm256_extractf128_ps(C,1) );
+		}
+		SSE2TransformPoints( Coords, In+i, Out+i, Num-i );
+	}
+	BATCHMATH_TARGET_AVX2 static void AVX2PointPlaneDots( const FPlane& Plane, const FVector* Points, FLOAT* Out, INT Num )
+	{
+		typedef __m256 T;
+		const T Nx=_mm256_set1_ps(Plane.X), Ny=_mm256_set1_ps(Plane.Y), Nz=_mm256_set1_ps(Plane.Z), Nw=_mm256_set1_ps(Plane.W);
+		INT i=0;
+		for( ; i+8<=Num; i+=8 )
+		{
+			const FLOAT* Src = &Points[i].X;
+			T A=BATCHMATH_LOADU2(Src,Src+12), B=BATCHMATH_LOADU2(Src+4,Src+16), C=BATCHMATH_LOADU2(Src+8,Src+20), X, Y, Z;
+			BATCHMATH_DEINTERLEAVE3( _mm256_shuffle_ps, A, B, C, X, Y, Z );
+			T D = _mm256_add_ps( _mm256_add_ps(_mm256_mul_ps(X,Nx),_mm256_mul_ps(Y,Ny)), _mm256_mul_ps(Z,Nz) );
+			_mm256_storeu_ps( Out+i, _mm256_sub_ps(D,Nw) );
+		}
+		SSE2PointPlaneDots( Plane, Points+i, Out+i, Num-i );
+	}
+	BATCHMATH_TARGET_AVX2 static void AVX2SpheresInFrustum( const FPlane* Planes, INT NumPlanes, const FSphere* Spheres, BYTE* Visible, INT Num )
+	{
+		typedef __m256 T;
+		INT i=0;
+		for( ; i+8<=Num; i+=8 )
+		{
+			const FLOAT* Src = &Spheres[i].X;
+			T R0=BATCHMATH_LOADU2(Src,Src+16), R1=BATCHMATH_LOADU2(Src+4,Src+20), R2=BATCHMATH_LOADU2(Src+8,Src+24), R3=BATCHMATH_LOADU2(Src+12,Src+28), X, Y, Z, Radius;
+			BATCHMATH_TRANSPOSE4( _mm256_shuffle_ps, _mm256_unpacklo_ps, _mm256_unpackhi_ps, R0, R1, R2, R3, X, Y, Z, Radius );
+			T Culled = _mm256_setzero_ps();
+			for( INT j=0; j<NumPlanes; j++ )
+			{
+				const FPlane& P = Planes[j];
+				T D = _mm256_add_ps( _mm256_add_ps(_mm256_mul_ps(X,_mm256_set1_ps(P.X)),_mm256_mul_ps(Y,_mm256_set1_ps(P.Y))), _mm256_mul_ps(Z,_mm256_set1_ps(P.Z)) );
+				Culled = _mm256_or_ps( Culled, _mm256_cmp_ps(_mm256_sub_ps(D,_mm256_set1_ps(P.W)),Radius,_CMP_GT_OQ) );
+			}
+			INT Mask = _mm256_movemask_ps( Culled );
+			for( INT k=0; k<8; k++ )
+				Visible[i+k] = !(Mask & (1<<k));
+		}
+		SSE2SpheresInFrustum( Planes, NumPlanes, Spheres+i, Visible+i, Num-i );
+	}
+	BATCHMATH_TARGET_AVX2 static void AVX2NormalizeMany( FVector* V, INT Num )
+	{
+		typedef __m256 T;
+		const T One   = _mm256_set1_ps( 1.0f );
+		const T Small = _mm256_set1_ps( SMALL_NUMBER );
+		INT i=0;
+		for( ; i+8<=Num; i+=8 )
+		{
+			FLOAT* Data = &V[i].X;
+			T A=BATCHMATH_LOADU2(Data,Data+12), B=BATCHMATH_LOADU2(Data+4,Data+16), C=BATCHMATH_LOADU2(Data+8,Data+20), X, Y, Z;
+			BATCHMATH_DEINTERLEAVE3( _mm256_shuffle_ps, A, B, C, X, Y, Z );
+			T SquareSum = _mm256_add_ps( _mm256_add_ps(_mm256_mul_ps(X,X),_mm256_mul_ps(Y,Y)), _mm256_mul_ps(Z,Z) );
+			T Keep      = _mm256_cmp_ps( SquareSum, Small, _CMP_LT_OQ );
+			T Scale     = _mm256_div_ps( One, _mm256_sqrt_ps(SquareSum) );
+			X = _mm256_blendv_ps( _mm256_mul_ps(X,Scale), X, Keep );
+			Y = _mm256_blendv_ps( _mm256_mul_ps(Y,Scale), Y, Keep );
+			Z = _mm256_blendv_ps( _mm256_mul_ps(Z,Scale), Z, Keep );
+			BATCHMATH_INTERLEAVE3( _mm256_shuffle_ps, _mm256_unpacklo_ps, _mm256_unpackhi_ps, X, Y, Z, A, B, C );
+			_mm_storeu_ps( Data,    _mm256_castps256_ps128(A) );
+			_mm_storeu_ps( Data+4,  _mm256_castps256_ps128(B) );
+			_mm_storeu_ps( Data+8,  _mm256_castps256_ps128(C) );
+			_mm_storeu_ps( Data+12, _mm256_extractf128_ps(A,1) );
+			_mm_storeu_ps( Data+16, _mm256_extractf128_ps(B,1) );
+			_mm_storeu_ps( Data+20, _mm256_extractf128_ps(C,1) );
+		}
+		SSE2NormalizeMany( V+i, Num-i );
+	}
+#endif
+};
+
+/*-----------------------------------------------------------------------------
+	The End.
+-----------------------------------------------------------------------------*/
@@ -196,6 +196,417 @@ private:
 	FMemStack::FTaggedMemory* SavedChunk;
 };
 
+/*-----------------------------------------------------------------------------
+	FMemChunkPool.
+-----------------------------------------------------------------------------*/
+
+//
+// Global spill list for FThreadMemStack chunks. All chunks handed out by a
+// pool have the same size. Thread stacks keep a few unused chunks to
+// themselves and only go through the pool once their own cache runs over
+// or dry, so the pool is touched rarely and never locked.
+//
+// Chunks are allocated through GMalloc, so either GMalloc has to be thread
+// safe or the pool has to be prefilled on the game thread.
+//
+class FMemChunkPool
+{
+public:
+	typedef FMemStack::FTaggedMemory FTaggedMemory;
+
+	// Constructors.
+	FMemChunkPool()
+	:	ChunkSize( 0 )
+	{}
+
+	// FMemChunkPool interface.
+	void Init( INT InChunkSize, INT NumPrefill=0 )
+	{
+		guard(FMemChunkPool::Init);
+		check(ChunkSize==0);
+		check(InChunkSize>(INT)sizeof(FTaggedMemory));
+		ChunkSize = InChunkSize;
+		for( INT i=0; i<NumPrefill; i++ )
+			Release( AllocateChunk() );
+		unguard;
+	}
+	void Exit()
+	{
+		guard(FMemChunkPool::Exit);
+		for( FTaggedMemory* Chunk=(FTaggedMemory*)FreeChunks.PopAll(); Chunk; )
+		{
+			FTaggedMemory* Next = Chunk->Next;
+			appFree( Chunk );
+			NumAllocated.Decrement();
+			NumFree.Decrement();
+			Chunk = Next;
+		}
+		if( NumAllocated.GetValue() )
+			debugf( NAME_Warning, TEXT("FMemChunkPool: %i chunks still in use on exit"), NumAllocated.GetValue() );
+		ChunkSize = 0;
+		unguard;
+	}
+	FTaggedMemory* Allocate()
+	{
+		guardSlow(FMemChunkPool::Allocate);
+		FTaggedMemory* Chunk = (FTaggedMemory*)FreeChunks.Pop();
+		if( Chunk )
+			NumFree.Decrement();
+		else
+			Chunk = AllocateChunk();
+		return Chunk;
+		unguardSlow;
+	}
+	void Release( FTaggedMemory* Chunk )
+	{
+		guardSlow(FMemChunkPool::Release);
+		checkSlow(Chunk->DataSize==GetDataSize());
+		NumFree.Increment();
+		FreeChunks.Push( Chunk );
+		unguardSlow;
+	}
+	INT GetChunkSize() const
+	{
+		return ChunkSize;
+	}
+	INT GetDataSize() const
+	{
+		return ChunkSize-sizeof(FTaggedMemory);
+	}
+	INT GetNumAllocated() const
+	{
+		return NumAllocated.GetValue();
+	}
+	INT GetNumFree() const
+	{
+		return NumFree.GetValue();
+	}
+
+private:
+	FLockFreeList      FreeChunks;
+	INT                ChunkSize;
+	FThreadSafeCounter NumAllocated;
+	FThreadSafeCounter NumFree;
+
+	FTaggedMemory* AllocateChunk()
+	{
+		guardSlow(FMemChunkPool::AllocateChunk);
+		check(ChunkSize);
+		FTaggedMemory* Chunk = (FTaggedMemory*)appMalloc( ChunkSize, TEXT("MemChunkPool") );
+		Chunk->Next          = NULL;
+		Chunk->DataSize      = GetDataSize();
+		NumAllocated.Increment();
+		return Chunk;
+		unguardSlow;
+	}
+};
+
+/*-----------------------------------------------------------------------------
+	FThreadMemStack.
+-----------------------------------------------------------------------------*/
+
+//
+// Per thread version of FMemStack.
+//
+// FMemStack keeps its unused chunks in a single static list inside Core.dll,
+// so neither GMem nor any other FMemStack may be used outside the game thread.
+// FThreadMemStack has the same interface, but each instance caches its own
+// unused chunks and spills into (or refills from) a shared FMemChunkPool.
+// Each thread owns exactly one instance, see appThreadMem().
+//
+class FThreadMemStack
+{
+public:
+	typedef FMemStack::FTaggedMemory FTaggedMemory;
+
+	// Constructors.
+	FThreadMemStack()
+	:	Top( NULL )
+	,	End( NULL )
+	,	DefaultChunkSize( 0 )
+	,	TopChunk( NULL )
+	,	Pool( NULL )
+	,	UnusedChunks( NULL )
+	,	NumUnusedChunks( 0 )
+	{}
+
+	// Get bytes.
+	BYTE* PushBytes( INT AllocSize, INT Align )
+	{
+		// Debug checks.
+		guardSlow(FThreadMemStack::PushBytes);
+		checkSlow(AllocSize>=0);
+		checkSlow((Align&(Align-1))==0);
+		checkSlow(Top<=End);
+
+		// Try to get memory from the current chunk.
+		BYTE* Result = (BYTE *)(((INT)Top+(Align-1))&~(Align-1));
+		Top = Result + AllocSize;
+
+		// Make sure we didn't overflow.
+		if( Top > End )
+		{
+			// We'd pass the end of the current chunk, so allocate a new one.
+			AllocateNewChunk( AllocSize + Align );
+			Result = (BYTE *)(((INT)Top+(Align-1))&~(Align-1));
+			Top    = Result + AllocSize;
+		}
+		return Result;
+		unguardSlow;
+	}
+
+	// Main functions.
+	void Init( INT InDefaultChunkSize, FMemChunkPool* InPool=NULL )
+	{
+		guard(FThreadMemStack::Init);
+		check(!InPool || InPool->GetChunkSize()==InDefaultChunkSize);
+		Top              = NULL;
+		End              = NULL;
+		DefaultChunkSize = InDefaultChunkSize;
+		TopChunk         = NULL;
+		Pool             = InPool;
+		UnusedChunks     = NULL;
+		NumUnusedChunks  = 0;
+		unguard;
+	}
+	void Exit()
+	{
+		guard(FThreadMemStack::Exit);
+		Tick();
+		while( UnusedChunks )
+		{
+			FTaggedMemory* Chunk = UnusedChunks;
+			UnusedChunks         = Chunk->Next;
+			ReleaseChunk( Chunk );
+		}
+		NumUnusedChunks = 0;
+		unguard;
+	}
+	void Tick()
+	{
+		guard(FThreadMemStack::Tick);
+		check(TopChunk==NULL);
+		unguard;
+	}
+	INT GetByteCount()
+	{
+		guard(FThreadMemStack::GetByteCount);
+		INT Count = 0;
+		for( FTaggedMemory* Chunk=TopChunk; Chunk; Chunk=Chunk->Next )
+		{
+			if( Chunk!=TopChunk )
+				Count += Chunk->DataSize;
+			else
+				Count += Top - Chunk->Data;
+		}
+		return Count;
+		unguard;
+	}
+
+	// Friends.
+	friend class FThreadMemMark;
+
+private:
+	// Constants.
+	enum {MAX_CACHED_CHUNKS=4};
+
+	// Variables.
+	BYTE*			Top;				// Top of current chunk (Top<=End).
+	BYTE*			End;				// End of current chunk.
+	INT				DefaultChunkSize;	// Maximum chunk size to allocate.
+	FTaggedMemory*	TopChunk;			// Only chunks 0..ActiveChunks-1 are valid.
+	FMemChunkPool*	Pool;				// Shared spill list, may be NULL.
+	FTaggedMemory*	UnusedChunks;		// Thread local chunk cache.
+	INT				NumUnusedChunks;	// Number of chunks in UnusedChunks.
+
+	// Functions.
+	BYTE* AllocateNewChunk( INT MinSize )
+	{
+		guardSlow(FThreadMemStack::AllocateNewChunk);
+		FTaggedMemory* Chunk=NULL;
+		for( FTaggedMemory** Link=&UnusedChunks; *Link; Link=&(*Link)->Next )
+		{
+			// Find existing chunk.
+			if( (*Link)->DataSize >= MinSize )
+			{
+				Chunk = *Link;
+				*Link = (*Link)->Next;
+				NumUnusedChunks--;
+				break;
+			}
+		}
+		if( !Chunk && Pool && MinSize<=Pool->GetDataSize() )
+		{
+			// Refill from shared pool.
+			Chunk = Pool->Allocate();
+		}
+		if( !Chunk )
+		{
+			// Create new chunk.
+			INT DataSize    = Max( MinSize, DefaultChunkSize-(INT)sizeof(FTaggedMemory) );
+			Chunk           = (FTaggedMemory*)appMalloc( DataSize + sizeof(FTaggedMemory), TEXT("ThreadMemChunk") );
+			Chunk->DataSize = DataSize;
+		}
+		Chunk->Next = TopChunk;
+		TopChunk    = Chunk;
+		Top         = Chunk->Data;
+		End         = Top + Chunk->DataSize;
+		return Top;
+		unguardSlow;
+	}
+	void FreeChunks( FTaggedMemory* NewTopChunk )
+	{
+		guardSlow(FThreadMemStack::FreeChunks);
+		while( TopChunk!=NewTopChunk )
+		{
+			FTaggedMemory* RemoveChunk = TopChunk;
+			TopChunk                   = TopChunk->Next;
+			if( NumUnusedChunks<MAX_CACHED_CHUNKS )
+			{
+				// Keep it for ourself.
+				RemoveChunk->Next = UnusedChunks;
+				UnusedChunks      = RemoveChunk;
+				NumUnusedChunks++;
+			}
+			else ReleaseChunk( RemoveChunk );
+		}
+		Top = NULL;
+		End = NULL;
+		if( TopChunk )
+		{
+			Top = TopChunk->Data;
+			End = Top + TopChunk->DataSize;
+		}
+		unguardSlow;
+	}
+	void ReleaseChunk( FTaggedMemory* Chunk )
+	{
+		guardSlow(FThreadMemStack::ReleaseChunk);
+		if( Pool && Chunk->DataSize==Pool->GetDataSize() )
+			Pool->Release( Chunk );
+		else
+			appFree( Chunk );
+		unguardSlow;
+	}
+};
+
+/*-----------------------------------------------------------------------------
+	FThreadMemStack templates.
+-----------------------------------------------------------------------------*/
+
+// Operator new for typesafe memory stack allocation.
+template <class T> inline T* New( FThreadMemStack& Mem, INT Count=1, INT Align=DEFAULT_ALIGNMENT )
+{
+	guardSlow(FThreadMemStack::New);
+	return (T*)Mem.PushBytes( Count*sizeof(T), Align );
+	unguardSlow;
+}
+template <class T> inline T* NewZeroed( FThreadMemStack& Mem, INT Count=1, INT Align=DEFAULT_ALIGNMENT )
+{
+	guardSlow(FThreadMemStack::New);
+	BYTE* Result = Mem.PushBytes( Count*sizeof(T), Align );
+	appMemzero( Result, Count*sizeof(T) );
+	return (T*)Result;
+	unguardSlow;
+}
+template <class T> inline T* NewOned( FThreadMemStack& Mem, INT Count=1, INT Align=DEFAULT_ALIGNMENT )
+{
+	guardSlow(FThreadMemStack::New);
+	BYTE* Result = Mem.PushBytes( Count*sizeof(T), Align );
+	appMemset( Result, 0xff, Count*sizeof(T) );
+	return (T*)Result;
+	unguardSlow;
+}
+
+/*-----------------------------------------------------------------------------
+	FThreadMemStack operator new's.
+-----------------------------------------------------------------------------*/
+
+// Operator new for typesafe memory stack allocation.
+inline void* operator new( size_t Size, FThreadMemStack& Mem, INT Count=1, INT Align=DEFAULT_ALIGNMENT )
+{
+	// Get uninitialized memory.
+	guardSlow(FThreadMemStack::New1);
+	return Mem.PushBytes( Size*Count, Align );
+	unguardSlow;
+}
+inline void* operator new( size_t Size, FThreadMemStack& Mem, EMemZeroed Tag, INT Count=1, INT Align=DEFAULT_ALIGNMENT )
+{
+	// Get zero-filled memory.
+	guardSlow(FThreadMemStack::New2);
+	BYTE* Result = Mem.PushBytes( Size*Count, Align );
+	appMemzero( Result, Size*Count );
+	return Result;
+	unguardSlow;
+}
+inline void* operator new( size_t Size, FThreadMemStack& Mem, EMemOned Tag, INT Count=1, INT Align=DEFAULT_ALIGNMENT )
+{
+	// Get one-filled memory.
+	guardSlow(FThreadMemStack::New3);
+	BYTE* Result = Mem.PushBytes( Size*Count, Align );
+	appMemset( Result, 0xff, Size*Count );
+	return Result;
+	unguardSlow;
+}
+
+/*-----------------------------------------------------------------------------
+	FThreadMemMark.
+-----------------------------------------------------------------------------*/
+
+//
+// FMemMark for FThreadMemStack.
+//
+class FThreadMemMark
+{
+public:
+	// Constructors.
+	FThreadMemMark()
+	{}
+	FThreadMemMark( FThreadMemStack& InMem )
+	{
+		guardSlow(FThreadMemMark::FThreadMemMark);
+		Mem          = &InMem;
+		Top          = Mem->Top;
+		SavedChunk   = Mem->TopChunk;
+		unguardSlow;
+	}
+
+	// FThreadMemMark interface.
+	void Pop()
+	{
+		// Check state.
+		guardSlow(FThreadMemMark::Pop);
+
+		// Unlock any new chunks that were allocated.
+		if( SavedChunk != Mem->TopChunk )
+			Mem->FreeChunks( SavedChunk );
+
+		// Restore the memory stack's state.
+		Mem->Top = Top;
+		unguardSlow;
+	}
+
+private:
+	// Implementation variables.
+	FThreadMemStack* Mem;
+	BYTE* Top;
+	FThreadMemStack::FTaggedMemory* SavedChunk;
+};
+
+/*-----------------------------------------------------------------------------
+	Per thread memory stacks (CoreI).
+-----------------------------------------------------------------------------*/
+
+// Shared chunk pool backing all per thread memory stacks.
+extern COREI_API FMemChunkPool GMemChunkPool;
+
+//
+// Returns the calling thread's memory stack. It is created on first use out
+// of GMemChunkPool and released on thread exit. On the game thread GMem
+// stays the stack to use.
+//
+COREI_API FThreadMemStack& appThreadMem();
+
 /*-----------------------------------------------------------------------------
 	The End.
 -----------------------------------------------------------------------------*/
@@ -48,6 +48,7 @@ struct FNameEntry
 template <> struct TTypeInfo<FNameEntry*> : public TTypeInfoBase<FNameEntry*>
 {
 	static UBOOL NeedsDestructor() {return 0;}
+	static UBOOL IsBitwiseCopyable() {return 1;}
 };
 
 /*----------------------------------------------------------------------------
@@ -159,6 +160,278 @@ inline DWORD GetTypeHash( const FName N )
 	return N.GetIndex();
 }
 
+/*----------------------------------------------------------------------------
+	FConcurrentNameTable.
+----------------------------------------------------------------------------*/
+
+//
+// An interned name string, as stored in FConcurrentNameTable.
+//
+struct FConcurrentNameEntry
+{
+	FConcurrentNameEntry* volatile HashNext;	// Next entry in this hash bin.
+	DWORD				Hash;		// appStrihash() of Name.
+	volatile NAME_INDEX	NameIndex;	// Index into the FName table, INDEX_NONE until resolved.
+	INT					Length;		// Length of Name without terminator.
+	TCHAR				Name[1];	// Name, variable-sized.
+};
+
+//
+// Thread safe name table, meant to intern names off the game thread (e.g.
+// while parsing package name tables on a loader thread) before they are
+// turned into FNames, as the FName table itself is not thread safe.
+//
+// The table is split into shards by hash. Each shard packs its entries into
+// an arena and keeps its own hash, which doubles in size when it gets full.
+// Lookups are lock-free; insertions and rehashes lock the shard. Readers
+// racing a rehash notice through the shard's version and retry. Replaced
+// bucket arrays are kept around until Exit() so no reader can touch freed
+// memory.
+//
+// Arena blocks are allocated through GMalloc, so GMalloc has to be thread
+// safe when names are added from other threads. For the same reason memory
+// is only freed by Exit(), which CoreI calls on shutdown while GMalloc
+// is still up. The destructor runs during static destruction, after GMalloc
+// may be gone, and leaves whatever is left to the process exit.
+//
+class FConcurrentNameTable
+{
+public:
+	enum {NUM_SHARDS       = 16   };
+	enum {INITIAL_BUCKETS  = 256  };
+	enum {ARENA_BLOCK_SIZE = 65536};
+
+	// Constructors.
+	FConcurrentNameTable()
+	{
+		appMemzero( Shards, sizeof(Shards) );
+	}
+	~FConcurrentNameTable()
+	{}
+
+	// FConcurrentNameTable interface.
+	void Exit()
+	{
+		guard(FConcurrentNameTable::Exit);
+		for( INT i=0; i<NUM_SHARDS; i++ )
+		{
+			FShard& Shard = Shards[i];
+			while( Shard.Blocks )
+			{
+				FArenaBlock* Next = Shard.Blocks->Next;
+				appFree( Shard.Blocks );
+				Shard.Blocks = Next;
+			}
+			while( Shard.Table )
+			{
+				FBucketTable* Next = Shard.Table->NextRetired;
+				appFree( Shard.Table );
+				Shard.Table = Next;
+			}
+			Shard.ArenaPos   = Shard.ArenaEnd = NULL;
+			Shard.NumEntries = 0;
+		}
+		unguard;
+	}
+	FConcurrentNameEntry* Find( const TCHAR* Name ) const
+	{
+		guardSlow(FConcurrentNameTable::Find);
+		DWORD Hash = appStrihash( Name );
+		const FShard& Shard = Shards[Hash & (NUM_SHARDS-1)];
+		for( ; ; )
+		{
+			INT Version = Shard.Version;
+			if( Version & 1 )
+			{
+				appPause();
+				continue;
+			}
+			FConcurrentNameEntry* Entry = FindInTable( Shard.Table, Name, Hash );
+			if( Entry || Shard.Version==Version )
+				return Entry;
+		}
+		unguardSlow;
+	}
+	FConcurrentNameEntry* FindOrAdd( const TCHAR* Name )
+	{
+		guardSlow(FConcurrentNameTable::FindOrAdd);
+		checkSlow(Name);
+		FConcurrentNameEntry* Entry = Find( Name );
+		if( Entry )
+			return Entry;
+
+		DWORD  Hash   = appStrihash( Name );
+		FShard& Shard = Shards[Hash & (NUM_SHARDS-1)];
+		FScopeLock Lock( Shard.Lock );
+
+		// Someone might have added it in the meantime.
+		Entry = FindInTable( Shard.Table, Name, Hash );
+		if( Entry )
+			return Entry;
+
+		// Create the entry.
+		INT Length = appStrlen( Name );
+		check(Length<NAME_SIZE);
+		Entry            = (FConcurrentNameEntry*)AllocateEntry( Shard, STRUCT_OFFSET(FConcurrentNameEntry,Name) + (Length+1)*sizeof(TCHAR) );
+		Entry->Hash      = Hash;
+		Entry->NameIndex = INDEX_NONE;
+		Entry->Length    = Length;
+		appMemcpy( Entry->Name, Name, (Length+1)*sizeof(TCHAR) );
+
+		// Link it in. The entry must be complete before it is visible.
+		if( !Shard.Table || Shard.NumEntries>=2*Shard.Table->NumBuckets )
+			Grow( Shard );
+		FConcurrentNameEntry* volatile& Bucket = Shard.Table->Buckets[(Hash/NUM_SHARDS) & (Shard.Table->NumBuckets-1)];
+		Entry->HashNext = Bucket;
+		appMemoryBarrier();
+		Bucket = Entry;
+		Shard.NumEntries++;
+		return Entry;
+		unguardSlow;
+	}
+
+	// Returns the FName of an entry. Game thread only.
+	FName Resolve( FConcurrentNameEntry* Entry )
+	{
+		guardSlow(FConcurrentNameTable::Resolve);
+		checkSlow(Entry);
+		if( Entry->NameIndex==INDEX_NONE )
+			Entry->NameIndex = FName( Entry->Name, FNAME_Add ).GetIndex();
+		return FName( (EName)Entry->NameIndex );
+		unguardSlow;
+	}
+	// Returns whether an entry has been resolved before. Safe on any thread.
+	static UBOOL TryResolve( const FConcurrentNameEntry* Entry, FName& Result )
+	{
+		NAME_INDEX Index = Entry->NameIndex;
+		if( Index==INDEX_NONE )
+			return 0;
+		Result = FName( (EName)Index );
+		return 1;
+	}
+
+	// Statistics. Not synchronized.
+	INT Num() const
+	{
+		INT Result = 0;
+		for( INT i=0; i<NUM_SHARDS; i++ )
+			Result += Shards[i].NumEntries;
+		return Result;
+	}
+	void Dump( FOutputDevice& Ar ) const
+	{
+		guard(FConcurrentNameTable::Dump);
+		INT TotalEntries=0, TotalBuckets=0, TotalUsed=0, Worst=0, ArenaBytes=0, NameBytes=0;
+		for( INT i=0; i<NUM_SHARDS; i++ )
+		{
+			const FShard& Shard = Shards[i];
+			TotalEntries += Shard.NumEntries;
+			for( FArenaBlock* Block=Shard.Blocks; Block; Block=Block->Next )
+				ArenaBytes += ARENA_BLOCK_SIZE;
+			if( !Shard.Table )
+				continue;
+			TotalBuckets += Shard.Table->NumBuckets;
+			for( INT j=0; j<Shard.Table->NumBuckets; j++ )
+			{
+				INT Count = 0;
+				for( FConcurrentNameEntry* Entry=Shard.Table->Buckets[j]; Entry; Entry=Entry->HashNext, Count++ )
+					NameBytes += STRUCT_OFFSET(FConcurrentNameEntry,Name) + (Entry->Length+1)*sizeof(TCHAR);
+				TotalUsed += Count>0;
+				Worst      = Max( Worst, Count );
+			}
+		}
+		Ar.Logf( TEXT("FConcurrentNameTable: %i names in %i shards, %i/%i buckets used, worst chain %i."), TotalEntries, (INT)NUM_SHARDS, TotalUsed, TotalBuckets, Worst );
+		Ar.Logf( TEXT("FConcurrentNameTable: %iK arena, %iK in entries (%iK as FNameEntry)."), ArenaBytes/1024, NameBytes/1024, TotalEntries*(INT)sizeof(FNameEntry)/1024 );
+		unguard;
+	}
+
+private:
+	FConcurrentNameTable( const FConcurrentNameTable& );
+	void operator=( const FConcurrentNameTable& );
+
+	// Hash bucket array, replaced as a whole when growing.
+	struct FBucketTable
+	{
+		FBucketTable*					NextRetired;
+		INT								NumBuckets;
+		FConcurrentNameEntry* volatile	Buckets[1]; // Variable-sized.
+	};
+	struct FArenaBlock
+	{
+		FArenaBlock* Next;
+	};
+	struct FShard
+	{
+		FSpinLock				Lock;
+		FBucketTable* volatile	Table;
+		volatile INT			Version;	// Odd while rehashing.
+		INT						NumEntries;
+		BYTE*					ArenaPos;
+		BYTE*					ArenaEnd;
+		FArenaBlock*			Blocks;
+	};
+
+	static FConcurrentNameEntry* FindInTable( const FBucketTable* Table, const TCHAR* Name, DWORD Hash )
+	{
+		if( Table )
+			for( FConcurrentNameEntry* Entry=Table->Buckets[(Hash/NUM_SHARDS) & (Table->NumBuckets-1)]; Entry; Entry=Entry->HashNext )
+				if( Entry->Hash==Hash && appStricmp(Entry->Name,Name)==0 )
+					return Entry;
+		return NULL;
+	}
+	static void* AllocateEntry( FShard& Shard, INT Size )
+	{
+		Size = Align( Size, (INT)sizeof(void*) );
+		if( Shard.ArenaPos+Size > Shard.ArenaEnd )
+		{
+			FArenaBlock* Block = (FArenaBlock*)appMalloc( ARENA_BLOCK_SIZE, TEXT("ConcurrentNameArena") );
+			Block->Next        = Shard.Blocks;
+			Shard.Blocks       = Block;
+			Shard.ArenaPos     = (BYTE*)Block + Align( (INT)sizeof(FArenaBlock), (INT)sizeof(void*) );
+			Shard.ArenaEnd     = (BYTE*)Block + ARENA_BLOCK_SIZE;
+		}
+		void* Result = Shard.ArenaPos;
+		Shard.ArenaPos += Size;
+		return Result;
+	}
+	static void Grow( FShard& Shard )
+	{
+		guard(FConcurrentNameTable::Grow);
+		FBucketTable* Old    = Shard.Table;
+		INT NumBuckets       = Old ? Old->NumBuckets*2 : (INT)INITIAL_BUCKETS;
+		FBucketTable* New    = (FBucketTable*)appMalloc( STRUCT_OFFSET(FBucketTable,Buckets) + NumBuckets*sizeof(FConcurrentNameEntry*), TEXT("ConcurrentNameHash") );
+		New->NextRetired     = Old;
+		New->NumBuckets      = NumBuckets;
+		appMemzero( (void*)New->Buckets, NumBuckets*sizeof(FConcurrentNameEntry*) );
+		if( Old )
+		{
+			// Relinking changes HashNext under the feet of readers. They can't
+			// loop, but they might miss entries, so let them know.
+			appInterlockedIncrement( &Shard.Version );
+			for( INT i=0; i<Old->NumBuckets; i++ )
+			{
+				FConcurrentNameEntry* Next;
+				for( FConcurrentNameEntry* Entry=Old->Buckets[i]; Entry; Entry=Next )
+				{
+					Next = Entry->HashNext;
+					FConcurrentNameEntry* volatile& Bucket = New->Buckets[(Entry->Hash/NUM_SHARDS) & (NumBuckets-1)];
+					Entry->HashNext = Bucket;
+					Bucket          = Entry;
+				}
+			}
+			Shard.Table = New;
+			appInterlockedIncrement( &Shard.Version );
+		}
+		else Shard.Table = New;
+		unguard;
+	}
+
+	FShard Shards[NUM_SHARDS];
+};
+
+// Global concurrent name table.
+extern COREI_API FConcurrentNameTable GConcurrentNames;
+
 /*----------------------------------------------------------------------------
 	The End.
 ----------------------------------------------------------------------------*/
@@ -488,6 +488,10 @@ public: \
 	UObject.
 -----------------------------------------------------------------------------*/
 
+// Cached event dispatch, implemented in UnFuncCache.h.
+inline UFunction* appFindFunctionCached( UObject* Object, FName InName, UBOOL Global=0 );
+inline void appProcessEventCached( UObject* Object, FName EventName, void* Parms=NULL );
+
 //
 // The base class of all objects.
 //
@@ -1007,11 +1011,11 @@ public:
 	// UnrealScript calling stubs.
 	void eventBeginState()
 	{
-		ProcessEvent(FindFunctionChecked(NAME_BeginState),NULL);
+		appProcessEventCached(this,NAME_BeginState);
 	}
 	void eventEndState()
 	{
-		ProcessEvent(FindFunctionChecked(NAME_EndState),NULL);
+		appProcessEventCached(this,NAME_EndState);
 	}
 };
 
@@ -0,0 +1,223 @@
+/*=============================================================================
+	UnObjHash.h: Resizable object lookup in front of UObject::GObjHash.
+	Copyright 2016-2019 Sebastian Kaufel, Inc. All Rights Reserved.
+
+	Notes:
+	* UObject::GObjHash has a fixed 4096 bins and is maintained by Core.dll,
+	  so with a few hundred thousand objects its chains get long. This keeps
+	  a second, open addressed index keyed by (Name, Outer) which grows with
+	  the number of objects.
+	* Core.dll doesn't tell anyone about objects being created, destroyed or
+	  renamed, so the index is filled on demand and every hit is validated
+	  against GObjObjects. A miss falls back to UObject::StaticFindObject(),
+	  whose result is added, so the answer is always the same as Core's.
+	* Lookups never allocate. The index is grown ahead of the object count
+	  by Tick(), call it once per frame (e.g. next to the garbage collector).
+	  A stale entry is reused for the object found instead, and results
+	  which don't fit are not remembered until the next Tick().
+	* Game thread only, like the rest of the object manager.
+=============================================================================*/
+
+/*-----------------------------------------------------------------------------
+	FObjectHash.
+-----------------------------------------------------------------------------*/
+
+//
+// Key of the object index.
+//
+struct FObjectHashKey
+{
+	NAME_INDEX	Name;
+	UObject*	Outer;
+
+	FObjectHashKey()
+	{}
+	FObjectHashKey( NAME_INDEX InName, UObject* InOuter )
+	:	Name( InName )
+	,	Outer( InOuter )
+	{}
+	UBOOL operator==( const FObjectHashKey& Other ) const
+	{
+		return Name==Other.Name && Outer==Other.Outer;
+	}
+};
+inline DWORD GetTypeHash( const FObjectHashKey& Key )
+{
+	return Key.Name ^ ((DWORD)Key.Outer>>4) ^ ((DWORD)Key.Outer<<16);
+}
+template <> struct TTypeInfo<FObjectHashKey> : public TTypeInfoBase<FObjectHashKey>
+{
+public:
+	static UBOOL NeedsDestructor() {return 0;}
+	static UBOOL IsBitwiseCopyable() {return 1;}
+};
+
+//
+// Object index, see notes above.
+//
+class FObjectHash
+{
+public:
+	enum {MIN_SLACK=1024};
+
+	// Constructors.
+	FObjectHash()
+	:	Hits( 0 )
+	,	Misses( 0 )
+	,	Stale( 0 )
+	,	Dropped( 0 )
+	{}
+
+	// FObjectHash interface.
+	void Exit()
+	{
+		guard(FObjectHash::Exit);
+		Index.Empty();
+		unguard;
+	}
+	void Flush()
+	{
+		guard(FObjectHash::Flush);
+		Index.Empty();
+		Hits = Misses = Stale = Dropped = 0;
+		unguard;
+	}
+
+	// Grows the index ahead of the objects, so lookups don't have to.
+	void Tick()
+	{
+		guard(FObjectHash::Tick);
+		if( Index.GetSlack() < Max(Index.Num()/4,(INT)MIN_SLACK) )
+			Index.Reserve( Max(UObject::GObjObjects.Num(),Index.Num()*2) + MIN_SLACK );
+		unguard;
+	}
+
+	// Adds all current objects, so lookups hit right away.
+	void Prime()
+	{
+		guard(FObjectHash::Prime);
+		Index.Reserve( UObject::GObjObjects.Num() + Max(UObject::GObjObjects.Num()/4,(INT)MIN_SLACK) );
+		for( INT i=0; i<UObject::GObjObjects.Num(); i++ )
+		{
+			UObject* Object = UObject::GObjObjects(i);
+			if( Object )
+				Index.Set( FObjectHashKey(Object->Name.GetIndex(),Object->Outer), i );
+		}
+		unguard;
+	}
+
+	// Drop in replacement for UObject::StaticFindObject().
+	UObject* FindObject( UClass* Class, UObject* InOuter, const TCHAR* Name, UBOOL ExactClass=0 )
+	{
+		guard(FObjectHash::FindObject);
+		checkSlow(Name);
+
+		// Qualified names, ANY_PACKAGE and the like are up to Core.
+		if( InOuter==ANY_PACKAGE || appStrchr(Name,'.') || appStrchr(Name,':') )
+			return UObject::StaticFindObject( Class, InOuter, Name, ExactClass );
+
+		// Objects can only be named by names which exist.
+		FName ObjectName( Name, FNAME_Find );
+		if( ObjectName==NAME_None )
+			return NULL;
+
+		// Look up and validate.
+		FObjectHashKey Key( ObjectName.GetIndex(), InOuter );
+		INT*  ObjectIndex = Index.Find( Key );
+		UBOOL IsStale     = 0;
+		if( ObjectIndex )
+		{
+			UObject* Object = *ObjectIndex<UObject::GObjObjects.Num() ? UObject::GObjObjects(*ObjectIndex) : NULL;
+			if( Object && Object->Name==ObjectName && Object->Outer==InOuter )
+			{
+				if( !Class || (ExactClass ? Object->Class==Class : Object->IsA(Class)) )
+				{
+					Hits++;
+					return Object;
+				}
+			}
+			else
+			{
+				// Destroyed or renamed since, the entry is reused or dropped below.
+				IsStale = 1;
+				Stale++;
+			}
+		}
+
+		// Ask Core, remember the result.
+		Misses++;
+		UObject* Object = UObject::StaticFindObject( Class, InOuter, Name, ExactClass );
+		if( IsStale )
+		{
+			if( Object )
+				*ObjectIndex = Object->Index;
+			else
+				Index.Remove( Key );
+		}
+		else if( Object && !ObjectIndex )
+		{
+			if( Index.GetSlack()>0 )
+				Index.Set( Key, Object->Index );
+			else
+				Dropped++;
+		}
+		return Object;
+		unguard;
+	}
+
+	// Exec.
+	UBOOL Exec( const TCHAR* Cmd, FOutputDevice& Ar )
+	{
+		guard(FObjectHash::Exec);
+		if( ParseCommand(&Cmd,TEXT("OBJHASH")) )
+		{
+			if( ParseCommand(&Cmd,TEXT("FLUSH")) )
+				Flush();
+			else if( ParseCommand(&Cmd,TEXT("PRIME")) )
+				Prime();
+			DumpStats( Ar );
+			return 1;
+		}
+		return 0;
+		unguard;
+	}
+	void DumpStats( FOutputDevice& Ar )
+	{
+		guard(FObjectHash::DumpStats);
+
+		// Chain length distribution of Core's hash, in powers of two.
+		INT Histogram[32], NumObjects=0, NumUsed=0, Worst=0;
+		appMemzero( Histogram, sizeof(Histogram) );
+		for( INT i=0; i<ARRAY_COUNT(UObject::GObjHash); i++ )
+		{
+			INT Length = 0;
+			for( UObject* Hash=UObject::GObjHash[i]; Hash; Hash=Hash->HashNext )
+				Length++;
+			Histogram[Length ? appFloorLogTwo(Length)+1 : 0]++;
+			NumObjects += Length;
+			NumUsed    += Length>0;
+			Worst       = Max( Worst, Length );
+		}
+		Ar.Logf( TEXT("GObjHash: %i objects in %i/%i bins, average chain %.1f, worst %i."), NumObjects, NumUsed, ARRAY_COUNT(UObject::GObjHash), NumUsed ? (FLOAT)NumObjects/NumUsed : 0.f, Worst );
+		Ar.Logf( TEXT("  %8i empty"), Histogram[0] );
+		for( INT j=1; j<ARRAY_COUNT(Histogram); j++ )
+			if( Histogram[j] )
+				Ar.Logf( TEXT("  %8i of length %i-%i"), Histogram[j], 1<<(j-1), (1<<j)-1 );
+
+		// Index.
+		INT Total = Hits + Misses;
+		Ar.Logf( TEXT("FObjectHash: %i entries, %i slack, %i hits, %i misses (%.1f%% hit), %i stale, %i dropped."), Index.Num(), Index.GetSlack(), Hits, Misses, Total ? 100.f*Hits/Total : 0.f, Stale, Dropped );
+		unguard;
+	}
+
+private:
+	TFlatMap<FObjectHashKey,INT> Index;
+	INT Hits, Misses, Stale, Dropped;
+};
+
+// Global object index.
+extern COREI_API FObjectHash GObjectHash;
+
+/*-----------------------------------------------------------------------------
+	The End.
+-----------------------------------------------------------------------------*/
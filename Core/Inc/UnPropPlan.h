@@ -0,0 +1,381 @@
+/*=============================================================================
+	UnPropPlan.h: Precomputed property construction plans.
+	Copyright 2016-2019 Sebastian Kaufel, Inc. All Rights Reserved.
+
+	Notes:
+	* UObject::InitProperties() copies the defaults over the new object,
+	  then walks the ConstructorLink and zeros and copies each string,
+	  array and struct through virtual calls. ExitProperties() walks the
+	  same list to destroy them. An FPropertyPlan flattens this once per
+	  class into spans which are copied from the defaults or zeroed, and
+	  leaves which need construction or destruction.
+	* Strings, including those inside structs, are handled inline. Strings
+	  and dynamic arrays which are empty in the defaults need no work at
+	  all, as a zeroed FArray is a valid empty one. The defaults themselves
+	  are checked on every call, so changing them at runtime is fine.
+	* Use FPropertyPlans::InitProperties() and ExitProperties() wherever
+	  native code would call the UObject ones, they take the same
+	  arguments and fall back to them whenever a plan doesn't fit.
+	* Plans are checked against the class layout on each use, flushed
+	  after garbage collection and not used inside the editor.
+	* Use "PROPPLAN [ON|OFF|FLUSH]" to toggle it and report stats.
+	* Game thread only.
+=============================================================================*/
+
+/*-----------------------------------------------------------------------------
+	FPropertyPlan.
+-----------------------------------------------------------------------------*/
+
+//
+// Flattened construction and destruction steps for objects of a class.
+//
+struct FPropertyPlan
+{
+	// Kinds of leaves.
+	enum ELeafKind
+	{
+		LEAF_String,	// A single FString.
+		LEAF_Array,		// A single dynamic array.
+		LEAF_Generic,	// Anything else, all array elements.
+	};
+
+	// Part of the object copied from the defaults or zeroed.
+	struct FSpan
+	{
+		INT		Offset;
+		INT		Count;
+		UBOOL	Copy;
+	};
+
+	// Part of the object which needs construction and destruction.
+	struct FLeaf
+	{
+		INT			Offset;
+		INT			Count;
+		INT			Kind;
+		UProperty*	Property;
+	};
+
+	// Variables.
+	UClass*			Class;
+	UProperty*		ConstructorLink;
+	INT				Size;
+	UBOOL			Valid;
+	TArray<FSpan>	Spans;
+	TArray<FLeaf>	Leaves;
+
+	// Constructor.
+	FPropertyPlan( UClass* InClass )
+	:	Class( InClass )
+	,	ConstructorLink( InClass->ConstructorLink )
+	,	Size( InClass->Defaults.Num() )
+	,	Valid( 1 )
+	{
+		guard(FPropertyPlan::FPropertyPlan);
+		AddLeaves( ConstructorLink, 0 );
+		if( Leaves.Num() )
+			Sort( &Leaves(0), Leaves.Num(), FCompareLeaves() );
+
+		// Copy everything in between the leaves, zero the leaves.
+		INT Pos = sizeof(UObject);
+		for( INT i=0; i<Leaves.Num() && Valid; i++ )
+		{
+			FLeaf& Leaf = Leaves(i);
+			if( Leaf.Offset<Pos || Leaf.Offset+Leaf.Count>Size )
+				Valid = 0;
+			AddSpan( Pos, Leaf.Offset-Pos, 1 );
+			AddSpan( Leaf.Offset, Leaf.Count, 0 );
+			Pos = Leaf.Offset + Leaf.Count;
+		}
+		if( Pos>Size )
+			Valid = 0;
+		if( Valid )
+			AddSpan( Pos, Size-Pos, 1 );
+		unguard;
+	}
+
+	// Whether the plan still matches the class.
+	UBOOL Matches( UClass* InClass ) const
+	{
+		return InClass==Class && InClass->ConstructorLink==ConstructorLink && InClass->Defaults.Num()==Size;
+	}
+
+	// Construct the properties of Data from Defaults, which hold Size bytes.
+	void Init( BYTE* Data, INT DataCount, BYTE* Defaults ) const
+	{
+		guardSlow(FPropertyPlan::Init);
+		checkSlow(Valid);
+		checkSlow(DataCount>=Size);
+		for( INT i=0; i<Spans.Num(); i++ )
+		{
+			const FSpan& Span = Spans(i);
+			if( Span.Copy )
+				appMemcpy( Data+Span.Offset, Defaults+Span.Offset, Span.Count );
+			else
+				appMemzero( Data+Span.Offset, Span.Count );
+		}
+		if( DataCount>Size )
+			appMemzero( Data+Size, DataCount-Size );
+		for( INT j=0; j<Leaves.Num(); j++ )
+		{
+			const FLeaf& Leaf = Leaves(j);
+			BYTE*        Dest = Data     + Leaf.Offset;
+			BYTE*        Src  = Defaults + Leaf.Offset;
+			if( Leaf.Kind==LEAF_String )
+			{
+				if( ((FArray*)Src)->Num() )
+					*(FString*)Dest = *(FString*)Src;
+			}
+			else if( Leaf.Kind==LEAF_Array )
+			{
+				if( ((FArray*)Src)->Num() )
+					Leaf.Property->CopySingleValue( Dest, Src );
+			}
+			else Leaf.Property->CopyCompleteValue( Dest, Src );
+		}
+		unguardSlow;
+	}
+
+	// Destroy the properties of Data.
+	void Exit( BYTE* Data ) const
+	{
+		guardSlow(FPropertyPlan::Exit);
+		checkSlow(Valid);
+		for( INT i=0; i<Leaves.Num(); i++ )
+		{
+			const FLeaf& Leaf = Leaves(i);
+			BYTE*        Dest = Data + Leaf.Offset;
+			if( Leaf.Kind==LEAF_String )
+			{
+				if( ((FArray*)Dest)->GetData() )
+					((FString*)Dest)->~FString();
+			}
+			else if( Leaf.Kind==LEAF_Array )
+			{
+				if( ((FArray*)Dest)->GetData() )
+					Leaf.Property->DestroyValue( Dest );
+			}
+			else Leaf.Property->DestroyValue( Dest );
+		}
+		unguardSlow;
+	}
+
+private:
+	struct FCompareLeaves
+	{
+		INT operator()( const FLeaf& A, const FLeaf& B ) const
+		{
+			return A.Offset - B.Offset;
+		}
+	};
+
+	// Implementation.
+	void AddLeaves( UProperty* Link, INT BaseOffset )
+	{
+		guard(FPropertyPlan::AddLeaves);
+		for( UProperty* P=Link; P; P=P->ConstructorLinkNext )
+		{
+			INT              Offset = BaseOffset + P->Offset;
+			UStructProperty* Struct = Cast<UStructProperty>(P);
+			if( Cast<UStrProperty>(P) )
+			{
+				for( INT i=0; i<P->ArrayDim; i++ )
+					AddLeaf( LEAF_String, Offset+i*P->ElementSize, P->ElementSize, P );
+			}
+			else if( Struct && Struct->Struct && Struct->Struct->ConstructorLink )
+			{
+				for( INT j=0; j<P->ArrayDim; j++ )
+					AddLeaves( Struct->Struct->ConstructorLink, Offset+j*P->ElementSize );
+			}
+			else if( Cast<UArrayProperty>(P) && P->ArrayDim==1 )
+				AddLeaf( LEAF_Array, Offset, P->ElementSize, P );
+			else
+				AddLeaf( LEAF_Generic, Offset, P->GetSize(), P );
+		}
+		unguard;
+	}
+	void AddLeaf( INT Kind, INT Offset, INT Count, UProperty* Property )
+	{
+		FLeaf Leaf;
+		Leaf.Offset   = Offset;
+		Leaf.Count    = Count;
+		Leaf.Kind     = Kind;
+		Leaf.Property = Property;
+		Leaves.AddItem( Leaf );
+	}
+	void AddSpan( INT Offset, INT Count, UBOOL Copy )
+	{
+		if( Count<=0 )
+			return;
+		if( Spans.Num() )
+		{
+			FSpan& Last = Spans.Last();
+			if( Last.Copy==Copy && Last.Offset+Last.Count==Offset )
+			{
+				Last.Count += Count;
+				return;
+			}
+		}
+		FSpan Span;
+		Span.Offset = Offset;
+		Span.Count  = Count;
+		Span.Copy   = Copy;
+		Spans.AddItem( Span );
+	}
+};
+
+/*-----------------------------------------------------------------------------
+	FPropertyPlans.
+-----------------------------------------------------------------------------*/
+
+//
+// Property plans for each class, built on demand.
+//
+class FPropertyPlans : public FExec
+{
+public:
+	// Variables.
+	UBOOL Enabled;
+
+	// Constructors.
+	FPropertyPlans()
+	:	Enabled( 1 )
+	,	NumInits( 0 )
+	,	NumExits( 0 )
+	,	NumFallbacks( 0 )
+	{}
+	~FPropertyPlans()
+	{
+		Flush();
+	}
+
+	// FPropertyPlans interface.
+	void Flush()
+	{
+		guard(FPropertyPlans::Flush);
+		for( INT i=0; i<PlanList.Num(); i++ )
+			delete PlanList(i);
+		PlanList.Empty();
+		Plans.Empty();
+		Sentinel.Clear();
+		unguard;
+	}
+	FPropertyPlan* GetPlan( UClass* Class )
+	{
+		guardSlow(FPropertyPlans::GetPlan);
+		if( !Class || !IsUsable() )
+			return NULL;
+		FPropertyPlan* Plan = Plans.FindRef( Class );
+		if( !Plan || !Plan->Matches(Class) )
+		{
+			// Old plans stay around until the next flush.
+			Plan = new FPropertyPlan( Class );
+			PlanList.AddItem( Plan );
+			Plans.Set( Class, Plan );
+		}
+		return Plan->Valid ? Plan : NULL;
+		unguardSlow;
+	}
+
+	// Drop-in replacements for UObject::InitProperties() and ExitProperties().
+	void InitProperties( BYTE* Data, INT DataCount, UClass* DefaultsClass, BYTE* Defaults, INT DefaultsCount )
+	{
+		guardSlow(FPropertyPlans::InitProperties);
+		if( !Defaults && DefaultsClass && DefaultsClass->Defaults.Num() )
+		{
+			Defaults      = &DefaultsClass->Defaults(0);
+			DefaultsCount =  DefaultsClass->Defaults.Num();
+		}
+		FPropertyPlan* Plan = Defaults ? GetPlan( DefaultsClass ) : NULL;
+		if( Plan && DefaultsCount==Plan->Size && DataCount>=Plan->Size )
+		{
+			NumInits++;
+			Plan->Init( Data, DataCount, Defaults );
+		}
+		else
+		{
+			NumFallbacks++;
+			UObject::InitProperties( Data, DataCount, DefaultsClass, Defaults, DefaultsCount );
+		}
+		unguardSlow;
+	}
+	void ExitProperties( BYTE* Data, UClass* Class )
+	{
+		guardSlow(FPropertyPlans::ExitProperties);
+		FPropertyPlan* Plan = GetPlan( Class );
+		if( Plan )
+		{
+			NumExits++;
+			Plan->Exit( Data );
+		}
+		else
+		{
+			NumFallbacks++;
+			UObject::ExitProperties( Data, Class );
+		}
+		unguardSlow;
+	}
+
+	// FExec interface.
+	UBOOL Exec( const TCHAR* Cmd, FOutputDevice& Ar )
+	{
+		guard(FPropertyPlans::Exec);
+		if( ParseCommand(&Cmd,TEXT("PROPPLAN")) )
+		{
+			if( ParseCommand(&Cmd,TEXT("ON")) )
+				Enabled = 1;
+			else if( ParseCommand(&Cmd,TEXT("OFF")) )
+				Enabled = 0;
+			if( !Enabled || ParseCommand(&Cmd,TEXT("FLUSH")) )
+				Flush();
+			INT NumSpans=0, NumLeaves=0, NumInvalid=0;
+			for( INT i=0; i<PlanList.Num(); i++ )
+			{
+				NumSpans   += PlanList(i)->Spans.Num();
+				NumLeaves  += PlanList(i)->Leaves.Num();
+				NumInvalid += !PlanList(i)->Valid;
+			}
+			Ar.Logf( TEXT("Property plans %s: %i plans (%i invalid), %i spans, %i leaves, %.0f inits, %.0f exits, %.0f fallbacks."), Enabled ? TEXT("on") : TEXT("off"), PlanList.Num(), NumInvalid, NumSpans, NumLeaves, NumInits, NumExits, NumFallbacks );
+			return 1;
+		}
+		return 0;
+		unguard;
+	}
+
+private:
+	FPropertyPlans( const FPropertyPlans& );
+	void operator=( const FPropertyPlans& );
+
+	// Variables.
+	TArray<FPropertyPlan*>				PlanList;
+	TFlatMap<UClass*,FPropertyPlan*>	Plans;
+	FGarbageSentinel					Sentinel;
+	DOUBLE								NumInits;
+	DOUBLE								NumExits;
+	DOUBLE								NumFallbacks;
+
+	// Implementation.
+	UBOOL IsUsable()
+	{
+		if( !Enabled || GIsEditor )
+			return 0;
+#if DEUS_EX
+		if( UObject::IsInGarbageCollection() )
+			return 0;
+#endif
+		if( !Sentinel.IsAlive() )
+		{
+			// Classes may have been unloaded.
+			Flush();
+			Sentinel.Reset();
+		}
+		return 1;
+	}
+};
+
+// Global property plans.
+extern COREI_API FPropertyPlans GPropertyPlans;
+
+/*-----------------------------------------------------------------------------
+	The End.
+-----------------------------------------------------------------------------*/
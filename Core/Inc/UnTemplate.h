@@ -13,12 +13,17 @@
 //
 // Type information for initialization.
 //
+// Elements of a TArray are always relocated bitwise when the array grows or
+// is exchanged. IsBitwiseCopyable() additionally allows copies to be done
+// with a plain memcpy instead of running the copy constructor per element.
+//
 template <class T> struct TTypeInfoBase
 {
 public:
 	typedef const T& ConstInitType;
 	static UBOOL NeedsDestructor() {return 1;}
 	static UBOOL DefinitelyNeedsDestructor() {return 0;}
+	static UBOOL IsBitwiseCopyable() {return 0;}
 	static const T& ToInit( const T& In ) {return In;}
 };
 template <class T> struct TTypeInfo : public TTypeInfoBase<T>
@@ -29,56 +34,67 @@ template <> struct TTypeInfo<BYTE> : public TTypeInfoBase<BYTE>
 {
 public:
 	static UBOOL NeedsDestructor() {return 0;}
+	static UBOOL IsBitwiseCopyable() {return 1;}
 };
 template <> struct TTypeInfo<SBYTE> : public TTypeInfoBase<SBYTE>
 {
 public:
 	static UBOOL NeedsDestructor() {return 0;}
+	static UBOOL IsBitwiseCopyable() {return 1;}
 };
 template <> struct TTypeInfo<ANSICHAR> : public TTypeInfoBase<ANSICHAR>
 {
 public:
 	static UBOOL NeedsDestructor() {return 0;}
+	static UBOOL IsBitwiseCopyable() {return 1;}
 };
 template <> struct TTypeInfo<INT> : public TTypeInfoBase<INT>
 {
 public:
 	static UBOOL NeedsDestructor() {return 0;}
+	static UBOOL IsBitwiseCopyable() {return 1;}
 };
 template <> struct TTypeInfo<DWORD> : public TTypeInfoBase<DWORD>
 {
 public:
 	static UBOOL NeedsDestructor() {return 0;}
+	static UBOOL IsBitwiseCopyable() {return 1;}
 };
 template <> struct TTypeInfo<_WORD> : public TTypeInfoBase<_WORD>
 {
 public:
 	static UBOOL NeedsDestructor() {return 0;}
+	static UBOOL IsBitwiseCopyable() {return 1;}
 };
 template <> struct TTypeInfo<SWORD> : public TTypeInfoBase<SWORD>
 {
 public:
 	static UBOOL NeedsDestructor() {return 0;}
+	static UBOOL IsBitwiseCopyable() {return 1;}
 };
 template <> struct TTypeInfo<QWORD> : public TTypeInfoBase<QWORD>
 {
 public:
 	static UBOOL NeedsDestructor() {return 0;}
+	static UBOOL IsBitwiseCopyable() {return 1;}
 };
 template <> struct TTypeInfo<SQWORD> : public TTypeInfoBase<SQWORD>
 {
 public:
 	static UBOOL NeedsDestructor() {return 0;}
+	static UBOOL IsBitwiseCopyable() {return 1;}
 };
 template <> struct TTypeInfo<FName> : public TTypeInfoBase<FName>
 {
 public:
 	static UBOOL NeedsDestructor() {return 0;}
+	static UBOOL IsBitwiseCopyable() {return 1;}
 };
 template <> struct TTypeInfo<UObject*> : public TTypeInfoBase<UObject*>
 {
 public:
 	static UBOOL NeedsDestructor() {return 0;}
+	static UBOOL IsBitwiseCopyable() {return 1;}
 };
 
 /*-----------------------------------------------------------------------------
@@ -202,6 +218,15 @@ inline DWORD GetTypeHash( const TCHAR* S )
 #define STRUCT_OFFSET(struc,member) \
 	( (SIZE_T)&((struc*)NULL)->member )
 
+// Whether the compiler supports rvalue references (move semantics).
+#if !defined(DEFINED_RValueReferences)
+	#if (_MSC_VER>=1600) || (__cplusplus>=201103L)
+		#define DEFINED_RValueReferences 1
+	#else
+		#define DEFINED_RValueReferences 0
+	#endif
+#endif
+
 /*-----------------------------------------------------------------------------
 	Allocators.
 -----------------------------------------------------------------------------*/
@@ -333,6 +358,20 @@ public:
 		Realloc( ElementSize );
 		unguardSlow;
 	}
+	void Reserve( INT Count, INT ElementSize )
+	{
+		guardSlow(FArray::Reserve);
+		checkSlow(Count>=0);
+		checkSlow(ElementSize>0);
+		checkSlow(ArrayNum>=0);
+		checkSlow(ArrayMax>=ArrayNum);
+		if( Count>ArrayMax )
+		{
+			ArrayMax = Count;
+			Realloc( ElementSize );
+		}
+		unguardSlow;
+	}
 	void Empty( INT ElementSize, INT Slack=0 )
 	{
 		guardSlow(FArray::Empty);
@@ -399,7 +438,12 @@ public:
 	:	FArray( Other.ArrayNum, sizeof(T) )
 	{
 		guardSlow(TArray::copyctor);
-		if( TTypeInfo<T>::NeedsDestructor() )
+		if( TTypeInfo<T>::IsBitwiseCopyable() )
+		{
+			if( ArrayNum>0 )
+				appMemcpy( &(*this)(0), &Other(0), ArrayNum * sizeof(T) );
+		}
+		else if( TTypeInfo<T>::NeedsDestructor() )
 		{
 			ArrayNum=0;
 			for( INT i=0; i<Other.ArrayNum; i++ )
@@ -418,6 +462,17 @@ public:
 		}
 		unguardSlow;
 	}
+#if DEFINED_RValueReferences
+	TArray( TArray&& Other )
+	:	FArray()
+	{
+		Data           = Other.Data;
+		ArrayNum       = Other.ArrayNum;
+		ArrayMax       = Other.ArrayMax;
+		Other.Data     = NULL;
+		Other.ArrayNum = Other.ArrayMax = 0;
+	}
+#endif
 	TArray( ENoInit )
 	: FArray( E_NoInit )
 	{}
@@ -481,6 +536,12 @@ public:
 		FArray::Shrink( sizeof(T) );
 		unguardSlow;
 	}
+	void Reserve( INT Count )
+	{
+		guardSlow(TArray::Reserve);
+		FArray::Reserve( Count, sizeof(T) );
+		unguardSlow;
+	}
 	UBOOL FindItem( const T& Item, INT& Index ) const
 	{
 		guardSlow(TArray::FindItem);
@@ -622,12 +683,34 @@ public:
 		if( this != &Other )
 		{
 			Empty( Other.ArrayNum );
-			for( INT i=0; i<Other.ArrayNum; i++ )
-				new( *this )T( Other(i) );
+			if( TTypeInfo<T>::IsBitwiseCopyable() )
+			{
+				ArrayNum = Other.ArrayNum;
+				if( ArrayNum>0 )
+					appMemcpy( &(*this)(0), &Other(0), ArrayNum * sizeof(T) );
+			}
+			else
+			{
+				for( INT i=0; i<Other.ArrayNum; i++ )
+					new( *this )T( Other(i) );
+			}
+		}
+		return *this;
+		unguardSlow;
+	}
+#if DEFINED_RValueReferences
+	TArray& operator=( TArray&& Other )
+	{
+		guardSlow(TArray::operator=(&&));
+		if( this != &Other )
+		{
+			Empty();
+			appMemswap( (FArray*)this, (FArray*)&Other, sizeof(FArray) );
 		}
 		return *this;
 		unguardSlow;
 	}
+#endif
 	INT AddItem( const T& Item )
 	{
 		guardSlow(TArray::AddItem);
@@ -643,6 +726,42 @@ public:
 		(*this)(Index)=Item;
 		unguardSlow;
 	}
+	// Constructs a new element in place at the end of the array.
+	INT Emplace()
+	{
+		guardSlow(TArray::Emplace);
+		new(*this) T();
+		return ArrayNum-1;
+		unguardSlow;
+	}
+	template<class A1> INT Emplace( const A1& Arg1 )
+	{
+		guardSlow(TArray::Emplace);
+		new(*this) T(Arg1);
+		return ArrayNum-1;
+		unguardSlow;
+	}
+	template<class A1, class A2> INT Emplace( const A1& Arg1, const A2& Arg2 )
+	{
+		guardSlow(TArray::Emplace);
+		new(*this) T(Arg1,Arg2);
+		return ArrayNum-1;
+		unguardSlow;
+	}
+	template<class A1, class A2, class A3> INT Emplace( const A1& Arg1, const A2& Arg2, const A3& Arg3 )
+	{
+		guardSlow(TArray::Emplace);
+		new(*this) T(Arg1,Arg2,Arg3);
+		return ArrayNum-1;
+		unguardSlow;
+	}
+	template<class A1, class A2, class A3, class A4> INT Emplace( const A1& Arg1, const A2& Arg2, const A3& Arg3, const A4& Arg4 )
+	{
+		guardSlow(TArray::Emplace);
+		new(*this) T(Arg1,Arg2,Arg3,Arg4);
+		return ArrayNum-1;
+		unguardSlow;
+	}
 	INT AddZeroed( INT n=1 )
 	{
 		guardSlow(TArray::AddZeroed);
@@ -978,6 +1097,43 @@ public:
 		}
 		unguard;
 	}
+
+	// Returns the elements without loading them if the array is still
+	// pending and its linker reads from a memory mapped file (see
+	// FFileManagerMapped.h), so large payloads stay in the page cache
+	// instead of being copied to the heap. Otherwise loads and returns the
+	// array itself. Only valid for T serialized as its raw bytes (BYTE, INT,
+	// FLOAT and structs of these without padding). The payload size, which
+	// precedes it in the file, must match Count*sizeof(T), otherwise the
+	// elements are serialized differently and the array is loaded instead.
+	// The data is read only and stays valid while the array is attached to
+	// its linker; Load() it to modify it.
+	const T* GetMappedData( INT& OutNum )
+	{
+		guard(TLazyArray::GetMappedData);
+#if __INTEL_BYTE_ORDER__
+		if( SavedPos>=(INT)sizeof(INT) && SavedAr->Ver()>61 )
+		{
+			INT ViewSize;
+			const BYTE* View = appGetArchiveView( *SavedAr, ViewSize );
+			if( View && SavedPos<ViewSize )
+			{
+				INT EndPos = *(const INT*)(View+SavedPos-sizeof(INT));
+				INT Count, Used=appReadCompactIndex( View+SavedPos, ViewSize-SavedPos, Count );
+				if( Used && Count>=0 && EndPos<=ViewSize && Count<=(INT)((ViewSize-SavedPos-Used)/sizeof(T)) && EndPos-SavedPos-Used==Count*(INT)sizeof(T) )
+				{
+					OutNum = Count;
+					return (const T*)(View+SavedPos+Used);
+				}
+			}
+		}
+#endif
+		Load();
+		OutNum = this->Num();
+		return (const T*)this->GetData();
+		unguard;
+	}
+
 	void Unload()
 #if __GNUG__
 		;	// Function declaration.
@@ -1076,6 +1232,11 @@ public:
 	FString( ENoInit )
 	: TArray<TCHAR>( E_NoInit )
 	{}
+#if DEFINED_RValueReferences
+	FString( FString&& Other )
+	: TArray<TCHAR>( (TArray<TCHAR>&&)Other )
+	{}
+#endif
 	// What is this?
 	explicit CORE_API FString( BYTE   Arg, INT Digits=1 );
 	explicit CORE_API FString( SBYTE  Arg, INT Digits=1 );
@@ -1121,6 +1282,15 @@ public:
 		return *this;
 		unguardSlow;
 	}
+#if DEFINED_RValueReferences
+	FString& operator=( FString&& Other )
+	{
+		guardSlow(FString::operator=(FString&&));
+		TArray<TCHAR>::operator=( (TArray<TCHAR>&&)Other );
+		return *this;
+		unguardSlow;
+	}
+#endif
 	TCHAR& operator[]( INT i )
 	{
 		guardSlow(FString::operator());
@@ -1457,6 +1627,254 @@ inline void ExchangeString( FString& A, FString& B )
 
 #define FSTRING(str) FString(TEXT(str))
 
+/*----------------------------------------------------------------------------
+	TInlineString.
+----------------------------------------------------------------------------*/
+
+//
+// String with an inline buffer for up to N-1 characters, which only goes to
+// the heap once it outgrows it. Meant for short lived strings like parsed
+// tokens, path names and labels which would otherwise cost an allocation
+// each as FString.
+//
+// FString can't get an inline buffer itself as its layout is shared with
+// Core.dll and script (sizeof(FString) is part of every UStrProperty), so
+// this is a separate type which converts to and from FString and serializes
+// in FString's format.
+//
+template<INT N> class TInlineString
+{
+public:
+	// Constructors.
+	TInlineString()
+	:	Heap	( NULL )
+	,	Length	( 0 )
+	,	Capacity( N )
+	{
+		Inline[0] = 0;
+	}
+	TInlineString( const TCHAR* In )
+	:	Heap	( NULL )
+	,	Length	( 0 )
+	,	Capacity( N )
+	{
+		Assign( In, (In && *In) ? appStrlen(In) : 0 );
+	}
+	TInlineString( const FString& In )
+	:	Heap	( NULL )
+	,	Length	( 0 )
+	,	Capacity( N )
+	{
+		Assign( *In, In.Len() );
+	}
+	TInlineString( const TInlineString& Other )
+	:	Heap	( NULL )
+	,	Length	( 0 )
+	,	Capacity( N )
+	{
+		Assign( *Other, Other.Length );
+	}
+	~TInlineString()
+	{
+		if( Heap )
+			appFree( Heap );
+	}
+
+	// Assignment.
+	TInlineString& operator=( const TCHAR* Other )
+	{
+		if( Other!=GetData() )
+			Assign( Other, (Other && *Other) ? appStrlen(Other) : 0 );
+		return *this;
+	}
+	TInlineString& operator=( const FString& Other )
+	{
+		Assign( *Other, Other.Len() );
+		return *this;
+	}
+	TInlineString& operator=( const TInlineString& Other )
+	{
+		if( this!=&Other )
+			Assign( *Other, Other.Length );
+		return *this;
+	}
+
+	// Accessors.
+	const TCHAR* operator*() const
+	{
+		return GetData();
+	}
+	TCHAR& operator[]( INT i )
+	{
+		checkSlow(i>=0);
+		checkSlow(i<Length);
+		return GetData()[i];
+	}
+	const TCHAR& operator[]( INT i ) const
+	{
+		checkSlow(i>=0);
+		checkSlow(i<Length);
+		return GetData()[i];
+	}
+	operator UBOOL() const
+	{
+		return Length!=0;
+	}
+	INT Len() const
+	{
+		return Length;
+	}
+	UBOOL IsInline() const
+	{
+		return Heap==NULL;
+	}
+	FString ToString() const
+	{
+		return FString( GetData() );
+	}
+
+	// Modification.
+	void Empty()
+	{
+		Length       = 0;
+		GetData()[0] = 0;
+	}
+	void Reserve( INT Count )
+	{
+		TCHAR* OldHeap = Grow( Count );
+		if( OldHeap )
+			appFree( OldHeap );
+	}
+	TInlineString& operator+=( const TCHAR* Str )
+	{
+		if( Str && *Str )
+			Append( Str, appStrlen(Str) );
+		return *this;
+	}
+	TInlineString& operator+=( const FString& Str )
+	{
+		Append( *Str, Str.Len() );
+		return *this;
+	}
+	TInlineString& operator+=( TCHAR Ch )
+	{
+		Append( &Ch, 1 );
+		return *this;
+	}
+	TInlineString& operator*=( const TCHAR* Str )
+	{
+		if( Length>0 && GetData()[Length-1]!=PATH_SEPARATOR[0] )
+			*this += PATH_SEPARATOR;
+		return *this += Str;
+	}
+
+	// Comparison, case insensitive like FString.
+	UBOOL operator==( const TCHAR* Other ) const
+	{
+		return appStricmp( GetData(), Other )==0;
+	}
+	UBOOL operator!=( const TCHAR* Other ) const
+	{
+		return appStricmp( GetData(), Other )!=0;
+	}
+	UBOOL operator==( const FString& Other ) const
+	{
+		return appStricmp( GetData(), *Other )==0;
+	}
+	UBOOL operator!=( const FString& Other ) const
+	{
+		return appStricmp( GetData(), *Other )!=0;
+	}
+
+	// Serializer, same format as FString.
+	friend FArchive& operator<<( FArchive& Ar, TInlineString& S )
+	{
+		guard(TInlineString<<);
+		FString Temp;
+		if( !Ar.IsLoading() )
+			Temp = *S;
+		Ar << Temp;
+		if( Ar.IsLoading() )
+			S = Temp;
+		return Ar;
+		unguard;
+	}
+
+private:
+	TCHAR* GetData()
+	{
+		return Heap ? Heap : Inline;
+	}
+	const TCHAR* GetData() const
+	{
+		return Heap ? Heap : Inline;
+	}
+	TCHAR* Grow( INT Count )
+	{
+		// Returns the old heap buffer, which the caller has to free.
+		guardSlow(TInlineString::Grow);
+		if( Count+1<=Capacity )
+			return NULL;
+		TCHAR* OldHeap  = Heap;
+		INT NewCapacity = Max( Count+1, Capacity*2 );
+		TCHAR* NewHeap  = (TCHAR*)appMalloc( NewCapacity*sizeof(TCHAR), TEXT("InlineString") );
+		appMemcpy( NewHeap, GetData(), (Length+1)*sizeof(TCHAR) );
+		Heap     = NewHeap;
+		Capacity = NewCapacity;
+		return OldHeap;
+		unguardSlow;
+	}
+	void Assign( const TCHAR* Str, INT Count )
+	{
+		// Str may point into our own buffer, in which case it can't grow.
+		Reserve( Count );
+		if( Count )
+			appMemmove( GetData(), Str, Count*sizeof(TCHAR) );
+		Length = Count;
+		GetData()[Count] = 0;
+	}
+	void Append( const TCHAR* Str, INT Count )
+	{
+		// Keep the old buffer alive while copying, Str may point into it.
+		TCHAR* OldHeap = Grow( Length+Count );
+		appMemcpy( GetData()+Length, Str, Count*sizeof(TCHAR) );
+		Length += Count;
+		GetData()[Length] = 0;
+		if( OldHeap )
+			appFree( OldHeap );
+	}
+
+	TCHAR*	Heap;
+	INT		Length;
+	INT		Capacity;
+	TCHAR	Inline[N];
+};
+
+//
+// Token parser for inline strings. Tokens which fit stay off the heap.
+//
+template<INT N> UBOOL ParseToken( const TCHAR*& Str, TInlineString<N>& Arg, UBOOL UseEscape )
+{
+	guard(ParseToken);
+	const TCHAR* Start = Str;
+	TCHAR Buffer[N];
+	if( !ParseToken( Str, Buffer, N, UseEscape ) )
+		return 0;
+	if( appStrlen(Buffer)<N-1 )
+	{
+		Arg = Buffer;
+		return 1;
+	}
+
+	// Might have been truncated.
+	Str = Start;
+	FString Temp;
+	UBOOL Result = ParseToken( Str, Temp, UseEscape );
+	Arg = Temp;
+	return Result;
+	unguard;
+}
+
 /*----------------------------------------------------------------------------
 	Special archivers.
 ----------------------------------------------------------------------------*/
@@ -1929,92 +2347,689 @@ public:
 // !! TMultiMapNoInit !!
 
 /*----------------------------------------------------------------------------
-	Sorting template.
+	TFlatMap.
 ----------------------------------------------------------------------------*/
 
 //
-// Sort elements. The sort is unstable, meaning that the ordering of equal 
-// items is not necessarily preserved.
+// Placement new for containers which manage their own storage.
 //
-template<class T> struct TStack
+enum EInPlace {E_InPlace=0};
+inline void* operator new( size_t Size, EInPlace, void* Mem )
 {
-	T* Min;
-	T* Max;
+	return Mem;
+}
+
+//
+// Control byte group matching for TFlatMap. Each bucket has a control byte,
+// which is either empty, deleted or holds 7 bits of the key's hash. Probing
+// compares a whole group of control bytes at once, 16 with SSE2, 8 otherwise.
+//
+#if defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#include <emmintrin.h>
+struct FFlatMapGroup
+{
+	enum {WIDTH=16};
+	typedef DWORD TMask;
+	__m128i Ctrl;
+	FFlatMapGroup( const BYTE* Pos )
+	:	Ctrl( _mm_loadu_si128((const __m128i*)Pos) )
+	{}
+	DWORD Match( BYTE H2 ) const
+	{
+		return _mm_movemask_epi8( _mm_cmpeq_epi8(Ctrl,_mm_set1_epi8(H2)) );
+	}
+	DWORD MatchEmpty() const
+	{
+		return _mm_movemask_epi8( _mm_cmpeq_epi8(Ctrl,_mm_set1_epi8((char)0x80)) );
+	}
+	DWORD MatchEmptyOrDeleted() const
+	{
+		return _mm_movemask_epi8( Ctrl );
+	}
+	static INT LowestBit( DWORD Mask )
+	{
+		return appCountTrailingZeros( Mask );
+	}
+	static DWORD ClearLowestBit( DWORD Mask )
+	{
+		return Mask&(Mask-1);
+	}
 };
-template<class T> void Sort( T* First, INT Num )
+#else
+struct FFlatMapGroup
 {
-	guard(Sort);
-	if( Num<2 )
-		return;
-	TStack<T> RecursionStack[32]={{First,First+Num-1}}, Current, Inner;
-	for( TStack<T>* StackTop=RecursionStack; StackTop>=RecursionStack; --StackTop )
+	enum {WIDTH=8};
+	typedef QWORD TMask;
+	QWORD Ctrl;
+	FFlatMapGroup( const BYTE* Pos )
+	:	Ctrl( *(const QWORD*)Pos )
+	{}
+	QWORD Match( BYTE H2 ) const
+	{
+		// May report false positives right after a true match, keys are compared anyway.
+		QWORD X = Ctrl ^ (QWORD(0x0101010101010101)*H2);
+		return (X-QWORD(0x0101010101010101)) & ~X & QWORD(0x8080808080808080);
+	}
+	QWORD MatchEmpty() const
+	{
+		return Ctrl & ~(Ctrl<<6) & QWORD(0x8080808080808080);
+	}
+	QWORD MatchEmptyOrDeleted() const
+	{
+		return Ctrl & QWORD(0x8080808080808080);
+	}
+	static INT LowestBit( QWORD Mask )
+	{
+		return ((DWORD)Mask ? appCountTrailingZeros((DWORD)Mask) : 32+appCountTrailingZeros((DWORD)(Mask>>32))) >> 3;
+	}
+	static QWORD ClearLowestBit( QWORD Mask )
+	{
+		return Mask&(Mask-1);
+	}
+};
+#endif
+
+//
+// Maps unique keys to values, like TMap, but stores the pairs inline in an
+// open addressed table, so lookups touch one or two cache lines and adding
+// and removing never allocates until the table has to grow. The load
+// factor is held below 7/8.
+//
+// Pairs are moved bitwise when the table grows, just like TArray moves its
+// elements. Pointers to values are invalidated by adding to the map.
+// Serializes in the same format as TMap.
+//
+template< class TK, class TI > class TFlatMap
+{
+public:
+	// Constants.
+	enum {CTRL_EMPTY=0x80};
+	enum {CTRL_DELETED=0xFE};
+	enum {MIN_BUCKETS=FFlatMapGroup::WIDTH};
+
+	class TPair
+	{
+	public:
+		TK Key;
+		TI Value;
+		TPair( typename TTypeInfo<TK>::ConstInitType InKey, typename TTypeInfo<TI>::ConstInitType InValue )
+		: Key( InKey ), Value( InValue )
+		{}
+	};
+
+	// Constructors.
+	TFlatMap()
+	:	Ctrl( NULL )
+	,	Pairs( NULL )
+	,	NumBuckets( 0 )
+	,	NumPairs( 0 )
+	,	GrowthLeft( 0 )
+	{}
+	TFlatMap( const TFlatMap& Other )
+	:	Ctrl( NULL )
+	,	Pairs( NULL )
+	,	NumBuckets( 0 )
+	,	NumPairs( 0 )
+	,	GrowthLeft( 0 )
+	{
+		guardSlow(TFlatMap::TFlatMap copy);
+		Copy( Other );
+		unguardSlow;
+	}
+	~TFlatMap()
+	{
+		DestroyPairs();
+		if( Ctrl )
+			appFree( Ctrl );
+		Ctrl = NULL;
+	}
+	TFlatMap& operator=( const TFlatMap& Other )
+	{
+		guardSlow(TFlatMap::operator=);
+		if( this!=&Other )
+		{
+			Empty();
+			Copy( Other );
+		}
+		return *this;
+		unguardSlow;
+	}
+
+	// TFlatMap interface.
+	INT Num() const
+	{
+		return NumPairs;
+	}
+	INT GetSlack() const
+	{
+		// Adding never allocates while this is nonzero.
+		return GrowthLeft;
+	}
+	void Empty( INT Slack=0 )
+	{
+		guardSlow(TFlatMap::Empty);
+		DestroyPairs();
+		if( Ctrl )
+			appFree( Ctrl );
+		Ctrl       = NULL;
+		Pairs      = NULL;
+		NumBuckets = 0;
+		NumPairs   = 0;
+		GrowthLeft = 0;
+		if( Slack )
+			Reserve( Slack );
+		unguardSlow;
+	}
+	void Reserve( INT Count )
+	{
+		guardSlow(TFlatMap::Reserve);
+		INT NewBuckets = NumBuckets ? NumBuckets : MIN_BUCKETS;
+		while( NewBuckets-NewBuckets/8 < Count )
+			NewBuckets *= 2;
+		if( NewBuckets!=NumBuckets )
+			Rehash( NewBuckets );
+		unguardSlow;
+	}
+	TI& Set( typename TTypeInfo<TK>::ConstInitType InKey, typename TTypeInfo<TI>::ConstInitType InValue )
+	{
+		guardSlow(TFlatMap::Set);
+		DWORD Hash  = HashKey( InKey );
+		INT   Index = FindIndex( InKey, Hash );
+		if( Index!=INDEX_NONE )
+		{
+			Pairs[Index].Value = InValue;
+			return Pairs[Index].Value;
+		}
+		Index = PrepareInsert( Hash );
+		return (new(E_InPlace,&Pairs[Index])TPair( InKey, InValue ))->Value;
+		unguardSlow;
+	}
+	INT Remove( typename TTypeInfo<TK>::ConstInitType InKey )
+	{
+		guardSlow(TFlatMap::Remove);
+		INT Index = FindIndex( InKey, HashKey(InKey) );
+		if( Index==INDEX_NONE )
+			return 0;
+		RemoveAt( Index );
+		return 1;
+		unguardSlow;
+	}
+	TI* Find( const TK& Key )
+	{
+		guardSlow(TFlatMap::Find);
+		INT Index = FindIndex( Key, HashKey(Key) );
+		return Index!=INDEX_NONE ? &Pairs[Index].Value : NULL;
+		unguardSlow;
+	}
+	const TI* Find( const TK& Key ) const
+	{
+		guardSlow(TFlatMap::Find);
+		INT Index = FindIndex( Key, HashKey(Key) );
+		return Index!=INDEX_NONE ? &Pairs[Index].Value : NULL;
+		unguardSlow;
+	}
+	TI FindRef( const TK& Key ) const
 	{
-		Current = *StackTop;
-	Loop:
-		INT Count = Current.Max - Current.Min + 1;
-		if( Count <= 8 )
+		guardSlow(TFlatMap::Find);
+		INT Index = FindIndex( Key, HashKey(Key) );
+		return Index!=INDEX_NONE ? Pairs[Index].Value : NULL;
+		unguardSlow;
+	}
+	friend FArchive& operator<<( FArchive& Ar, TFlatMap& M )
+	{
+		guardSlow(TFlatMap<<);
+		INT Count = M.NumPairs;
+		Ar << AR_INDEX(Count);
+		if( Ar.IsLoading() )
 		{
-			// Use simple bubble-sort.
-			while( Current.Max > Current.Min )
+			M.Empty( Count );
+			for( INT i=0; i<Count; i++ )
 			{
-				T *Max, *Item;
-				for( Max=Current.Min, Item=Current.Min+1; Item<=Current.Max; Item++ )
-					if( Compare(*Item, *Max) > 0 )
-						Max = Item;
-				Exchange( *Max, *Current.Max-- );
+				TK Key;
+				TI Value;
+				Ar << Key << Value;
+				M.Set( Key, Value );
 			}
 		}
 		else
 		{
-			// Grab middle element so sort doesn't exhibit worst-cast behaviour with presorted lists.
-			Exchange( Current.Min[Count/2], Current.Min[0] );
-
-			// Divide list into two halves, one with items <=Current.Min, the other with items >Current.Max.
-			Inner.Min = Current.Min;
-			Inner.Max = Current.Max+1;
-			for( ; ; )
+			for( INT i=0; i<M.NumBuckets; i++ )
+				if( M.IsFull(i) )
+					Ar << M.Pairs[i].Key << M.Pairs[i].Value;
+		}
+		return Ar;
+		unguardSlow;
+	}
+	void Dump( FOutputDevice& Ar )
+	{
+		guard(TFlatMap::Dump);
+		INT Deleted=0, Displaced=0, Worst=0;
+		for( INT i=0; i<NumBuckets; i++ )
+		{
+			if( Ctrl[i]==CTRL_DELETED )
+				Deleted++;
+			else if( IsFull(i) )
 			{
-				while( ++Inner.Min<=Current.Max && Compare(*Inner.Min, *Current.Min) <= 0 );
-				while( --Inner.Max> Current.Min && Compare(*Inner.Max, *Current.Min) >= 0 );
-				if( Inner.Min>Inner.Max )
-					break;
-				Exchange( *Inner.Min, *Inner.Max );
+				// Distance from the bucket the hash points at.
+				INT Distance = (i-(INT)(HashKey(Pairs[i].Key)>>7)) & (NumBuckets-1);
+				if( Distance>=FFlatMapGroup::WIDTH )
+					Displaced++;
+				Worst = Max( Worst, Distance );
 			}
-			Exchange( *Current.Min, *Inner.Max );
+		}
+		Ar.Logf( TEXT("TFlatMap: %i items, %i deleted, %i buckets, %i outside home group, worst distance %i."), NumPairs, Deleted, NumBuckets, Displaced, Worst );
+		unguard;
+	}
+	class TIterator
+	{
+	public:
+		TIterator( TFlatMap<TK,TI>& InMap ) : Map( InMap ), Index( -1 ) { ++*this; }
+		void operator++()          { while( ++Index<Map.NumBuckets && !Map.IsFull(Index) ); }
+		void Increment()           { ++*this; }
+		void RemoveCurrent()       { Map.RemoveAt( Index ); }
+		operator UBOOL() const     { return Index<Map.NumBuckets; }
+		TK& Key() const            { return Map.Pairs[Index].Key; }
+		TI& Value() const          { return Map.Pairs[Index].Value; }
+	private:
+		TFlatMap<TK,TI>& Map;
+		INT Index;
+	};
+	friend class TIterator;
+
+private:
+	// Variables.
+	BYTE*  Ctrl;		// NumBuckets control bytes, followed by a copy of the first WIDTH-1.
+	TPair* Pairs;		// Stored in the same allocation as Ctrl.
+	INT    NumBuckets;	// Zero or a power of two >= MIN_BUCKETS.
+	INT    NumPairs;
+	INT    GrowthLeft;	// Number of empty buckets which may still be filled before growing.
+
+	// Hashing.
+	static DWORD HashKey( const TK& Key )
+	{
+		// GetTypeHash is often the identity, spread it over all bits.
+		DWORD Hash = GetTypeHash(Key) * 0x9E3779B1;
+		return Hash ^ (Hash>>16);
+	}
+	UBOOL IsFull( INT Index ) const
+	{
+		return Ctrl[Index]<0x80;
+	}
+	void SetCtrl( INT Index, BYTE Value )
+	{
+		Ctrl[Index] = Value;
+		if( Index<FFlatMapGroup::WIDTH-1 )
+			Ctrl[NumBuckets+Index] = Value;
+	}
 
-			// Save big half and recurse with small half.
-			if( Inner.Max-1-Current.Min >= Current.Max-Inner.Min )
+	// Lookup.
+	INT FindIndex( const TK& Key, DWORD Hash ) const
+	{
+		if( !NumPairs )
+			return INDEX_NONE;
+		INT  Mask = NumBuckets-1;
+		BYTE H2   = Hash & 0x7F;
+		for( INT Pos=(Hash>>7)&Mask, Stride=0; ; Stride+=FFlatMapGroup::WIDTH, Pos=(Pos+Stride)&Mask )
+		{
+			FFlatMapGroup Group( Ctrl+Pos );
+			for( FFlatMapGroup::TMask Match=Group.Match(H2); Match; Match=FFlatMapGroup::ClearLowestBit(Match) )
 			{
-				if( Current.Min+1 < Inner.Max )
-				{
-					StackTop->Min = Current.Min;
-					StackTop->Max = Inner.Max - 1;
-					StackTop++;
-				}
-				if( Current.Max>Inner.Min )
-				{
-					Current.Min = Inner.Min;
-					goto Loop;
-				}
+				INT Index = (Pos+FFlatMapGroup::LowestBit(Match)) & Mask;
+				if( Pairs[Index].Key==Key )
+					return Index;
 			}
-			else
+			if( Group.MatchEmpty() )
+				return INDEX_NONE;
+		}
+	}
+	INT FindInsertIndex( DWORD Hash ) const
+	{
+		INT Mask = NumBuckets-1;
+		for( INT Pos=(Hash>>7)&Mask, Stride=0; ; Stride+=FFlatMapGroup::WIDTH, Pos=(Pos+Stride)&Mask )
+		{
+			FFlatMapGroup::TMask Free = FFlatMapGroup(Ctrl+Pos).MatchEmptyOrDeleted();
+			if( Free )
+				return (Pos+FFlatMapGroup::LowestBit(Free)) & Mask;
+		}
+	}
+	INT PrepareInsert( DWORD Hash )
+	{
+		INT Index = NumBuckets ? FindInsertIndex( Hash ) : INDEX_NONE;
+		if( Index==INDEX_NONE || (GrowthLeft==0 && Ctrl[Index]==CTRL_EMPTY) )
+		{
+			// Drop tombstones if they make up for much of the table, otherwise grow.
+			Rehash( NumBuckets && NumPairs<=(NumBuckets-NumBuckets/8)/2 ? NumBuckets : Max<INT>(NumBuckets*2,MIN_BUCKETS) );
+			Index = FindInsertIndex( Hash );
+		}
+		if( Ctrl[Index]==CTRL_EMPTY )
+			GrowthLeft--;
+		SetCtrl( Index, Hash & 0x7F );
+		NumPairs++;
+		return Index;
+	}
+	void RemoveAt( INT Index )
+	{
+		checkSlow(IsFull(Index));
+		(&Pairs[Index])->~TPair();
+		SetCtrl( Index, CTRL_DELETED );
+		NumPairs--;
+	}
+
+	// Storage.
+	void Rehash( INT NewBuckets )
+	{
+		guardSlow(TFlatMap::Rehash);
+		checkSlow(!(NewBuckets&(NewBuckets-1)));
+		checkSlow(NewBuckets>=MIN_BUCKETS);
+		BYTE*  OldCtrl    = Ctrl;
+		TPair* OldPairs   = Pairs;
+		INT    OldBuckets = NumBuckets;
+
+		INT CtrlSize = Align( NewBuckets+FFlatMapGroup::WIDTH, DEFAULT_ALIGNMENT );
+		Ctrl       = (BYTE*)appMalloc( CtrlSize+NewBuckets*sizeof(TPair), TEXT("FlatMap") );
+		Pairs      = (TPair*)(Ctrl+CtrlSize);
+		NumBuckets = NewBuckets;
+		GrowthLeft = NewBuckets-NewBuckets/8-NumPairs;
+		appMemset( Ctrl, CTRL_EMPTY, NewBuckets+FFlatMapGroup::WIDTH );
+
+		// Relocate the pairs.
+		for( INT i=0; i<OldBuckets; i++ )
+		{
+			if( OldCtrl[i]<0x80 )
 			{
-				if( Current.Max>Inner.Min )
-				{
-					StackTop->Min = Inner  .Min;
-					StackTop->Max = Current.Max;
-					StackTop++;
-				}
-				if( Current.Min+1<Inner.Max )
-				{
-					Current.Max = Inner.Max - 1;
-					goto Loop;
-				}
+				DWORD Hash  = HashKey( OldPairs[i].Key );
+				INT   Index = FindInsertIndex( Hash );
+				SetCtrl( Index, Hash & 0x7F );
+				appMemcpy( &Pairs[Index], &OldPairs[i], sizeof(TPair) );
 			}
 		}
+		if( OldCtrl )
+			appFree( OldCtrl );
+		unguardSlow;
+	}
+	void DestroyPairs()
+	{
+		if( TTypeInfo<TK>::NeedsDestructor() || TTypeInfo<TI>::NeedsDestructor() )
+			for( INT i=0; i<NumBuckets; i++ )
+				if( IsFull(i) )
+					(&Pairs[i])->~TPair();
+	}
+	void Copy( const TFlatMap& Other )
+	{
+		Reserve( Other.NumPairs );
+		for( INT i=0; i<Other.NumBuckets; i++ )
+			if( Other.IsFull(i) )
+				Set( Other.Pairs[i].Key, Other.Pairs[i].Value );
+	}
+};
+
+/*----------------------------------------------------------------------------
+	Sorting template.
+----------------------------------------------------------------------------*/
+
+//
+// Sort elements. The sort is unstable, meaning that the ordering of equal 
+// items is not necessarily preserved.
+//
+// Introsort: quicksort with median of three (ninther for large ranges)
+// pivots, insertion sort for small ranges and heapsort once the recursion
+// gets too deep, so the worst case stays O(n log n). Ranges which are found
+// to be already partitioned get a bounded insertion sort attempt first, so
+// sorted and nearly sorted input is handled in linear time.
+//
+// Elements are compared with Compare(A,B), or with a predicate object whose
+// operator()(A,B) returns <0, 0 or >0 like Compare.
+//
+template<class T> struct TCompareGlobal
+{
+	INT operator()( T& A, T& B ) const
+	{
+		return Compare( A, B );
+	}
+};
+enum {SORT_INSERTION_THRESHOLD=16};
+enum {SORT_NINTHER_THRESHOLD=128};
+enum {SORT_PARTIAL_INSERTION_LIMIT=8};
+
+template<class T, class PREDICATE> void SortInsertion( T* Min, T* Max, const PREDICATE& Pred )
+{
+	for( T* Item=Min+1; Item<=Max; Item++ )
+		for( T* Inner=Item; Inner>Min && Pred(*Inner, *(Inner-1))<0; Inner-- )
+			Exchange( *Inner, *(Inner-1) );
+}
+template<class T, class PREDICATE> UBOOL SortPartialInsertion( T* Min, T* Max, const PREDICATE& Pred )
+{
+	// Like SortInsertion, but gives up after moving a few elements.
+	INT Moved = 0;
+	for( T* Item=Min+1; Item<=Max; Item++ )
+	{
+		T* Inner;
+		for( Inner=Item; Inner>Min && Pred(*Inner, *(Inner-1))<0; Inner-- )
+			Exchange( *Inner, *(Inner-1) );
+		Moved += Item - Inner;
+		if( Moved>SORT_PARTIAL_INSERTION_LIMIT )
+			return Item==Max;
+	}
+	return 1;
+}
+template<class T, class PREDICATE> void SortSiftDown( T* Heap, INT Root, INT Count, const PREDICATE& Pred )
+{
+	for( INT Child=2*Root+1; Child<Count; Root=Child, Child=2*Root+1 )
+	{
+		if( Child+1<Count && Pred(Heap[Child], Heap[Child+1])<0 )
+			Child++;
+		if( Pred(Heap[Root], Heap[Child])>=0 )
+			break;
+		Exchange( Heap[Root], Heap[Child] );
+	}
+}
+template<class T, class PREDICATE> void SortHeap( T* First, INT Count, const PREDICATE& Pred )
+{
+	INT i;
+	for( i=Count/2-1; i>=0; i-- )
+		SortSiftDown( First, i, Count, Pred );
+	for( i=Count-1; i>0; i-- )
+	{
+		Exchange( First[0], First[i] );
+		SortSiftDown( First, 0, i, Pred );
+	}
+}
+template<class T, class PREDICATE> void SortMedianOfThree( T* A, T* B, T* C, const PREDICATE& Pred )
+{
+	// Orders the three so that *A <= *B <= *C.
+	if( Pred(*B, *A)<0 )
+		Exchange( *A, *B );
+	if( Pred(*C, *B)<0 )
+	{
+		Exchange( *B, *C );
+		if( Pred(*B, *A)<0 )
+			Exchange( *A, *B );
+	}
+}
+template<class T, class PREDICATE> void SortRange( T* Min, T* Max, INT DepthLimit, const PREDICATE& Pred )
+{
+	for( ; ; )
+	{
+		INT Count = Max - Min + 1;
+		if( Count<=SORT_INSERTION_THRESHOLD )
+		{
+			SortInsertion( Min, Max, Pred );
+			return;
+		}
+		if( DepthLimit--<=0 )
+		{
+			SortHeap( Min, Count, Pred );
+			return;
+		}
+
+		// Choose pivot and move it to the front. The last element ends up >= pivot,
+		// which together with the pivot itself bounds both scans below.
+		T* Mid = Min + Count/2;
+		if( Count>SORT_NINTHER_THRESHOLD )
+		{
+			SortMedianOfThree( Min+1, Mid-1, Max-1, Pred );
+			SortMedianOfThree( Min+2, Mid+1, Max-2, Pred );
+			SortMedianOfThree( Mid-1, Mid,   Mid+1, Pred );
+		}
+		SortMedianOfThree( Min, Mid, Max, Pred );
+		Exchange( *Min, *Mid );
+
+		// Partition into [Min,Pivot-1] <= pivot <= [Pivot+1,Max]. Stopping on equal
+		// elements keeps the halves balanced when there are many duplicates.
+		T* Left  = Min;
+		T* Right = Max+1;
+		UBOOL Swapped = 0;
+		for( ; ; )
+		{
+			while( Pred(*++Left, *Min)<0 );
+			while( Pred(*--Right, *Min)>0 );
+			if( Left>=Right )
+				break;
+			Exchange( *Left, *Right );
+			Swapped = 1;
+		}
+		Exchange( *Min, *Right );
+		T* Pivot = Right;
+
+		// Already partitioned, chances are the input was (nearly) sorted.
+		if( !Swapped && SortPartialInsertion(Min, Pivot-1 < Min ? Min : Pivot-1, Pred) && SortPartialInsertion(Pivot+1 > Max ? Max : Pivot+1, Max, Pred) )
+			return;
+
+		// Recurse into the smaller half, loop on the bigger one.
+		if( Pivot-Min < Max-Pivot )
+		{
+			if( Min<Pivot-1 )
+				SortRange( Min, Pivot-1, DepthLimit, Pred );
+			Min = Pivot+1;
+		}
+		else
+		{
+			if( Pivot+1<Max )
+				SortRange( Pivot+1, Max, DepthLimit, Pred );
+			Max = Pivot-1;
+		}
+		if( Min>=Max )
+			return;
+	}
+}
+template<class T, class PREDICATE> void Sort( T* First, INT Num, const PREDICATE& Pred )
+{
+	guard(Sort);
+	if( Num<2 )
+		return;
+	SortRange( First, First+Num-1, 2*appFloorLogTwo(Num), Pred );
+	unguard;
+}
+template<class T> void Sort( T* First, INT Num )
+{
+	Sort( First, Num, TCompareGlobal<T>() );
+}
+
+//
+// Sorts large ranges on GThreadPool. The range is split into chunks which are
+// sorted with Sort() in parallel and then merged pairwise, also in parallel,
+// through a temporary buffer. Falls back to Sort() for small ranges or
+// without a pool. Elements are moved bitwise while merging, which every TArray
+// element type has to support anyway. Unlike Sort() the merge steps are stable.
+//
+enum {PARALLEL_SORT_MIN_CHUNK=8192};
+enum {PARALLEL_SORT_MAX_CHUNKS=16};
+
+template<class T, class PREDICATE> class TParallelSortWork : public FQueuedWork
+{
+public:
+	struct FRaw {BYTE Bytes[sizeof(T)];};
+	T*					Src;
+	T*					Dst;
+	INT					Start, Split, End;
+	const PREDICATE*	Pred;
+
+	void DoThreadedWork()
+	{
+		if( !Dst )
+		{
+			Sort( Src+Start, End-Start, *Pred );
+			return;
+		}
+		T* Left     = Src+Start;
+		T* LeftEnd  = Src+Split;
+		T* Right    = Src+Split;
+		T* RightEnd = Src+End;
+		T* Out      = Dst+Start;
+		while( Left<LeftEnd && Right<RightEnd )
+		{
+			if( (*Pred)(*Right, *Left)<0 )
+				*(FRaw*)Out++ = *(FRaw*)Right++;
+			else
+				*(FRaw*)Out++ = *(FRaw*)Left++;
+		}
+		if( Left<LeftEnd )
+			appMemcpy( Out, Left, (LeftEnd-Left)*sizeof(T) );
+		else if( Right<RightEnd )
+			appMemcpy( Out, Right, (RightEnd-Right)*sizeof(T) );
+	}
+};
+template<class T, class PREDICATE> void ParallelSort( T* First, INT Num, const PREDICATE& Pred )
+{
+	guard(ParallelSort);
+	INT NumChunks = 1;
+	if( GThreadPool )
+		while( NumChunks<PARALLEL_SORT_MAX_CHUNKS && NumChunks<=GThreadPool->GetNumThreads() && Num/(NumChunks*2)>=PARALLEL_SORT_MIN_CHUNK )
+			NumChunks *= 2;
+	if( NumChunks==1 )
+	{
+		Sort( First, Num, Pred );
+		return;
+	}
+
+	TParallelSortWork<T,PREDICATE> Work[PARALLEL_SORT_MAX_CHUNKS];
+	FQueuedWork* WorkPtrs[PARALLEL_SORT_MAX_CHUNKS];
+	INT i;
+	for( i=0; i<NumChunks; i++ )
+		WorkPtrs[i] = &Work[i];
+
+	// Sort chunks.
+	for( i=0; i<NumChunks; i++ )
+	{
+		Work[i].Src   = First;
+		Work[i].Dst   = NULL;
+		Work[i].Start = (INT)((QWORD)Num*i/NumChunks);
+		Work[i].Split = 0;
+		Work[i].End   = (INT)((QWORD)Num*(i+1)/NumChunks);
+		Work[i].Pred  = &Pred;
+	}
+	FQueuedWorkBatch( WorkPtrs, NumChunks ).Run();
+
+	// Merge neighbouring runs until one is left, ping-ponging between the
+	// input and the temporary buffer.
+	T* Temp = (T*)appMalloc( Num*sizeof(T), TEXT("ParallelSort") );
+	T* Src  = First;
+	T* Dst  = Temp;
+	for( INT NumRuns=NumChunks; NumRuns>1; NumRuns/=2 )
+	{
+		INT Runs[PARALLEL_SORT_MAX_CHUNKS+1];
+		for( i=0; i<=NumRuns; i++ )
+			Runs[i] = (INT)((QWORD)Num*i/NumRuns);
+		for( i=0; i<NumRuns/2; i++ )
+		{
+			Work[i].Src   = Src;
+			Work[i].Dst   = Dst;
+			Work[i].Start = Runs[2*i];
+			Work[i].Split = Runs[2*i+1];
+			Work[i].End   = Runs[2*i+2];
+		}
+		FQueuedWorkBatch( WorkPtrs, NumRuns/2 ).Run();
+		Exchange( Src, Dst );
 	}
+	if( Src!=First )
+		appMemcpy( First, Src, Num*sizeof(T) );
+	appFree( Temp );
 	unguard;
 }
+template<class T> void ParallelSort( T* First, INT Num )
+{
+	ParallelSort( First, Num, TCompareGlobal<T>() );
+}
 
 /*----------------------------------------------------------------------------
 	TDoubleLinkedList.
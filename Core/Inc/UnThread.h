@@ -0,0 +1,358 @@
+/*=============================================================================
+	UnThread.h: Threading primitives.
+	Copyright 2016-2019 Sebastian Kaufel, Inc. All Rights Reserved.
+
+	Notes:
+	* Core itself is not thread safe. These primitives exist so code which
+	  moves work onto other threads has something better than nothing.
+	* Atomic operations are provided by the platform headers.
+=============================================================================*/
+
+#if !DEFINED_appInterlocked
+	#error "Platform does not provide atomic operations."
+#endif
+
+/*-----------------------------------------------------------------------------
+	Thread functions (CoreI).
+-----------------------------------------------------------------------------*/
+
+COREI_API DWORD appGetCurrentThreadId();
+
+// Thread local storage. appTlsAlloc() returns INDEX_NONE on failure.
+COREI_API INT appTlsAlloc();
+COREI_API void appTlsFree( INT Slot );
+COREI_API void* appTlsGetValue( INT Slot );
+COREI_API void appTlsSetValue( INT Slot, void* Value );
+
+//
+// Notified on a thread which is about to exit, while its TLS is still
+// valid. CoreI calls the registered handlers from its thread detach
+// notification, so this covers threads created outside of Core as well.
+//
+class FThreadExitHandler
+{
+public:
+	virtual ~FThreadExitHandler() {}
+	virtual void ThreadExit()=0;
+};
+COREI_API void appRegisterThreadExitHandler( FThreadExitHandler* Handler );
+COREI_API void appUnregisterThreadExitHandler( FThreadExitHandler* Handler );
+
+/*-----------------------------------------------------------------------------
+	FThreadSafeCounter.
+-----------------------------------------------------------------------------*/
+
+//
+// Integer counter which may be modified by multiple threads.
+//
+class FThreadSafeCounter
+{
+public:
+	// Constructors.
+	FThreadSafeCounter( INT InValue=0 )
+	:	Value( InValue )
+	{}
+
+	// FThreadSafeCounter interface.
+	INT Increment()
+	{
+		return appInterlockedIncrement( &Value );
+	}
+	INT Decrement()
+	{
+		return appInterlockedDecrement( &Value );
+	}
+	INT Add( INT Amount )
+	{
+		return appInterlockedAdd( &Value, Amount );
+	}
+	INT Set( INT NewValue )
+	{
+		return appInterlockedExchange( &Value, NewValue );
+	}
+	INT GetValue() const
+	{
+		return Value;
+	}
+
+private:
+	// Not copyable, a copy would not be atomic anyway.
+	FThreadSafeCounter( const FThreadSafeCounter& );
+	void operator=( const FThreadSafeCounter& );
+
+	volatile INT Value;
+};
+
+/*-----------------------------------------------------------------------------
+	FSpinLock.
+-----------------------------------------------------------------------------*/
+
+//
+// Lightweight non recursive lock for very short critical sections.
+// Spins a couple of times before it starts to give up its time slice.
+//
+class FSpinLock
+{
+public:
+	// Constructors.
+	FSpinLock()
+	:	State( 0 )
+	{}
+
+	// FSpinLock interface.
+	UBOOL TryLock()
+	{
+		return State==0 && appInterlockedCompareExchange( &State, 1, 0 )==0;
+	}
+	void Lock()
+	{
+		for( INT Spins=0; !TryLock(); Spins++ )
+		{
+			if( Spins<64 )
+				appPause();
+			else
+				appSleep( 0.f );
+		}
+	}
+	void Unlock()
+	{
+		checkSlow(State==1);
+		appInterlockedExchange( &State, 0 );
+	}
+
+private:
+	FSpinLock( const FSpinLock& );
+	void operator=( const FSpinLock& );
+
+	volatile INT State;
+};
+
+//
+// Acquires a FSpinLock for the lifetime of the scope.
+//
+class FScopeLock
+{
+public:
+	FScopeLock( FSpinLock& InLock )
+	:	Lock( InLock )
+	{
+		Lock.Lock();
+	}
+	~FScopeLock()
+	{
+		Lock.Unlock();
+	}
+
+private:
+	FScopeLock( const FScopeLock& );
+	void operator=( const FScopeLock& );
+
+	FSpinLock& Lock;
+};
+
+/*-----------------------------------------------------------------------------
+	FLockFreeList.
+-----------------------------------------------------------------------------*/
+
+//
+// Lock-free intrusive LIFO list. Nodes store their Next pointer in the first
+// DWORD of the node itself. The head is tagged with a generation counter to
+// avoid the ABA problem, so this requires a 64 bit compare exchange and 32 bit
+// pointers.
+//
+// Popped nodes may still be read by a racing Pop(), so memory which has been
+// pushed must stay addressable while the list is in use (e.g. don't release
+// pages back to the OS).
+//
+class FLockFreeList
+{
+public:
+	// Constructors.
+	FLockFreeList()
+	{
+		Head.Value = 0;
+	}
+
+	// FLockFreeList interface.
+	void Push( void* Node )
+	{
+		guardSlow(FLockFreeList::Push);
+		checkSlow(Node);
+		FTaggedHead Old, New;
+		do
+		{
+			Old.Value  = Head.Value;
+			*(void**)Node = Old.Ptr;
+			New.Ptr    = Node;
+			New.Tag    = Old.Tag+1;
+		}
+		while( appInterlockedCompareExchange64( &Head.Value, New.Value, Old.Value )!=Old.Value );
+		unguardSlow;
+	}
+	void* Pop()
+	{
+		guardSlow(FLockFreeList::Pop);
+		FTaggedHead Old, New;
+		do
+		{
+			Old.Value = Head.Value;
+			if( !Old.Ptr )
+				return NULL;
+			New.Ptr   = *(void**)Old.Ptr;
+			New.Tag   = Old.Tag+1;
+		}
+		while( appInterlockedCompareExchange64( &Head.Value, New.Value, Old.Value )!=Old.Value );
+		return Old.Ptr;
+		unguardSlow;
+	}
+	void* PopAll()
+	{
+		guardSlow(FLockFreeList::PopAll);
+		FTaggedHead Old, New;
+		do
+		{
+			Old.Value = Head.Value;
+			New.Ptr   = NULL;
+			New.Tag   = Old.Tag+1;
+		}
+		while( appInterlockedCompareExchange64( &Head.Value, New.Value, Old.Value )!=Old.Value );
+		return Old.Ptr;
+		unguardSlow;
+	}
+	UBOOL IsEmpty() const
+	{
+		return Head.Ptr==NULL;
+	}
+
+private:
+	FLockFreeList( const FLockFreeList& );
+	void operator=( const FLockFreeList& );
+
+	// Tagged pointer, swapped as a whole.
+	union FTaggedHead
+	{
+		struct
+		{
+			void* Ptr;
+			DWORD Tag;
+		};
+		volatile SQWORD Value;
+	};
+	FTaggedHead Head;
+
+	// Ptr and Tag must fill Value exactly. 64 bit pointers would need a 128
+	// bit compare exchange, this fails to compile rather than corrupt the list.
+	typedef BYTE FTaggedHeadFitsInQWORD[sizeof(void*)==sizeof(DWORD) && sizeof(FTaggedHead)==sizeof(SQWORD) ? 1 : -1];
+};
+
+/*-----------------------------------------------------------------------------
+	Thread pool.
+-----------------------------------------------------------------------------*/
+
+//
+// A unit of work which can be executed on a pool thread. The pool must not
+// touch the work object after DoThreadedWork() returned.
+//
+class FQueuedWork
+{
+public:
+	virtual ~FQueuedWork() {}
+	virtual void DoThreadedWork()=0;
+};
+
+//
+// Pool of worker threads executing FQueuedWork in FIFO order.
+//
+class FQueuedThreadPool
+{
+public:
+	virtual ~FQueuedThreadPool() {}
+	virtual void AddQueuedWork( FQueuedWork* Work )=0;
+	virtual INT GetNumThreads()=0;
+	virtual UBOOL IsPoolThread()=0; // Whether the calling thread is one of the pool's.
+};
+
+// Global thread pool, created by CoreI. May be NULL (e.g. single core machines).
+extern COREI_API FQueuedThreadPool* GThreadPool;
+
+//
+// Executes a batch of independent work items on GThreadPool and the calling
+// thread, returning once all of them are done. Items are handed out one at a
+// time, so uneven items still balance. Runs serially without a pool.
+//
+// Runs serially on a pool thread as well. Waiting there for helpers queued
+// behind the caller's own work item could deadlock the pool.
+//
+class FQueuedWorkBatch
+{
+public:
+	enum {MAX_HELPERS=16};
+
+	// Constructors.
+	FQueuedWorkBatch( FQueuedWork** InWork, INT InNum )
+	:	Work( InWork )
+	,	Num( InNum )
+	{}
+
+	// FQueuedWorkBatch interface.
+	void Run()
+	{
+		guard(FQueuedWorkBatch::Run);
+		INT NumHelpers = GThreadPool && !GThreadPool->IsPoolThread() ? GThreadPool->GetNumThreads() : 0;
+		if( NumHelpers>Num-1 )
+			NumHelpers = Num-1;
+		if( NumHelpers>MAX_HELPERS )
+			NumHelpers = MAX_HELPERS;
+		if( NumHelpers<0 )
+			NumHelpers = 0;
+		Next.Set( 0 );
+		Pending.Set( NumHelpers );
+		for( INT i=0; i<NumHelpers; i++ )
+		{
+			Helpers[i].Batch = this;
+			GThreadPool->AddQueuedWork( &Helpers[i] );
+		}
+		Process();
+		for( INT Spins=0; Pending.GetValue()>0; Spins++ )
+		{
+			if( Spins<64 )
+				appPause();
+			else
+				appSleep( 0.f );
+		}
+		unguard;
+	}
+
+private:
+	FQueuedWorkBatch( const FQueuedWorkBatch& );
+	void operator=( const FQueuedWorkBatch& );
+
+	// Pool side helper, pulls items until the batch is exhausted.
+	class FHelper;
+	friend class FHelper;
+	class FHelper : public FQueuedWork
+	{
+	public:
+		FQueuedWorkBatch* Batch;
+		void DoThreadedWork()
+		{
+			Batch->Process();
+			Batch->Pending.Decrement(); // Batch may be gone after this.
+		}
+	};
+	void Process()
+	{
+		for( INT i=Next.Increment()-1; i<Num; i=Next.Increment()-1 )
+			Work[i]->DoThreadedWork();
+	}
+
+	FQueuedWork**		Work;
+	INT					Num;
+	FThreadSafeCounter	Next;
+	FThreadSafeCounter	Pending;
+	FHelper				Helpers[MAX_HELPERS];
+};
+
+/*-----------------------------------------------------------------------------
+	The End.
+-----------------------------------------------------------------------------*/
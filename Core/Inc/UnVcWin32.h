@@ -256,6 +256,131 @@ inline BYTE _BitScanReverse( DWORD* Index, DWORD Mask )
 }
 #endif
 
+/*-----------------------------------------------------------------------------
+	Atomic operations.
+-----------------------------------------------------------------------------*/
+
+//
+// All functions return the value *before* the operation, except for
+// Increment/Decrement which return the resulting value (like Win32 does).
+// Locked instructions act as full memory barriers on x86.
+//
+#if _MSC_VER>=1400
+#include <intrin.h>
+#define DEFINED_appInterlocked 1
+inline INT appInterlockedIncrement( volatile INT* Addend )
+{
+	return _InterlockedIncrement( (volatile long*)Addend );
+}
+inline INT appInterlockedDecrement( volatile INT* Addend )
+{
+	return _InterlockedDecrement( (volatile long*)Addend );
+}
+inline INT appInterlockedAdd( volatile INT* Addend, INT Value )
+{
+	return _InterlockedExchangeAdd( (volatile long*)Addend, Value );
+}
+inline INT appInterlockedExchange( volatile INT* Target, INT Value )
+{
+	return _InterlockedExchange( (volatile long*)Target, Value );
+}
+inline INT appInterlockedCompareExchange( volatile INT* Dest, INT Exchange, INT Comparand )
+{
+	return _InterlockedCompareExchange( (volatile long*)Dest, Exchange, Comparand );
+}
+inline SQWORD appInterlockedCompareExchange64( volatile SQWORD* Dest, SQWORD Exchange, SQWORD Comparand )
+{
+	return _InterlockedCompareExchange64( Dest, Exchange, Comparand );
+}
+inline void* appInterlockedCompareExchangePointer( void* volatile* Dest, void* Exchange, void* Comparand )
+{
+	return (void*)_InterlockedCompareExchange( (volatile long*)Dest, (long)Exchange, (long)Comparand );
+}
+inline void appMemoryBarrier()
+{
+	_mm_mfence();
+}
+inline void appPause()
+{
+	_mm_pause();
+}
+#elif ASM
+#define DEFINED_appInterlocked 1
+#pragma warning (push)
+#pragma warning (disable : 4035)
+inline INT appInterlockedAdd( volatile INT* Addend, INT Value )
+{
+	__asm
+	{
+		mov  ecx, [Addend]
+		mov  eax, [Value]
+		lock xadd [ecx], eax
+		mov  [Value], eax
+	}
+	return Value;
+}
+inline INT appInterlockedIncrement( volatile INT* Addend )
+{
+	return appInterlockedAdd( Addend, 1 ) + 1;
+}
+inline INT appInterlockedDecrement( volatile INT* Addend )
+{
+	return appInterlockedAdd( Addend, -1 ) - 1;
+}
+inline INT appInterlockedExchange( volatile INT* Target, INT Value )
+{
+	__asm
+	{
+		mov  ecx, [Target]
+		mov  eax, [Value]
+		xchg [ecx], eax
+		mov  [Value], eax
+	}
+	return Value;
+}
+inline INT appInterlockedCompareExchange( volatile INT* Dest, INT Exchange, INT Comparand )
+{
+	__asm
+	{
+		mov  ecx, [Dest]
+		mov  edx, [Exchange]
+		mov  eax, [Comparand]
+		lock cmpxchg [ecx], edx
+		mov  [Comparand], eax
+	}
+	return Comparand;
+}
+inline SQWORD appInterlockedCompareExchange64( volatile SQWORD* Dest, SQWORD Exchange, SQWORD Comparand )
+{
+	__asm
+	{
+		mov  esi, [Dest]
+		mov  ebx, dword ptr [Exchange]
+		mov  ecx, dword ptr [Exchange+4]
+		mov  eax, dword ptr [Comparand]
+		mov  edx, dword ptr [Comparand+4]
+		lock cmpxchg8b qword ptr [esi]
+		mov  dword ptr [Comparand], eax
+		mov  dword ptr [Comparand+4], edx
+	}
+	return Comparand;
+}
+inline void* appInterlockedCompareExchangePointer( void* volatile* Dest, void* Exchange, void* Comparand )
+{
+	return (void*)appInterlockedCompareExchange( (volatile INT*)Dest, (INT)Exchange, (INT)Comparand );
+}
+inline void appMemoryBarrier()
+{
+	__asm lock or dword ptr [esp], 0 // mfence is SSE2 only.
+}
+inline void appPause()
+{
+	__asm _emit 0xF3 // PAUSE (rep nop) - harmless on pre P4 cpus.
+	__asm _emit 0x90
+}
+#pragma warning (pop)
+#endif
+
 /*----------------------------------------------------------------------------
 	Functions.
 ----------------------------------------------------------------------------*/
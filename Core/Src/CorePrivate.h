@@ -27,6 +27,7 @@ extern UBOOL GExitPurge;
 -----------------------------------------------------------------------------*/
 
 #include "UnLinker.h"
+#include "UnAsyncLoad.h"
 
 /*-----------------------------------------------------------------------------
 	The End.
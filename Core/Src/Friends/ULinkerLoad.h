@@ -1 +1,2 @@
 friend class UObjectI;
+friend class FAsyncPackageLoader;
@@ -0,0 +1,750 @@
+/*=============================================================================
+	UnAsyncLoad.h: Background package loading.
+	Copyright 2016-2019 Sebastian Kaufel, Inc. All Rights Reserved.
+
+	Notes:
+	* A pool thread maps the file, parses the summary, name, import and
+	  export tables, interns the names in GConcurrentNames and touches every
+	  export, so the export data is read from memory later on. The game
+	  thread then resolves the names and builds the linker from these
+	  tables, instead of running the ULinkerLoad constructor which would
+	  read them all over again. Packages older than PACKAGE_MIN_VERSION
+	  still go through GetPackageLinker(), which asks whether to load them.
+	* Imports are verified and exports are created in time-sliced batches.
+	  Verifying is what ULinkerLoad::Verify() does, one import at a time.
+	  Each export batch ends in EndLoad(), which preloads and post loads.
+	* Packages imported by a request are read ahead the same way, before
+	  the linker verifies its imports and opens their linkers.
+	* Files which aren't plain packages, e.g. block compressed containers,
+	  are read whole through GFileManager instead of being mapped, so the
+	  tables are parsed from what the linker will read as well.
+	* Reads allocate from GMalloc on pool threads, so GMalloc has to be
+	  thread safe (e.g. FMallocSlab). Without GThreadPool the read is done
+	  right away.
+	* Call Tick() once a frame with the time it may take. Flush() finishes
+	  everything at once, e.g. before a level change or garbage collection.
+	  Neither can make progress while another load is in progress, so
+	  Flush() must not be called from within one (e.g. from PostLoad()).
+	* Requested packages, and the exports created so far, are kept in the
+	  root set until their callback ran, as nothing references the exports
+	  while they are loaded over several frames.
+=============================================================================*/
+
+/*-----------------------------------------------------------------------------
+	FAsyncPackageLoader.
+-----------------------------------------------------------------------------*/
+
+// Called on the game thread once a request is done. Package is NULL on error.
+typedef void (*FAsyncLoadCallback)( UPackage* Package, const TCHAR* Error, void* UserData );
+
+//
+// Loads packages over several frames, see notes above.
+//
+class FAsyncPackageLoader : public FExec
+{
+public:
+	// Constructors.
+	FAsyncPackageLoader()
+	:	NumLoaded( 0 )
+	,	NumFailed( 0 )
+	{}
+
+	// FAsyncPackageLoader interface.
+	void Exit()
+	{
+		guard(FAsyncPackageLoader::Exit);
+		for( INT i=0; i<Queue.Num(); i++ )
+		{
+			WaitForRead( Queue(i) );
+			if( Queue(i)->Rooted )
+				Queue(i)->Package->RemoveFromRoot();
+			UnrootExports( Queue(i) );
+			delete Queue(i);
+		}
+		for( INT j=0; j<Prefetches.Num(); j++ )
+		{
+			WaitForRead( Prefetches(j) );
+			delete Prefetches(j);
+		}
+		Queue.Empty();
+		Prefetches.Empty();
+		Prefetched.Empty();
+		unguard;
+	}
+
+	// Queues a package to be loaded. Returns 0 if it can't be found.
+	UBOOL LoadPackageAsync( const TCHAR* PackageName, FAsyncLoadCallback Callback=NULL, void* UserData=NULL )
+	{
+		guard(FAsyncPackageLoader::LoadPackageAsync);
+		FAsyncPackage* Pkg = Request( PackageName );
+		if( !Pkg )
+		{
+			if( Callback )
+				Callback( NULL, LocalizeError(TEXT("FileNotFound"),TEXT("Core")), UserData );
+			return 0;
+		}
+		Pkg->Callback = Callback;
+		Pkg->UserData = UserData;
+		Queue.AddItem( Pkg );
+		return 1;
+		unguard;
+	}
+
+	// Only reads a package ahead, so loading it later doesn't wait for the disk.
+	void Prefetch( const TCHAR* PackageName )
+	{
+		guard(FAsyncPackageLoader::Prefetch);
+		if( Prefetched.FindItemIndex(PackageName)!=INDEX_NONE || HasLinker(PackageName) )
+			return;
+		new(Prefetched)FString( PackageName );
+		FAsyncPackage* Pkg = Request( PackageName );
+		if( Pkg )
+			Prefetches.AddItem( Pkg );
+		unguard;
+	}
+
+	// Advances the requests in order, for at most MaxSeconds.
+	void Tick( FLOAT MaxSeconds )
+	{
+		guard(FAsyncPackageLoader::Tick);
+		Process( appSeconds()+MaxSeconds, 0 );
+		unguard;
+	}
+
+	// Finishes all requests.
+	void Flush()
+	{
+		guard(FAsyncPackageLoader::Flush);
+		check(UObject::GObjBeginLoadCount==0);
+		while( Queue.Num() || Prefetches.Num() )
+			Process( 0.0, 1 );
+		unguard;
+	}
+
+	UBOOL IsPending() const
+	{
+		return Queue.Num()>0;
+	}
+
+	// FExec interface.
+	UBOOL Exec( const TCHAR* Cmd, FOutputDevice& Ar )
+	{
+		guard(FAsyncPackageLoader::Exec);
+		if( ParseCommand(&Cmd,TEXT("ASYNCLOAD")) )
+		{
+			TCHAR PackageName[NAME_SIZE];
+			if( ParseCommand(&Cmd,TEXT("FLUSH")) )
+				Flush();
+			else if( ParseToken(Cmd,PackageName,ARRAY_COUNT(PackageName),0) && !LoadPackageAsync(PackageName) )
+				Ar.Logf( TEXT("Package %s not found."), PackageName );
+			static const TCHAR* StateNames[] = { TEXT("Reading"), TEXT("Linking"), TEXT("Verifying"), TEXT("Exports") };
+			for( INT i=0; i<Queue.Num(); i++ )
+			{
+				FAsyncPackage* Pkg = Queue(i);
+				if( Pkg->State==ASYNC_Verifying )
+					Ar.Logf( TEXT("  %s: %s %i/%i"), *Pkg->PackageName, StateNames[Pkg->State], Pkg->NextImport, Pkg->Linker->ImportMap.Num() );
+				else if( Pkg->State==ASYNC_Exports )
+					Ar.Logf( TEXT("  %s: %s %i/%i"), *Pkg->PackageName, StateNames[Pkg->State], Pkg->NextExport, Pkg->Linker->ExportMap.Num() );
+				else
+					Ar.Logf( TEXT("  %s: %s"), *Pkg->PackageName, StateNames[Pkg->State] );
+			}
+			Ar.Logf( TEXT("%i packages queued, %i reading ahead, %i loaded, %i failed."), Queue.Num(), Prefetches.Num(), NumLoaded, NumFailed );
+			return 1;
+		}
+		return 0;
+		unguard;
+	}
+
+private:
+	FAsyncPackageLoader( const FAsyncPackageLoader& );
+	void operator=( const FAsyncPackageLoader& );
+
+	// Request states, handled by the game thread in this order.
+	enum EAsyncState
+	{
+		ASYNC_Reading,	// Waiting for the pool thread and read aheads.
+		ASYNC_Linking,	// Creating the linker.
+		ASYNC_Verifying,// Verifying imports.
+		ASYNC_Exports,	// Creating exports.
+	};
+
+	// Import and export table entries as read, name indices are the file's.
+	struct FAsyncImport
+	{
+		INT ClassPackage, ClassName, PackageIndex, ObjectName;
+	};
+	struct FAsyncExport
+	{
+		INT ClassIndex, SuperIndex, PackageIndex, ObjectName;
+		DWORD ObjectFlags;
+		INT SerialSize, SerialOffset;
+	};
+
+	// A request. Everything above ReadDone belongs to the game thread, the
+	// rest to the read until ReadDone is set.
+	class FAsyncPackage : public FQueuedWork
+	{
+	public:
+		FString				PackageName;
+		FString				Filename;
+		FAsyncLoadCallback	Callback;
+		void*				UserData;
+		INT					State;
+		UPackage*			Package;
+		ULinkerLoad*		Linker;
+		UBOOL				Rooted;
+		TArray<UObject*>	RootedExports;
+		INT					NextImport;
+		INT					NextExport;
+		DOUBLE				StartTime;
+		DOUBLE				ReadTime;
+		DOUBLE				VerifyTime;
+
+		volatile INT		ReadDone;
+		DWORD				ContextFlags;
+		TCHAR				Error[256];
+		BYTE				Touched;	// Only kept so the touches aren't optimized away.
+		FPackageFileSummary	Summary;
+		TArray<FConcurrentNameEntry*> Names;
+		TArray<FAsyncImport> Imports;
+		TArray<FAsyncExport> Exports;
+		TArray<FConcurrentNameEntry*> Dependencies;
+
+		FAsyncPackage( const TCHAR* InPackageName, const TCHAR* InFilename )
+		:	PackageName( InPackageName )
+		,	Filename( InFilename )
+		,	Callback( NULL )
+		,	UserData( NULL )
+		,	State( ASYNC_Reading )
+		,	Package( NULL )
+		,	Linker( NULL )
+		,	Rooted( 0 )
+		,	NextImport( 0 )
+		,	NextExport( 0 )
+		,	StartTime( appSeconds() )
+		,	ReadTime( 0.0 )
+		,	VerifyTime( 0.0 )
+		,	ReadDone( 0 )
+		,	ContextFlags( (GIsEditor ? RF_LoadForEdit : 0) | (GIsClient ? RF_LoadForClient : 0) | (GIsServer ? RF_LoadForServer : 0) )
+		,	Touched( 0 )
+		{
+			Error[0] = 0;
+		}
+		void DoThreadedWork()
+		{
+			Read();
+			ReadTime = appSeconds() - StartTime;
+			appMemoryBarrier();
+			ReadDone = 1; // Deleted by the game thread after this.
+		}
+
+	private:
+		// Pool thread, so no guards. Failures end up in Error.
+		void Read()
+		{
+			INT Size = 0;
+			const BYTE* View = appMapFile( *Filename, Size );
+			if( !View )
+			{
+				appSprintf( Error, TEXT("Can't open %s"), *Filename );
+				return;
+			}
+			if( Size>=(INT)sizeof(INT) && INTEL_ORDER(*(const INT*)View)!=PACKAGE_FILE_TAG )
+			{
+				appUnmapFile( View, Size );
+				ReadThroughFileManager();
+				return;
+			}
+			if( !ParseTables(View,Size) && !Error[0] )
+				appSprintf( Error, TEXT("%s is truncated"), *Filename );
+			appUnmapFile( View, Size );
+		}
+		// Reads the package as GFileManager presents it, e.g. decoded from a
+		// block compressed container. The reader is only used by this thread.
+		void ReadThroughFileManager()
+		{
+			FArchive* Reader = GFileManager->CreateFileReader( *Filename, 0, GNull );
+			if( !Reader )
+			{
+				appSprintf( Error, TEXT("Can't open %s"), *Filename );
+				return;
+			}
+			TArray<BYTE> Data;
+			Data.Add( Reader->TotalSize() );
+			if( Data.Num() )
+				Reader->Serialize( &Data(0), Data.Num() );
+			UBOOL Failed = Reader->GetError();
+			delete Reader;
+			if( Failed )
+				appSprintf( Error, TEXT("Can't read %s"), *Filename );
+			else if( !ParseTables(Data.Num() ? &Data(0) : NULL, Data.Num()) && !Error[0] )
+				appSprintf( Error, TEXT("%s is truncated"), *Filename );
+		}
+		UBOOL ParseTables( const BYTE* View, INT Size )
+		{
+			// Summary, laid out as FPackageFileSummary serializes it. The
+			// upper half of the version is the licensee's.
+			INT Pos=0, i;
+			FPackageFileSummary& S = Summary;
+			if
+			(	!ReadInt(View,Size,Pos,S.Tag) || !ReadInt(View,Size,Pos,S.FileVersion) || !ReadInt(View,Size,Pos,*(INT*)&S.PackageFlags)
+			||	!ReadInt(View,Size,Pos,S.NameCount) || !ReadInt(View,Size,Pos,S.NameOffset)
+			||	!ReadInt(View,Size,Pos,S.ExportCount) || !ReadInt(View,Size,Pos,S.ExportOffset)
+			||	!ReadInt(View,Size,Pos,S.ImportCount) || !ReadInt(View,Size,Pos,S.ImportOffset) )
+				return 0;
+			if( S.Tag!=PACKAGE_FILE_TAG )
+			{
+				appSprintf( Error, TEXT("%s is not a package"), *Filename );
+				return 0;
+			}
+			INT FileVersion = S.FileVersion & 0xffff;
+			if( FileVersion>=68 )
+			{
+				INT GenerationCount;
+				if( !ReadGuid(View,Size,Pos,S.Guid) || !ReadInt(View,Size,Pos,GenerationCount) || GenerationCount<0 )
+					return 0;
+				for( i=0; i<GenerationCount; i++ )
+				{
+					INT GenExportCount, GenNameCount;
+					if( !ReadInt(View,Size,Pos,GenExportCount) || !ReadInt(View,Size,Pos,GenNameCount) )
+						return 0;
+					new(S.Generations)FGenerationInfo( GenExportCount, GenNameCount );
+				}
+			}
+			else
+			{
+				INT HeritageCount, HeritageOffset;
+				if( !ReadInt(View,Size,Pos,HeritageCount) || !ReadInt(View,Size,Pos,HeritageOffset) )
+					return 0;
+				INT HeritagePos = HeritageOffset;
+				for( i=0; i<HeritageCount; i++ )
+					if( !ReadGuid(View,Size,HeritagePos,S.Guid) )
+						return 0;
+				new(S.Generations)FGenerationInfo( S.ExportCount, S.NameCount );
+			}
+			if
+			(	S.NameCount<0 || S.NameOffset<0 || S.NameOffset>Size
+			||	S.ImportCount<0 || S.ImportOffset<0 || S.ImportOffset>Size
+			||	S.ExportCount<0 || S.ExportOffset<0 || S.ExportOffset>Size )
+				return 0;
+
+			// Names. Only those the linker will add are interned.
+			Names.Empty( S.NameCount );
+			Pos = S.NameOffset;
+			for( i=0; i<S.NameCount; i++ )
+			{
+				TCHAR Name[NAME_SIZE];
+				INT Length=0, Used;
+				if( FileVersion>=64 )
+				{
+					if( (Used=appReadCompactIndex(View+Pos,Size-Pos,Length))==0 || Length<0 || Pos+Used+Length>Size )
+						return 0;
+					Pos += Used;
+				}
+				else
+				{
+					while( Pos+Length<Size && View[Pos+Length] )
+						Length++;
+					Length++;
+				}
+				INT j;
+				for( j=0; j<Length-1 && j<NAME_SIZE-1; j++ )
+					Name[j] = (TCHAR)View[Pos+j];
+				Name[j] = 0;
+				Pos += Length;
+				if( Pos+(INT)sizeof(DWORD)>Size )
+					return 0;
+				DWORD Flags = INTEL_ORDER(*(const DWORD*)(View+Pos));
+				Pos += sizeof(DWORD);
+				Names.AddItem( (Flags & ContextFlags) ? GConcurrentNames.FindOrAdd(Name) : NULL );
+			}
+
+			// Imports. Imported packages are read ahead.
+			Imports.Empty( S.ImportCount );
+			Pos = S.ImportOffset;
+			for( i=0; i<S.ImportCount; i++ )
+			{
+				FAsyncImport& I = Imports(Imports.Add());
+				if( !ReadIndex(View,Size,Pos,I.ClassPackage) || !ReadIndex(View,Size,Pos,I.ClassName) || !ReadInt(View,Size,Pos,I.PackageIndex) || !ReadIndex(View,Size,Pos,I.ObjectName) )
+					return 0;
+				if( !IsName(I.ClassPackage) || !IsName(I.ClassName) || !IsName(I.ObjectName) )
+					return 0;
+				if( I.PackageIndex==0 && Names(I.ObjectName) )
+					Dependencies.AddItem( Names(I.ObjectName) );
+			}
+
+			// Exports, touch every page of their data.
+			Exports.Empty( S.ExportCount );
+			Pos = S.ExportOffset;
+			BYTE Sum = 0;
+			for( i=0; i<S.ExportCount; i++ )
+			{
+				FAsyncExport& E = Exports(Exports.Add());
+				E.SerialOffset = 0;
+				if( !ReadIndex(View,Size,Pos,E.ClassIndex) || !ReadIndex(View,Size,Pos,E.SuperIndex) || !ReadInt(View,Size,Pos,E.PackageIndex) || !ReadIndex(View,Size,Pos,E.ObjectName) || !ReadInt(View,Size,Pos,*(INT*)&E.ObjectFlags) || !ReadIndex(View,Size,Pos,E.SerialSize) )
+					return 0;
+				if( E.SerialSize && !ReadIndex(View,Size,Pos,E.SerialOffset) )
+					return 0;
+				if( !IsName(E.ObjectName) )
+					return 0;
+				if( (E.ObjectFlags & ContextFlags) && E.SerialOffset>=0 && E.SerialSize>0 && E.SerialOffset+E.SerialSize<=Size )
+					for( INT Touch=E.SerialOffset; Touch<E.SerialOffset+E.SerialSize; Touch+=4096 )
+						Sum += View[Touch];
+			}
+			Touched = Sum;
+			return 1;
+		}
+		UBOOL IsName( INT NameIndex )
+		{
+			if( NameIndex>=0 && NameIndex<Names.Num() )
+				return 1;
+			appSprintf( Error, TEXT("Bad name index %i/%i in %s"), NameIndex, Names.Num(), *Filename );
+			return 0;
+		}
+		static UBOOL ReadGuid( const BYTE* View, INT Size, INT& Pos, FGuid& Guid )
+		{
+			return ReadInt(View,Size,Pos,*(INT*)&Guid.A) && ReadInt(View,Size,Pos,*(INT*)&Guid.B) && ReadInt(View,Size,Pos,*(INT*)&Guid.C) && ReadInt(View,Size,Pos,*(INT*)&Guid.D);
+		}
+		static UBOOL ReadIndex( const BYTE* View, INT Size, INT& Pos, INT& Value )
+		{
+			INT Used = Pos<Size ? appReadCompactIndex( View+Pos, Size-Pos, Value ) : 0;
+			Pos += Used;
+			return Used>0;
+		}
+		static UBOOL ReadInt( const BYTE* View, INT Size, INT& Pos, INT& Value )
+		{
+			if( Pos+(INT)sizeof(INT)>Size )
+				return 0;
+			Value = INTEL_ORDER(*(const INT*)(View+Pos));
+			Pos += sizeof(INT);
+			return 1;
+		}
+	};
+
+	// Creates a request and starts reading. Returns NULL if the file is missing.
+	FAsyncPackage* Request( const TCHAR* PackageName )
+	{
+		guard(FAsyncPackageLoader::Request);
+		TCHAR Filename[256];
+		if( !appFindPackageFile(PackageName,NULL,Filename) )
+			return NULL;
+		FAsyncPackage* Pkg = new FAsyncPackage( PackageName, Filename );
+		if( GThreadPool )
+			GThreadPool->AddQueuedWork( Pkg );
+		else
+			Pkg->DoThreadedWork();
+		return Pkg;
+		unguard;
+	}
+
+	// Whether a package already has a linker, so there's nothing to read.
+	static UBOOL HasLinker( const TCHAR* PackageName )
+	{
+		guard(FAsyncPackageLoader::HasLinker);
+		for( INT i=0; i<UObject::GObjLoaders.Num(); i++ )
+			if( appStricmp(((ULinkerLoad*)UObject::GObjLoaders(i))->LinkerRoot->GetName(),PackageName)==0 )
+				return 1;
+		return 0;
+		unguard;
+	}
+	static UBOOL IsLinked( ULinkerLoad* Linker )
+	{
+		return UObject::GObjLoaders.FindItemIndex(Linker)!=INDEX_NONE;
+	}
+
+	// Creates the linker from the tables the read parsed. This is what the
+	// ULinkerLoad constructor does, minus reading them and verifying.
+	static ULinkerLoad* CreateLinker( FAsyncPackage* Pkg )
+	{
+		guard(FAsyncPackageLoader::CreateLinker);
+		{for( INT i=0; i<UObject::GObjLoaders.Num(); i++ )
+			if( UObject::GetLoader(i)->LinkerRoot==Pkg->Package )
+				appThrowf( LocalizeError(TEXT("LinkerExists"),TEXT("Core")), Pkg->Package->GetName() );}
+
+		ULinkerLoad* Linker   = new ULinkerLoad;
+		Linker->LinkerRoot    = Pkg->Package;
+		Linker->Filename      = Pkg->Filename;
+		Linker->Success       = 123456;
+		Linker->_ContextFlags = Pkg->ContextFlags;
+		Linker->LoadFlags     = LOAD_Throw | LOAD_NoWarn | LOAD_NoVerify;
+		Linker->Verified      = 0;
+		Linker->Loader        = NULL;
+		debugf( TEXT("Loading: %s"), Pkg->Package->GetFullName() );
+
+		// Same archive state the constructor sets up.
+		Linker->ArVer          = Pkg->Summary.FileVersion & 0xffff;
+		Linker->ArIsLoading    = Linker->ArIsPersistent = 1;
+		Linker->ArForEdit      = GIsEditor;
+		Linker->ArForClient    = 1;
+		Linker->ArForServer    = 1;
+		Linker->Summary        = Pkg->Summary;
+		Pkg->Package->PackageFlags = Pkg->Summary.PackageFlags;
+		Linker->Loader = GFileManager->CreateFileReader( *Pkg->Filename, 0, GError );
+		if( !Linker->Loader )
+		{
+			delete Linker;
+			appThrowf( LocalizeError(TEXT("OpenFailed"),TEXT("Core")) );
+		}
+
+		// Tables. The names are already interned, only the FNames are left.
+		Linker->NameMap.Empty( Pkg->Names.Num() );
+		{for( INT i=0; i<Pkg->Names.Num(); i++ )
+			new(Linker->NameMap)FName( Pkg->Names(i) ? GConcurrentNames.Resolve(Pkg->Names(i)) : FName(NAME_None) );}
+		Linker->ImportMap.Empty( Pkg->Imports.Num() );
+		{for( INT i=0; i<Pkg->Imports.Num(); i++ )
+		{
+			FAsyncImport&  In     = Pkg->Imports(i);
+			FObjectImport* Import = new(Linker->ImportMap)FObjectImport;
+			Import->ClassPackage  = Linker->NameMap(In.ClassPackage);
+			Import->ClassName     = Linker->NameMap(In.ClassName);
+			Import->PackageIndex  = In.PackageIndex;
+			Import->ObjectName    = Linker->NameMap(In.ObjectName);
+			Import->XObject       = NULL;
+			Import->SourceLinker  = NULL;
+			Import->SourceIndex   = INDEX_NONE;
+		}}
+		Linker->ExportMap.Empty( Pkg->Exports.Num() );
+		{for( INT i=0; i<Pkg->Exports.Num(); i++ )
+		{
+			FAsyncExport&  In     = Pkg->Exports(i);
+			FObjectExport* Export = new(Linker->ExportMap)FObjectExport;
+			Export->ClassIndex    = In.ClassIndex;
+			Export->SuperIndex    = In.SuperIndex;
+			Export->PackageIndex  = In.PackageIndex;
+			Export->ObjectName    = Linker->NameMap(In.ObjectName);
+			Export->ObjectFlags   = In.ObjectFlags;
+			Export->SerialSize    = In.SerialSize;
+			Export->SerialOffset  = In.SerialOffset;
+		}}
+
+		// Export hash.
+		{for( INT i=0; i<ARRAY_COUNT(Linker->ExportHash); i++ )
+			Linker->ExportHash[i] = INDEX_NONE;}
+		{for( INT i=0; i<Linker->ExportMap.Num(); i++ )
+		{
+			INT iHash = HashNames( Linker->ExportMap(i).ObjectName, Linker->GetExportClassName(i), Linker->GetExportClassPackage(i) ) & (ARRAY_COUNT(Linker->ExportHash)-1);
+			Linker->ExportMap(i)._iHashNext = Linker->ExportHash[iHash];
+			Linker->ExportHash[iHash] = i;
+		}}
+
+		UObject::GObjLoaders.AddItem( Linker );
+		Linker->Success = 1;
+		return Linker;
+		unguard;
+	}
+
+	// Takes the exports of a request out of the root set again. Removes the
+	// last entry of each, so an export someone else rooted stays rooted.
+	static void UnrootExports( FAsyncPackage* Pkg )
+	{
+		guard(FAsyncPackageLoader::UnrootExports);
+		TFlatMap<UObject*,BYTE> Pending;
+		Pending.Reserve( Pkg->RootedExports.Num() );
+		{for( INT i=0; i<Pkg->RootedExports.Num(); i++ )
+			Pending.Set( Pkg->RootedExports(i), 1 );}
+		for( INT i=UObject::GObjRoot.Num()-1; i>=0 && Pending.Num(); i-- )
+			if( Pending.Remove(UObject::GObjRoot(i)) )
+				UObject::GObjRoot.Remove( i );
+		Pkg->RootedExports.Empty();
+		unguard;
+	}
+	static void WaitForRead( FAsyncPackage* Pkg )
+	{
+		for( INT Spins=0; !Pkg->ReadDone; Spins++ )
+		{
+			if( Spins<64 )
+				appPause();
+			else
+				appSleep( 0.f );
+		}
+		appMemoryBarrier();
+	}
+
+	// Drops finished read aheads and queues those of their imports.
+	void ProcessPrefetches( UBOOL Wait )
+	{
+		guard(FAsyncPackageLoader::ProcessPrefetches);
+		for( INT i=0; i<Prefetches.Num(); i++ )
+		{
+			FAsyncPackage* Pkg = Prefetches(i);
+			if( Wait )
+				WaitForRead( Pkg );
+			if( Pkg->ReadDone )
+			{
+				appMemoryBarrier();
+				Prefetches.Remove( i-- );
+				for( INT j=0; j<Pkg->Dependencies.Num(); j++ )
+					Prefetch( Pkg->Dependencies(j)->Name );
+				delete Pkg;
+			}
+		}
+		unguard;
+	}
+
+	// Advances the queue until EndTime. Returns when the head has to wait
+	// for a read, unless Wait is set.
+	void Process( DOUBLE EndTime, UBOOL Wait )
+	{
+		guard(FAsyncPackageLoader::Process);
+
+		// Not while something else is loading, the linker isn't reentrant.
+		if( UObject::GObjBeginLoadCount>0 )
+			return;
+
+		// Read aheads are only tracked to break import cycles, so start over
+		// once everything is done.
+		if( !Queue.Num() && !Prefetches.Num() )
+			Prefetched.Empty();
+
+		ProcessPrefetches( Wait );
+		while( Queue.Num() )
+		{
+			FAsyncPackage* Pkg = Queue(0);
+			const TCHAR* Error = NULL;
+			UBOOL Done = 0;
+			if( Pkg->State==ASYNC_Reading )
+			{
+				// The read and the read aheads it triggered have to be done.
+				if( Wait )
+					WaitForRead( Pkg );
+				if( !Pkg->ReadDone )
+					return;
+				appMemoryBarrier();
+				if( Pkg->Error[0] )
+				{
+					Error = Pkg->Error;
+				}
+				else
+				{
+					for( INT i=0; i<Pkg->Dependencies.Num(); i++ )
+						Prefetch( Pkg->Dependencies(i)->Name );
+					ProcessPrefetches( Wait );
+					if( Prefetches.Num() )
+						return;
+					Pkg->State = ASYNC_Linking;
+				}
+			}
+			else if( Pkg->State==ASYNC_Linking )
+			{
+				UObject::BeginLoad();
+				try
+				{
+					Pkg->Package = UObject::CreatePackage( NULL, *Pkg->PackageName );
+					if( UObject::GObjRoot.FindItemIndex(Pkg->Package)==INDEX_NONE )
+					{
+						Pkg->Package->AddToRoot();
+						Pkg->Rooted = 1;
+					}
+					DOUBLE LinkStart = appSeconds();
+					if( (Pkg->Summary.FileVersion & 0xffff)>=PACKAGE_MIN_VERSION )
+						Pkg->Linker = CreateLinker( Pkg );
+					else
+						Pkg->Linker = UObject::GetPackageLinker( Pkg->Package, *Pkg->Filename, LOAD_Throw|LOAD_NoWarn|LOAD_NoVerify, NULL, NULL );
+					GLinkerExportHashes.RecordLink( Pkg->Linker, appSeconds()-LinkStart );
+					Pkg->State = ASYNC_Verifying;
+				}
+				catch( const TCHAR* LinkerError )
+				{
+					Error = LinkerError;
+				}
+				UObject::EndLoad();
+			}
+			else if( !IsLinked(Pkg->Linker) )
+			{
+				// ResetLoaders() closed the linker in between.
+				Error = TEXT("Linker was reset while loading");
+			}
+			else if( Pkg->State==ASYNC_Verifying )
+			{
+				// A batch of imports, as ULinkerLoad::Verify() would do them.
+				ULinkerLoad* Linker = Pkg->Linker;
+				DOUBLE VerifyStart = appSeconds();
+				UObject::BeginLoad();
+				try
+				{
+					if( Pkg->NextImport==0 )
+						Pkg->Package->PackageFlags &= ~PKG_BrokenLinks;
+					while( !Linker->Verified && Pkg->NextImport<Linker->Summary.ImportCount )
+					{
+						Linker->VerifyImport( Pkg->NextImport++ );
+						if( !Wait && appSeconds()>=EndTime )
+							break;
+					}
+					if( Pkg->NextImport>=Linker->Summary.ImportCount )
+						Linker->Verified = 1;
+				}
+				catch( const TCHAR* VerifyError )
+				{
+					// Destroying the linker takes it out of GObjLoaders.
+					delete Linker;
+					Pkg->Linker = NULL;
+					Error = VerifyError;
+				}
+				UObject::EndLoad();
+				Pkg->VerifyTime += appSeconds() - VerifyStart;
+				if( !Error && Linker->Verified )
+				{
+					GLinkerExportHashes.RecordVerify( Linker, Pkg->VerifyTime );
+					Pkg->State = ASYNC_Exports;
+				}
+			}
+			else
+			{
+				// A batch of exports, EndLoad() post loads them. They are
+				// rooted until the request is done, see notes.
+				UObject::BeginLoad();
+				while( Pkg->NextExport<Pkg->Linker->ExportMap.Num() )
+				{
+					UObject* Object = Pkg->Linker->CreateExport( Pkg->NextExport++ );
+					if( Object )
+					{
+						Object->AddToRoot();
+						Pkg->RootedExports.AddItem( Object );
+					}
+					if( !Wait && appSeconds()>=EndTime )
+						break;
+				}
+				UObject::EndLoad();
+				Done = Pkg->NextExport>=Pkg->Linker->ExportMap.Num();
+			}
+
+			// Finished, either way?
+			if( Error || Done )
+			{
+				Queue.Remove( 0 );
+				if( Error )
+				{
+					debugf( NAME_Warning, TEXT("Failed to load %s: %s"), *Pkg->PackageName, Error );
+					NumFailed++;
+				}
+				else
+				{
+					debugf( NAME_DevLoad, TEXT("Loaded %s in %.1f ms (read %.1f ms)"), *Pkg->PackageName, (appSeconds()-Pkg->StartTime)*1000.0, Pkg->ReadTime*1000.0 );
+					NumLoaded++;
+				}
+				if( Pkg->Callback )
+					Pkg->Callback( Error ? NULL : Pkg->Package, Error, Pkg->UserData );
+				if( Pkg->Rooted )
+					Pkg->Package->RemoveFromRoot();
+				UnrootExports( Pkg );
+				delete Pkg;
+			}
+			if( !Wait && appSeconds()>=EndTime )
+				return;
+		}
+		unguard;
+	}
+
+	TArray<FAsyncPackage*>	Queue;
+	TArray<FAsyncPackage*>	Prefetches;
+	TArray<FString>			Prefetched;
+	INT						NumLoaded;
+	INT						NumFailed;
+};
+
+// Global async package loader.
+extern COREI_API FAsyncPackageLoader GAsyncLoader;
+
+/*-----------------------------------------------------------------------------
+	The End.
+-----------------------------------------------------------------------------*/
@@ -305,6 +305,114 @@ class CORE_API ULinker : public UObject
 	}
 };
 
+/*----------------------------------------------------------------------------
+	FLinkerExportHash.
+----------------------------------------------------------------------------*/
+
+//
+// Export lookup of a single linker, sized from its export count, as
+// ULinkerLoad::ExportHash has a fixed 256 bins. Chains keep the order of
+// ExportHash's, so lookups find the same export.
+//
+class FLinkerExportHash
+{
+public:
+	// Variables.
+	ULinkerLoad*	Linker;
+	UObject*		LinkerRoot;
+	const void*		ExportData;
+	INT				NumExports;
+	TArray<INT>		Buckets;
+	TArray<INT>		Next;
+
+	// Constructors.
+	FLinkerExportHash( ULinkerLoad* InLinker, UObject* InLinkerRoot, const void* InExportData, INT InNumExports )
+	:	Linker( InLinker )
+	,	LinkerRoot( InLinkerRoot )
+	,	ExportData( InExportData )
+	,	NumExports( InNumExports )
+	,	Buckets( 1<<appCeilLogTwo(InNumExports) )
+	,	Next( InNumExports )
+	{
+		for( INT i=0; i<Buckets.Num(); i++ )
+			Buckets(i) = INDEX_NONE;
+	}
+
+	// FLinkerExportHash interface.
+	void Add( INT ExportIndex, INT Hash )
+	{
+		INT& Bucket     = Buckets( Hash & (Buckets.Num()-1) );
+		Next(ExportIndex) = Bucket;
+		Bucket          = ExportIndex;
+	}
+	INT First( INT Hash ) const
+	{
+		return Buckets( Hash & (Buckets.Num()-1) );
+	}
+};
+
+//
+// Export hashes of the linkers which outgrow ExportHash, along with link
+// timings per package. Hashes are built on first use, kept by linker index
+// and dropped once their linker is gone. Game thread only.
+//
+// Core.dll runs its own compiled copy of ULinkerLoad, so sync loads neither
+// use these hashes nor record timings. Only linkers built and verified by
+// code compiled against these headers do, i.e. the async loader's.
+//
+class FLinkerExportHashes : public FExec
+{
+public:
+	enum {MIN_EXPORTS=1024}; // Smaller linkers keep using ExportHash.
+
+	// Variables.
+	INT Lookups;
+	INT Probes;
+
+	// Constructors.
+	FLinkerExportHashes()
+	:	Lookups( 0 )
+	,	Probes( 0 )
+	{}
+
+	// FLinkerExportHashes interface.
+	FLinkerExportHash* Get( ULinkerLoad* Linker );
+	void RecordLink( ULinkerLoad* Linker, DOUBLE LinkSeconds );
+	void RecordVerify( ULinkerLoad* Linker, DOUBLE VerifySeconds );
+	void Flush()
+	{
+		guard(FLinkerExportHashes::Flush);
+		for( TFlatMap<INT,FLinkerExportHash*>::TIterator It(Hashes); It; ++It )
+			delete It.Value();
+		Hashes.Empty();
+		Timings.Empty();
+		Lookups = Probes = 0;
+		unguard;
+	}
+
+	// FExec interface.
+	UBOOL Exec( const TCHAR* Cmd, FOutputDevice& Ar );
+
+private:
+	// Link timing of a package, kept by linker index. A linker reusing an
+	// index replaces the entry, so only the latest linker per index is kept.
+	struct FLinkTiming
+	{
+		ULinkerLoad*	Linker; // Only compared, may be gone.
+		FString	Package;
+		INT		NumImports;
+		INT		NumExports;
+		DOUBLE	LinkSeconds;
+		DOUBLE	VerifySeconds;
+	};
+
+	TFlatMap<INT,FLinkerExportHash*>	Hashes;
+	TFlatMap<INT,FLinkTiming>			Timings;
+};
+
+// Global linker export hashes.
+extern COREI_API FLinkerExportHashes GLinkerExportHashes;
+
 /*----------------------------------------------------------------------------
 	ULinkerLoad.
 ----------------------------------------------------------------------------*/
@@ -569,12 +677,15 @@ class ULinkerLoad : public ULinker, public FArchive
 		// Find this import within its existing linker.
 		UBOOL SafeReplace = 0;
 	Rehack://oldver
-		//new:
-		INT iHash = HashNames( Import.ObjectName, Import.ClassName, Import.ClassPackage) & (ARRAY_COUNT(ExportHash)-1);
-		for( INT j=Import.SourceLinker->ExportHash[iHash]; j!=INDEX_NONE; j=Import.SourceLinker->ExportMap(j)._iHashNext )
+		//new: Big linkers use a hash sized to fit, see FLinkerExportHashes.
+		FLinkerExportHash* SourceHash = GLinkerExportHashes.Get( Import.SourceLinker );
+		INT iHash = HashNames( Import.ObjectName, Import.ClassName, Import.ClassPackage);
+		GLinkerExportHashes.Lookups++;
+		for( INT j=SourceHash ? SourceHash->First(iHash) : Import.SourceLinker->ExportHash[iHash & (ARRAY_COUNT(ExportHash)-1)]; j!=INDEX_NONE; j=SourceHash ? SourceHash->Next(j) : Import.SourceLinker->ExportMap(j)._iHashNext )
 		//old:
 		//for( INT j=0; j<Import.SourceLinker->ExportMap.Num(); j++ )
 		{
+			GLinkerExportHashes.Probes++;
 			FObjectExport& Source = Import.SourceLinker->ExportMap( j );
 			UBOOL ClassHack = Import.ClassPackage==NAME_UnrealI && Import.SourceLinker->GetExportClassPackage(j)==NAME_UnrealShare;//oldver
 			if
@@ -697,9 +808,13 @@ class ULinkerLoad : public ULinker, public FArchive
 	{
 		guard(ULinkerLoad::FindExportIndex);
 	Rehack://oldver
-		INT iHash = HashNames( ObjectName, ClassName, ClassPackage ) & (ARRAY_COUNT(ExportHash)-1);
-		for( INT i=ExportHash[iHash]; i!=INDEX_NONE; i=ExportMap(i)._iHashNext )
+		// Big linkers use a hash sized to fit, see FLinkerExportHashes.
+		FLinkerExportHash* Hash = GLinkerExportHashes.Get( this );
+		INT iHash = HashNames( ObjectName, ClassName, ClassPackage );
+		GLinkerExportHashes.Lookups++;
+		for( INT i=Hash ? Hash->First(iHash) : ExportHash[iHash & (ARRAY_COUNT(ExportHash)-1)]; i!=INDEX_NONE; i=Hash ? Hash->Next(i) : ExportMap(i)._iHashNext )
 		{
+			GLinkerExportHashes.Probes++;
 			if
 			(  (ExportMap(i).ObjectName  ==ObjectName                              )
 			&& (ExportMap(i).PackageIndex==PackageIndex || PackageIndex==INDEX_NONE)
@@ -1024,6 +1139,117 @@ private:
 };
 CORE_API UClass* autoclassULinkerLoad;
 
+/*----------------------------------------------------------------------------
+	FLinkerExportHashes implementation.
+----------------------------------------------------------------------------*/
+
+inline FLinkerExportHash* FLinkerExportHashes::Get( ULinkerLoad* Linker )
+{
+	guardSlow(FLinkerExportHashes::Get);
+	if( Linker->ExportMap.Num()<MIN_EXPORTS )
+		return NULL;
+
+	// Still matching the linker? A new linker may reuse a freed one's index
+	// or memory.
+	FLinkerExportHash** Found = Hashes.Find( Linker->GetIndex() );
+	if( Found )
+	{
+		FLinkerExportHash* Hash = *Found;
+		if( Hash->Linker==Linker && Hash->LinkerRoot==Linker->LinkerRoot && Hash->ExportData==Linker->ExportMap.GetData() && Hash->NumExports==Linker->ExportMap.Num() )
+			return Hash;
+		delete Hash;
+		Hashes.Remove( Linker->GetIndex() );
+	}
+
+	// Drop the hashes of closed linkers. Only done when building one, which
+	// is once per big linker.
+	for( TFlatMap<INT,FLinkerExportHash*>::TIterator It(Hashes); It; ++It )
+	{
+		if( UObject::GObjLoaders.FindItemIndex(It.Value()->Linker)==INDEX_NONE )
+		{
+			delete It.Value();
+			It.RemoveCurrent();
+		}
+	}
+
+	// Build it in export order, just like the linker's constructor.
+	FLinkerExportHash* Hash = new FLinkerExportHash( Linker, Linker->LinkerRoot, Linker->ExportMap.GetData(), Linker->ExportMap.Num() );
+	for( INT k=0; k<Linker->ExportMap.Num(); k++ )
+		Hash->Add( k, HashNames(Linker->ExportMap(k).ObjectName,Linker->GetExportClassName(k),Linker->GetExportClassPackage(k)) );
+	Hashes.Set( Linker->GetIndex(), Hash );
+	return Hash;
+	unguardSlow;
+}
+
+inline void FLinkerExportHashes::RecordLink( ULinkerLoad* Linker, DOUBLE LinkSeconds )
+{
+	guard(FLinkerExportHashes::RecordLink);
+	FLinkTiming* Timing   = &Timings.Set( Linker->GetIndex(), FLinkTiming() );
+	Timing->Linker        = Linker;
+	Timing->Package       = Linker->LinkerRoot->GetName();
+	Timing->NumImports    = Linker->ImportMap.Num();
+	Timing->NumExports    = Linker->ExportMap.Num();
+	Timing->LinkSeconds   = LinkSeconds;
+	Timing->VerifySeconds = 0.0;
+	unguard;
+}
+
+inline void FLinkerExportHashes::RecordVerify( ULinkerLoad* Linker, DOUBLE VerifySeconds )
+{
+	guard(FLinkerExportHashes::RecordVerify);
+	FLinkTiming* Timing = Timings.Find( Linker->GetIndex() );
+	if( Timing && Timing->Linker==Linker )
+	{
+		Timing->NumImports     = Linker->ImportMap.Num();
+		Timing->VerifySeconds += VerifySeconds;
+	}
+	unguard;
+}
+
+inline UBOOL FLinkerExportHashes::Exec( const TCHAR* Cmd, FOutputDevice& Ar )
+{
+	guard(FLinkerExportHashes::Exec);
+	if( ParseCommand(&Cmd,TEXT("LINKERS")) )
+	{
+		if( ParseCommand(&Cmd,TEXT("FLUSH")) )
+			Flush();
+
+		// Open linkers and how ExportHash copes with them.
+		Ar.Logf( TEXT("%-24s %7s %7s %7s %6s %s"), TEXT("Package"), TEXT("Names"), TEXT("Imports"), TEXT("Exports"), TEXT("Chain"), TEXT("Hash") );
+		for( INT i=0; i<UObject::GObjLoaders.Num(); i++ )
+		{
+			ULinkerLoad* Linker = (ULinkerLoad*)UObject::GObjLoaders(i);
+			INT Worst = 0;
+			for( INT j=0; j<ARRAY_COUNT(Linker->ExportHash); j++ )
+			{
+				INT Length = 0;
+				for( INT k=Linker->ExportHash[j]; k!=INDEX_NONE; k=Linker->ExportMap(k)._iHashNext )
+					Length++;
+				Worst = Max( Worst, Length );
+			}
+			FLinkerExportHash** Hash = Hashes.Find( Linker->GetIndex() );
+			INT NumBuckets = (Hash && (*Hash)->Linker==Linker) ? (*Hash)->Buckets.Num() : 0;
+			Ar.Logf( TEXT("%-24s %7i %7i %7i %6i %i"), Linker->LinkerRoot->GetName(), Linker->NameMap.Num(), Linker->ImportMap.Num(), Linker->ExportMap.Num(), Worst, NumBuckets );
+		}
+		Ar.Logf( TEXT("%i export lookups, %.1f probes each."), Lookups, Lookups ? (FLOAT)Probes/Lookups : 0.f );
+
+		// Timings of the linkers the async loader created.
+		DOUBLE TotalLink=0.0, TotalVerify=0.0;
+		for( TFlatMap<INT,FLinkTiming>::TIterator It(Timings); It; ++It )
+		{
+			FLinkTiming& Timing = It.Value();
+			Ar.Logf( TEXT("%-24s %7i imports %7i exports: link %7.2f ms, verify imports %7.2f ms"), *Timing.Package, Timing.NumImports, Timing.NumExports, Timing.LinkSeconds*1000.0, Timing.VerifySeconds*1000.0 );
+			TotalLink   += Timing.LinkSeconds;
+			TotalVerify += Timing.VerifySeconds;
+		}
+		if( Timings.Num() )
+			Ar.Logf( TEXT("%i packages: link %.2f ms, verify imports %.2f ms"), Timings.Num(), TotalLink*1000.0, TotalVerify*1000.0 );
+		return 1;
+	}
+	return 0;
+	unguard;
+}
+
 /*----------------------------------------------------------------------------
 	ULinkerSave.
 ----------------------------------------------------------------------------*/
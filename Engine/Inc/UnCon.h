@@ -50,29 +50,29 @@ class ENGINE_API UConsole : public UObject, public FOutputDevice
         Parms.S=S;
 		Parms.PZone=PZone;
 		Parms.N=Name;
-        ProcessEvent(FindFunctionChecked(NAME_Message),&Parms);
+        appProcessEventCached(this,NAME_Message,&Parms);
     }
     void eventTick(FLOAT DeltaTime)
     {
         struct {FLOAT DeltaTime; } Parms;
         Parms.DeltaTime=DeltaTime;
-        ProcessEvent(FindFunctionChecked(ENGINE_Tick),&Parms);
+        appProcessEventCached(this,ENGINE_Tick,&Parms);
     }
     void eventVideoChange()
     {
-        ProcessEvent(FindFunctionChecked(NAME_VideoChange),NULL);
+        appProcessEventCached(this,NAME_VideoChange);
     }
     void eventPostRender(class UCanvas* C)
     {
         struct {class UCanvas* C; } Parms;
         Parms.C=C;
-        ProcessEvent(FindFunctionChecked(ENGINE_PostRender),&Parms);
+        appProcessEventCached(this,ENGINE_PostRender,&Parms);
     }
     void eventPreRender(class UCanvas* C)
     {
         struct {class UCanvas* C; } Parms;
         Parms.C=C;
-        ProcessEvent(FindFunctionChecked(ENGINE_PreRender),&Parms);
+        appProcessEventCached(this,ENGINE_PreRender,&Parms);
     }
     DWORD eventKeyType(BYTE Key)
     {
@@ -94,14 +94,14 @@ class ENGINE_API UConsole : public UObject, public FOutputDevice
     }
     void eventNotifyLevelChange()
     {
-        ProcessEvent(FindFunctionChecked(NAME_NotifyLevelChange),NULL);
+        appProcessEventCached(this,NAME_NotifyLevelChange);
     }
     void eventConnectFailure(const FString& FailCode, const FString& URL)
     {
         UConsole_eventConnectFailure_Parms Parms;
         Parms.FailCode=FailCode;
         Parms.URL=URL;
-        ProcessEvent(FindFunctionChecked(NAME_ConnectFailure),&Parms);
+        appProcessEventCached(this,NAME_ConnectFailure,&Parms);
     }
 	UBOOL IsTimeDemo()
 	{
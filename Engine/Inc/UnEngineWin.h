@@ -147,7 +147,7 @@ class WConfigPageFirstTime : public WWizardPage
 	{}
 	const TCHAR* GetNextText()
 	{
-		return LocalizeGeneral(TEXT("Run"),TEXT("Startup"));
+		return GLocalizeCache.LocalizeGeneral(TEXT("Run"),TEXT("Startup"));
 	}
 	WWizardPage* GetNext()
 	{
@@ -187,7 +187,7 @@ class WConfigPageSafeOptions : public WWizardPage
 	}
 	const TCHAR* GetNextText()
 	{
-		return LocalizeGeneral(TEXT("Run"),TEXT("Startup"));
+		return GLocalizeCache.LocalizeGeneral(TEXT("Run"),TEXT("Startup"));
 	}
 	WWizardPage* GetNext()
 	{
@@ -247,7 +247,7 @@ class WConfigPageDetail : public WWizardPage
 		// DEUS_EX CNN - change to 64 meg minimum
 		if( !GIsMMX || GPhysicalMemory <= 64*1024*1024 )
 		{
-			Info = Info + LocalizeGeneral(TEXT("SoundLow"),TEXT("Startup")) + TEXT("\r\n");
+			Info = Info + GLocalizeCache.LocalizeGeneral(TEXT("SoundLow"),TEXT("Startup")) + TEXT("\r\n");
 			GConfig->SetString( TEXT("Galaxy.GalaxyAudioSubsystem"), TEXT("UseReverb"),       TEXT("False") );
 			GConfig->SetString( TEXT("Galaxy.GalaxyAudioSubsystem"), TEXT("OutputRate"),      TEXT("11025Hz") );
 			GConfig->SetString( TEXT("Galaxy.GalaxyAudioSubsystem"), TEXT("UseSpatial"),      TEXT("False") );
@@ -261,29 +261,29 @@ class WConfigPageDetail : public WWizardPage
 		}
 		else
 		{
-			Info = Info + LocalizeGeneral(TEXT("SoundHigh"),TEXT("Startup")) + TEXT("\r\n");
+			Info = Info + GLocalizeCache.LocalizeGeneral(TEXT("SoundHigh"),TEXT("Startup")) + TEXT("\r\n");
 		}
 
 		// Skins.
 		if( (GPhysicalMemory < 96*1024*1024) || (DescFlags&RDDESCF_LowDetailSkins) )
 		{
-			Info = Info + LocalizeGeneral(TEXT("SkinsLow"),TEXT("Startup")) + TEXT("\r\n");
+			Info = Info + GLocalizeCache.LocalizeGeneral(TEXT("SkinsLow"),TEXT("Startup")) + TEXT("\r\n");
 			GConfig->SetString( TEXT("WinDrv.WindowsClient"), TEXT("SkinDetail"), TEXT("Medium") );
 		}
 		else
 		{
-			Info = Info + LocalizeGeneral(TEXT("SkinsHigh"),TEXT("Startup")) + TEXT("\r\n");
+			Info = Info + GLocalizeCache.LocalizeGeneral(TEXT("SkinsHigh"),TEXT("Startup")) + TEXT("\r\n");
 		}
 
 		// World.
 		if( (GPhysicalMemory < 64*1024*1024) || (DescFlags&RDDESCF_LowDetailWorld) )
 		{
-			Info = Info + LocalizeGeneral(TEXT("WorldLow"),TEXT("Startup")) + TEXT("\r\n");
+			Info = Info + GLocalizeCache.LocalizeGeneral(TEXT("WorldLow"),TEXT("Startup")) + TEXT("\r\n");
 			GConfig->SetString( TEXT("WinDrv.WindowsClient"), TEXT("TextureDetail"), TEXT("Medium") );
 		}
 		else
 		{
-			Info = Info + LocalizeGeneral(TEXT("WorldHigh"),TEXT("Startup")) + TEXT("\r\n");
+			Info = Info + GLocalizeCache.LocalizeGeneral(TEXT("WorldHigh"),TEXT("Startup")) + TEXT("\r\n");
 		}
 
 		// Resolution.
@@ -297,7 +297,7 @@ class WConfigPageDetail : public WWizardPage
 /*
 		if( (!GIsMMX || !GIsPentiumPro) && Driver==TEXT("SoftDrv.SoftwareRenderDevice") )
 		{
-			Info = Info + LocalizeGeneral(TEXT("ResLow"),TEXT("Startup")) + TEXT("\r\n");
+			Info = Info + GLocalizeCache.LocalizeGeneral(TEXT("ResLow"),TEXT("Startup")) + TEXT("\r\n");
 			GConfig->SetString( TEXT("WinDrv.WindowsClient"), TEXT("WindowedViewportX"),  TEXT("320") );
 			GConfig->SetString( TEXT("WinDrv.WindowsClient"), TEXT("WindowedViewportY"),  TEXT("240") );
 			GConfig->SetString( TEXT("WinDrv.WindowsClient"), TEXT("WindowedColorBits"),  TEXT("16") );
@@ -307,7 +307,7 @@ class WConfigPageDetail : public WWizardPage
 		}
 		else if( Driver==TEXT("SoftDrv.SoftwareRenderDevice") || (DescFlags&RDDESCF_LowDetailWorld) )
 		{
-			Info = Info + LocalizeGeneral(TEXT("ResLow"),TEXT("Startup")) + TEXT("\r\n");
+			Info = Info + GLocalizeCache.LocalizeGeneral(TEXT("ResLow"),TEXT("Startup")) + TEXT("\r\n");
 			GConfig->SetString( TEXT("WinDrv.WindowsClient"), TEXT("WindowedViewportX"),  TEXT("512") );
 			GConfig->SetString( TEXT("WinDrv.WindowsClient"), TEXT("WindowedViewportY"),  TEXT("384") );
 			GConfig->SetString( TEXT("WinDrv.WindowsClient"), TEXT("WindowedColorBits"),  TEXT("16") );
@@ -318,7 +318,7 @@ class WConfigPageDetail : public WWizardPage
 		else
 */
 //		{
-			Info = Info + LocalizeGeneral(TEXT("ResHigh"),TEXT("Startup")) + TEXT("\r\n");
+			Info = Info + GLocalizeCache.LocalizeGeneral(TEXT("ResHigh"),TEXT("Startup")) + TEXT("\r\n");
 //		}
 		DetailEdit.SetText(*Info);
 	}
@@ -337,7 +337,7 @@ class WConfigPageDriver : public WWizardPage
 	WConfigPageDriver( WConfigWizard* InOwner )
 	: WWizardPage( TEXT("ConfigPageDriver"), IDDIALOG_ConfigPageDriver, InOwner )
 	, Owner(InOwner)
-	, WebButton(this,LocalizeGeneral(TEXT("Direct3DWebPage"),TEXT("Startup")),IDC_WebButton)
+	, WebButton(this,GLocalizeCache.LocalizeGeneral(TEXT("Direct3DWebPage"),TEXT("Startup")),IDC_WebButton)
 	, Card(this,IDC_Card)
 	{}
 	void OnInitDialog()
@@ -397,7 +397,7 @@ class WConfigPageRenderer : public WWizardPage
 					DoShow = Priority = 1;
 				if( DoShow )
 				{
-					RenderList.AddString( *(Temp=Localize(*Right,TEXT("ClassCaption"),*Left)) );
+					RenderList.AddString( *(Temp=GLocalizeCache.Localize(*Right,TEXT("ClassCaption"),*Left)) );
 					if( Priority>=BestPriority )
 						{Default=Temp; BestPriority=Priority;}
 				}
@@ -409,7 +409,7 @@ class WConfigPageRenderer : public WWizardPage
 	}
 	void CurrentChange()
 	{
-		RenderNote.SetText(Localize(TEXT("Descriptions"),*CurrentDriver(),TEXT("Startup"),NULL,1));
+		RenderNote.SetText(GLocalizeCache.Localize(TEXT("Descriptions"),*CurrentDriver(),TEXT("Startup"),NULL,1));
 	}
 	void OnPaint()
 	{
@@ -438,7 +438,7 @@ class WConfigPageRenderer : public WWizardPage
 		SendMessageX(ShowCompatible,BM_SETCHECK,BST_CHECKED,0);
 		RenderList.SelectionChangeDelegate = FDelegate(this,(TDelegate)&WConfigPageRenderer::CurrentChange);
 		RenderList.DoubleClickDelegate = FDelegate(Owner,(TDelegate)&WWizardDialog::OnNext);
-		RenderList.AddString( LocalizeGeneral(TEXT("Detecting"),TEXT("Startup")) );
+		RenderList.AddString( GLocalizeCache.LocalizeGeneral(TEXT("Detecting"),TEXT("Startup")) );
 	}
 	FString CurrentDriver()
 	{
@@ -449,7 +449,7 @@ class WConfigPageRenderer : public WWizardPage
 			{
 				FString Path=It->Object, Left, Right, Temp;
 				if( Path.Split(TEXT("."),&Left,&Right) )
-					if( Name==Localize(*Right,TEXT("ClassCaption"),*Left) )
+					if( Name==GLocalizeCache.Localize(*Right,TEXT("ClassCaption"),*Left) )
 						return Path;
 			}
 		}
@@ -493,7 +493,7 @@ class WConfigPageSafeMode : public WWizardPage
 	}
 	void OnWeb()
 	{
-		ShellExecuteX( *this, TEXT("open"), LocalizeGeneral(TEXT("WebPage"),TEXT("Startup")), TEXT(""), appBaseDir(), SW_SHOWNORMAL );
+		ShellExecuteX( *this, TEXT("open"), GLocalizeCache.LocalizeGeneral(TEXT("WebPage"),TEXT("Startup")), TEXT(""), appBaseDir(), SW_SHOWNORMAL );
 		Owner->EndDialog(0);
 	}
 	const TCHAR* GetNextText()
@@ -635,7 +635,7 @@ private:
 		{
 			if( !Preferences )
 			{
-				Preferences = new WConfigProperties( TEXT("Preferences"), LocalizeGeneral("AdvancedOptionsTitle",TEXT("Window")) );
+				Preferences = new WConfigProperties( TEXT("Preferences"), GLocalizeCache.LocalizeGeneral(TEXT("AdvancedOptionsTitle"),TEXT("Window")) );
 				Preferences->SetNotifyHook( this );
 				Preferences->OpenWindow( GLogWindow ? GLogWindow->hWnd : NULL );
 				Preferences->ForceRefresh();
@@ -747,14 +747,14 @@ static UEngine* InitEngine()
 		WConfigWizard D;
 		WWizardPage* Page = NULL;
 		if( ParseParam(appCmdLine(),TEXT("safe")) || appStrfind(appCmdLine(),TEXT("readini")) )
-			{Page = new WConfigPageSafeMode(&D); D.Title=LocalizeGeneral(TEXT("SafeMode"),TEXT("Startup"));}
+			{Page = new WConfigPageSafeMode(&D); D.Title=GLocalizeCache.LocalizeGeneral(TEXT("SafeMode"),TEXT("Startup"));}
 		//else if( FirstRun<ENGINE_VERSION )
       else if ( FirstRun<400 )
-			{Page = new WConfigPageRenderer(&D); D.Title=LocalizeGeneral(TEXT("FirstTime"),TEXT("Startup"));}
+			{Page = new WConfigPageRenderer(&D); D.Title=GLocalizeCache.LocalizeGeneral(TEXT("FirstTime"),TEXT("Startup"));}
 		else if( ParseParam(appCmdLine(),TEXT("changevideo")) )
-			{Page = new WConfigPageRenderer(&D); D.Title=LocalizeGeneral(TEXT("Video"),TEXT("Startup"));}
+			{Page = new WConfigPageRenderer(&D); D.Title=GLocalizeCache.LocalizeGeneral(TEXT("Video"),TEXT("Startup"));}
 		else if( !AlreadyRunning && GFileManager->FileSize(TEXT("Running.ini"))>=0 )
-			{Page = new WConfigPageSafeMode(&D); D.Title=LocalizeGeneral(TEXT("RecoveryMode"),TEXT("Startup"));}
+			{Page = new WConfigPageSafeMode(&D); D.Title=GLocalizeCache.LocalizeGeneral(TEXT("RecoveryMode"),TEXT("Startup"));}
 		if( Page )
 		{
 			ExitSplash();
@@ -790,8 +790,8 @@ static UEngine* InitEngine()
 			if( MessageBox
 			(
 				NULL,
-				LocalizeGeneral("InsertCdText",TEXT("Window")),
-				LocalizeGeneral("InsertCdTitle",TEXT("Window")),
+				GLocalizeCache.LocalizeGeneral(TEXT("InsertCdText"),TEXT("Window")),
+				GLocalizeCache.LocalizeGeneral(TEXT("InsertCdTitle"),TEXT("Window")),
 				MB_TOPMOST|MB_SETFOREGROUND|MB_TASKMODAL|MB_OKCANCEL	// DEUS_EX CNN - Added MB_TOPMOST|MB_SETFOREGROUND to force the window to the front
 			)==IDCANCEL )
 			{
@@ -489,7 +489,7 @@ inline void LocalizeSubMenu( HMENU hMenu, const TCHAR* Name, const TCHAR* Packag
 			const ANSICHAR* String = (const ANSICHAR*)Info.dwTypeData;
 			if( String && String[0]=='I' && String[1]=='D' && String[2]=='_' )
 			{
-				const_cast<const ANSICHAR*&>(Info.dwTypeData) = TCHAR_TO_ANSI(Localize( Name, appFromAnsi(String), Package ));
+				const_cast<const ANSICHAR*&>(Info.dwTypeData) = TCHAR_TO_ANSI(GLocalizeCache.Localize( Name, appFromAnsi(String), Package ));
 				SetMenuItemInfoA( hMenu, i, 1, &Info );
 			}
 			if( Info.hSubMenu )
@@ -509,7 +509,7 @@ inline void LocalizeSubMenu( HMENU hMenu, const TCHAR* Name, const TCHAR* Packag
 			const TCHAR* String = (const TCHAR*)Info.dwTypeData;
 			if( String && String[0]=='I' && String[1]=='D' && String[2]=='_' )
 			{
-				const_cast<const TCHAR*&>(Info.dwTypeData) = Localize( Name, String, Package );
+				const_cast<const TCHAR*&>(Info.dwTypeData) = GLocalizeCache.Localize( Name, String, Package );
 				SetMenuItemInfo( hMenu, i, 1, &Info );
 			}
 			if( Info.hSubMenu )
@@ -2016,7 +2016,7 @@ class WINDOW_API WTerminal : public WTerminalBase, public FOutputDevice
 			MdiChild
 			?	(WS_EX_MDICHILD)
 			:	(AppWindow?WS_EX_APPWINDOW:0),
-			*FString::Printf( LocalizeGeneral("LogWindow",TEXT("Window")), LocalizeGeneral("Product",TEXT("Core")) ),
+			*FString::Printf( GLocalizeCache.LocalizeGeneral(TEXT("LogWindow"),TEXT("Window")), GLocalizeCache.LocalizeGeneral(TEXT("Product"),TEXT("Core")) ),
 			MdiChild
 			?	(WS_CHILD | WS_CLIPSIBLINGS | WS_CLIPCHILDREN | WS_SYSMENU | WS_CAPTION | WS_THICKFRAME | WS_MINIMIZEBOX | WS_MAXIMIZEBOX)
 			:	(WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU | WS_SIZEBOX),
@@ -2082,7 +2082,7 @@ class WINDOW_API WTerminal : public WTerminalBase, public FOutputDevice
 			appStrcpy( Typing, TEXT(">") );
 			if( Exec )
 				if( !Exec->Exec( Temp, *GLog ) )
-					Log( LocalizeError("Exec",TEXT("Core")) );
+					Log( GLocalizeCache.LocalizeError(TEXT("Exec"),TEXT("Core")) );
 			SelectTyping();
 		}
 		else if( (Ch==8 || Ch==127) && Length>1 )
@@ -2416,11 +2416,11 @@ class WINDOW_API WDialog : public WWindow
 			String = Ch;
 		}
 		if( FString(String).Left(4)==TEXT("IDC_") )
-			SendMessageLX( hInWmd, WM_SETTEXT, 0, LineFormat(Localize(Temp[0],*String,Temp[1])) );
+			SendMessageLX( hInWmd, WM_SETTEXT, 0, LineFormat(GLocalizeCache.Localize(Temp[0],*String,Temp[1])) );
 		else if( String==TEXT("IDOK") )
-			SendMessageLX( hInWmd, WM_SETTEXT, 0, LineFormat(LocalizeGeneral("OkButton",TEXT("Window"))) );
+			SendMessageLX( hInWmd, WM_SETTEXT, 0, LineFormat(GLocalizeCache.LocalizeGeneral(TEXT("OkButton"),TEXT("Window"))) );
 		else if( String==TEXT("IDCANCEL") )
-			SendMessageLX( hInWmd, WM_SETTEXT, 0, LineFormat(LocalizeGeneral("CancelButton",TEXT("Window"))) );
+			SendMessageLX( hInWmd, WM_SETTEXT, 0, LineFormat(GLocalizeCache.LocalizeGeneral(TEXT("CancelButton"),TEXT("Window"))) );
 		return 1;
 		unguard;
 	}
@@ -2511,8 +2511,8 @@ class WINDOW_API WPasswordDialog : public WDialog
 	{
 		guard(WPasswordDialog::OnInitDialog);
 		WDialog::OnInitDialog();
-		SetText( LocalizeQuery("PassDlg",TEXT("Core")) );
-		Prompt.SetText( LocalizeQuery("PassPrompt",TEXT("Core")) );
+		SetText( GLocalizeCache.LocalizeQuery(TEXT("PassDlg"),TEXT("Core")) );
+		Prompt.SetText( GLocalizeCache.LocalizeQuery(TEXT("PassPrompt"),TEXT("Core")) );
 		Name.SetText( TEXT("") );
 		Password.SetText( TEXT("") );
 		SetFocus( Name );
@@ -3542,9 +3542,9 @@ public:
 			FString Path, Left, Right;
 			GConfig->GetString( Property->GetOwnerClass()->GetPathName(), Property->GetName(), Path );
 			if( Path.Split(TEXT("."),&Left,&Right) )
-				appStrcpy( Str, Localize(*Right,TEXT("ClassCaption"),*Left) );
+				appStrcpy( Str, GLocalizeCache.Localize(*Right,TEXT("ClassCaption"),*Left) );
 			else
-				appStrcpy( Str, Localize("Language","Language",TEXT("Core"),*Path) );
+				appStrcpy( Str, GLocalizeCache.Localize(TEXT("Language"),TEXT("Language"),TEXT("Core"),*Path) );
 		}
 		else
 		{
@@ -3721,9 +3721,9 @@ public:
 					{
 						FString Path=Classes(i).Object, Left, Right;
 						if( Path.Split(TEXT("."),&Left,&Right) )
-							ComboControl->AddString( Localize(*Right,TEXT("ClassCaption"),*Left) );
+							ComboControl->AddString( GLocalizeCache.Localize(*Right,TEXT("ClassCaption"),*Left) );
 						else
-							ComboControl->AddString( Localize("Language","Language",TEXT("Core"),*Path) );
+							ComboControl->AddString( GLocalizeCache.Localize(TEXT("Language"),TEXT("Language"),TEXT("Core"),*Path) );
 					}
 					goto SkipTheRest;
 				}
@@ -3732,29 +3732,29 @@ public:
 			{
 				if( Expandable )
 				{
-					AddButton( LocalizeGeneral("AddButton",TEXT("Window")), FDelegate(this,(TDelegate)&FPropertyItem::OnArrayAdd) );
+					AddButton( GLocalizeCache.LocalizeGeneral(TEXT("AddButton"),TEXT("Window")), FDelegate(this,(TDelegate)&FPropertyItem::OnArrayAdd) );
 				}
-				AddButton( LocalizeGeneral("EmptyButton",TEXT("Window")), FDelegate(this,(TDelegate)&FPropertyItem::OnArrayEmpty) );
+				AddButton( GLocalizeCache.LocalizeGeneral(TEXT("EmptyButton"),TEXT("Window")), FDelegate(this,(TDelegate)&FPropertyItem::OnArrayEmpty) );
 			}
 			if( Cast<UArrayProperty>(Property->GetOuter()) )
 			{
 				if( Parent->Expandable )
 				{
-					AddButton( LocalizeGeneral("InsertButton",TEXT("Window")), FDelegate(this,(TDelegate)&FPropertyItem::OnArrayInsert) );
-					AddButton( LocalizeGeneral("DeleteButton",TEXT("Window")), FDelegate(this,(TDelegate)&FPropertyItem::OnArrayDelete) );
+					AddButton( GLocalizeCache.LocalizeGeneral(TEXT("InsertButton"),TEXT("Window")), FDelegate(this,(TDelegate)&FPropertyItem::OnArrayInsert) );
+					AddButton( GLocalizeCache.LocalizeGeneral(TEXT("DeleteButton"),TEXT("Window")), FDelegate(this,(TDelegate)&FPropertyItem::OnArrayDelete) );
 				}
 			}
 			if( Property->IsA(UStructProperty::StaticClass()) && appStricmp(Cast<UStructProperty>(Property)->Struct->GetName(),TEXT("Color"))==0 )
 			{
 				// Color.
-				AddButton( LocalizeGeneral("BrowseButton",TEXT("Window")), FDelegate(this,(TDelegate)&FPropertyItem::OnChooseColorButton) );
+				AddButton( GLocalizeCache.LocalizeGeneral(TEXT("BrowseButton"),TEXT("Window")), FDelegate(this,(TDelegate)&FPropertyItem::OnChooseColorButton) );
 			}
 			else if( Property->IsA(UObjectProperty::StaticClass()) )
 			{
 				// Class.
-				AddButton( LocalizeGeneral("BrowseButton",TEXT("Window")), FDelegate(this,(TDelegate)&FPropertyItem::OnBrowseButton) );
-				AddButton( LocalizeGeneral("UseButton",   TEXT("Window")), FDelegate(this,(TDelegate)&FPropertyItem::OnUseCurrentButton) );
-				AddButton( LocalizeGeneral("ClearButton", TEXT("Window")), FDelegate(this,(TDelegate)&FPropertyItem::OnClearButton) );
+				AddButton( GLocalizeCache.LocalizeGeneral(TEXT("BrowseButton"),TEXT("Window")), FDelegate(this,(TDelegate)&FPropertyItem::OnBrowseButton) );
+				AddButton( GLocalizeCache.LocalizeGeneral(TEXT("UseButton"),   TEXT("Window")), FDelegate(this,(TDelegate)&FPropertyItem::OnUseCurrentButton) );
+				AddButton( GLocalizeCache.LocalizeGeneral(TEXT("ClearButton"), TEXT("Window")), FDelegate(this,(TDelegate)&FPropertyItem::OnClearButton) );
 			}
 			if
 			(	(Property->IsA(UFloatProperty ::StaticClass()))
@@ -4671,11 +4671,11 @@ public:
 		if( Caption.Len() )
 			return Caption;			
 		else if( !BaseClass )
-			return LocalizeGeneral("PropNone",TEXT("Window"));
+			return GLocalizeCache.LocalizeGeneral(TEXT("PropNone"),TEXT("Window"));
 		else if( _Objects.Num()==1 )
-			return FString::Printf( LocalizeGeneral("PropSingle",TEXT("Window")), BaseClass->GetName() );
+			return FString::Printf( GLocalizeCache.LocalizeGeneral(TEXT("PropSingle"),TEXT("Window")), BaseClass->GetName() );
 		else
-			return FString::Printf( LocalizeGeneral("PropMulti",TEXT("Window")), BaseClass->GetName(), _Objects.Num() );
+			return FString::Printf( GLocalizeCache.LocalizeGeneral(TEXT("PropMulti"),TEXT("Window")), BaseClass->GetName(), _Objects.Num() );
 
 		unguard;
 	}
@@ -4869,7 +4869,7 @@ public:
 				TCHAR Path[4096], *Str;
 				appStrcpy( Path, *Classes(i).Object );
 				Str = appStrstr(Path,TEXT("."));
-				const TCHAR* Text = Str ? (*Str++=0,Localize(Str,TEXT("ClassCaption"),Path)) : Localize("Language","Language",TEXT("Core"),Path);
+				const TCHAR* Text = Str ? (*Str++=0,GLocalizeCache.Localize(Str,TEXT("ClassCaption"),Path)) : GLocalizeCache.Localize(TEXT("Language"),TEXT("Language"),TEXT("Core"),Path);
 					if( appStricmp( Text, Value )==0 )
 						GConfig->SetString( Property->GetOwnerClass()->GetPathName(), Property->GetName(), *Classes(i).Object );
 			}
@@ -4905,7 +4905,7 @@ public:
 	void OnItemSetFocus()
 	{
 		FPropertyItemBase::OnItemSetFocus();
-		AddButton( LocalizeGeneral("DefaultsButton",TEXT("Window")), FDelegate(this,(TDelegate)&FObjectConfigItem::OnResetToDefaultsButton) );
+		AddButton( GLocalizeCache.LocalizeGeneral(TEXT("DefaultsButton"),TEXT("Window")), FDelegate(this,(TDelegate)&FObjectConfigItem::OnResetToDefaultsButton) );
 	}
 	void Expand()
 	{
@@ -4945,7 +4945,7 @@ public:
 			if( !Class )
 			{
 				Failed = 1;
-				Caption = FString::Printf( LocalizeError("FailedConfigLoad",TEXT("Window")), ClassName );
+				Caption = FString::Printf( GLocalizeCache.LocalizeError(TEXT("FailedConfigLoad"),TEXT("Window")), ClassName );
 			}
 		}
 		unguard;
@@ -5079,11 +5079,11 @@ class WINDOW_API WWizardPage : public WDialog
 	}
 	virtual const TCHAR* GetBackText()
 	{
-		return LocalizeGeneral("BackButton",TEXT("Window"));
+		return GLocalizeCache.LocalizeGeneral(TEXT("BackButton"),TEXT("Window"));
 	}
 	virtual const TCHAR* GetNextText()
 	{
-		return LocalizeGeneral("NextButton",TEXT("Window"));
+		return GLocalizeCache.LocalizeGeneral(TEXT("NextButton"),TEXT("Window"));
 	}
 	virtual const TCHAR* GetFinishText()
 	{
@@ -5091,7 +5091,7 @@ class WINDOW_API WWizardPage : public WDialog
 	}
 	virtual const TCHAR* GetCancelText()
 	{
-		return LocalizeGeneral("CancelButton",TEXT("Window"));
+		return GLocalizeCache.LocalizeGeneral(TEXT("CancelButton"),TEXT("Window"));
 	}
 	virtual UBOOL GetShow()
 	{